@@ -21,6 +21,7 @@ from tf import TransformListener
 from tf.transformations import euler_from_quaternion, quaternion_from_euler
 
 import poop_scoop.srv
+import sbpl_lattice_planner.srv
 from subscription_buffer import SubscriptionBuffer
 
 from haptic_poop_drop_checker import HapticPoopDropChecker
@@ -28,6 +29,7 @@ from haptic_poop_drop_checker import HapticPoopDropChecker
 RESENSE_TIMEOUT = 10.0
 WORKING_DIST_FROM_POOP = 0.58 #0.65  #0.55
 STAGE1_OFFSET = 0.15
+TOUR_SERVICE = '/move_base_node/SBPLLatticePlanner/plan_tour'
 #START_X = 10
 #START_Y = 10
 #START_YAW = 0
@@ -253,13 +255,39 @@ def dist_between(x1, y1, x2, y2):
 
 
 def scoop_poops_and_go_back(base, scooper, poops):
-    """poops is a list of tuples (map_x, map_y)."""
+    """poops is a list of tuples (map_x, map_y), visited in tour order."""
+    poops = order_poops_by_tour(base, poops)
+    loginfo("Poops (map x, map y) in tour order: %s" % poops)
     for poop in poops:
       if go_to_scoop_poop_at(base, poop[0], poop[1],0):
           scooper.scoop()
 #    base.go_to_start()
 
 
+def order_poops_by_tour(base, poops):
+    """Ask the global planner for the shortest order to visit poops (a list
+    of tuples (map_x, map_y)) in, falling back to sorting them by distance."""
+    base_x = base.get_x_map()
+    base_y = base.get_y_map()
+    try:
+        rospy.wait_for_service(TOUR_SERVICE, 2.0)
+        plan_tour = rospy.ServiceProxy(TOUR_SERVICE,
+                                       sbpl_lattice_planner.srv.PlanTour)
+        start = PoseStamped(header=Header(frame_id='/map', stamp=Time.now()),
+                            pose=base._x_y_yaw_to_pose(base_x, base_y,
+                                                       base.get_yaw_map()))
+        goals = [PoseStamped(header=start.header,
+                             pose=base._x_y_yaw_to_pose(p[0], p[1], 0))
+                 for p in poops]
+        tour = plan_tour(start=start, goals=goals, plan_legs=False)
+        loginfo("Tour through %d of %d poops, estimated cost %d" %
+                (len(tour.order), len(poops), tour.total_cost))
+        return [poops[i] for i in tour.order]
+    except (rospy.ROSException, rospy.ServiceException), e:
+        logerr("Tour planning failed (%s), visiting the closest poops first." % e)
+        return sorted(poops, key=lambda p: dist_between(p[0], p[1], base_x, base_y))
+
+
 def get_lowest_2d_poop(points2d):
     poops2d = [(p.x, p.y) for p in points if p.z != 25]
     loginfo("Got the following 2d real poops: %s" % poops2d)
@@ -424,17 +452,7 @@ def main():
         poops = hall2_poops
         loginfo("Got the following FAKE poops: %s" % poops)
         
-        base_x = base.get_x_map()
-        base_y = base.get_y_map()
-        poops_w_dist = [(p[0], p[1], dist_between(p[0], p[1], base_x, base_y))
-                        for p in poops]
-        def get_dist(poop_w_dist):
-            return poop_w_dist[2]
-        poops_w_dist.sort(key=get_dist)
-        loginfo("Poops (map x, map y, distance) sorted by distance: %s" %
-                poops_w_dist)
-        
-        scoop_poops_and_go_back(base, scooper, poops_w_dist)
+        scoop_poops_and_go_back(base, scooper, poops)
     elif mode == 'v4':
         poop_perception = SubscriptionBuffer('/poo_view', PointCloud,
                                              blocking=True)
@@ -471,6 +489,14 @@ def main():
             if closest[2] > 1.5:
               loginfo("[stage 1] Closest poop is too far.");
               continue
+
+            # Of the poops in reach, go to the first stop of the tour through all of them
+            in_reach = [(p[0], p[1]) for p in poops_w_dist if p[2] <= 1.5]
+            if len(in_reach) > 1:
+              tour = order_poops_by_tour(base, in_reach)
+              if len(tour) > 0:
+                closest = (tour[0][0], tour[0][1],
+                           dist_between(tour[0][0], tour[0][1], base_x, base_y))
         
             visualize_poop(closest[0],closest[1],0.02,0,"/map","sensed_poop")
             x, y, yaw = calc_work_x_y_yaw(base_x, base_y, closest[0],closest[1],STAGE1_OFFSET)
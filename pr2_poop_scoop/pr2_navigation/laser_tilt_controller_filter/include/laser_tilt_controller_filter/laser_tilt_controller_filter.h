@@ -40,6 +40,8 @@
 #include <filters/filter_base.h>
 #include <pr2_msgs/LaserScannerSignal.h>
 #include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <cmath>
 
 namespace laser_tilt_controller_filter {
   
@@ -50,7 +52,7 @@ namespace laser_tilt_controller_filter {
   class LaserTiltControllerFilter : public filters::FilterBase<sensor_msgs::LaserScan>
   {
     public:
-      LaserTiltControllerFilter(): signal_received_(false){}
+      LaserTiltControllerFilter(): uniform_sections_(false), section_length_(0.0), timer_seq_(0), signal_received_(false){}
 
       bool loadFilterSignals(){
         XmlRpc::XmlRpcValue filter_sections;
@@ -120,9 +122,72 @@ namespace laser_tilt_controller_filter {
         return true;
       }
 
+      /**
+       * @brief  Turn the profile times and filter signals into a table with one
+       * entry per section, so that update() only has to locate the section of a scan
+       */
+      bool compileSections(){
+        for(unsigned int i = 1; i < tilt_profile_times_.size(); ++i){
+          //written so that NaN times are rejected as well
+          if(!(tilt_profile_times_[i] >= tilt_profile_times_[i - 1])){
+            ROS_ERROR("The tilt_profile_times must be in increasing order");
+            return false;
+          }
+        }
+        if(!(tilt_profile_times_.back() > tilt_profile_times_.front())){
+          ROS_ERROR("The tilt_profile_times must span a period of non-zero length");
+          return false;
+        }
+
+        unsigned int num_sections = tilt_profile_times_.size() - 1;
+        section_filtered_.assign(num_sections, 0);
+        for(unsigned int i = 0; i < filter_signals_.size(); ++i){
+          if(filter_signals_[i] < 0 || filter_signals_[i] >= (int)num_sections){
+            ROS_WARN("Filter section %d is not part of the tilt profile, which has %u sections", filter_signals_[i], num_sections);
+            continue;
+          }
+          section_filtered_[filter_signals_[i]] = 1;
+        }
+
+        //when all the sections have the same length, the section of a time can be computed directly
+        section_length_ = (tilt_profile_times_.back() - tilt_profile_times_.front()) / num_sections;
+        uniform_sections_ = section_length_ > 0.0;
+        for(unsigned int i = 0; i < num_sections && uniform_sections_; ++i){
+          double length = tilt_profile_times_[i + 1] - tilt_profile_times_[i];
+          if(fabs(length - section_length_) > 1e-9 * section_length_ + 1e-12)
+            uniform_sections_ = false;
+        }
+        return true;
+      }
+
+      /**
+       * @brief  Get the section [t_i, t_i+1) of the profile that contains a time
+       * @param period_time The time within the period of the profile
+       * @return The index of the section, 0 if the time is outside the profile or not a number
+       */
+      int getProfileSection(double period_time) const {
+        const std::vector<double>& times = tilt_profile_times_;
+        int num_sections = times.size() - 1;
+        if(!(period_time >= times.front() && period_time < times.back()))
+          return 0;
+
+        int section;
+        if(uniform_sections_){
+          section = std::min(int((period_time - times.front()) / section_length_), num_sections - 1);
+          //the division may round across a boundary
+          if(period_time < times[section])
+            --section;
+          else if(section < num_sections - 1 && period_time >= times[section + 1])
+            ++section;
+        }
+        else
+          section = std::upper_bound(times.begin(), times.end(), period_time) - times.begin() - 1;
+        return section;
+      }
+
       bool configure(){
         ROS_DEBUG("Filtering initialized");
-        bool success = loadTiltProfileTiming() && loadFilterSignals();
+        bool success = loadTiltProfileTiming() && loadFilterSignals() && compileSections();
 
         ros::NodeHandle n;
         signal_sub_ = n.subscribe("laser_tilt_controller/laser_scanner_signal", 1, &LaserTiltControllerFilter::signalCb, this);
@@ -130,55 +195,65 @@ namespace laser_tilt_controller_filter {
       }
 
       void signalCb(const pr2_msgs::LaserScannerSignal::ConstPtr& signal){
-        boost::mutex::scoped_lock lock(mutex_);
         //we'll sync the timer to the signal for the beginning of the profile to make sure we don't drift
         if(signal->signal == 0){
+          //the mutex only orders writers, scans read the timer through the sequence counter
+          boost::mutex::scoped_lock lock(mutex_);
+          __sync_fetch_and_add(&timer_seq_, 1);
           timer_zero_ = signal->header.stamp;
           signal_received_ = true;
+          __sync_fetch_and_add(&timer_seq_, 1);
         }
       }
 
-      bool update(const sensor_msgs::LaserScan& scan_in, sensor_msgs::LaserScan& scan_out){
-        ROS_DEBUG("Signal filter running, current timer %.4f, signal_received: %d", timer_zero_.toSec(), signal_received_);
+      /**
+       * @brief  Read the start of the current profile without blocking the signal callback
+       * @param timer_zero Will be set to the stamp of the last start signal
+       * @return True if a start signal has been received
+       */
+      bool readTimerZero(ros::Time& timer_zero) const {
+        unsigned int seq_begin, seq_end;
+        bool received;
+        do {
+          seq_begin = timer_seq_;
+          __sync_synchronize();
+          timer_zero = timer_zero_;
+          received = signal_received_;
+          __sync_synchronize();
+          seq_end = timer_seq_;
+        } while((seq_begin & 1) || seq_begin != seq_end);
+        return received;
+      }
+
+      /**
+       * @brief  Check whether a scan falls in one of the filtered sections of the profile
+       * @param stamp The stamp of the scan
+       * @return True if the scan should be thrown out
+       */
+      bool isScanFiltered(const ros::Time& stamp) const {
         //make sure that we've received at least one scanner signal before throwing out scans
-        if(!signal_received_){
-          scan_out = scan_in;
-          return true;
-        }
+        ros::Time timer_zero;
+        if(!readTimerZero(timer_zero))
+          return false;
 
-        boost::mutex::scoped_lock lock(mutex_);
-        double time_diff = (scan_in.header.stamp - timer_zero_).toSec() + tilt_profile_times_.front();
+        double time_diff = (stamp - timer_zero).toSec() + tilt_profile_times_.front();
 
         //make sure to put the time within the period of the profile
-        ROS_DEBUG("time_diff: %.4f, periold: %.4f", time_diff, tilt_profile_times_.back());
         double period_time = fmod(time_diff, tilt_profile_times_.back());
+        return section_filtered_[getProfileSection(period_time)];
+      }
 
-        int profile_section = 0;
-        //get the period in which the scan falls
-        for(unsigned int i = 0; i < tilt_profile_times_.size() - 1; ++i){
-          ROS_DEBUG("Checking period_time: %.4f against tilt_profile time: %.4f and next %.4f", 
-              period_time, tilt_profile_times_[i], tilt_profile_times_[i+1]);
-          if(period_time >= tilt_profile_times_[i] && period_time < tilt_profile_times_[i + 1]){
-            profile_section = i;
-          }
-        }
-
-        ROS_DEBUG("Profile section: %d, time: %.4f", profile_section, scan_in.header.stamp.toSec());
+      bool update(const sensor_msgs::LaserScan& scan_in, sensor_msgs::LaserScan& scan_out){
+        if(&scan_out != &scan_in)
+          scan_out = scan_in;
 
         //check if our current tilt signal is one that should be filtered
-        for(unsigned int i = 0; i < filter_signals_.size(); ++i){
-          if(filter_signals_[i] == profile_section){
-            sensor_msgs::LaserScan empty_scan;
-            empty_scan.header = scan_in.header;
-            scan_out = empty_scan;
-            ROS_DEBUG("Filtering out scan");
-            return true;
-          }
+        if(isScanFiltered(scan_in.header.stamp)){
+          //invalidate every reading at once, past the max range like the other filters do
+          std::fill(scan_out.ranges.begin(), scan_out.ranges.end(), scan_out.range_max + 1.0);
+          std::fill(scan_out.intensities.begin(), scan_out.intensities.end(), 0.0);
+          ROS_DEBUG("Filtering out scan");
         }
-
-        //if we made it here, then the tilt signal does not need to be
-        //filtered, so we'll just send the scan on
-        scan_out = scan_in;
         return true;
       }
 
@@ -187,6 +262,10 @@ namespace laser_tilt_controller_filter {
     private:
       std::vector<int> filter_signals_;
       std::vector<double> tilt_profile_times_;
+      std::vector<char> section_filtered_;
+      bool uniform_sections_;
+      double section_length_;
+      volatile unsigned int timer_seq_;
       ros::Time timer_zero_;
       boost::mutex mutex_;
       bool signal_received_;
@@ -42,20 +42,24 @@ This is useful for ground plane extraction
 **/
 
 
-#include "filters/filter_base.h"
+#include "pr2_laser_filters/scan_mask_filter.h"
 #include "sensor_msgs/LaserScan.h"
 #include "tf/transform_listener.h"
 #include "sensor_msgs/PointCloud.h"
 #include "ros/ros.h"
-#include "laser_geometry/laser_geometry.h"
+#include "pr2_navigation_self_filter/transform_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
 
 namespace pr2_laser_filters
 {
 
-class PR2LaserScanFootprintFilterNew : public filters::FilterBase<sensor_msgs::LaserScan>
+class PR2LaserScanFootprintFilterNew : public ScanMaskFilter
 {
 public:
-  PR2LaserScanFootprintFilterNew(){}
+  PR2LaserScanFootprintFilterNew() : tfc_(tf_), beam_angle_min_(0.0), beam_angle_increment_(0.0) {}
 
   bool configure()
   {
@@ -72,49 +76,33 @@ public:
 
   }
 
-  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
+  bool mask(const sensor_msgs::LaserScan& input_scan, std::vector<unsigned char>& keep, unsigned int& num_rejected)
   {
-    filtered_scan = input_scan ;
-    sensor_msgs::PointCloud laser_cloud;
-
-    try{
-    projector_.transformLaserScanToPointCloud("base_link", input_scan, laser_cloud, tf_);
-    }
-    catch(tf::TransformException& ex){
-      ROS_ERROR("Transform unavailable %s", ex.what());
+    num_rejected = 0;
+    btTransform to_base;
+    if (!tfc_.lookup("base_link", input_scan.header.stamp, input_scan.header.frame_id, to_base, ros::Duration(0.2)))
+    {
+      ROS_ERROR("Transform unavailable from %s to base_link", input_scan.header.frame_id.c_str());
       return false;
     }
+    updateBeams(input_scan);
+    updateRangeLimits(to_base);
 
-    int c_idx = indexChannel(laser_cloud);
-
-    if (c_idx == -1 || laser_cloud.channels[c_idx].values.size () == 0){
-      ROS_ERROR("We need an index channel to be able to filter out the footprint");
-      return false;
-    }
-    
-    for (unsigned int i=0; i < laser_cloud.points.size(); i++)  
+    // A beam hits the footprint when its range falls between the ranges at
+    // which its ray enters and leaves the footprint box
+    for (unsigned int i = 0; i < input_scan.ranges.size(); i++)
     {
-      if (inFootprint(laser_cloud.points[i])){
-        int index = laser_cloud.channels[c_idx].values[i];
-        filtered_scan.ranges[index] = filtered_scan.range_max + 1.0 ; // If so, then make it a value bigger than the max range
+      const float range = input_scan.ranges[i];
+      if (keep[i] && range >= range_enter_[i] && range <= range_exit_[i] &&
+          range > input_scan.range_min && range < input_scan.range_max)
+      {
+        keep[i] = 0;
+        num_rejected++;
       }
     }
     return true;
   }
 
-  int indexChannel(const sensor_msgs::PointCloud& scan_cloud){
-      int c_idx = -1;
-      for (unsigned int d = 0; d < scan_cloud.get_channels_size (); d++)
-      {
-        if (scan_cloud.channels[d].name == "index")
-        {
-          c_idx = d;
-          break;
-        }
-      }
-      return c_idx;
-  }
-
   bool inFootprint(const geometry_msgs::Point32& scan_pt){
     if(scan_pt.x < -1.0 * inscribed_radius_ || scan_pt.x > inscribed_radius_ || scan_pt.y < -1.0 * inscribed_radius_ || scan_pt.y > inscribed_radius_)
       return false;
@@ -122,9 +110,82 @@ public:
   }
 
 private:
+  /** \brief Recompute the beam directions if the angles of the scan changed */
+  void updateBeams(const sensor_msgs::LaserScan& scan)
+  {
+    if (beam_cos_.size() == scan.ranges.size() && beam_angle_min_ == scan.angle_min &&
+        beam_angle_increment_ == scan.angle_increment)
+      return;
+    beam_angle_min_ = scan.angle_min;
+    beam_angle_increment_ = scan.angle_increment;
+    beam_cos_.resize(scan.ranges.size());
+    beam_sin_.resize(scan.ranges.size());
+    for (unsigned int i = 0; i < scan.ranges.size(); i++)
+    {
+      double angle = scan.angle_min + i * scan.angle_increment;
+      beam_cos_[i] = cos(angle);
+      beam_sin_[i] = sin(angle);
+    }
+    // the range limits belong to the old beams
+    range_enter_.clear();
+  }
+
+  /** \brief Recompute the range interval in which each beam is inside the
+      footprint if the laser moved with respect to base_link */
+  void updateRangeLimits(const btTransform& to_base)
+  {
+    if (range_enter_.size() == beam_cos_.size() && to_base == range_limits_transform_)
+      return;
+    range_limits_transform_ = to_base;
+    range_enter_.resize(beam_cos_.size());
+    range_exit_.resize(beam_cos_.size());
+
+    // The ray of beam i in base_link is o + t d_i, with d_i the rotated beam
+    // direction. Clip t against the two slabs |x| <= r and |y| <= r.
+    const btMatrix3x3 &basis = to_base.getBasis();
+    const double origin[2] = { to_base.getOrigin().x(), to_base.getOrigin().y() };
+    for (unsigned int i = 0; i < beam_cos_.size(); i++)
+    {
+      double t_min = 0.0, t_max = std::numeric_limits<double>::infinity();
+      for (int k = 0; k < 2; k++)
+      {
+        double dir = basis[k].x() * beam_cos_[i] + basis[k].y() * beam_sin_[i];
+        if (fabs(dir) < 1e-9)
+        {
+          if (fabs(origin[k]) > inscribed_radius_)
+            t_max = -1.0;
+          continue;
+        }
+        double t1 = (-inscribed_radius_ - origin[k]) / dir;
+        double t2 = (inscribed_radius_ - origin[k]) / dir;
+        t_min = std::max(t_min, std::min(t1, t2));
+        t_max = std::min(t_max, std::max(t1, t2));
+      }
+      if (t_min > t_max)
+      {
+        // the beam never crosses the footprint
+        range_enter_[i] = std::numeric_limits<float>::infinity();
+        range_exit_[i] = -std::numeric_limits<float>::infinity();
+      }
+      else
+      {
+        range_enter_[i] = t_min;
+        range_exit_[i] = t_max;
+      }
+    }
+  }
+
   tf::TransformListener tf_;
-  laser_geometry::LaserProjection projector_;
+  robot_self_filter::TransformCache tfc_;
   double inscribed_radius_;
+
+  // per-beam directions in the laser frame
+  double beam_angle_min_, beam_angle_increment_;
+  std::vector<double> beam_cos_, beam_sin_;
+
+  // per-beam ranges at which the ray enters and leaves the footprint
+  btTransform range_limits_transform_;
+  std::vector<float> range_enter_, range_exit_;
 } ;
 
 }
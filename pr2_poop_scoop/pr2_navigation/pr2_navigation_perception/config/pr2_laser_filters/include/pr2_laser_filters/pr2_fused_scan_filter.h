@@ -0,0 +1,291 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  FOOTPRINTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef PR2_FUSED_SCAN_FILTER_H
+#define PR2_FUSED_SCAN_FILTER_H
+/**
+@b PR2FusedScanFilter runs a list of per-beam filters over a single keep
+mask and writes the scan once, instead of copying the scan between the
+stages of a filter chain. The stages are listed in the "stages" parameter
+with the same name/type/params layout as a filter chain. Supported types:
+
+  PR2LaserScanFootprintFilterNew
+  laser_tilt_controller_filter/LaserTiltControllerFilter
+  LaserScanRangeFilter      (lower_threshold, upper_threshold on the range)
+  LaserScanIntensityFilter  (lower_threshold, upper_threshold on the intensity)
+
+Each stage keeps count of the beams it rejects and of the time it takes;
+with report_interval set, the counts are printed every report_interval scans.
+
+**/
+
+#include "pr2_laser_filters/scan_mask_filter.h"
+#include "pr2_laser_filters/pr2_footprint_filter.h"
+#include "laser_tilt_controller_filter/laser_tilt_controller_filter.h"
+#include "ros/ros.h"
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace pr2_laser_filters
+{
+
+/** \brief Drops the beams with a range outside (lower_threshold, upper_threshold) */
+class PR2LaserScanRangeMaskFilter : public ScanMaskFilter
+{
+public:
+  bool configure()
+  {
+    if (!getParam("lower_threshold", lower_threshold_) || !getParam("upper_threshold", upper_threshold_))
+    {
+      ROS_ERROR("PR2LaserScanRangeMaskFilter needs lower_threshold and upper_threshold to be set");
+      return false;
+    }
+    return true;
+  }
+
+  bool mask(const sensor_msgs::LaserScan& scan, std::vector<unsigned char>& keep, unsigned int& num_rejected)
+  {
+    num_rejected = 0;
+    const float lower = lower_threshold_, upper = upper_threshold_;
+    for (unsigned int i = 0; i < scan.ranges.size(); i++)
+    {
+      if (keep[i] && (scan.ranges[i] <= lower || scan.ranges[i] >= upper))
+      {
+        keep[i] = 0;
+        num_rejected++;
+      }
+    }
+    return true;
+  }
+
+private:
+  double lower_threshold_, upper_threshold_;
+} ;
+
+/** \brief Drops the beams with an intensity outside (lower_threshold, upper_threshold) */
+class PR2LaserScanIntensityMaskFilter : public ScanMaskFilter
+{
+public:
+  bool configure()
+  {
+    if (!getParam("lower_threshold", lower_threshold_) || !getParam("upper_threshold", upper_threshold_))
+    {
+      ROS_ERROR("PR2LaserScanIntensityMaskFilter needs lower_threshold and upper_threshold to be set");
+      return false;
+    }
+    return true;
+  }
+
+  bool mask(const sensor_msgs::LaserScan& scan, std::vector<unsigned char>& keep, unsigned int& num_rejected)
+  {
+    num_rejected = 0;
+    if (scan.intensities.size() != scan.ranges.size())
+    {
+      ROS_ERROR("The scan has %u intensities for %u ranges", (unsigned int)scan.intensities.size(), (unsigned int)scan.ranges.size());
+      return false;
+    }
+    const float lower = lower_threshold_, upper = upper_threshold_;
+    for (unsigned int i = 0; i < scan.intensities.size(); i++)
+    {
+      if (keep[i] && (scan.intensities[i] <= lower || scan.intensities[i] >= upper))
+      {
+        keep[i] = 0;
+        num_rejected++;
+      }
+    }
+    return true;
+  }
+
+private:
+  double lower_threshold_, upper_threshold_;
+} ;
+
+/** \brief Drops whole scans taken in the filtered sections of the tilt profile */
+class PR2TiltSectionMaskFilter : public ScanMaskFilter
+{
+public:
+  PR2TiltSectionMaskFilter(const boost::shared_ptr<laser_tilt_controller_filter::LaserTiltControllerFilter>& tilt) : tilt_(tilt) {}
+
+  /** \brief The tilt filter is configured before it is handed over */
+  bool configure()
+  {
+    return true;
+  }
+
+  bool mask(const sensor_msgs::LaserScan& scan, std::vector<unsigned char>& keep, unsigned int& num_rejected)
+  {
+    num_rejected = 0;
+    if (!tilt_->isScanFiltered(scan.header.stamp))
+      return true;
+    for (unsigned int i = 0; i < keep.size(); i++)
+      num_rejected += keep[i];
+    std::fill(keep.begin(), keep.end(), 0);
+    return true;
+  }
+
+private:
+  boost::shared_ptr<laser_tilt_controller_filter::LaserTiltControllerFilter> tilt_;
+} ;
+
+class PR2FusedScanFilter : public ScanMaskFilter
+{
+public:
+  /** \brief What one stage did since the filter was configured */
+  struct StageStats
+  {
+    StageStats() : beams(0), rejected(0), seconds(0.0) {}
+
+    std::string name;
+    unsigned long long beams;
+    unsigned long long rejected;
+    double seconds;
+  };
+
+  PR2FusedScanFilter() : report_interval_(0), num_scans_(0) {}
+
+  bool configure()
+  {
+    XmlRpc::XmlRpcValue stages;
+    if (!getParam("stages", stages) || stages.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+      ROS_ERROR("PR2FusedScanFilter needs a list of stages");
+      return false;
+    }
+    int report_interval = 0;
+    getParam("report_interval", report_interval);
+    report_interval_ = report_interval > 0 ? report_interval : 0;
+
+    stages_.clear();
+    stats_.clear();
+    for (int i = 0; i < stages.size(); i++)
+    {
+      if (stages[i].getType() != XmlRpc::XmlRpcValue::TypeStruct || !stages[i].hasMember("name") || !stages[i].hasMember("type"))
+      {
+        ROS_ERROR("Stage %d of PR2FusedScanFilter needs a name and a type", i);
+        return false;
+      }
+      std::string name = std::string(stages[i]["name"]);
+      std::string type = std::string(stages[i]["type"]);
+
+      boost::shared_ptr<ScanMaskFilter> stage;
+      bool configured = false;
+      if (type == "laser_tilt_controller_filter/LaserTiltControllerFilter")
+      {
+        boost::shared_ptr<laser_tilt_controller_filter::LaserTiltControllerFilter> tilt(new laser_tilt_controller_filter::LaserTiltControllerFilter());
+        configured = tilt->filters::FilterBase<sensor_msgs::LaserScan>::configure(stages[i]);
+        stage.reset(new PR2TiltSectionMaskFilter(tilt));
+      }
+      else
+      {
+        if (type == "PR2LaserScanFootprintFilterNew")
+          stage.reset(new PR2LaserScanFootprintFilterNew());
+        else if (type == "LaserScanRangeFilter")
+          stage.reset(new PR2LaserScanRangeMaskFilter());
+        else if (type == "LaserScanIntensityFilter")
+          stage.reset(new PR2LaserScanIntensityMaskFilter());
+        else
+        {
+          ROS_ERROR("PR2FusedScanFilter cannot run stage %s of type %s", name.c_str(), type.c_str());
+          return false;
+        }
+        configured = stage->configure(stages[i]);
+      }
+
+      if (!configured)
+      {
+        ROS_ERROR("Failed to configure stage %s of PR2FusedScanFilter", name.c_str());
+        return false;
+      }
+      stages_.push_back(stage);
+      stats_.push_back(StageStats());
+      stats_.back().name = name;
+    }
+    return true;
+  }
+
+  virtual ~PR2FusedScanFilter()
+  {
+
+  }
+
+  bool mask(const sensor_msgs::LaserScan& scan, std::vector<unsigned char>& keep, unsigned int& num_rejected)
+  {
+    num_rejected = 0;
+    for (unsigned int s = 0; s < stages_.size(); s++)
+    {
+      ros::WallTime start = ros::WallTime::now();
+      unsigned int stage_rejected = 0;
+      if (!stages_[s]->mask(scan, keep, stage_rejected))
+        return false;
+      stats_[s].seconds += (ros::WallTime::now() - start).toSec();
+      stats_[s].beams += scan.ranges.size();
+      stats_[s].rejected += stage_rejected;
+      num_rejected += stage_rejected;
+    }
+
+    num_scans_++;
+    if (report_interval_ > 0 && num_scans_ % report_interval_ == 0)
+      report();
+    return true;
+  }
+
+  /** \brief Print the rejection counts and the time per beam of every stage */
+  void report() const
+  {
+    for (unsigned int s = 0; s < stats_.size(); s++)
+    {
+      const StageStats& st = stats_[s];
+      ROS_INFO("%s: rejected %llu of %llu beams, %.1f ns per beam", st.name.c_str(), st.rejected, st.beams,
+               st.beams > 0 ? st.seconds * 1e9 / st.beams : 0.0);
+    }
+  }
+
+  /** \brief Get the counts of every stage, in chain order */
+  const std::vector<StageStats>& getStats() const
+  {
+    return stats_;
+  }
+
+private:
+  std::vector<boost::shared_ptr<ScanMaskFilter> > stages_;
+  std::vector<StageStats> stats_;
+  unsigned int report_interval_;
+  unsigned long long num_scans_;
+} ;
+
+}
+
+#endif // PR2_FUSED_SCAN_FILTER_H
@@ -44,8 +44,11 @@ This is useful for ground plane extraction
 #include "laser_geometry/laser_geometry.h"
 #include "filters/filter_base.h"
 #include "tf/transform_listener.h"
+#include "pr2_navigation_self_filter/transform_cache.h"
 #include "sensor_msgs/PointCloud.h"
 #include "ros/ros.h"
+#include <cmath>
+#include <vector>
 
 namespace pr2_laser_filters
 {
@@ -53,7 +56,7 @@ namespace pr2_laser_filters
 class PR2PointCloudFootprintFilterNew : public filters::FilterBase<sensor_msgs::PointCloud>
 {
 public:
-  PR2PointCloudFootprintFilterNew() {}
+  PR2PointCloudFootprintFilterNew() : tfc_(tf_) {}
 
   bool configure()
   {
@@ -72,57 +75,91 @@ public:
 
   bool update(const sensor_msgs::PointCloud& input_scan, sensor_msgs::PointCloud& filtered_scan)
   {
-    if(&input_scan == &filtered_scan){
-      ROS_ERROR("This filter does not currently support in place copying");
+    // only the transform to base_link is needed: the footprint is brought
+    // into the frame of the cloud and the points are tested where they are
+    btTransform to_base;
+    if (!tfc_.lookup("base_link", input_scan.header.stamp, input_scan.header.frame_id, to_base, ros::Duration(0.2)))
+    {
+      ROS_ERROR("Transform unavailable from %s to base_link", input_scan.header.frame_id.c_str());
       return false;
     }
-    sensor_msgs::PointCloud laser_cloud;
 
-    try{
-      tf_.waitForTransform(input_scan.header.frame_id, "base_link", input_scan.header.stamp, ros::Duration(0.2));
-      tf_.transformPointCloud("base_link", input_scan, laser_cloud);
+    // In the cloud frame the footprint box (unbounded in z) is the
+    // intersection of two slabs, |n_x . p + o_x| <= r and |n_y . p + o_y| <= r,
+    // where n_x and n_y are the first two rows of the rotation to base_link
+    const btMatrix3x3 &basis = to_base.getBasis();
+    const double nx[3] = { basis[0].x(), basis[0].y(), basis[0].z() };
+    const double ny[3] = { basis[1].x(), basis[1].y(), basis[1].z() };
+    const double ox = to_base.getOrigin().x();
+    const double oy = to_base.getOrigin().y();
+    const double r = inscribed_radius_;
+
+    const unsigned int n = input_scan.points.size();
+    for (unsigned int d = 0; d < input_scan.get_channels_size (); d++)
+    {
+      if (input_scan.channels[d].values.size() != n)
+      {
+        ROS_ERROR("Channel %s has %u values for %u points", input_scan.channels[d].name.c_str(),
+                  (unsigned int)input_scan.channels[d].values.size(), n);
+        return false;
+      }
     }
-    catch(tf::TransformException& ex){
-      ROS_ERROR("Transform unavailable %s", ex.what());
-      return false;
+
+    keep_.resize(n);
+    unsigned int num_pts = 0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+      const geometry_msgs::Point32 &pt = input_scan.points[i];
+      double dx = nx[0] * pt.x + nx[1] * pt.y + nx[2] * pt.z + ox;
+      double dy = ny[0] * pt.x + ny[1] * pt.y + ny[2] * pt.z + oy;
+      keep_[i] = (std::fabs(dx) > r || std::fabs(dy) > r);
+      num_pts += keep_[i];
     }
 
+    // Compact the points and then each channel, one array at a time. When
+    // the filter runs in place the survivors are moved down within the input.
     filtered_scan.header = input_scan.header;
-    filtered_scan.points.resize (input_scan.points.size());
+    compact(input_scan.points, num_pts, filtered_scan.points);
     filtered_scan.channels.resize (input_scan.channels.size());
-    for (unsigned int d = 0; d < input_scan.get_channels_size (); d++){
-      filtered_scan.channels[d].values.resize  (input_scan.points.size());
-      filtered_scan.channels[d].name = input_scan.channels[d].name;
-    }
-
-    int num_pts = 0;
-    for (unsigned int i=0; i < laser_cloud.points.size(); i++)  
+    for (unsigned int d = 0; d < input_scan.get_channels_size (); d++)
     {
-      if (!inFootprint(laser_cloud.points[i])){
-        filtered_scan.points[num_pts] = input_scan.points[i];
-        for (unsigned int d = 0; d < filtered_scan.get_channels_size (); d++)
-          filtered_scan.channels[d].values[num_pts] = input_scan.channels[d].values[i];
-        num_pts++;
-      }
+      filtered_scan.channels[d].name = input_scan.channels[d].name;
+      compact(input_scan.channels[d].values, num_pts, filtered_scan.channels[d].values);
     }
 
-    // Resize output vectors
-    filtered_scan.points.resize (num_pts);
-    for (unsigned int d = 0; d < filtered_scan.get_channels_size (); d++)
-      filtered_scan.channels[d].values.resize (num_pts);
-
     return true;
   }
 
-
   bool inFootprint(const geometry_msgs::Point32& scan_pt){
     if(scan_pt.x < -1.0 * inscribed_radius_ || scan_pt.x > inscribed_radius_ || scan_pt.y < -1.0 * inscribed_radius_ || scan_pt.y > inscribed_radius_)
       return false;
     return true;
   }
 
+  bool inFootprint(const btVector3& scan_pt){
+    if(scan_pt.x() < -1.0 * inscribed_radius_ || scan_pt.x() > inscribed_radius_ || scan_pt.y() < -1.0 * inscribed_radius_ || scan_pt.y() > inscribed_radius_)
+      return false;
+    return true;
+  }
+
 private:
+  /** \brief Copy the elements of \e in flagged in keep_ to \e out, which may be \e in itself */
+  template <typename T>
+  void compact(const std::vector<T>& in, unsigned int num_kept, std::vector<T>& out)
+  {
+    // the survivors only ever move down, so this also works in place
+    if (&in != &out)
+      out.resize(num_kept);
+    unsigned int j = 0;
+    for (unsigned int i = 0; i < keep_.size(); i++)
+      if (keep_[i])
+        out[j++] = in[i];
+    out.resize(num_kept);
+  }
+
   tf::TransformListener tf_;
+  robot_self_filter::TransformCache tfc_;
+  std::vector<unsigned char> keep_;
   laser_geometry::LaserProjection projector_;
   double inscribed_radius_;
 } ;
@@ -0,0 +1,93 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  FOOTPRINTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef PR2_LASER_SCAN_MASK_FILTER_H
+#define PR2_LASER_SCAN_MASK_FILTER_H
+/**
+@b ScanMaskFilter is a laser scan filter that can report the beams it would
+remove instead of writing a new scan. Several of them can then share one
+mask and the scan is only written once (see PR2FusedScanFilter).
+
+**/
+
+#include "filters/filter_base.h"
+#include "sensor_msgs/LaserScan.h"
+#include <vector>
+
+namespace pr2_laser_filters
+{
+
+class ScanMaskFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+{
+public:
+  virtual ~ScanMaskFilter()
+  {
+
+  }
+
+  /** \brief Clear keep[i] for every beam i of \e scan that the filter
+      removes. Beams that are already cleared may be skipped.
+      \param num_rejected set to the number of entries cleared by this call */
+  virtual bool mask(const sensor_msgs::LaserScan& scan, std::vector<unsigned char>& keep, unsigned int& num_rejected) = 0;
+
+  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
+  {
+    keep_.assign(input_scan.ranges.size(), 1);
+    unsigned int num_rejected = 0;
+    if (!mask(input_scan, keep_, num_rejected))
+      return false;
+
+    if (&input_scan != &filtered_scan)
+      filtered_scan = input_scan;
+    if (num_rejected > 0)
+      invalidate(filtered_scan, keep_);
+    return true;
+  }
+
+  /** \brief Move the beams cleared in \e keep past the max range */
+  static void invalidate(sensor_msgs::LaserScan& scan, const std::vector<unsigned char>& keep)
+  {
+    const float max_range = scan.range_max + 1.0;
+    for (unsigned int i = 0; i < scan.ranges.size(); i++)
+      if (!keep[i])
+        scan.ranges[i] = max_range; // If so, then make it a value bigger than the max range
+  }
+
+private:
+  std::vector<unsigned char> keep_;
+} ;
+
+}
+
+#endif // PR2_LASER_SCAN_MASK_FILTER_H
@@ -29,7 +29,9 @@
 
 #include "sensor_msgs/LaserScan.h"
 #include "pr2_laser_filters/pr2_footprint_filter.h"
+#include "pr2_laser_filters/pr2_fused_scan_filter.h"
 #include "filters/filter_base.h"
 #include "pluginlib/class_list_macros.h"
 
 PLUGINLIB_REGISTER_CLASS(PR2LaserScanFootprintFilterNew, pr2_laser_filters::PR2LaserScanFootprintFilterNew, filters::FilterBase<sensor_msgs::LaserScan>)
+PLUGINLIB_REGISTER_CLASS(PR2FusedScanFilter, pr2_laser_filters::PR2FusedScanFilter, filters::FilterBase<sensor_msgs::LaserScan>)
@@ -41,6 +41,8 @@
 #include <LinearMath/btTransform.h>
 // #include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
 // #include <BulletCollision/CollisionShapes/btTriangleMesh.h>
+#include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -62,6 +64,49 @@ namespace bodies
 	double    radius;
     };
     
+    /** \brief Options for computing the convex hull of a mesh */
+    struct HullOptions
+    {
+	HullOptions(void) : maxPlanes(0), tolerance(0.0)
+	{
+	}
+	
+	/** \brief Merge hull planes until there are at most this many. 0 means no bound */
+	unsigned int maxPlanes;
+	
+	/** \brief Hull planes are merged as long as the hull grows by at most this distance */
+	double       tolerance;
+	
+	/** \brief If not empty, computed hulls (and preprocessed meshes) are stored in (and loaded from) this directory */
+	std::string  cacheDir;
+    };
+    
+    /** \brief Information about a computed convex hull */
+    struct HullStats
+    {
+	HullStats(void) : triangles(0), distinctPlanes(0), planes(0), error(0.0), fromCache(false)
+	{
+	}
+	
+	/** \brief The number of triangles of the hull */
+	unsigned int triangles;
+	
+	/** \brief The number of distinct planes of the hull, before simplification */
+	unsigned int distinctPlanes;
+	
+	/** \brief The number of planes used for containment tests */
+	unsigned int planes;
+	
+	/** \brief Estimate of how far the simplified hull extends beyond the actual one */
+	double       error;
+	
+	/** \brief The (plane count, estimated error) pairs obtained at each simplification step */
+	std::vector< std::pair<unsigned int, double> > tradeoff;
+	
+	/** \brief True if the hull was loaded from the cache */
+	bool         fromCache;
+    };
+    
     /** \brief A body is a shape + its pose. Point inclusion, ray
 	intersection can be tested, volumes and bounding spheres can
 	be computed.*/
@@ -365,6 +410,12 @@ namespace bodies
 	    setDimensions(shape);
 	}
 	
+	ConvexMesh(const shapes::Shape *shape, const HullOptions &options) : Body(), m_options(options)
+	{	  
+	    m_type = shapes::MESH;
+	    setDimensions(shape);
+	}
+	
 	virtual ~ConvexMesh(void)
 	{
 	}	
@@ -375,15 +426,37 @@ namespace bodies
 	virtual void computeBoundingSphere(BoundingSphere &sphere) const;
 	virtual bool intersectsRay(const btVector3& origin, const btVector3 &dir, std::vector<btVector3> *intersections = NULL, unsigned int count = 0) const;
 
+	/** \brief Get information about the hull used for containment tests */
+	const HullStats& getHullStats(void) const
+	{
+	    return m_stats;
+	}
+	
     protected:
 	
 	virtual void useDimensions(const shapes::Shape *shape);
 	virtual void updateInternalData(void);
 	
+	/** \brief Compute the convex hull of the mesh and its per-triangle planes */
+	void computeHull(const shapes::Mesh *mesh);
+	
+	/** \brief Merge the planes of the hull into the (smaller) set used for containment tests */
+	void simplifyPlanes(void);
+	
+	bool loadHull(const std::string &filename);
+	void saveHull(const std::string &filename) const;
+	
 	unsigned int countVerticesBehindPlane(const btVector4& planeNormal) const;
 	bool isPointInsidePlanes(const btVector3& point) const;
 	
+	HullOptions               m_options;
+	HullStats                 m_stats;
+	
+	/** \brief One plane per triangle, used for ray intersection */
 	std::vector<btVector4>    m_planes;
+	
+	/** \brief The planes used for containment tests */
+	std::vector<btVector4>    m_hullPlanes;
 	std::vector<btVector3>    m_vertices;
 	std::vector<btVector3>    m_scaledVertices;
 	std::vector<unsigned int> m_triangles;
@@ -403,6 +476,9 @@ namespace bodies
     /** \brief Create a body from a given shape */
     Body* createBodyFromShape(const shapes::Shape *shape);
     
+    /** \brief Create a body from a given shape; meshes use the specified hull options */
+    Body* createBodyFromShape(const shapes::Shape *shape, const HullOptions &options);
+    
     /** \brief Compute a bounding sphere to enclose a set of bounding spheres */
     void mergeBoundingSpheres(const std::vector<BoundingSphere> &spheres, BoundingSphere &mergedSphere);
     
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROBOT_SELF_FILTER_CLOUD_VIEW_
+#define ROBOT_SELF_FILTER_CLOUD_VIEW_
+
+#include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <LinearMath/btVector3.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace robot_self_filter
+{
+
+    /** \brief A read-only view of the coordinates of a point cloud as three
+     *  strided float32 arrays (x, y, z).
+     *
+     *  The view does not copy any data: for a sensor_msgs::PointCloud it
+     *  points into the Point32 array, for a sensor_msgs::PointCloud2 it
+     *  points into the data blob, using the offsets of the x, y and z
+     *  fields. The viewed message must outlive the view. */
+    class CloudView
+    {
+    public:
+	
+	/** \brief View a sensor_msgs::PointCloud */
+	explicit CloudView(const sensor_msgs::PointCloud &cloud);
+	
+	/** \brief View a sensor_msgs::PointCloud2. The cloud must have float32 x, y and z
+	    fields inside each point, data for all of its points and no padding at the end
+	    of rows, otherwise the view is not valid() */
+	explicit CloudView(const sensor_msgs::PointCloud2 &cloud);
+	
+	/** \brief Check if the viewed cloud could be interpreted */
+	bool valid(void) const
+	{
+	    return valid_;
+	}
+	
+	/** \brief The number of points in the view */
+	unsigned int size(void) const
+	{
+	    return size_;
+	}
+	
+	/** \brief The header of the viewed cloud */
+	const roslib::Header& header(void) const
+	{
+	    return *header_;
+	}
+	
+	float x(unsigned int i) const
+	{
+	    return *reinterpret_cast<const float*>(x_ + i * stride_);
+	}
+	
+	float y(unsigned int i) const
+	{
+	    return *reinterpret_cast<const float*>(y_ + i * stride_);
+	}
+	
+	float z(unsigned int i) const
+	{
+	    return *reinterpret_cast<const float*>(z_ + i * stride_);
+	}
+	
+	btVector3 point(unsigned int i) const
+	{
+	    return btVector3(x(i), y(i), z(i));
+	}
+	
+    private:
+	
+	const roslib::Header *header_;
+	const unsigned char  *x_;
+	const unsigned char  *y_;
+	const unsigned char  *z_;
+	unsigned int          stride_;
+	unsigned int          size_;
+	bool                  valid_;
+    };
+    
+    /** \brief Pack a mask (one byte per point) into a bitmask with one bit
+	per point. The bit for point \e i is set if (mask[i] == value) == equal */
+    void packMask(const std::vector<unsigned char> &mask, unsigned char value, bool equal, std::vector<uint32_t> &bits);
+    
+    /** \brief Count the number of bits set in a bitmask of \e n points */
+    unsigned int countSet(const std::vector<uint32_t> &bits, unsigned int n);
+    
+    /** \brief Find the first point at index \e i or later whose bit equals \e set. Returns \e n if there is no such point */
+    inline unsigned int findNext(const std::vector<uint32_t> &bits, unsigned int n, unsigned int i, bool set)
+    {
+	while (i < n)
+	{
+	    uint32_t w = bits[i >> 5];
+	    if (!set)
+		w = ~w;
+	    w &= ~0u << (i & 31);
+	    if (w)
+	    {
+		i = (i & ~31u) + __builtin_ctz(w);
+		return i < n ? i : n;
+	    }
+	    i = (i & ~31u) + 32;
+	}
+	return n;
+    }
+    
+    /** \brief Call \e f(begin, end) for every maximal run [begin, end) of consecutive points whose bit is set */
+    template<typename F>
+    void forEachSetRun(const std::vector<uint32_t> &bits, unsigned int n, F f)
+    {
+	unsigned int i = findNext(bits, n, 0, true);
+	while (i < n)
+	{
+	    unsigned int e = findNext(bits, n, i, false);
+	    f(i, e);
+	    i = findNext(bits, n, e, true);
+	}
+    }
+    
+    /** \brief Copy the points (and channel values) whose bit is set from \e data_in to \e data_out.
+	Runs of consecutive kept points are copied as blocks. \e data_out must not be \e data_in */
+    void compactCloud(const sensor_msgs::PointCloud &data_in, const std::vector<uint32_t> &bits, sensor_msgs::PointCloud &data_out);
+    
+    /** \brief Copy the points whose bit is set from \e data_in to \e data_out. The output is an
+	unorganized (height 1) cloud with the same fields. \e data_out must not be \e data_in */
+    void compactCloud(const sensor_msgs::PointCloud2 &data_in, const std::vector<uint32_t> &bits, sensor_msgs::PointCloud2 &data_out);
+    
+}
+
+#endif
@@ -32,11 +32,19 @@
 
 #include <sensor_msgs/PointCloud.h>
 #include <pr2_navigation_self_filter/bodies.h>
+#include <pr2_navigation_self_filter/cloud_view.h>
+#include <pr2_navigation_self_filter/transform_cache.h>
 #include <tf/transform_listener.h>
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
 #include <string>
 #include <vector>
 
+namespace urdf
+{
+    class Model;
+}
+
 namespace robot_self_filter
 {
 
@@ -87,12 +95,29 @@ struct LinkInfo
 	
     public:
 	
-	/** \brief Construct the filter */
-	SelfMask(tf::TransformListener &tf, const std::vector<LinkInfo> &links) : tf_(tf)
+	/** \brief Construct the filter. The robot model is read from the robot_description parameter */
+	SelfMask(tf::Transformer &tf, const std::vector<LinkInfo> &links,
+		 const bodies::HullOptions &hull_options = bodies::HullOptions()) : tf_(tf), tfc_(new TransformCache(tf)), hull_options_(hull_options)
 	{
 	    configure(links);
 	}
 	
+	/** \brief Construct the filter using a transform cache that may be shared with other
+	    stages processing the same data */
+	SelfMask(const boost::shared_ptr<TransformCache> &tfc, const std::vector<LinkInfo> &links,
+		 const bodies::HullOptions &hull_options = bodies::HullOptions()) : tf_(tfc->getTransformer()), tfc_(tfc), hull_options_(hull_options)
+	{
+	    configure(links);
+	}
+	
+	/** \brief Construct the filter for a given robot model. This does not need a ROS master,
+	    as long as \e tf is not a tf::TransformListener */
+	SelfMask(tf::Transformer &tf, const std::vector<LinkInfo> &links, const urdf::Model &model,
+		 const bodies::HullOptions &hull_options = bodies::HullOptions()) : tf_(tf), tfc_(new TransformCache(tf)), hull_options_(hull_options)
+	{
+	    configure(links, model);
+	}
+	
 	/** \brief Destructor to clean up
 	 */
 	~SelfMask(void)
@@ -126,6 +151,16 @@ struct LinkInfo
 	void maskIntersection(const sensor_msgs::PointCloud& data_in, const btVector3 &sensor, const double min_sensor_dist,
 			      std::vector<int> &mask, const boost::function<void(const btVector3&)> &intersectionCallback = NULL);
 	
+	/** \brief Compute the containment mask (INSIDE or OUTSIDE) for the points of a cloud view.
+	    The mask uses one byte per point. */
+	void maskContainment(const CloudView& data_in, std::vector<unsigned char> &mask);
+	
+	/** \brief Compute the intersection mask (INSIDE, OUTSIDE or SHADOW) for the points of a
+	    cloud view. The mask uses one byte per point. If \e sensor_frame is empty, only
+	    containment is checked. */
+	void maskIntersection(const CloudView& data_in, const std::string &sensor_frame, const double min_sensor_dist,
+			      std::vector<unsigned char> &mask, const boost::function<void(const btVector3&)> &intersectionCallback = NULL);
+	
 	/** \brief Assume subsequent calls to getMaskX() will be in the frame passed to this function.
 	 *   The frame in which the sensor is located is optional */
 	void assumeFrame(const roslib::Header& header);
@@ -159,30 +194,56 @@ struct LinkInfo
 	/** \brief Get the set of link names that have been instantiated for self filtering */
 	void getLinkNames(std::vector<std::string> &frames) const;
 	
+	/** \brief Get the transform cache used to place the links */
+	const boost::shared_ptr<TransformCache>& getTransformCache(void) const
+	{
+	    return tfc_;
+	}
+	
     private:
 
 	/** \brief Free memory. */
 	void freeMemory(void);
 
-	/** \brief Configure the filter. */
+	/** \brief Configure the filter, using the robot model from the parameter server. */
 	bool configure(const std::vector<LinkInfo> &links);
+
+	/** \brief Configure the filter. */
+	bool configure(const std::vector<LinkInfo> &links, const urdf::Model &model);
+	
+	/** \brief Place the links (and optionally the sensor, if \e sensor_frame is not empty) in the frame of \e header */
+	void placeLinks(const roslib::Header& header, const std::string &sensor_frame);
 	
 	/** \brief Compute bounding spheres for the checked robot links. */
 	void computeBoundingSpheres(void);
 	
+	/** \brief Compute the containment mask; assumeFrame() is called first, unless there are no bodies */
+	template<typename M>
+	void maskContainmentT(const CloudView& data_in, std::vector<M> &mask);
+
+	/** \brief Compute the intersection mask; assumeFrame() is called first, unless there are no bodies */
+	template<typename M>
+	void maskIntersectionT(const CloudView& data_in, const std::string &sensor_frame, const double min_sensor_dist,
+			       std::vector<M> &mask, const boost::function<void(const btVector3&)> &callback);
+	
 	/** \brief Perform the actual mask computation. */
-	void maskAuxContainment(const sensor_msgs::PointCloud& data_in, std::vector<int> &mask);
+	template<typename M>
+	void maskAuxContainment(const CloudView& data_in, std::vector<M> &mask);
 
 	/** \brief Perform the actual mask computation. */
-	void maskAuxIntersection(const sensor_msgs::PointCloud& data_in, std::vector<int> &mask, const boost::function<void(const btVector3&)> &callback);
+	template<typename M>
+	void maskAuxIntersection(const CloudView& data_in, std::vector<M> &mask, const boost::function<void(const btVector3&)> &callback);
 	
-	tf::TransformListener              &tf_;
-	ros::NodeHandle                     nh_;
+	tf::Transformer                    &tf_;
+	boost::shared_ptr<TransformCache>   tfc_;
+	bodies::HullOptions                 hull_options_;
 	
 	btVector3                           sensor_pos_;
 	double                              min_sensor_dist_;
 	
 	std::vector<SeeLink>                bodies_;
+	std::vector<std::string>            frames_;
+	std::vector<btTransform>            transforms_;
 	std::vector<double>                 bspheresRadius2_;
 	std::vector<bodies::BoundingSphere> bspheres_;
 	
@@ -32,7 +32,10 @@
 
 #include <filters/filter_base.h>
 #include <pr2_navigation_self_filter/self_mask.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <boost/scoped_ptr.hpp>
 #include <ros/console.h>
+#include <cstring>
 
 namespace filters
 {
@@ -47,8 +50,10 @@ class SelfFilter: public FilterBase <T>
     
 public:
 
-  /** \brief Construct the filter */
-  SelfFilter(ros::NodeHandle nh) : nh_(nh) 
+  /** \brief Construct the filter. If \e tfc is given, the transforms are looked up through
+      that (possibly shared) cache; otherwise the filter creates its own TransformListener */
+  SelfFilter(ros::NodeHandle nh, const boost::shared_ptr<robot_self_filter::TransformCache> &tfc =
+             boost::shared_ptr<robot_self_filter::TransformCache>()) : nh_(nh) 
   {
     nh_.param<double>("min_sensor_dist", min_sensor_dist_, 0.01);
     double default_padding, default_scale;
@@ -101,7 +106,21 @@ public:
         }      
       }
     }
-    sm_ = new robot_self_filter::SelfMask(tf_, links);
+    // convex hulls of mesh links may be simplified and cached between runs
+    bodies::HullOptions hull_options;
+    int hull_max_planes;
+    nh_.param<int>("hull_max_planes", hull_max_planes, 0);
+    hull_options.maxPlanes = hull_max_planes > 0 ? hull_max_planes : 0;
+    nh_.param<double>("hull_tolerance", hull_options.tolerance, 0.0);
+    nh_.param<std::string>("hull_cache_dir", hull_options.cacheDir, std::string());
+
+    if (tfc)
+      sm_ = new robot_self_filter::SelfMask(tfc, links, hull_options);
+    else
+    {
+      tf_.reset(new tf::TransformListener());
+      sm_ = new robot_self_filter::SelfMask(*tf_, links, hull_options);
+    }
     nh_.param<std::string>("annotate", annotate_, std::string());
     if (!annotate_.empty())
       ROS_INFO("Self filter is adding annotation channel '%s'", annotate_.c_str());
@@ -140,13 +159,12 @@ public:
    */
   virtual bool update(const sensor_msgs::PointCloud& data_in, sensor_msgs::PointCloud& data_out)
   {
-    std::vector<int> keep(data_in.points.size());
-    if(sensor_frame_.empty()) {
-      sm_->maskContainment(data_in, keep);
-    } else {
-      sm_->maskIntersection(data_in, sensor_frame_, min_sensor_dist_, keep);
-    }	
-    fillResult(data_in, keep, data_out);
+    std::vector<unsigned char> keep;
+    sm_->maskIntersection(robot_self_filter::CloudView(data_in), sensor_frame_, min_sensor_dist_, keep);
+    if (annotate_.empty())
+      compactResult(data_in, keep, data_out);
+    else
+      fillResult(data_in, keep, data_out);
     return true;
   }
 
@@ -162,18 +180,59 @@ public:
    */
   virtual bool update(const sensor_msgs::PointCloud& data_in, sensor_msgs::PointCloud& data_out, sensor_msgs::PointCloud& data_diff)
   {
-    std::vector<int> keep(data_in.points.size());
-    if(sensor_frame_.empty()) {
-      sm_->maskContainment(data_in, keep);
-    } else {
-      sm_->maskIntersection(data_in, sensor_frame_, min_sensor_dist_, keep);
+    std::vector<unsigned char> keep;
+    sm_->maskIntersection(robot_self_filter::CloudView(data_in), sensor_frame_, min_sensor_dist_, keep);
+    if (annotate_.empty())
+      compactResult(data_in, keep, data_out);
+    else
+      fillResult(data_in, keep, data_out);
+    compactDiff(data_in, keep, data_diff);
+    return true;
+  }
+
+  bool updateWithSensorFrame(const sensor_msgs::PointCloud2& data_in, sensor_msgs::PointCloud2& data_out, const std::string& sensor_frame)
+  {
+    sensor_frame_ = sensor_frame;
+    return update(data_in, data_out);
+  }
+
+  /** \brief Update the filter for a cloud in the sensor_msgs::PointCloud2 format.
+   * The cloud needs float32 x, y and z fields; the output has the same fields
+   * (plus the annotation field, if annotating)
+   */
+  bool update(const sensor_msgs::PointCloud2& data_in, sensor_msgs::PointCloud2& data_out)
+  {
+    robot_self_filter::CloudView view(data_in);
+    if (!view.valid())
+      return false;
+    std::vector<unsigned char> keep;
+    sm_->maskIntersection(view, sensor_frame_, min_sensor_dist_, keep);
+    if (annotate_.empty())
+    {
+      robot_self_filter::packMask(keep, robot_self_filter::OUTSIDE, true, bits_);
+      robot_self_filter::compactCloud(data_in, bits_, data_out);
     }
-    fillResult(data_in, keep, data_out);
-    fillDiff(data_in,keep,data_diff);
+    else
+      fillResult(data_in, keep, data_out);
     return true;
   }
 
-  void fillDiff(const sensor_msgs::PointCloud& data_in, const std::vector<int> &keep, sensor_msgs::PointCloud& data_out)
+  /** \brief Keep only the points that are OUTSIDE the robot */
+  void compactResult(const sensor_msgs::PointCloud& data_in, const std::vector<unsigned char> &keep, sensor_msgs::PointCloud& data_out)
+  {
+    robot_self_filter::packMask(keep, robot_self_filter::OUTSIDE, true, bits_);
+    robot_self_filter::compactCloud(data_in, bits_, data_out);
+  }
+
+  /** \brief Same selection as fillDiff(), using the bitmask compaction */
+  void compactDiff(const sensor_msgs::PointCloud& data_in, const std::vector<unsigned char> &keep, sensor_msgs::PointCloud& data_out)
+  {
+    robot_self_filter::packMask(keep, robot_self_filter::INSIDE, !invert_, bits_);
+    robot_self_filter::compactCloud(data_in, bits_, data_out);
+  }
+
+  template<typename M>
+  void fillDiff(const sensor_msgs::PointCloud& data_in, const std::vector<M> &keep, sensor_msgs::PointCloud& data_out)
   {
     const unsigned int np = data_in.points.size();
 	
@@ -202,7 +261,8 @@ public:
     }
   }
 
-  void fillResult(const sensor_msgs::PointCloud& data_in, const std::vector<int> &keep, sensor_msgs::PointCloud& data_out)
+  template<typename M>
+  void fillResult(const sensor_msgs::PointCloud& data_in, const std::vector<M> &keep, sensor_msgs::PointCloud& data_out)
   {
     const unsigned int np = data_in.points.size();
 
@@ -267,6 +327,53 @@ public:
       }
   }
 
+  /** \brief Keep all the points and write the annotation field (1 for OUTSIDE, -1 for INSIDE, 0 for SHADOW).
+      If the input has no float32 field with the annotation name, one is appended to each point. */
+  void fillResult(const sensor_msgs::PointCloud2& data_in, const std::vector<unsigned char> &keep, sensor_msgs::PointCloud2& data_out)
+  {
+    const unsigned int np = keep.size();
+
+    int offset = -1;
+    for (unsigned int i = 0 ; i < data_in.fields.size() ; ++i)
+      if (data_in.fields[i].name == annotate_ && data_in.fields[i].datatype == sensor_msgs::PointField::FLOAT32)
+      {
+        offset = data_in.fields[i].offset;
+        break;
+      }
+
+    if (offset >= 0)
+      data_out = data_in;
+    else
+    {
+      data_out.header = data_in.header;
+      data_out.height = data_in.height;
+      data_out.width = data_in.width;
+      data_out.is_bigendian = data_in.is_bigendian;
+      data_out.is_dense = data_in.is_dense;
+      data_out.fields = data_in.fields;
+      offset = data_in.point_step;
+      sensor_msgs::PointField field;
+      field.name = annotate_;
+      field.offset = offset;
+      field.datatype = sensor_msgs::PointField::FLOAT32;
+      field.count = 1;
+      data_out.fields.push_back(field);
+      data_out.point_step = data_in.point_step + sizeof(float);
+      data_out.row_step = data_out.point_step * data_out.width;
+      data_out.data.resize(data_out.point_step * np);
+      for (unsigned int i = 0 ; i < np ; ++i)
+        memcpy(&data_out.data[i * data_out.point_step], &data_in.data[i * data_in.point_step], data_in.point_step);
+    }
+
+    for (unsigned int i = 0 ; i < np ; ++i)
+    {
+      float flag = 0.0;
+      if (keep[i] != robot_self_filter::SHADOW)
+        flag = keep[i] == robot_self_filter::OUTSIDE ? 1.0f : -1.0f;
+      memcpy(&data_out.data[i * data_out.point_step + offset], &flag, sizeof(float));
+    }
+  }
+
   virtual bool updateWithSensorFrame(const std::vector<sensor_msgs::PointCloud> & data_in, std::vector<sensor_msgs::PointCloud>& data_out, const std::string& sensor_frame)
   {
     sensor_frame_ = sensor_frame;
@@ -293,7 +400,7 @@ public:
     
 protected:
     
-  tf::TransformListener tf_;
+  boost::scoped_ptr<tf::TransformListener> tf_;
   robot_self_filter::SelfMask* sm_;
   
   ros::NodeHandle nh_;
@@ -301,6 +408,7 @@ protected:
   std::string sensor_frame_;
   std::string annotate_;
   double min_sensor_dist_;
+  std::vector<uint32_t> bits_;
     
   
 };
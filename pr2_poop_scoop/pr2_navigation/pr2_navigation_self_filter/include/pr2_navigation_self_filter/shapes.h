@@ -38,6 +38,7 @@
 #define GEOMETRIC_SHAPES_SHAPES_
 
 #include <cstdlib>
+#include <string>
 #include <vector>
 #include <LinearMath/btVector3.h>
 
@@ -241,6 +242,26 @@ namespace shapes
 	recomputed and repeating vertices are identified. */
     Mesh* createMeshFromBinaryStlData(const char *data, unsigned int size);
 
+    /** \brief Load a mesh from a binary STL file, using a cache of
+	preprocessed meshes in \e cacheDir. The cache is keyed by file
+	name, size and modification time; if an entry exists the STL
+	file is not read. An empty \e cacheDir disables the cache. */
+    Mesh* createMeshFromBinaryStl(const char *filename, const std::string &cacheDir);
+
+    /** \brief Load a mesh from a binary STL stream, using a cache of
+	preprocessed meshes in \e cacheDir, keyed by a hash of the
+	data. An empty \e cacheDir disables the cache. */
+    Mesh* createMeshFromBinaryStlData(const char *data, unsigned int size, const std::string &cacheDir);
+
+    /** \brief Load a mesh previously stored with saveMeshCache(). The
+	file is memory mapped and the mesh arrays point into the
+	mapping. Returns NULL if the file is missing or invalid. */
+    Mesh* loadMeshCache(const char *filename);
+
+    /** \brief Store a mesh (vertices, normals and triangles) in the
+	format read by loadMeshCache() */
+    bool saveMeshCache(const Mesh *mesh, const char *filename);
+
     /** \brief Create a copy of a shape */
     Shape* cloneShape(const Shape *shape);
 
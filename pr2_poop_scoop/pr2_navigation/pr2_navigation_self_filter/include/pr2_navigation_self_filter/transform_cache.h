@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROBOT_SELF_FILTER_TRANSFORM_CACHE_
+#define ROBOT_SELF_FILTER_TRANSFORM_CACHE_
+
+#include <tf/transform_listener.h>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace robot_self_filter
+{
+
+    /** \brief Resolve a set of frames into a common target frame at
+     *  a given stamp in one pass, and remember the result.
+     *
+     *  Consecutive filter stages that see the same cloud (same
+     *  target frame and stamp) get their transforms from the
+     *  snapshot instead of going back to TF. Waiting for TF to catch
+     *  up is done once for the whole set of frames, so the total
+     *  stall is bounded by a single timeout rather than one timeout
+     *  per frame. */
+    class TransformCache
+    {
+    public:
+
+	/** \brief Construct a cache on top of a transformer (usually a tf::TransformListener). At most \e max_snapshots
+	    (target frame, stamp) pairs are remembered; the oldest one is dropped first. */
+	TransformCache(tf::Transformer &tf, unsigned int max_snapshots = 4);
+
+	/** \brief Compute the transforms that take data from each of \e frames into \e target_frame
+	    at time \e stamp. The call waits at most \e timeout in total for TF to have all the frames.
+	    Frames that cannot be resolved get the identity transform and an error is reported. Returns
+	    true if all frames were resolved. A zero \e stamp (latest available) is never cached. */
+	bool lookup(const std::string &target_frame, const ros::Time &stamp, const std::vector<std::string> &frames,
+		    std::vector<btTransform> &transforms, const ros::Duration &timeout = ros::Duration(0.1));
+
+	/** \brief Compute the transform that takes data from \e frame into \e target_frame at time \e stamp */
+	bool lookup(const std::string &target_frame, const ros::Time &stamp, const std::string &frame,
+		    btTransform &transform, const ros::Duration &timeout = ros::Duration(0.1));
+
+	/** \brief Forget all remembered snapshots */
+	void clear(void);
+
+	/** \brief Get the transformer this cache uses */
+	tf::Transformer& getTransformer(void)
+	{
+	    return tf_;
+	}
+
+    private:
+
+	struct Snapshot
+	{
+	    std::string                        target_frame;
+	    ros::Time                          stamp;
+	    std::map<std::string, btTransform> transforms;
+	};
+
+	/** \brief Find the snapshot for (target frame, stamp); create it if it does not exist */
+	Snapshot& getSnapshot(const std::string &target_frame, const ros::Time &stamp);
+
+	tf::Transformer       &tf_;
+	unsigned int           max_snapshots_;
+	std::deque<Snapshot>   snapshots_;
+	boost::mutex           lock_;
+    };
+
+}
+
+#endif
@@ -39,9 +39,23 @@
 // #include <BulletCollision/CollisionShapes/btTriangleShape.h>
 #include <algorithm>
 #include <iostream>
+#include <queue>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
 #include <cmath>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 bodies::Body* bodies::createBodyFromShape(const shapes::Shape *shape)
+{
+    return createBodyFromShape(shape, HullOptions());
+}
+
+bodies::Body* bodies::createBodyFromShape(const shapes::Shape *shape, const HullOptions &options)
 {
     Body *body = NULL;
     
@@ -58,7 +72,7 @@ bodies::Body* bodies::createBodyFromShape(const shapes::Shape *shape)
 	    body = new bodies::Cylinder(shape);
 	    break;
 	case shapes::MESH:
-	    body = new bodies::ConvexMesh(shape);
+	    body = new bodies::ConvexMesh(shape, options);
 	    break;
 	default:
 	    std::cerr << "Creating body from shape: Unknown shape type" << shape->type << std::endl;
@@ -703,6 +717,120 @@ void bodies::Mesh::computeBoundingSphere(BoundingSphere &sphere) const
 
 */
 
+namespace bodies
+{
+    namespace detail
+    {
+	static const char HULL_CACHE_MAGIC[8] = { 'S', 'F', 'H', 'U', 'L', 'L', '0', '1' };
+	
+	// a set of hull planes replaced by a single plane
+	struct HullCluster
+	{
+	    btVector4                 plane;
+	    double                    area;
+	    double                    error;
+	    std::vector<btVector4>    originals;
+	    std::vector<unsigned int> vertices;
+	};
+	
+	// a candidate merge of clusters i and j; vi and vj are the versions of the clusters it was computed for
+	struct HullMerge
+	{
+	    HullMerge(unsigned int _i, unsigned int _j, unsigned int _vi, unsigned int _vj) : i(_i), j(_j), vi(_vi), vj(_vj), cost(INFINITY)
+	    {
+	    }
+	    
+	    // the cheapest merge has the highest priority
+	    bool operator<(const HullMerge &other) const
+	    {
+		return cost > other.cost;
+	    }
+	    
+	    unsigned int i, j, vi, vj;
+	    double       cost;
+	    btVector4    plane;
+	};
+	
+	// only neighbouring planes (that share a hull vertex) are merged; vertex lists are sorted
+	static bool shareVertex(const HullCluster &a, const HullCluster &b)
+	{
+	    std::vector<unsigned int>::const_iterator ia = a.vertices.begin(), ib = b.vertices.begin();
+	    while (ia != a.vertices.end() && ib != b.vertices.end())
+	    {
+		if (*ia == *ib)
+		    return true;
+		if (*ia < *ib)
+		    ++ia;
+		else
+		    ++ib;
+	    }
+	    return false;
+	}
+	
+	// compute the plane that replaces two clusters and return how far
+	// the hull grows if that plane is used instead of the original ones
+	static double mergeCost(const HullCluster &a, const HullCluster &b, const std::vector<btVector3> &vertices, btVector4 &plane)
+	{
+	    btVector3 na(a.plane.getX(), a.plane.getY(), a.plane.getZ());
+	    btVector3 nb(b.plane.getX(), b.plane.getY(), b.plane.getZ());
+	    if (na.dot(nb) <= 0.0)
+		return INFINITY;
+	    
+	    btVector3 n(na * a.area + nb * b.area);
+	    if (n.length2() < ZERO)
+		return INFINITY;
+	    n.normalize();
+	    
+	    // the new plane supports the hull, so the simplified hull still contains it
+	    double d = -INFINITY;
+	    for (unsigned int i = 0 ; i < vertices.size() ; ++i)
+		d = std::max(d, (double)n.dot(vertices[i]));
+	    plane.setValue(n.getX(), n.getY(), n.getZ(), -d);
+	    
+	    // the hull grows the most above the faces being replaced: push their
+	    // vertices out onto the new plane and measure how far outside the
+	    // original planes they end up
+	    double error = std::max(a.error, b.error);
+	    const HullCluster *c[2] = { &a, &b };
+	    for (int k = 0 ; k < 2 ; ++k)
+		for (unsigned int i = 0 ; i < c[k]->vertices.size() ; ++i)
+		{
+		    const btVector3 &v = vertices[c[k]->vertices[i]];
+		    btVector3 q(v + n * (d - n.dot(v)));
+		    for (int m = 0 ; m < 2 ; ++m)
+			for (unsigned int j = 0 ; j < c[m]->originals.size() ; ++j)
+			{
+			    const btVector4 &o = c[m]->originals[j];
+			    error = std::max(error, (double)(o.dot(q) + o.getW()));
+			}
+		}
+	    return error;
+	}
+	
+	// name of the cache file for a mesh: a hash of the mesh and of the options that affect the hull
+	static std::string hullCacheKey(const shapes::Mesh *mesh, const HullOptions &options)
+	{
+	    uint64_t h = 14695981039346656037ULL;
+	    const unsigned char *data[4] = { reinterpret_cast<const unsigned char*>(mesh->vertices),
+					     reinterpret_cast<const unsigned char*>(mesh->triangles),
+					     reinterpret_cast<const unsigned char*>(&options.maxPlanes),
+					     reinterpret_cast<const unsigned char*>(&options.tolerance) };
+	    const size_t size[4] = { mesh->vertexCount * 3 * sizeof(double), mesh->triangleCount * 3 * sizeof(unsigned int),
+				     sizeof(options.maxPlanes), sizeof(options.tolerance) };
+	    for (int k = 0 ; k < 4 ; ++k)
+		for (size_t i = 0 ; i < size[k] ; ++i)
+		{
+		    h ^= data[k][i];
+		    h *= 1099511628211ULL;
+		}
+	    
+	    std::stringstream ss;
+	    ss << std::hex << std::setw(16) << std::setfill('0') << h;
+	    return ss.str();
+	}
+    }
+}
+
 bool bodies::ConvexMesh::containsPoint(const btVector3 &p, bool verbose) const
 {
     if (m_boundingBox.containsPoint(p))
@@ -748,11 +876,33 @@ void bodies::ConvexMesh::useDimensions(const shapes::Shape *shape)
     m_boxOffset.setValue((minX + maxX) / 2.0, (minY + maxY) / 2.0, (minZ + maxZ) / 2.0);
     
     m_planes.clear();
+    m_hullPlanes.clear();
     m_triangles.clear();
     m_vertices.clear();
     m_meshRadiusB = 0.0;
     m_meshCenter.setValue(btScalar(0), btScalar(0), btScalar(0));
+    m_stats = HullStats();
+    
+    std::string filename;
+    if (!m_options.cacheDir.empty())
+    {
+	filename = m_options.cacheDir + "/" + detail::hullCacheKey(mesh, m_options) + ".hull";
+	if (loadHull(filename))
+	{
+	    m_stats.fromCache = true;
+	    return;
+	}
+    }
+    
+    computeHull(mesh);
+    simplifyPlanes();
+    
+    if (!filename.empty())
+	saveHull(filename);
+}
 
+void bodies::ConvexMesh::computeHull(const shapes::Mesh *mesh)
+{
     btVector3 *vertices = new btVector3[mesh->vertexCount];
     for(unsigned int i = 0; i < mesh->vertexCount ; ++i)
     {
@@ -835,6 +985,235 @@ void bodies::ConvexMesh::useDimensions(const shapes::Shape *shape)
     hl.ReleaseResult(hr);    
     delete[] vertices;
     
+    m_stats.triangles = m_triangles.size() / 3;
+}
+
+void bodies::ConvexMesh::simplifyPlanes(void)
+{
+    // group the triangle planes into distinct planes first; a face of the
+    // hull is usually split in several triangles that share the same plane
+    std::vector<detail::HullCluster> clusters;
+    for (unsigned int i = 0 ; i < m_planes.size() ; ++i)
+    {
+	const btVector4 &pl = m_planes[i];
+	const btVector3 &a = m_vertices[m_triangles[3 * i    ]];
+	const btVector3 &b = m_vertices[m_triangles[3 * i + 1]];
+	const btVector3 &c = m_vertices[m_triangles[3 * i + 2]];
+	double area = (b - a).cross(c - a).length() / 2.0;
+	
+	unsigned int k = 0;
+	for ( ; k < clusters.size() ; ++k)
+	{
+	    const btVector4 &q = clusters[k].plane;
+	    if (pl.getX() * q.getX() + pl.getY() * q.getY() + pl.getZ() * q.getZ() > 1.0 - 1e-9 && fabs(pl.getW() - q.getW()) < 1e-6)
+		break;
+	}
+	if (k == clusters.size())
+	{
+	    clusters.resize(k + 1);
+	    clusters[k].plane = pl;
+	    clusters[k].area = 0.0;
+	    clusters[k].error = 0.0;
+	    clusters[k].originals.push_back(pl);
+	}
+	clusters[k].area += area;
+	for (int j = 0 ; j < 3 ; ++j)
+	    clusters[k].vertices.push_back(m_triangles[3 * i + j]);
+    }
+    for (unsigned int k = 0 ; k < clusters.size() ; ++k)
+    {
+	std::sort(clusters[k].vertices.begin(), clusters[k].vertices.end());
+	clusters[k].vertices.erase(std::unique(clusters[k].vertices.begin(), clusters[k].vertices.end()), clusters[k].vertices.end());
+    }
+    
+    m_stats.distinctPlanes = clusters.size();
+    
+    // greedily merge the pair of neighbouring planes that grows the hull the least, as long
+    // as the growth is within tolerance or there are more planes than allowed
+    const unsigned int n = clusters.size();
+    std::vector<bool> alive(n, true);
+    std::vector<unsigned int> version(n, 0);
+    unsigned int count = n;
+    double error = 0.0;
+    m_stats.tradeoff.push_back(std::make_pair(count, error));
+    
+    bool merge = m_options.tolerance > 0.0 || (m_options.maxPlanes > 0 && count > m_options.maxPlanes);
+    
+    std::priority_queue<detail::HullMerge> queue;
+    if (merge)
+	for (unsigned int i = 0 ; i < n ; ++i)
+	    for (unsigned int j = i + 1 ; j < n ; ++j)
+		if (detail::shareVertex(clusters[i], clusters[j]))
+		{
+		    detail::HullMerge hm(i, j, 0, 0);
+		    hm.cost = detail::mergeCost(clusters[i], clusters[j], m_vertices, hm.plane);
+		    if (hm.cost != INFINITY)
+			queue.push(hm);
+		}
+    
+    while (merge && count > 1 && !queue.empty())
+    {
+	detail::HullMerge best = queue.top();
+	queue.pop();
+	
+	// skip candidates that refer to planes changed since they were computed
+	if (!alive[best.i] || !alive[best.j] || version[best.i] != best.vi || version[best.j] != best.vj)
+	    continue;
+	
+	if (best.cost > m_options.tolerance && (m_options.maxPlanes == 0 || count <= m_options.maxPlanes))
+	    break;
+	
+	detail::HullCluster &ci = clusters[best.i];
+	detail::HullCluster &cj = clusters[best.j];
+	ci.plane = best.plane;
+	ci.area += cj.area;
+	ci.error = best.cost;
+	ci.originals.insert(ci.originals.end(), cj.originals.begin(), cj.originals.end());
+	ci.vertices.insert(ci.vertices.end(), cj.vertices.begin(), cj.vertices.end());
+	std::sort(ci.vertices.begin(), ci.vertices.end());
+	ci.vertices.erase(std::unique(ci.vertices.begin(), ci.vertices.end()), ci.vertices.end());
+	alive[best.j] = false;
+	version[best.i]++;
+	count--;
+	
+	for (unsigned int k = 0 ; k < n ; ++k)
+	    if (alive[k] && k != best.i && detail::shareVertex(ci, clusters[k]))
+	    {
+		detail::HullMerge hm(best.i, k, version[best.i], version[k]);
+		hm.cost = detail::mergeCost(ci, clusters[k], m_vertices, hm.plane);
+		if (hm.cost != INFINITY)
+		    queue.push(hm);
+	    }
+	
+	error = std::max(error, best.cost);
+	m_stats.tradeoff.push_back(std::make_pair(count, error));
+    }
+    
+    for (unsigned int i = 0 ; i < n ; ++i)
+	if (alive[i])
+	    m_hullPlanes.push_back(clusters[i].plane);
+    m_stats.planes = m_hullPlanes.size();
+    m_stats.error = error;
+}
+
+bool bodies::ConvexMesh::loadHull(const std::string &filename)
+{
+    FILE *input = fopen(filename.c_str(), "rb");
+    if (!input)
+	return false;
+    
+    bool ok = true;
+    char magic[8];
+    ok = ok && fread(magic, sizeof(magic), 1, input) == 1 && memcmp(magic, detail::HULL_CACHE_MAGIC, sizeof(magic)) == 0;
+    
+    uint32_t nv = 0, nt = 0, np = 0, ns = 0;
+    ok = ok && fread(&nv, sizeof(nv), 1, input) == 1;
+    ok = ok && fread(&nt, sizeof(nt), 1, input) == 1;
+    ok = ok && fread(&np, sizeof(np), 1, input) == 1;
+    ok = ok && fread(&ns, sizeof(ns), 1, input) == 1;
+    
+    std::vector<double>   v(3 * nv), tp(4 * nt), hp(4 * np), center(4), stats(3), tradeoff(2 * ns);
+    std::vector<uint32_t> t(3 * nt);
+    ok = ok && (nv == 0 || fread(&v[0], sizeof(double), v.size(), input) == v.size());
+    ok = ok && (nt == 0 || fread(&t[0], sizeof(uint32_t), t.size(), input) == t.size());
+    ok = ok && (nt == 0 || fread(&tp[0], sizeof(double), tp.size(), input) == tp.size());
+    ok = ok && (np == 0 || fread(&hp[0], sizeof(double), hp.size(), input) == hp.size());
+    ok = ok && fread(&center[0], sizeof(double), center.size(), input) == center.size();
+    ok = ok && fread(&stats[0], sizeof(double), stats.size(), input) == stats.size();
+    ok = ok && (ns == 0 || fread(&tradeoff[0], sizeof(double), tradeoff.size(), input) == tradeoff.size());
+    fclose(input);
+    
+    for (unsigned int i = 0 ; ok && i < t.size() ; ++i)
+	if (t[i] >= nv)
+	    ok = false;
+    
+    if (!ok)
+    {
+	std::cerr << "Ignoring invalid convex hull cache file " << filename << std::endl;
+	return false;
+    }
+    
+    m_vertices.resize(nv);
+    for (unsigned int i = 0 ; i < nv ; ++i)
+	m_vertices[i].setValue(v[3 * i], v[3 * i + 1], v[3 * i + 2]);
+    m_triangles.assign(t.begin(), t.end());
+    m_planes.resize(nt);
+    for (unsigned int i = 0 ; i < nt ; ++i)
+	m_planes[i].setValue(tp[4 * i], tp[4 * i + 1], tp[4 * i + 2], tp[4 * i + 3]);
+    m_hullPlanes.resize(np);
+    for (unsigned int i = 0 ; i < np ; ++i)
+	m_hullPlanes[i].setValue(hp[4 * i], hp[4 * i + 1], hp[4 * i + 2], hp[4 * i + 3]);
+    m_meshCenter.setValue(center[0], center[1], center[2]);
+    m_meshRadiusB = center[3];
+    
+    m_stats.triangles = nt;
+    m_stats.distinctPlanes = (unsigned int)stats[0];
+    m_stats.planes = np;
+    m_stats.error = stats[1];
+    m_stats.tradeoff.resize(ns);
+    for (unsigned int i = 0 ; i < ns ; ++i)
+	m_stats.tradeoff[i] = std::make_pair((unsigned int)tradeoff[2 * i], tradeoff[2 * i + 1]);
+    
+    return true;
+}
+
+void bodies::ConvexMesh::saveHull(const std::string &filename) const
+{
+    // create the cache directory if needed; failure shows up when opening the file
+    mkdir(m_options.cacheDir.c_str(), 0755);
+    
+    // write to a temporary file first, so other processes never see a partial file
+    std::stringstream tmp;
+    tmp << filename << ".tmp" << getpid();
+    FILE *output = fopen(tmp.str().c_str(), "wb");
+    if (!output)
+    {
+	std::cerr << "Unable to write convex hull cache file " << filename << std::endl;
+	return;
+    }
+    
+    uint32_t nv = m_vertices.size(), nt = m_planes.size(), np = m_hullPlanes.size(), ns = m_stats.tradeoff.size();
+    std::vector<double>   v(3 * nv), tp(4 * nt), hp(4 * np), center(4), stats(3), tradeoff(2 * ns);
+    std::vector<uint32_t> t(m_triangles.begin(), m_triangles.end());
+    for (unsigned int i = 0 ; i < nv ; ++i)
+	for (int j = 0 ; j < 3 ; ++j)
+	    v[3 * i + j] = m_vertices[i][j];
+    for (unsigned int i = 0 ; i < nt ; ++i)
+	for (int j = 0 ; j < 4 ; ++j)
+	    tp[4 * i + j] = m_planes[i][j];
+    for (unsigned int i = 0 ; i < np ; ++i)
+	for (int j = 0 ; j < 4 ; ++j)
+	    hp[4 * i + j] = m_hullPlanes[i][j];
+    for (int j = 0 ; j < 3 ; ++j)
+	center[j] = m_meshCenter[j];
+    center[3] = m_meshRadiusB;
+    stats[0] = m_stats.distinctPlanes;
+    stats[1] = m_stats.error;
+    for (unsigned int i = 0 ; i < ns ; ++i)
+    {
+	tradeoff[2 * i] = m_stats.tradeoff[i].first;
+	tradeoff[2 * i + 1] = m_stats.tradeoff[i].second;
+    }
+    
+    bool ok = fwrite(detail::HULL_CACHE_MAGIC, 8, 1, output) == 1;
+    ok = ok && fwrite(&nv, sizeof(nv), 1, output) == 1;
+    ok = ok && fwrite(&nt, sizeof(nt), 1, output) == 1;
+    ok = ok && fwrite(&np, sizeof(np), 1, output) == 1;
+    ok = ok && fwrite(&ns, sizeof(ns), 1, output) == 1;
+    ok = ok && (nv == 0 || fwrite(&v[0], sizeof(double), v.size(), output) == v.size());
+    ok = ok && (nt == 0 || fwrite(&t[0], sizeof(uint32_t), t.size(), output) == t.size());
+    ok = ok && (nt == 0 || fwrite(&tp[0], sizeof(double), tp.size(), output) == tp.size());
+    ok = ok && (np == 0 || fwrite(&hp[0], sizeof(double), hp.size(), output) == hp.size());
+    ok = ok && fwrite(&center[0], sizeof(double), center.size(), output) == center.size();
+    ok = ok && fwrite(&stats[0], sizeof(double), stats.size(), output) == stats.size();
+    ok = ok && (ns == 0 || fwrite(&tradeoff[0], sizeof(double), tradeoff.size(), output) == tradeoff.size());
+    ok = fclose(output) == 0 && ok;
+    
+    if (!ok || rename(tmp.str().c_str(), filename.c_str()) != 0)
+    {
+	std::cerr << "Unable to write convex hull cache file " << filename << std::endl;
+	remove(tmp.str().c_str());
+    }
 }
 
 void bodies::ConvexMesh::updateInternalData(void) 
@@ -867,10 +1246,10 @@ void bodies::ConvexMesh::computeBoundingSphere(BoundingSphere &sphere) const
 
 bool bodies::ConvexMesh::isPointInsidePlanes(const btVector3& point) const
 {
-    unsigned int numplanes = m_planes.size();
+    unsigned int numplanes = m_hullPlanes.size();
     for (unsigned int i = 0 ; i < numplanes ; ++i)
     {
-	const btVector4& plane = m_planes[i];
+	const btVector4& plane = m_hullPlanes[i];
 	btScalar dist = plane.dot(point) + plane.getW() - m_padding - btScalar(1e-6);
 	if (dist > btScalar(0))
 	    return false;
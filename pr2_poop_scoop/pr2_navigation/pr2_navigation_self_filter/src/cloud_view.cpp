@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pr2_navigation_self_filter/cloud_view.h"
+#include <ros/console.h>
+#include <algorithm>
+#include <cstring>
+
+robot_self_filter::CloudView::CloudView(const sensor_msgs::PointCloud &cloud) : header_(&cloud.header), stride_(sizeof(geometry_msgs::Point32)),
+										size_(cloud.points.size()), valid_(true)
+{
+    if (size_ > 0)
+    {
+	x_ = reinterpret_cast<const unsigned char*>(&cloud.points[0].x);
+	y_ = reinterpret_cast<const unsigned char*>(&cloud.points[0].y);
+	z_ = reinterpret_cast<const unsigned char*>(&cloud.points[0].z);
+    }
+    else
+	x_ = y_ = z_ = NULL;
+}
+
+robot_self_filter::CloudView::CloudView(const sensor_msgs::PointCloud2 &cloud) : header_(&cloud.header), x_(NULL), y_(NULL), z_(NULL),
+										 stride_(cloud.point_step), size_(0), valid_(false)
+{
+    int offset[3] = { -1, -1, -1 };
+    const char *names[3] = { "x", "y", "z" };
+    for (unsigned int i = 0 ; i < cloud.fields.size() ; ++i)
+	for (int k = 0 ; k < 3 ; ++k)
+	    if (cloud.fields[i].name == names[k] && cloud.fields[i].datatype == sensor_msgs::PointField::FLOAT32)
+		offset[k] = cloud.fields[i].offset;
+    
+    if (offset[0] < 0 || offset[1] < 0 || offset[2] < 0)
+    {
+	ROS_ERROR("Point cloud does not have float32 x, y and z fields");
+	return;
+    }
+    
+    if (cloud.row_step != cloud.width * cloud.point_step)
+    {
+	ROS_ERROR("Point cloud rows are padded; this is not supported");
+	return;
+    }
+    
+    for (int k = 0 ; k < 3 ; ++k)
+	if ((uint64_t)offset[k] + sizeof(float) > cloud.point_step)
+	{
+	    ROS_ERROR("Point cloud field %s (offset %d) does not fit in a point of %u bytes", names[k], offset[k], cloud.point_step);
+	    return;
+	}
+    
+    if ((uint64_t)cloud.width * cloud.height * cloud.point_step > cloud.data.size())
+    {
+	ROS_ERROR("Point cloud has %u x %u points of %u bytes but only %u bytes of data", cloud.width, cloud.height, cloud.point_step, (unsigned int)cloud.data.size());
+	return;
+    }
+    
+    valid_ = true;
+    size_ = cloud.width * cloud.height;
+    if (size_ > 0)
+    {
+	x_ = &cloud.data[0] + offset[0];
+	y_ = &cloud.data[0] + offset[1];
+	z_ = &cloud.data[0] + offset[2];
+    }
+}
+
+void robot_self_filter::packMask(const std::vector<unsigned char> &mask, unsigned char value, bool equal, std::vector<uint32_t> &bits)
+{
+    const unsigned int np = mask.size();
+    bits.resize((np + 31) / 32);
+    
+    unsigned int i = 0;
+    for (unsigned int w = 0 ; w < bits.size() ; ++w)
+    {
+	const unsigned int e = std::min(i + 32, np);
+	uint32_t word = 0;
+	for (unsigned int b = 0 ; i < e ; ++i, ++b)
+	    word |= (uint32_t)((mask[i] == value) == equal) << b;
+	bits[w] = word;
+    }
+}
+
+unsigned int robot_self_filter::countSet(const std::vector<uint32_t> &bits, unsigned int n)
+{
+    unsigned int count = 0;
+    const unsigned int full = n / 32;
+    for (unsigned int w = 0 ; w < full ; ++w)
+	count += __builtin_popcount(bits[w]);
+    if (n & 31)
+	count += __builtin_popcount(bits[full] & ((1u << (n & 31)) - 1));
+    return count;
+}
+
+namespace robot_self_filter
+{
+    
+    // copies one run of kept points (and their channel values) to the end of the output
+    struct CopyPointRun
+    {
+	CopyPointRun(const sensor_msgs::PointCloud &in, sensor_msgs::PointCloud &out) : in_(in), out_(out), pos_(0)
+	{
+	}
+	
+	void operator()(unsigned int b, unsigned int e)
+	{
+	    std::copy(in_.points.begin() + b, in_.points.begin() + e, out_.points.begin() + pos_);
+	    for (unsigned int j = 0 ; j < in_.channels.size() ; ++j)
+		std::copy(in_.channels[j].values.begin() + b, in_.channels[j].values.begin() + e, out_.channels[j].values.begin() + pos_);
+	    pos_ += e - b;
+	}
+	
+	const sensor_msgs::PointCloud &in_;
+	sensor_msgs::PointCloud       &out_;
+	unsigned int                   pos_;
+    };
+    
+    // copies one run of kept points as a single block of bytes
+    struct CopyBlobRun
+    {
+	CopyBlobRun(const sensor_msgs::PointCloud2 &in, sensor_msgs::PointCloud2 &out) : in_(in), out_(out), pos_(0)
+	{
+	}
+	
+	void operator()(unsigned int b, unsigned int e)
+	{
+	    const unsigned int bytes = (e - b) * in_.point_step;
+	    memcpy(&out_.data[pos_], &in_.data[b * in_.point_step], bytes);
+	    pos_ += bytes;
+	}
+	
+	const sensor_msgs::PointCloud2 &in_;
+	sensor_msgs::PointCloud2       &out_;
+	unsigned int                    pos_;
+    };
+    
+}
+
+void robot_self_filter::compactCloud(const sensor_msgs::PointCloud &data_in, const std::vector<uint32_t> &bits, sensor_msgs::PointCloud &data_out)
+{
+    const unsigned int np = data_in.points.size();
+    const unsigned int nk = countSet(bits, np);
+    
+    data_out.header = data_in.header;
+    data_out.points.resize(nk);
+    data_out.channels.resize(data_in.channels.size());
+    for (unsigned int j = 0 ; j < data_in.channels.size() ; ++j)
+    {
+	ROS_ASSERT(data_in.channels[j].values.size() == np);
+	data_out.channels[j].name = data_in.channels[j].name;
+	data_out.channels[j].values.resize(nk);
+    }
+    
+    forEachSetRun(bits, np, CopyPointRun(data_in, data_out));
+}
+
+void robot_self_filter::compactCloud(const sensor_msgs::PointCloud2 &data_in, const std::vector<uint32_t> &bits, sensor_msgs::PointCloud2 &data_out)
+{
+    const unsigned int np = data_in.width * data_in.height;
+    const unsigned int nk = countSet(bits, np);
+    
+    data_out.header = data_in.header;
+    data_out.fields = data_in.fields;
+    data_out.is_bigendian = data_in.is_bigendian;
+    data_out.is_dense = data_in.is_dense;
+    data_out.point_step = data_in.point_step;
+    data_out.height = 1;
+    data_out.width = nk;
+    data_out.row_step = nk * data_in.point_step;
+    data_out.data.resize(data_out.row_step);
+    
+    if (nk > 0)
+	forEachSetRun(bits, np, CopyBlobRun(data_in, data_out));
+}
@@ -34,8 +34,18 @@
 
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
-#include <set>
+#include <sstream>
+#include <iomanip>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 #include "pr2_navigation_self_filter/shapes.h"
 
 // \author Ioan Sucan ;  based on stl_to_mesh 
@@ -45,39 +55,126 @@ namespace shapes
 
     namespace detail
     {
-	struct myVertex
+	// vertices are identified by value; -0.0 and 0.0 are the same vertex
+	struct hashVertexValue
 	{
-	    btVector3    point;
-	    unsigned int index;
+	    std::size_t operator()(const btVector3 &v) const
+	    {
+		std::size_t seed = 0;
+		boost::hash_combine(seed, (double)v.getX() + 0.0);
+		boost::hash_combine(seed, (double)v.getY() + 0.0);
+		boost::hash_combine(seed, (double)v.getZ() + 0.0);
+		return seed;
+	    }
 	};
 	
-	struct ltVertexValue
+	struct eqVertexValue
 	{
-	    bool operator()(const myVertex &p1, const myVertex &p2) const
+	    bool operator()(const btVector3 &v1, const btVector3 &v2) const
 	    {
-		const btVector3 &v1 = p1.point;
-		const btVector3 &v2 = p2.point;
-		if (v1.getX() < v2.getX())
-		    return true;
-		if (v1.getX() > v2.getX())
-		    return false;
-		if (v1.getY() < v2.getY())
-		    return true;
-		if (v1.getY() > v2.getY())
-		    return false;
-		if (v1.getZ() < v2.getZ())
-		    return true;
-		return false;
+		return v1.getX() == v2.getX() && v1.getY() == v2.getY() && v1.getZ() == v2.getZ();
 	    }
 	};
 	
-	struct ltVertexIndex
+	static const char MESH_CACHE_MAGIC[8] = { 'S', 'F', 'M', 'E', 'S', 'H', '0', '1' };
+	
+	// layout of a cached mesh: this header, then vertices (3 doubles each),
+	// normals (3 doubles per triangle) and triangles (3 indices each)
+	struct MeshCacheHeader
+	{
+	    char     magic[8];
+	    uint32_t vertexCount;
+	    uint32_t triangleCount;
+	};
+	
+	static inline std::size_t meshCacheSize(uint32_t vertexCount, uint32_t triangleCount)
 	{
-	    bool operator()(const myVertex &p1, const myVertex &p2) const
+	    return sizeof(MeshCacheHeader) + (3 * vertexCount + 3 * triangleCount) * sizeof(double) + 3 * triangleCount * sizeof(uint32_t);
+	}
+	
+	// a mesh whose arrays point into a memory mapped cache file
+	class MappedMesh : public Mesh
+	{
+	public:
+	    MappedMesh(void *address, std::size_t length) : Mesh(), address_(address), length_(length)
+	    {
+		char *data = static_cast<char*>(address);
+		const MeshCacheHeader *header = reinterpret_cast<const MeshCacheHeader*>(data);
+		vertexCount = header->vertexCount;
+		triangleCount = header->triangleCount;
+		data += sizeof(MeshCacheHeader);
+		vertices = reinterpret_cast<double*>(data);
+		data += 3 * vertexCount * sizeof(double);
+		normals = reinterpret_cast<double*>(data);
+		data += 3 * triangleCount * sizeof(double);
+		triangles = reinterpret_cast<unsigned int*>(data);
+	    }
+	    
+	    virtual ~MappedMesh(void)
 	    {
-		return p1.index < p2.index;
+		// the arrays are not ours to delete
+		vertices = NULL;
+		normals = NULL;
+		triangles = NULL;
+		munmap(address_, length_);
 	    }
+	    
+	private:
+	    void        *address_;
+	    std::size_t  length_;
 	};
+	
+	// map a whole file in memory; the mapping is private, so changes are never written back
+	static void* mapFile(const char *filename, std::size_t &length)
+	{
+	    int fd = open(filename, O_RDONLY);
+	    if (fd < 0)
+		return NULL;
+	    
+	    void *address = NULL;
+	    struct stat st;
+	    if (fstat(fd, &st) == 0 && st.st_size > 0)
+	    {
+		length = st.st_size;
+		address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (address == MAP_FAILED)
+		    address = NULL;
+	    }
+	    close(fd);
+	    return address;
+	}
+	
+	static uint64_t hashBytes(const void *data, std::size_t size, uint64_t h = 14695981039346656037ULL)
+	{
+	    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	    for (std::size_t i = 0 ; i < size ; ++i)
+	    {
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	    }
+	    return h;
+	}
+	
+	static std::string cacheFileName(const std::string &cacheDir, uint64_t key)
+	{
+	    std::stringstream ss;
+	    ss << cacheDir << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".mesh";
+	    return ss.str();
+	}
+	
+	// load the cached mesh if there is one, otherwise build it and cache it
+	static Mesh* loadOrCreateMesh(const std::string &cacheDir, uint64_t key, const char *data, unsigned int size)
+	{
+	    std::string filename = cacheFileName(cacheDir, key);
+	    Mesh *mesh = loadMeshCache(filename.c_str());
+	    if (!mesh)
+	    {
+		mesh = createMeshFromBinaryStlData(data, size);
+		if (mesh)
+		    saveMeshCache(mesh, filename.c_str());
+	    }
+	    return mesh;
+	}
     }
     
     shapes::Mesh* createMeshFromVertices(const std::vector<btVector3> &vertices, const std::vector<unsigned int> &triangles)
@@ -112,80 +209,24 @@ namespace shapes
 	if (source.size() < 3)
 	    return NULL;
 	
-	std::set<detail::myVertex, detail::ltVertexValue> vertices;
-	std::vector<unsigned int>                         triangles;
-	
-	for (unsigned int i = 0 ; i < source.size() / 3 ; ++i)
-	{
-	    // check if we have new vertices
-	    detail::myVertex vt;
-	    
-	    vt.point = source[3 * i];
-	    std::set<detail::myVertex, detail::ltVertexValue>::iterator p1 = vertices.find(vt);
-	    if (p1 == vertices.end())
-	    {
-		vt.index = vertices.size();
-		vertices.insert(vt);		    
-	    }
-	    else
-		vt.index = p1->index;
-	    triangles.push_back(vt.index);		
-	    
-	    vt.point = source[3 * i + 1];
-	    std::set<detail::myVertex, detail::ltVertexValue>::iterator p2 = vertices.find(vt);
-	    if (p2 == vertices.end())
-	    {
-		vt.index = vertices.size();
-		vertices.insert(vt);		    
-	    }
-	    else
-		vt.index = p2->index;
-	    triangles.push_back(vt.index);		
-	    
-	    vt.point = source[3 * i + 2];
-	    std::set<detail::myVertex, detail::ltVertexValue>::iterator p3 = vertices.find(vt);
-	    if (p3 == vertices.end())
-	    {
-		vt.index = vertices.size();
-		vertices.insert(vt);		    
-	    }
-	    else
-		vt.index = p3->index;
-
-	    triangles.push_back(vt.index);
-	}
-	
-	// sort our vertices
-	std::vector<detail::myVertex> vt;
-	vt.insert(vt.begin(), vertices.begin(), vertices.end());
-	std::sort(vt.begin(), vt.end(), detail::ltVertexIndex());
+	typedef boost::unordered_map<btVector3, unsigned int, detail::hashVertexValue, detail::eqVertexValue> VertexIndex;
 	
-	// copy the data to a mesh structure 
-	unsigned int nt = triangles.size() / 3;
+	VertexIndex               index(source.size());
+	std::vector<btVector3>    vertices;
+	std::vector<unsigned int> triangles;
 	
-	shapes::Mesh *mesh = new shapes::Mesh(vt.size(), nt);
-	for (unsigned int i = 0 ; i < vt.size() ; ++i)
+	// vertices are numbered in the order in which they are first seen
+	const unsigned int n = (source.size() / 3) * 3;
+	triangles.reserve(n);
+	for (unsigned int i = 0 ; i < n ; ++i)
 	{
-	    mesh->vertices[3 * i    ] = vt[i].point.getX();
-	    mesh->vertices[3 * i + 1] = vt[i].point.getY();
-	    mesh->vertices[3 * i + 2] = vt[i].point.getZ();
+	    std::pair<VertexIndex::iterator, bool> it = index.insert(std::make_pair(source[i], (unsigned int)vertices.size()));
+	    if (it.second)
+		vertices.push_back(source[i]);
+	    triangles.push_back(it.first->second);
 	}
 	
-	std::copy(triangles.begin(), triangles.end(), mesh->triangles);
-	
-	// compute normals 
-	for (unsigned int i = 0 ; i < nt ; ++i)
-	{
-	    btVector3 s1 = vt[triangles[i * 3    ]].point - vt[triangles[i * 3 + 1]].point;
-	    btVector3 s2 = vt[triangles[i * 3 + 1]].point - vt[triangles[i * 3 + 2]].point;
-	    btVector3 normal = s1.cross(s2);
-	    normal.normalize();
-	    mesh->normals[3 * i    ] = normal.getX();
-	    mesh->normals[3 * i + 1] = normal.getY();
-	    mesh->normals[3 * i + 2] = normal.getZ();
-	}
-	
-	return mesh;
+	return createMeshFromVertices(vertices, triangles);
     }
 
     shapes::Mesh* createMeshFromBinaryStlData(const char *data, unsigned int size)
@@ -200,6 +241,7 @@ namespace shapes
 	if ((long)(50 * numTriangles + 84) <= size)
 	{
 	    std::vector<btVector3> vertices;
+	    vertices.reserve(3 * numTriangles);
 	    
 	    for (unsigned int currentTriangle = 0 ; currentTriangle < numTriangles ; ++currentTriangle)
 	    {
@@ -246,29 +288,118 @@ namespace shapes
 	return NULL;
     }
     
+    shapes::Mesh* createMeshFromBinaryStlData(const char *data, unsigned int size, const std::string &cacheDir)
+    {
+	if (cacheDir.empty())
+	    return createMeshFromBinaryStlData(data, size);
+	return detail::loadOrCreateMesh(cacheDir, detail::hashBytes(data, size), data, size);
+    }
+    
     shapes::Mesh* createMeshFromBinaryStl(const char *filename)
     {
-	FILE* input = fopen(filename, "r");
-	if (!input)
+	return createMeshFromBinaryStl(filename, std::string());
+    }
+    
+    shapes::Mesh* createMeshFromBinaryStl(const char *filename, const std::string &cacheDir)
+    {
+	// the cache key uses the name, size and modification time of the file,
+	// so a cached mesh can be used without reading the file at all
+	uint64_t key = 0;
+	if (!cacheDir.empty())
+	{
+	    struct stat st;
+	    if (stat(filename, &st) != 0)
+		return NULL;
+	    uint64_t fileSize = st.st_size, fileTime = st.st_mtime;
+	    key = detail::hashBytes(filename, strlen(filename));
+	    key = detail::hashBytes(&fileSize, sizeof(fileSize), key);
+	    key = detail::hashBytes(&fileTime, sizeof(fileTime), key);
+	    Mesh *mesh = loadMeshCache(detail::cacheFileName(cacheDir, key).c_str());
+	    if (mesh)
+		return mesh;
+	}
+	
+	std::size_t fileSize = 0;
+	void *buffer = detail::mapFile(filename, fileSize);
+	if (!buffer)
 	    return NULL;
 	
-	fseek(input, 0, SEEK_END);
-	long fileSize = ftell(input);
-	fseek(input, 0, SEEK_SET);
+	shapes::Mesh *result = NULL;
+	if (cacheDir.empty())
+	    result = createMeshFromBinaryStlData(static_cast<const char*>(buffer), fileSize);
+	else
+	    result = detail::loadOrCreateMesh(cacheDir, key, static_cast<const char*>(buffer), fileSize);
 	
-	char* buffer = new char[fileSize];
-	size_t rd = fread(buffer, fileSize, 1, input);
+	munmap(buffer, fileSize);
 	
-	fclose(input);
+	return result;
+    }
+    
+    shapes::Mesh* loadMeshCache(const char *filename)
+    {
+	std::size_t length = 0;
+	void *address = detail::mapFile(filename, length);
+	if (!address)
+	    return NULL;
 	
-	shapes::Mesh *result = NULL;
+	// check the file is a complete cached mesh before using it
+	const detail::MeshCacheHeader *header = static_cast<const detail::MeshCacheHeader*>(address);
+	bool ok = length >= sizeof(detail::MeshCacheHeader) && memcmp(header->magic, detail::MESH_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+	    length == detail::meshCacheSize(header->vertexCount, header->triangleCount);
+	
+	detail::MappedMesh *mesh = NULL;
+	if (ok)
+	{
+	    mesh = new detail::MappedMesh(address, length);
+	    const unsigned int n = 3 * mesh->triangleCount;
+	    for (unsigned int i = 0 ; ok && i < n ; ++i)
+		if (mesh->triangles[i] >= mesh->vertexCount)
+		    ok = false;
+	    if (!ok)
+	    {
+		delete mesh;
+		return NULL;
+	    }
+	}
+	else
+	    munmap(address, length);
 	
-	if (rd == 1)
-    	    result = createMeshFromBinaryStlData(buffer, fileSize);
+	return mesh;
+    }
+    
+    bool saveMeshCache(const Mesh *mesh, const char *filename)
+    {
+	// create the cache directory if needed; failure shows up when opening the file
+	std::string dir(filename);
+	std::size_t slash = dir.rfind('/');
+	if (slash != std::string::npos && slash > 0)
+	    mkdir(dir.substr(0, slash).c_str(), 0755);
 	
-	delete[] buffer;
+	// write to a temporary file first, so other processes never see a partial file
+	std::stringstream tmp;
+	tmp << filename << ".tmp" << getpid();
+	FILE *output = fopen(tmp.str().c_str(), "wb");
+	if (!output)
+	    return false;
 	
-	return result;
+	detail::MeshCacheHeader header;
+	memcpy(header.magic, detail::MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.vertexCount = mesh->vertexCount;
+	header.triangleCount = mesh->triangleCount;
+	
+	std::vector<uint32_t> triangles(mesh->triangles, mesh->triangles + 3 * mesh->triangleCount);
+	bool ok = fwrite(&header, sizeof(header), 1, output) == 1;
+	ok = ok && fwrite(mesh->vertices, sizeof(double), 3 * mesh->vertexCount, output) == 3 * mesh->vertexCount;
+	ok = ok && fwrite(mesh->normals, sizeof(double), 3 * mesh->triangleCount, output) == 3 * mesh->triangleCount;
+	ok = ok && (triangles.empty() || fwrite(&triangles[0], sizeof(uint32_t), triangles.size(), output) == triangles.size());
+	ok = fclose(output) == 0 && ok;
+	
+	if (!ok || rename(tmp.str().c_str(), filename) != 0)
+	{
+	    remove(tmp.str().c_str());
+	    return false;
+	}
+	return true;
     }
     
 }
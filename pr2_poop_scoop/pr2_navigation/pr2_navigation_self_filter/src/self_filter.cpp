@@ -45,18 +45,46 @@ class SelfFilter
 {
 public:
 
-  SelfFilter(void): nh_("~")
+  SelfFilter(void): nh_("~"), tfc_(new robot_self_filter::TransformCache(tf_))
   {
     nh_.param<std::string>("sensor_frame", sensor_frame_, std::string());
-    self_filter_ = new filters::SelfFilter<sensor_msgs::PointCloud>(nh_);
+    nh_.param<bool>("use_cloud2", use_cloud2_, false);
+    // the filter shares our listener (through the cache) instead of running a second one
+    self_filter_ = new filters::SelfFilter<sensor_msgs::PointCloud>(nh_, tfc_);
+
+    sub_ = NULL;
+    mn_ = NULL;
+    sub2_ = NULL;
+    mn2_ = NULL;
+
+    std::vector<std::string> frames;
+    self_filter_->getSelfMask()->getLinkNames(frames);
+
+    // with use_cloud2 the node filters sensor_msgs/PointCloud2 messages, without converting them
+    if (use_cloud2_)
+    {
+      sub2_ = new message_filters::Subscriber<sensor_msgs::PointCloud2>(root_handle_, "cloud_in", 1);
+      mn2_ = new tf::MessageFilter<sensor_msgs::PointCloud2>(*sub2_, tf_, "", 1);
+      pointCloudPublisher_ = root_handle_.advertise<sensor_msgs::PointCloud2>("cloud_out", 1);
+      if(frames.empty())
+      {
+        ROS_DEBUG("No valid frames have been passed into the self filter. Using a callback that will just forward scans on.");
+        no_filter_sub_ = root_handle_.subscribe<sensor_msgs::PointCloud2>("cloud_in", 1, boost::bind(&SelfFilter::noFilterCallback2, this, _1));
+      }
+      else
+      {
+        ROS_DEBUG("Valid frames were passed in. We'll filter them.");
+        mn2_->setTargetFrames(frames);
+        mn2_->registerCallback(boost::bind(&SelfFilter::cloud2Callback, this, _1));
+      }
+      return;
+    }
 
     sub_ = new message_filters::Subscriber<sensor_msgs::PointCloud>(root_handle_, "cloud_in", 1);	
     mn_ = new tf::MessageFilter<sensor_msgs::PointCloud>(*sub_, tf_, "", 1);
 
     //mn_ = new tf::MessageNotifier<sensor_msgs::PointCloud>(tf_, boost::bind(&SelfFilter::cloudCallback, this, _1), "cloud_in", "", 1);
     pointCloudPublisher_ = root_handle_.advertise<sensor_msgs::PointCloud>("cloud_out", 1);
-    std::vector<std::string> frames;
-    self_filter_->getSelfMask()->getLinkNames(frames);
     if(frames.empty())
     {
       ROS_DEBUG("No valid frames have been passed into the self filter. Using a callback that will just forward scans on.");
@@ -75,6 +103,8 @@ public:
     delete self_filter_;
     delete mn_;
     delete sub_;
+    delete mn2_;
+    delete sub2_;
   }
     
 private:
@@ -100,15 +130,43 @@ private:
     ROS_DEBUG("Self filter: reduced %d points to %d points in %f seconds", (int)cloud->points.size(), (int)out.points.size(), sec);
   }
 
+  void noFilterCallback2(const sensor_msgs::PointCloud2ConstPtr &cloud){
+    pointCloudPublisher_.publish(cloud);
+    ROS_DEBUG("Self filter publishing unfiltered frame");
+  }
+
+  void cloud2Callback(const sensor_msgs::PointCloud2ConstPtr &cloud)
+  {
+    sensor_msgs::PointCloud2 out;
+      
+    ROS_DEBUG("Got pointcloud that is %f seconds old", (ros::Time::now() - cloud->header.stamp).toSec());
+    ros::WallTime tm = ros::WallTime::now();
+      
+    if (!self_filter_->updateWithSensorFrame(*cloud, out, sensor_frame_))
+    {
+      ROS_ERROR("Self filter: unable to interpret the point cloud, dropping it");
+      return;
+    }
+      
+    double sec = (ros::WallTime::now() - tm).toSec();
+
+    pointCloudPublisher_.publish(out);
+    ROS_DEBUG("Self filter: reduced %d points to %d points in %f seconds", (int)(cloud->width * cloud->height), (int)(out.width * out.height), sec);
+  }
+
   tf::TransformListener                                 tf_;
   //tf::MessageNotifier<sensor_msgs::PointCloud>           *mn_;
   ros::NodeHandle                                       nh_, root_handle_;
+  boost::shared_ptr<robot_self_filter::TransformCache>  tfc_;
 
   tf::MessageFilter<sensor_msgs::PointCloud>           *mn_;
   message_filters::Subscriber<sensor_msgs::PointCloud> *sub_;
+  tf::MessageFilter<sensor_msgs::PointCloud2>          *mn2_;
+  message_filters::Subscriber<sensor_msgs::PointCloud2> *sub2_;
 
   filters::SelfFilter<sensor_msgs::PointCloud> *self_filter_;
   std::string sensor_frame_;
+  bool use_cloud2_;
 
   ros::Publisher                                        pointCloudPublisher_;
   ros::Subscriber                                       no_filter_sub_;
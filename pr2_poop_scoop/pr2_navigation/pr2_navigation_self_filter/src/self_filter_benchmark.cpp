@@ -0,0 +1,366 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/** \author Ioan Sucan */
+
+/** Offline benchmark for the self filter. The robot model is read from
+    a URDF file and the transforms and clouds are read from a bag, so no
+    ROS master is needed and runs are reproducible.
+
+    Usage: self_filter_benchmark [-p padding] [-s sensor_frame] <robot.urdf> [data.bag [cloud_topic ...]]
+
+    The bag is expected to contain /tf (e.g. recorded alongside
+    robot_state_publisher, which turns the joint states into transforms)
+    and the clouds to filter, as sensor_msgs/PointCloud or
+    sensor_msgs/PointCloud2. Without a bag, a synthetic scene is used:
+    the robot in its zero joint configuration and random points in a box
+    around it. data/benchmark_robot.urdf is a small model (primitive
+    shapes only) that can be used this way.
+
+    The links with collision geometry are grouped by body type and
+    maskContainment() and maskIntersection() are timed for each group
+    and each cloud size. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <unistd.h>
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <tf/tfMessage.h>
+#include <urdf/model.h>
+#include <boost/foreach.hpp>
+#include "pr2_navigation_self_filter/self_mask.h"
+
+/** \brief Maximum number of clouds kept for each topic */
+static const unsigned int MAX_CLOUDS_PER_TOPIC = 20;
+
+/** \brief Number of points the clouds are resampled to; 0 stands for the size of the recorded cloud */
+static const unsigned int CLOUD_SIZES[] = { 1000, 10000, 100000, 0 };
+
+/** \brief Number of points in the synthetic cloud */
+static const unsigned int SYNTHETIC_POINTS = 100000;
+
+/** \brief Half extents (x, y) and height (z) of the box the synthetic points are drawn from, around the root link */
+static const double SYNTHETIC_BOX[3] = { 1.5, 1.5, 2.0 };
+
+struct BenchmarkCloud
+{
+    std::string              topic;
+    sensor_msgs::PointCloud  cloud;
+};
+
+struct BenchmarkResult
+{
+    BenchmarkResult(void) : points(0), seconds(0.0)
+    {
+	counts[robot_self_filter::INSIDE] = counts[robot_self_filter::OUTSIDE] = counts[robot_self_filter::SHADOW] = 0;
+    }
+
+    void add(const std::vector<unsigned char> &mask, double sec)
+    {
+	points += mask.size();
+	seconds += sec;
+	for (unsigned int i = 0 ; i < mask.size() ; ++i)
+	    counts[mask[i]]++;
+    }
+
+    void print(const char *group, const char *method, unsigned int size) const
+    {
+	printf("%-10s %-13s %8u %12.0f %10u %10u %10u\n", group, method, size, seconds > 0.0 ? (double)points / seconds : 0.0,
+	       counts[robot_self_filter::INSIDE], counts[robot_self_filter::OUTSIDE], counts[robot_self_filter::SHADOW]);
+    }
+
+    unsigned int points;
+    double       seconds;
+    unsigned int counts[3];
+};
+
+static const char* geometryName(int type)
+{
+    switch (type)
+    {
+    case urdf::Geometry::SPHERE:
+	return "sphere";
+    case urdf::Geometry::BOX:
+	return "box";
+    case urdf::Geometry::CYLINDER:
+	return "cylinder";
+    case urdf::Geometry::MESH:
+	return "mesh";
+    default:
+	return "unknown";
+    }
+}
+
+/** \brief Read all of /tf into \e tf and the clouds on \e topics into \e clouds */
+static bool loadBag(const std::string &filename, const std::vector<std::string> &topics, tf::Transformer &tf, std::vector<BenchmarkCloud> &clouds)
+{
+    rosbag::Bag bag;
+    try
+    {
+	bag.open(filename, rosbag::bagmode::Read);
+    }
+    catch (rosbag::BagException &ex)
+    {
+	ROS_ERROR("Unable to open '%s': %s", filename.c_str(), ex.what());
+	return false;
+    }
+
+    // transforms first, so that every cloud finds its transforms regardless of the order of the messages in the bag
+    rosbag::View tfView(bag, rosbag::TopicQuery(std::vector<std::string>(1, "/tf")));
+    unsigned int ntf = 0;
+    BOOST_FOREACH(const rosbag::MessageInstance &m, tfView)
+    {
+	tf::tfMessage::ConstPtr msg = m.instantiate<tf::tfMessage>();
+	if (!msg)
+	    continue;
+	for (unsigned int i = 0 ; i < msg->transforms.size() ; ++i)
+	{
+	    tf::StampedTransform t;
+	    tf::transformStampedMsgToTF(msg->transforms[i], t);
+	    tf.setTransform(t, "bag");
+	    ntf++;
+	}
+    }
+
+    std::map<std::string, unsigned int> count;
+    rosbag::View cloudView(bag, rosbag::TopicQuery(topics));
+    BOOST_FOREACH(const rosbag::MessageInstance &m, cloudView)
+    {
+	if (count[m.getTopic()] >= MAX_CLOUDS_PER_TOPIC)
+	    continue;
+	BenchmarkCloud bc;
+	bc.topic = m.getTopic();
+	sensor_msgs::PointCloud::ConstPtr pc = m.instantiate<sensor_msgs::PointCloud>();
+	if (pc)
+	    bc.cloud = *pc;
+	else
+	{
+	    sensor_msgs::PointCloud2::ConstPtr pc2 = m.instantiate<sensor_msgs::PointCloud2>();
+	    if (!pc2)
+		continue;
+	    robot_self_filter::CloudView view(*pc2);
+	    if (!view.valid())
+		continue;
+	    bc.cloud.header = view.header();
+	    bc.cloud.points.resize(view.size());
+	    for (unsigned int i = 0 ; i < view.size() ; ++i)
+	    {
+		bc.cloud.points[i].x = view.x(i);
+		bc.cloud.points[i].y = view.y(i);
+		bc.cloud.points[i].z = view.z(i);
+	    }
+	}
+	if (bc.cloud.points.empty())
+	    continue;
+	count[bc.topic]++;
+	clouds.push_back(bc);
+    }
+    bag.close();
+
+    ROS_INFO("Read %u transforms and %u clouds from '%s'", ntf, (unsigned int)clouds.size(), filename.c_str());
+    return !clouds.empty();
+}
+
+/** \brief Put the robot of \e model in its zero joint configuration into \e tf, and fill a cloud with
+    points drawn uniformly from a box around the root link. The same seed is used on every run. */
+static bool makeSyntheticScene(const urdf::Model &model, tf::Transformer &tf, std::vector<BenchmarkCloud> &clouds)
+{
+    boost::shared_ptr<const urdf::Link> root = model.getRoot();
+    if (!root)
+	return false;
+    const ros::Time stamp(1.0);
+
+    std::vector<boost::shared_ptr<urdf::Link> > links;
+    model.getLinks(links);
+    for (unsigned int i = 0 ; i < links.size() ; ++i)
+    {
+	const boost::shared_ptr<urdf::Joint> &joint = links[i]->parent_joint;
+	if (!joint)
+	    continue;
+	const urdf::Pose &pose = joint->parent_to_joint_origin_transform;
+	double qx, qy, qz, qw;
+	pose.rotation.getQuaternion(qx, qy, qz, qw);
+	tf::StampedTransform t(btTransform(btQuaternion(qx, qy, qz, qw), btVector3(pose.position.x, pose.position.y, pose.position.z)),
+			       stamp, joint->parent_link_name, joint->child_link_name);
+	tf.setTransform(t, "synthetic");
+    }
+
+    BenchmarkCloud bc;
+    bc.topic = "synthetic";
+    bc.cloud.header.frame_id = root->name;
+    bc.cloud.header.stamp = stamp;
+    bc.cloud.points.resize(SYNTHETIC_POINTS);
+    srand(42);
+    for (unsigned int i = 0 ; i < SYNTHETIC_POINTS ; ++i)
+    {
+	bc.cloud.points[i].x = SYNTHETIC_BOX[0] * (2.0 * rand() / RAND_MAX - 1.0);
+	bc.cloud.points[i].y = SYNTHETIC_BOX[1] * (2.0 * rand() / RAND_MAX - 1.0);
+	bc.cloud.points[i].z = SYNTHETIC_BOX[2] * rand() / RAND_MAX;
+    }
+    clouds.push_back(bc);
+
+    ROS_INFO("Synthetic scene: %u links, %u points in the frame of '%s'", (unsigned int)links.size(), SYNTHETIC_POINTS, root->name.c_str());
+    return true;
+}
+
+/** \brief Build a cloud of \e size points by cycling through the points of \e src */
+static void resample(const sensor_msgs::PointCloud &src, unsigned int size, sensor_msgs::PointCloud &dst)
+{
+    dst.header = src.header;
+    dst.channels.clear();
+    if (size == 0)
+	size = src.points.size();
+    dst.points.resize(size);
+    for (unsigned int i = 0 ; i < size ; ++i)
+	dst.points[i] = src.points[i % src.points.size()];
+}
+
+int main(int argc, char **argv)
+{
+    std::string sensor_frame = "laser_tilt_mount_link";
+    double padding = 0.01;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:h")) != -1)
+    {
+	switch (opt)
+	{
+	case 'p':
+	    padding = atof(optarg);
+	    break;
+	case 's':
+	    sensor_frame = optarg;
+	    break;
+	default:
+	    printf("Usage: %s [-p padding] [-s sensor_frame] <robot.urdf> [data.bag [cloud_topic ...]]\n", argv[0]);
+	    printf("  -p  padding added to every link, in m (default 0.01)\n");
+	    printf("  -s  frame of the sensor, for the shadow points (default laser_tilt_mount_link)\n");
+	    printf("Without a bag, a synthetic scene around the robot in its zero configuration is used.\n");
+	    return opt == 'h' ? 0 : 1;
+	}
+    }
+    if (optind >= argc)
+    {
+	printf("Usage: %s [-p padding] [-s sensor_frame] <robot.urdf> [data.bag [cloud_topic ...]]\n", argv[0]);
+	return 1;
+    }
+
+    // no master is contacted: the clock is the wall clock and the transforms come from the bag
+    ros::Time::init();
+
+    std::vector<std::string> topics;
+    for (int i = optind + 2 ; i < argc ; ++i)
+	topics.push_back(argv[i]);
+    if (topics.empty())
+    {
+	topics.push_back("/tilt_scan_cloud");
+	topics.push_back("/base_scan_cloud");
+    }
+
+    urdf::Model model;
+    if (!model.initFile(argv[optind]))
+    {
+	ROS_ERROR("Unable to parse URDF from '%s'", argv[optind]);
+	return 1;
+    }
+
+    // keep the whole bag in the buffer; lookups are made at the recorded stamps
+    tf::Transformer tf(true, ros::Duration(3600.0));
+    std::vector<BenchmarkCloud> clouds;
+    bool loaded = optind + 1 < argc ? loadBag(argv[optind + 1], topics, tf, clouds) : makeSyntheticScene(model, tf, clouds);
+    if (!loaded)
+    {
+	ROS_ERROR("No clouds to filter");
+	return 1;
+    }
+
+    // group the links by the type of their collision geometry
+    std::vector<boost::shared_ptr<urdf::Link> > urdfLinks;
+    model.getLinks(urdfLinks);
+    std::map<std::string, std::vector<robot_self_filter::LinkInfo> > groups;
+    for (unsigned int i = 0 ; i < urdfLinks.size() ; ++i)
+    {
+	if (!urdfLinks[i]->collision || !urdfLinks[i]->collision->geometry)
+	    continue;
+	robot_self_filter::LinkInfo li;
+	li.name = urdfLinks[i]->name;
+	li.padding = padding;
+	li.scale = 1.0;
+	groups[geometryName(urdfLinks[i]->collision->geometry->type)].push_back(li);
+	groups["all"].push_back(li);
+    }
+
+    printf("%-10s %-13s %8s %12s %10s %10s %10s\n", "bodies", "method", "points", "points/s", "INSIDE", "OUTSIDE", "SHADOW");
+    for (std::map<std::string, std::vector<robot_self_filter::LinkInfo> >::const_iterator it = groups.begin() ; it != groups.end() ; ++it)
+    {
+	robot_self_filter::SelfMask sm(tf, it->second, model);
+
+	for (unsigned int s = 0 ; s < sizeof(CLOUD_SIZES) / sizeof(CLOUD_SIZES[0]) ; ++s)
+	{
+	    BenchmarkResult containment, intersection;
+	    unsigned int total = 0;
+	    sensor_msgs::PointCloud cloud;
+	    std::vector<unsigned char> mask;
+
+	    for (unsigned int c = 0 ; c < clouds.size() ; ++c)
+	    {
+		resample(clouds[c].cloud, CLOUD_SIZES[s], cloud);
+		robot_self_filter::CloudView view(cloud);
+		total += cloud.points.size();
+
+		// maskContainment() and maskIntersection() call assumeFrame() themselves, so placing the
+		// links is part of the timed region. This call only warms the transform cache, so that the
+		// timed calls get their transforms from the snapshot instead of waiting on TF.
+		sm.assumeFrame(cloud.header, sensor_frame, 0.0);
+
+		ros::WallTime tm = ros::WallTime::now();
+		sm.maskContainment(view, mask);
+		containment.add(mask, (ros::WallTime::now() - tm).toSec());
+
+		tm = ros::WallTime::now();
+		sm.maskIntersection(view, sensor_frame, 0.0, mask);
+		intersection.add(mask, (ros::WallTime::now() - tm).toSec());
+	    }
+
+	    unsigned int size = CLOUD_SIZES[s] ? CLOUD_SIZES[s] : total / clouds.size();
+	    containment.print(it->first.c_str(), "containment", size);
+	    intersection.print(it->first.c_str(), "intersection", size);
+	}
+    }
+
+    return 0;
+}
@@ -46,6 +46,7 @@ void robot_self_filter::SelfMask::freeMemory(void)
     }
     
     bodies_.clear();
+    frames_.clear();
 }
 
 
@@ -57,7 +58,7 @@ namespace robot_self_filter
 			   btVector3(pose.position.x, pose.position.y, pose.position.z));
     }
 
-    static shapes::Shape* constructShape(const urdf::Geometry *geom)
+    static shapes::Shape* constructShape(const urdf::Geometry *geom, const std::string &cacheDir)
     {
 	ROS_ASSERT(geom);
 	
@@ -102,7 +103,7 @@ namespace robot_self_filter
 			    ROS_WARN("Retrieved empty mesh for resource '%s'", mesh->filename.c_str());
 			else
 			{
-			    result = shapes::createMeshFromBinaryStlData(reinterpret_cast<char*>(res.data.get()), res.size);
+			    result = shapes::createMeshFromBinaryStlData(reinterpret_cast<char*>(res.data.get()), res.size, cacheDir);
 			    if (result == NULL)
 				ROS_ERROR("Failed to load mesh '%s'", mesh->filename.c_str());
 			}
@@ -124,28 +125,36 @@ namespace robot_self_filter
 
 bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links)
 {
-    // in case configure was called before, we free the memory
-    freeMemory();
-    sensor_pos_.setValue(0, 0, 0);
-    
     std::string content;
     boost::shared_ptr<urdf::Model> urdfModel;
+    ros::NodeHandle nh;
 
-    if (nh_.getParam("robot_description", content))
+    if (nh.getParam("robot_description", content))
     {
 	urdfModel = boost::shared_ptr<urdf::Model>(new urdf::Model());
 	if (!urdfModel->initString(content))
 	{
 	    ROS_ERROR("Unable to parse URDF description!");
+	    freeMemory();
 	    return false;
 	}
     }
     else
     {
 	ROS_ERROR("Robot model not found! Did you remap 'robot_description'?");
+	freeMemory();
 	return false;
     }
     
+    return configure(links, *urdfModel);
+}
+
+bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links, const urdf::Model &model)
+{
+    // in case configure was called before, we free the memory
+    freeMemory();
+    sensor_pos_.setValue(0, 0, 0);
+    
     std::stringstream missing;
     
     // from the geometric model, find the shape of each link of interest
@@ -153,7 +162,7 @@ bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links)
     // check for point inclusion
     for (unsigned int i = 0 ; i < links.size() ; ++i)
     {
-	const urdf::Link *link = urdfModel->getLink(links[i].name).get();
+	const urdf::Link *link = model.getLink(links[i].name).get();
 	if (!link)
 	{
 	    missing << " " << links[i].name;
@@ -166,7 +175,7 @@ bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links)
 	    continue;
 	}
 	
-	shapes::Shape *shape = constructShape(link->collision->geometry.get());
+	shapes::Shape *shape = constructShape(link->collision->geometry.get(), hull_options_.cacheDir);
 	
 	if (!shape)
 	{
@@ -175,7 +184,7 @@ bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links)
 	}
 	
 	SeeLink sl;
-	sl.body = bodies::createBodyFromShape(shape);
+	sl.body = bodies::createBodyFromShape(shape, hull_options_);
 
 	if (sl.body)
 	{
@@ -189,8 +198,17 @@ bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links)
 	    sl.body->setPadding(links[i].padding);
             ROS_INFO_STREAM("Self see link name " <<  links[i].name << " padding " << links[i].padding);
 	    sl.volume = sl.body->computeVolume();
-	    sl.unscaledBody = bodies::createBodyFromShape(shape);
+	    sl.unscaledBody = bodies::createBodyFromShape(shape, hull_options_);
 	    bodies_.push_back(sl);
+	    
+	    if (shape->type == shapes::MESH)
+	    {
+		const bodies::HullStats &hs = static_cast<const bodies::ConvexMesh*>(sl.body)->getHullStats();
+		ROS_INFO("Self see link %s: convex hull of %u triangles uses %u planes (%u distinct), estimated containment error %g m%s",
+			 links[i].name.c_str(), hs.triangles, hs.planes, hs.distinctPlanes, hs.error, hs.fromCache ? " (cached)" : "");
+		for (unsigned int j = 0 ; j < hs.tradeoff.size() ; ++j)
+		    ROS_DEBUG("Self see link %s: %u planes, estimated containment error %g m", links[i].name.c_str(), hs.tradeoff[j].first, hs.tradeoff[j].second);
+	    }
 	}
 	else
 	    ROS_WARN("Unable to create point inclusion body for link '%s'", links[i].name.c_str());
@@ -209,6 +227,11 @@ bool robot_self_filter::SelfMask::configure(const std::vector<LinkInfo> &links)
     
     bspheres_.resize(bodies_.size());
     bspheresRadius2_.resize(bodies_.size());
+    
+    // the frames we look up for every cloud; the sensor frame, if any, is appended at the end
+    frames_.resize(bodies_.size());
+    for (unsigned int i = 0 ; i < bodies_.size() ; ++i)
+	frames_[i] = bodies_[i].name;
 
     for (unsigned int i = 0 ; i < bodies_.size() ; ++i)
 	ROS_DEBUG("Self mask includes link %s with volume %f", bodies_[i].name.c_str(), bodies_[i].volume);
@@ -224,28 +247,29 @@ void robot_self_filter::SelfMask::getLinkNames(std::vector<std::string> &frames)
 	frames.push_back(bodies_[i].name);
 }
 
-void robot_self_filter::SelfMask::maskContainment(const sensor_msgs::PointCloud& data_in, std::vector<int> &mask)
+template<typename M>
+void robot_self_filter::SelfMask::maskContainmentT(const CloudView& data_in, std::vector<M> &mask)
 {
-    mask.resize(data_in.points.size());
+    mask.resize(data_in.size());
     if (bodies_.empty())
-	std::fill(mask.begin(), mask.end(), (int)OUTSIDE);
+	std::fill(mask.begin(), mask.end(), (M)OUTSIDE);
     else
     {
-	assumeFrame(data_in.header);
+	assumeFrame(data_in.header());
 	maskAuxContainment(data_in, mask);
     }
 }
 
-void robot_self_filter::SelfMask::maskIntersection(const sensor_msgs::PointCloud& data_in, const std::string &sensor_frame, const double min_sensor_dist,
-						   std::vector<int> &mask, const boost::function<void(const btVector3&)> &callback)
+template<typename M>
+void robot_self_filter::SelfMask::maskIntersectionT(const CloudView& data_in, const std::string &sensor_frame, const double min_sensor_dist,
+						    std::vector<M> &mask, const boost::function<void(const btVector3&)> &callback)
 {
-    mask.resize(data_in.points.size());
-    if (bodies_.empty()) {
-      std::fill(mask.begin(), mask.end(), (int)OUTSIDE);
-    }
+    mask.resize(data_in.size());
+    if (bodies_.empty())
+	std::fill(mask.begin(), mask.end(), (M)OUTSIDE);
     else
     {
-	assumeFrame(data_in.header, sensor_frame, min_sensor_dist);
+	assumeFrame(data_in.header(), sensor_frame, min_sensor_dist);
 	if (sensor_frame.empty())
 	    maskAuxContainment(data_in, mask);
 	else
@@ -253,6 +277,28 @@ void robot_self_filter::SelfMask::maskIntersection(const sensor_msgs::PointCloud
     }
 }
 
+void robot_self_filter::SelfMask::maskContainment(const sensor_msgs::PointCloud& data_in, std::vector<int> &mask)
+{
+    maskContainmentT(CloudView(data_in), mask);
+}
+
+void robot_self_filter::SelfMask::maskContainment(const CloudView& data_in, std::vector<unsigned char> &mask)
+{
+    maskContainmentT(data_in, mask);
+}
+
+void robot_self_filter::SelfMask::maskIntersection(const sensor_msgs::PointCloud& data_in, const std::string &sensor_frame, const double min_sensor_dist,
+						   std::vector<int> &mask, const boost::function<void(const btVector3&)> &callback)
+{
+    maskIntersectionT(CloudView(data_in), sensor_frame, min_sensor_dist, mask, callback);
+}
+
+void robot_self_filter::SelfMask::maskIntersection(const CloudView& data_in, const std::string &sensor_frame, const double min_sensor_dist,
+						   std::vector<unsigned char> &mask, const boost::function<void(const btVector3&)> &callback)
+{
+    maskIntersectionT(data_in, sensor_frame, min_sensor_dist, mask, callback);
+}
+
 void robot_self_filter::SelfMask::maskIntersection(const sensor_msgs::PointCloud& data_in, const btVector3 &sensor_pos, const double min_sensor_dist,
 						   std::vector<int> &mask, const boost::function<void(const btVector3&)> &callback)
 {
@@ -262,7 +308,7 @@ void robot_self_filter::SelfMask::maskIntersection(const sensor_msgs::PointCloud
     else
     {
 	assumeFrame(data_in.header, sensor_pos, min_sensor_dist);
-	maskAuxIntersection(data_in, mask, callback);
+	maskAuxIntersection(CloudView(data_in), mask, callback);
     }
 }
 
@@ -285,69 +331,46 @@ void robot_self_filter::SelfMask::assumeFrame(const roslib::Header& header, cons
 
 void robot_self_filter::SelfMask::assumeFrame(const roslib::Header& header, const std::string &sensor_frame, double min_sensor_dist)
 {
-  
-  assumeFrame(header);
-
-  std::string err;
-  if(!tf_.waitForTransform(header.frame_id, sensor_frame, header.stamp, ros::Duration(.1), ros::Duration(.01), &err)) {
-    ROS_ERROR("WaitForTransform timed out from %s to %s after 100ms.  Error string: %s", sensor_frame.c_str(), header.frame_id.c_str(), err.c_str());
-    sensor_pos_.setValue(0, 0, 0);
-  } 
-
-  //transform should be there
-  // compute the origin of the sensor in the frame of the cloud
-  try
-  {
-    tf::StampedTransform transf;
-    tf_.lookupTransform(header.frame_id, sensor_frame, header.stamp, transf);
-    sensor_pos_ = transf.getOrigin();
-  }
-  catch(tf::TransformException& ex)
-  {
-    sensor_pos_.setValue(0, 0, 0);
-    ROS_ERROR("Unable to lookup transform from %s to %s.  Exception: %s", sensor_frame.c_str(), header.frame_id.c_str(), ex.what());
-  }
-  
-  min_sensor_dist_ = min_sensor_dist;
+    placeLinks(header, sensor_frame);
+    min_sensor_dist_ = min_sensor_dist;
 }
 
 void robot_self_filter::SelfMask::assumeFrame(const roslib::Header& header)
+{
+    placeLinks(header, std::string());
+}
+
+void robot_self_filter::SelfMask::placeLinks(const roslib::Header& header, const std::string &sensor_frame)
 {
     const unsigned int bs = bodies_.size();
     
-    // place the links in the assumed frame 
+    // resolve all the links (and the sensor) in one pass; frames that
+    // cannot be found are reported by the cache and get the identity transform
+    if (!sensor_frame.empty())
+	frames_.push_back(sensor_frame);
+    tfc_->lookup(header.frame_id, header.stamp, frames_, transforms_);
+    if (!sensor_frame.empty())
+    {
+	// compute the origin of the sensor in the frame of the cloud
+	sensor_pos_ = transforms_.back().getOrigin();
+	frames_.pop_back();
+    }
+    
+    // place the links in the assumed frame; we also include the offset specified in URDF
     for (unsigned int i = 0 ; i < bs ; ++i)
     {
-      std::string err;
-      if(!tf_.waitForTransform(header.frame_id, bodies_[i].name, header.stamp, ros::Duration(.1), ros::Duration(.01), &err)) {
-        ROS_ERROR("WaitForTransform timed out from %s to %s after 100ms.  Error string: %s", bodies_[i].name.c_str(), header.frame_id.c_str(), err.c_str());
-        
-      } 
-      
-      // find the transform between the link's frame and the pointcloud frame
-      tf::StampedTransform transf;
-      try
-      {
-        tf_.lookupTransform(header.frame_id, bodies_[i].name, header.stamp, transf);
-      }
-      catch(tf::TransformException& ex)
-      {
-        transf.setIdentity();
-        ROS_ERROR("Unable to lookup transform from %s to %s. Exception: %s", bodies_[i].name.c_str(), header.frame_id.c_str(), ex.what());	
-      }
-      
-      // set it for each body; we also include the offset specified in URDF
-      bodies_[i].body->setPose(transf * bodies_[i].constTransf);
-      bodies_[i].unscaledBody->setPose(transf * bodies_[i].constTransf);
+	bodies_[i].body->setPose(transforms_[i] * bodies_[i].constTransf);
+	bodies_[i].unscaledBody->setPose(transforms_[i] * bodies_[i].constTransf);
     }
     
     computeBoundingSpheres();
 }
 
-void robot_self_filter::SelfMask::maskAuxContainment(const sensor_msgs::PointCloud& data_in, std::vector<int> &mask)
+template<typename M>
+void robot_self_filter::SelfMask::maskAuxContainment(const CloudView& data_in, std::vector<M> &mask)
 {
     const unsigned int bs = bodies_.size();
-    const unsigned int np = data_in.points.size();
+    const unsigned int np = data_in.size();
     
     // compute a sphere that bounds the entire robot
     bodies::BoundingSphere bound;
@@ -358,21 +381,22 @@ void robot_self_filter::SelfMask::maskAuxContainment(const sensor_msgs::PointClo
     //#pragma omp parallel for schedule(dynamic) 
     for (int i = 0 ; i < (int)np ; ++i)
     {
-	btVector3 pt = btVector3(data_in.points[i].x, data_in.points[i].y, data_in.points[i].z);
+	btVector3 pt = data_in.point(i);
 	int out = OUTSIDE;
 	if (bound.center.distance2(pt) < radiusSquared)
 	    for (unsigned int j = 0 ; out == OUTSIDE && j < bs ; ++j)
 		if (bodies_[j].body->containsPoint(pt))
 		    out = INSIDE;
 	
-	mask[i] = out;
+	mask[i] = (M)out;
     }
 }
 
-void robot_self_filter::SelfMask::maskAuxIntersection(const sensor_msgs::PointCloud& data_in, std::vector<int> &mask, const boost::function<void(const btVector3&)> &callback)
+template<typename M>
+void robot_self_filter::SelfMask::maskAuxIntersection(const CloudView& data_in, std::vector<M> &mask, const boost::function<void(const btVector3&)> &callback)
 {
     const unsigned int bs = bodies_.size();
-    const unsigned int np = data_in.points.size();
+    const unsigned int np = data_in.size();
     
     // compute a sphere that bounds the entire robot
     bodies::BoundingSphere bound;
@@ -387,7 +411,7 @@ void robot_self_filter::SelfMask::maskAuxIntersection(const sensor_msgs::PointCl
     {
       bool print = false;
       //if(i%100 == 0) print = true;
-	btVector3 pt = btVector3(data_in.points[i].x, data_in.points[i].y, data_in.points[i].z);
+	btVector3 pt = data_in.point(i);
 	int out = OUTSIDE;
 
 	// we first check is the point is in the unscaled body. 
@@ -436,7 +460,7 @@ void robot_self_filter::SelfMask::maskAuxIntersection(const sensor_msgs::PointCl
                       }
 	    }
 	}
-	mask[i] = out;
+	mask[i] = (M)out;
     }
 }
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pr2_navigation_self_filter/transform_cache.h"
+#include <ros/console.h>
+
+robot_self_filter::TransformCache::TransformCache(tf::Transformer &tf, unsigned int max_snapshots) : tf_(tf), max_snapshots_(max_snapshots)
+{
+    if (max_snapshots_ == 0)
+	max_snapshots_ = 1;
+}
+
+void robot_self_filter::TransformCache::clear(void)
+{
+    boost::mutex::scoped_lock slock(lock_);
+    snapshots_.clear();
+}
+
+robot_self_filter::TransformCache::Snapshot& robot_self_filter::TransformCache::getSnapshot(const std::string &target_frame, const ros::Time &stamp)
+{
+    // the most recent snapshot is at the back; that is the one most likely to be asked for
+    for (std::deque<Snapshot>::reverse_iterator it = snapshots_.rbegin() ; it != snapshots_.rend() ; ++it)
+	if (it->stamp == stamp && it->target_frame == target_frame)
+	    return *it;
+    
+    if (snapshots_.size() >= max_snapshots_)
+	snapshots_.pop_front();
+    snapshots_.push_back(Snapshot());
+    snapshots_.back().target_frame = target_frame;
+    snapshots_.back().stamp = stamp;
+    return snapshots_.back();
+}
+
+bool robot_self_filter::TransformCache::lookup(const std::string &target_frame, const ros::Time &stamp, const std::vector<std::string> &frames,
+					       std::vector<btTransform> &transforms, const ros::Duration &timeout)
+{
+    transforms.resize(frames.size());
+    
+    // a zero stamp means "latest available", which is not a fixed point in time and cannot be cached
+    const bool cacheable = !stamp.isZero();
+    
+    // first take whatever we already know for this stamp
+    std::vector<unsigned int> missing;
+    if (!cacheable)
+    {
+	for (unsigned int i = 0 ; i < frames.size() ; ++i)
+	    missing.push_back(i);
+    }
+    else
+    {
+	boost::mutex::scoped_lock slock(lock_);
+	Snapshot &snap = getSnapshot(target_frame, stamp);
+	for (unsigned int i = 0 ; i < frames.size() ; ++i)
+	{
+	    std::map<std::string, btTransform>::const_iterator it = snap.transforms.find(frames[i]);
+	    if (it == snap.transforms.end())
+		missing.push_back(i);
+	    else
+		transforms[i] = it->second;
+	}
+    }
+    
+    if (missing.empty())
+	return true;
+    
+    // wait for all the missing frames at once; the timeout applies to the whole set
+    std::vector<unsigned int> pending = missing;
+    ros::Time deadline = ros::Time::now() + timeout;
+    while (true)
+    {
+	std::vector<unsigned int> still_pending;
+	for (unsigned int i = 0 ; i < pending.size() ; ++i)
+	    if (!tf_.canTransform(target_frame, frames[pending[i]], stamp))
+		still_pending.push_back(pending[i]);
+	pending.swap(still_pending);
+	if (pending.empty() || ros::Time::now() >= deadline)
+	    break;
+	ros::Duration(0.01).sleep();
+    }
+    
+    for (unsigned int i = 0 ; i < pending.size() ; ++i)
+	ROS_ERROR("WaitForTransform timed out from %s to %s after %f seconds", frames[pending[i]].c_str(), target_frame.c_str(), timeout.toSec());
+    
+    // look up the transforms; only the ones we actually obtained are remembered
+    bool result = true;
+    std::vector<bool> found(missing.size(), false);
+    for (unsigned int i = 0 ; i < missing.size() ; ++i)
+    {
+	const unsigned int k = missing[i];
+	tf::StampedTransform transf;
+	try
+	{
+	    tf_.lookupTransform(target_frame, frames[k], stamp, transf);
+	    transforms[k] = transf;
+	    found[i] = true;
+	}
+	catch(tf::TransformException& ex)
+	{
+	    transforms[k].setIdentity();
+	    result = false;
+	    ROS_ERROR("Unable to lookup transform from %s to %s. Exception: %s", frames[k].c_str(), target_frame.c_str(), ex.what());
+	}
+    }
+    
+    if (cacheable)
+    {
+	boost::mutex::scoped_lock slock(lock_);
+	Snapshot &snap = getSnapshot(target_frame, stamp);
+	for (unsigned int i = 0 ; i < missing.size() ; ++i)
+	    if (found[i])
+		snap.transforms[frames[missing[i]]] = transforms[missing[i]];
+    }
+    
+    return result;
+}
+
+bool robot_self_filter::TransformCache::lookup(const std::string &target_frame, const ros::Time &stamp, const std::string &frame,
+					       btTransform &transform, const ros::Duration &timeout)
+{
+    std::vector<std::string> frames(1, frame);
+    std::vector<btTransform> transforms;
+    bool result = lookup(target_frame, stamp, frames, transforms, timeout);
+    transform = transforms[0];
+    return result;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SEMANTIC_POINT_ANNOTATOR_CLOUD_PIPELINE_H_
+#define _SEMANTIC_POINT_ANNOTATOR_CLOUD_PIPELINE_H_
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud.h>  // ROS point cloud type
+#include <tf/transform_listener.h>
+#include <Eigen/Core>
+#include <boost/function.hpp>
+#include <string>
+#include <vector>
+
+namespace semantic_point_annotator
+{
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  // Helpers shared by the ground removal nodes
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Get the index of a specified dimension/channel in a point cloud, or -1 if it does not exist
+    * \param points the point cloud
+    * \param channel_name the string defining the channel name
+    */
+  int getChannelIndex (const sensor_msgs::PointCloud &points, const std::string &channel_name);
+
+  /** \brief Get the available dimensions as a space separated string
+    * \param cloud the point cloud data message
+    */
+  std::string getAvailableChannels (const sensor_msgs::PointCloud &cloud);
+
+  /** \brief Decompose a PointCloud message into LaserScan clusters
+    * \param points the point cloud message
+    * \param indices a list of point indices
+    * \param clusters the resultant clusters
+    * \param idx the index of the channel containing the laser scan index
+    */
+  void splitPointsBasedOnLaserScanIndex (const sensor_msgs::PointCloud &points, const std::vector<int> &indices,
+                                         std::vector<std::vector<int> > &clusters, int idx);
+
+  /** \brief Get the distance from a point to a plane (signed) defined by ax+by+cz+d=0
+    * \param p a point
+    * \param plane_coefficients the normalized coefficients (a, b, c, d) of a plane
+    */
+  inline double
+    pointToPlaneDistanceSigned (const geometry_msgs::Point32 &p, const Eigen::Vector4d &plane_coefficients)
+  {
+    return ( plane_coefficients (0) * p.x + plane_coefficients (1) * p.y + plane_coefficients (2) * p.z + plane_coefficients (3) );
+  }
+
+  /** \brief Order point indices by the distance of their points to the ground (z = 0). This is the quality ordering
+    * used for PROSAC: the points closest to the ground are the most likely ground line inliers. */
+  struct CloserToGround
+  {
+    CloserToGround (const sensor_msgs::PointCloud *points) : points_ (points) { }
+    bool operator () (int a, int b) const
+    {
+      return (fabs (points_->points[a].z) < fabs (points_->points[b].z));
+    }
+    const sensor_msgs::PointCloud *points_;
+  };
+
+  /** \brief Flip (in place) the estimated normal of a point towards a given viewpoint
+    * \param normal the plane normal to be flipped
+    * \param point a given point
+    * \param viewpoint the viewpoint
+    */
+  void flipNormalTowardsViewpoint (Eigen::Vector4d &normal, const geometry_msgs::Point32 &point,
+                                   const geometry_msgs::PointStamped &viewpoint);
+
+  /** \brief Compute the Least-Squares plane fit for a given set of points, using their indices,
+    * and return the estimated plane parameters together with the surface curvature.
+    * \param points the input point cloud
+    * \param indices the point cloud indices that need to be used
+    * \param plane_parameters the plane parameters as: a, b, c, d (ax + by + cz + d = 0)
+    * \param curvature the estimated surface curvature as a measure of
+    * \f[
+    * \lambda_0 / (\lambda_0 + \lambda_1 + \lambda_2)
+    * \f]
+    */
+  void computePointNormal (const sensor_msgs::PointCloud &points, const std::vector<int> &indices,
+                           Eigen::Vector4d &plane_parameters, double &curvature);
+
+  /** \brief Get the view point from where the scans were taken in the incoming PointCloud message frame. Falls back to
+    * the PR2 tilting laser position if the transform is not available.
+    * \param tf a pointer to a TransformListener object
+    * \param viewpoint_frame the frame of the sensor
+    * \param cloud_frame the point cloud message TF frame
+    * \param viewpoint_cloud the resultant view point in the incoming cloud frame
+    */
+  void getCloudViewPoint (tf::TransformListener *tf, const std::string &viewpoint_frame, const std::string &cloud_frame,
+                          geometry_msgs::PointStamped &viewpoint_cloud);
+
+  /** \brief Transform a value from a source frame to a target frame at a certain moment in time with TF. The value is
+    * taken as the z coordinate of a point on the z axis of the source frame. Returns the value unchanged if the
+    * transform is not available.
+    * \param val the value to transform
+    * \param src_frame the source frame to transform the value from
+    * \param tgt_frame the target frame to transform the value into
+    * \param stamp a given time stamp
+    * \param tf a pointer to a TransformListener object
+    */
+  double transformDoubleValueTF (double val, const std::string &src_frame, const std::string &tgt_frame,
+                                 const ros::Time &stamp, tf::TransformListener *tf);
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  // Pipeline
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief The data passed along the stages of a pipeline. All the stages work on the same cloud buffer, either in
+    * place or through the index sets below, so that a cloud is only copied when it enters (transformed) and when it
+    * leaves (filtered) the pipeline.
+    */
+  struct CloudContext
+  {
+    /** \brief The input message, as received. */
+    sensor_msgs::PointCloudConstPtr input;
+    /** \brief The working cloud. */
+    sensor_msgs::PointCloud cloud;
+    /** \brief The view point of the sensor, in the frame of the working cloud. */
+    geometry_msgs::PointStamped viewpoint;
+    /** \brief The points the segmentation stages look at (e.g. the points close to the ground). */
+    std::vector<int> candidates;
+    /** \brief The points the segmentation stages found (e.g. the ground points). */
+    std::vector<int> inliers;
+    /** \brief The resultant cloud. */
+    sensor_msgs::PointCloud output;
+  };
+
+  /** \brief A pipeline stage. Returns false if the processing of the current cloud should stop there. */
+  typedef boost::function<bool (CloudContext &)> CloudStage;
+
+  /** \brief A sequence of named stages run on the same CloudContext, timing each of them. */
+  class CloudPipeline
+  {
+    public:
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Append a stage to the pipeline.
+        * \param name the name of the stage, used when printing the timings
+        * \param stage the stage
+        */
+      void addStage (const std::string &name, const CloudStage &stage);
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Run all the stages in order, until one of them returns false.
+        * \param context the data to process
+        * \return true if all the stages were run successfully
+        */
+      bool process (CloudContext &context);
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Print the time spent in every stage for the last cloud, and on average (ROS_DEBUG). */
+      void printTimings () const;
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Get the time (in seconds) spent in every stage for the last cloud, 0 for the stages not run. */
+      inline const std::vector<double>&
+        getLastTimings () const
+      {
+        return (last_time_);
+      }
+
+    private:
+      std::vector<std::string> names_;
+      std::vector<CloudStage> stages_;
+
+      /** \brief Time spent in every stage for the last cloud, total, and number of clouds processed by every stage. */
+      std::vector<double> last_time_, total_time_;
+      std::vector<int> nr_runs_;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  // Stages
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Transform the input message into the working cloud, in a given frame. */
+  class TransformCloud
+  {
+    public:
+      TransformCloud (tf::TransformListener *tf, const std::string &target_frame) : tf_ (tf), target_frame_ (target_frame) { }
+      bool operator () (CloudContext &context) const;
+
+    private:
+      tf::TransformListener *tf_;
+      std::string target_frame_;
+  };
+
+  /** \brief Compute the view point of the working cloud. */
+  class ComputeViewPoint
+  {
+    public:
+      ComputeViewPoint (tf::TransformListener *tf, const std::string &viewpoint_frame) : tf_ (tf), viewpoint_frame_ (viewpoint_frame) { }
+      bool operator () (CloudContext &context) const;
+
+    private:
+      tf::TransformListener *tf_;
+      std::string viewpoint_frame_;
+  };
+
+  /** \brief Select the points whose Z dimension is close to the ground (0,0,0 in the robot footprint frame) or under
+    * a gentle slope (allowing for pitch/roll error) as the candidates.
+    */
+  class SelectGroundCandidates
+  {
+    public:
+      SelectGroundCandidates (tf::TransformListener *tf, const std::string &robot_footprint_frame, double z_threshold,
+                              double ground_slope_threshold) :
+        tf_ (tf), robot_footprint_frame_ (robot_footprint_frame), z_threshold_ (z_threshold),
+        ground_slope_threshold_ (ground_slope_threshold) { }
+      bool operator () (CloudContext &context) const;
+
+    private:
+      tf::TransformListener *tf_;
+      std::string robot_footprint_frame_;
+      double z_threshold_, ground_slope_threshold_;
+  };
+
+  /** \brief Fit a plane to the inliers and add the points "below" it (seen from the view point) to the inliers. */
+  class RefineGroundPlane
+  {
+    public:
+      bool operator () (CloudContext &context) const;
+  };
+
+  /** \brief Copy the points that are not inliers, with all their channels, to the output cloud. */
+  class ExtractOutliers
+  {
+    public:
+      bool operator () (CloudContext &context) const;
+  };
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SAMPLE_CONSENSUS_LORANSAC_H_
+#define _SAMPLE_CONSENSUS_LORANSAC_H_
+
+#include <algorithm>
+#include <sac.h>
+#include <sac_model.h>
+
+namespace sample_consensus
+{
+  /** \brief LO-RANSAC (Locally Optimized RANSAC). Every time a new best model is found, it is refined by iterated
+    * least-squares fitting to its inliers (SACModel::refitModel) for as long as this increases the number of
+    * inliers. The larger support of the refined models also makes the search terminate sooner.
+    */
+  class LORANSAC : public SAC
+  {
+    public:
+
+      LORANSAC (SACModel* model);
+      LORANSAC (SACModel* model, double threshold);
+
+      virtual ~LORANSAC () { }
+
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Set the maximum number of least-squares refinements in a local optimization step.
+        * \param lo_iterations the maximum number of refinements
+        */
+      inline void
+        setLocalOptimizationIterations (int lo_iterations)
+      {
+        this->lo_iterations_ = std::max (0, lo_iterations);
+      }
+
+      bool computeModel (int debug = 0);
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return the coefficients of the best (locally optimized) model. */
+      virtual void
+        computeCoefficients (std::vector<double> &coefficients)
+      {
+        coefficients = best_coefficients_;
+      }
+
+    protected:
+      /** \brief Maximum number of least-squares refinements per local optimization. */
+      int lo_iterations_;
+
+      /** \brief The coefficients of the best model found by the last computeModel () call. */
+      std::vector<double> best_coefficients_;
+  };
+}
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SEMANTIC_POINT_ANNOTATOR_PLANE_CACHE_H_
+#define _SEMANTIC_POINT_ANNOTATOR_PLANE_CACHE_H_
+
+#include <sensor_msgs/PointCloud.h>  // ROS point cloud type
+#include <tf/transform_listener.h>
+#include <string>
+#include <vector>
+
+namespace semantic_point_annotator
+{
+  /** \brief A planar model found in a point cloud. */
+  struct TrackedPlane
+  {
+    TrackedPlane () : region_type (0), nr_inliers (0) { }
+
+    /** \brief The plane coefficients (a, b, c, d), with ax+by+cz+d=0 and a unit normal. */
+    std::vector<double> coefficients;
+    /** \brief The type of the region the plane was found in. */
+    int region_type;
+    /** \brief The number of points supporting the plane. */
+    int nr_inliers;
+  };
+
+  /** \brief Keeps the planes found in the last point cloud in a fixed frame (e.g. odom), so that they can be
+    * predicted in the frame of the next cloud and validated there before searching for new planes.
+    */
+  class PlaneCache
+  {
+    public:
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Constructor for an empty PlaneCache.
+        * \param fixed_frame the frame the planes are stored in
+        */
+      PlaneCache (const std::string &fixed_frame = "odom_combined") : fixed_frame_ (fixed_frame) { }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Set the frame the planes are stored in. Clears the cache. */
+      inline void
+        setFixedFrame (const std::string &fixed_frame)
+      {
+        fixed_frame_ = fixed_frame;
+        planes_.clear ();
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Replace the cached planes with the ones found in a point cloud.
+        * \param tf a pointer to a TransformListener object
+        * \param cloud_frame the frame of the point cloud
+        * \param stamp the time stamp of the point cloud
+        * \param planes the planes found in the point cloud, in cloud_frame
+        * \return false (and an empty cache) if the planes could not be transformed into the fixed frame
+        */
+      bool update (tf::TransformListener *tf, const std::string &cloud_frame, const ros::Time &stamp,
+                   const std::vector<TrackedPlane> &planes);
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Get the cached planes in the frame of a new point cloud.
+        * \param tf a pointer to a TransformListener object
+        * \param cloud_frame the frame of the point cloud
+        * \param stamp the time stamp of the point cloud
+        * \param planes the resultant planes, in cloud_frame (empty if the transform is not available)
+        */
+      bool predict (tf::TransformListener *tf, const std::string &cloud_frame, const ros::Time &stamp,
+                    std::vector<TrackedPlane> &planes) const;
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Remove all the cached planes. */
+      inline void clear () { planes_.clear (); }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Get the number of cached planes. */
+      inline unsigned int size () const { return (planes_.size ()); }
+
+    private:
+      /** \brief The frame the planes are stored in. */
+      std::string fixed_frame_;
+
+      /** \brief The cached planes, in fixed_frame_. */
+      std::vector<TrackedPlane> planes_;
+  };
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Transform the coefficients of a plane: n' = R n, d' = d - n' . t
+    * \param transform the transformation to apply to the points of the plane
+    * \param coefficients_in the plane coefficients (a, b, c, d)
+    * \param coefficients_out the resultant plane coefficients
+    */
+  void transformPlane (const tf::Transform &transform, const std::vector<double> &coefficients_in,
+                       std::vector<double> &coefficients_out);
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Check whether a predicted plane is supported by a set of points, with a single inlier count. If so, the
+    * plane is refitted to its inliers with least-squares (keeping the direction of its normal) and its inliers are
+    * selected again.
+    * \param points the point cloud message
+    * \param indices the indices of the points to test
+    * \param coefficients the predicted plane coefficients, replaced with the refitted ones
+    * \param threshold the maximum distance from an inlier to the plane
+    * \param min_inliers the minimum number of inliers for the plane to be accepted
+    * \param inliers the resultant inliers
+    * \return true if the plane was accepted
+    */
+  bool validatePlane (const sensor_msgs::PointCloud &points, const std::vector<int> &indices,
+                      std::vector<double> &coefficients, double threshold, int min_inliers, std::vector<int> &inliers);
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SAMPLE_CONSENSUS_PROSAC_H_
+#define _SAMPLE_CONSENSUS_PROSAC_H_
+
+#include <sac.h>
+#include <sac_model.h>
+
+namespace sample_consensus
+{
+  /** \brief PROSAC (PROgressive SAmple Consensus). The samples are drawn from a progressively larger set of the best
+    * points, so the data indices given to the model (see SACModel::setDataSet) must be sorted by decreasing quality,
+    * i.e., by how likely each point is to be an inlier. After enough trials, PROSAC samples uniformly like RANSAC.
+    * The search stops once, for some n, a model with enough (non-random) support in the n best points would have been
+    * found with the desired probability.
+    */
+  class PROSAC : public SAC
+  {
+    public:
+
+      PROSAC (SACModel* model);
+      PROSAC (SACModel* model, double threshold);
+
+      virtual ~PROSAC () { }
+
+      bool computeModel (int debug = 0);
+
+    protected:
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Draw distinct random positions in [0, range) and append the corresponding data indices.
+        * \param range the number of (best) data indices to draw from
+        * \param nr_samples the number of samples to draw
+        * \param samples the resultant samples
+        */
+      void drawSamples (int range, int nr_samples, std::vector<int> &samples);
+
+      /** \brief Scratch space for the sampled positions. */
+      std::vector<int> positions_;
+  };
+}
+
+#endif
@@ -33,6 +33,7 @@
 #ifndef _SAMPLE_CONSENSUS_RANSAC_H_
 #define _SAMPLE_CONSENSUS_RANSAC_H_
 
+#include <algorithm>
 #include <sac.h>
 #include <sac_model.h>
 
@@ -47,7 +48,23 @@ namespace sample_consensus
 
       virtual ~RANSAC () { }
 
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Set the number of hypotheses that are drawn together and scored in parallel.
+        * \note The samples are always drawn in the same order from a single thread, so the model found does not
+        * depend on the number of threads, only on the random seed.
+        * \param batch_size the number of hypotheses per batch
+        */
+      inline void
+        setBatchSize (int batch_size)
+      {
+        this->batch_size_ = std::max (1, batch_size);
+      }
+
       bool computeModel (int debug = 0);
+
+    protected:
+      /** \brief Number of hypotheses drawn and scored together. */
+      int batch_size_;
   };
 }
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SEMANTIC_POINT_ANNOTATOR_REGION_GROWING_H_
+#define _SEMANTIC_POINT_ANNOTATOR_REGION_GROWING_H_
+
+#include <sensor_msgs/PointCloud.h>  // ROS point cloud type
+#include <vector>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Decompose a set of points into smooth regions: two points are connected if they are closer than a given
+    * tolerance and the angle between their normals is smaller than a given threshold, and the regions are the
+    * connected components of this graph. The neighbors are searched in parallel (with OpenMP, if enabled) in a
+    * VoxelGridIndex, and merged with a lock-free union-find, so the result does not depend on the number of threads.
+    * \param points the point cloud message
+    * \param indices a list of point indices
+    * \param tolerance the spatial tolerance as a measure in the L2 Euclidean space
+    * \param nx_idx the index of the channel containing the x component of the normals
+    * \param ny_idx the index of the channel containing the y component of the normals
+    * \param nz_idx the index of the channel containing the z component of the normals
+    * \param angle_threshold the maximum angle between the normals of two connected points, in radians
+    * \param min_pts_per_cluster minimum number of points that a region may contain
+    * \param clusters the resultant regions (as point indices), ordered by their first point in indices
+    */
+  void growRegions (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, double tolerance,
+                    int nx_idx, int ny_idx, int nz_idx, double angle_threshold, unsigned int min_pts_per_cluster,
+                    std::vector<std::vector<int> > &clusters);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SAMPLE_CONSENSUS_RRANSAC_H_
+#define _SAMPLE_CONSENSUS_RRANSAC_H_
+
+#include <algorithm>
+#include <sac.h>
+#include <sac_model.h>
+
+namespace sample_consensus
+{
+  /** \brief Randomized RANSAC. Each hypothesis must first pass a T(d,d) test: d randomly chosen points have to be
+    * inliers, otherwise the hypothesis is rejected without being scored. The hypotheses that pass are scored block
+    * by block, and scoring stops as soon as the remaining points can no longer beat the best model found so far.
+    */
+  class RRANSAC : public SAC
+  {
+    public:
+
+      RRANSAC (SACModel* model);
+      RRANSAC (SACModel* model, double threshold);
+
+      virtual ~RRANSAC () { }
+
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Set the number of points d used by the T(d,d) pre-test.
+        * \param pretest_size the number of randomly chosen points that must be inliers
+        */
+      inline void
+        setPretestSize (int pretest_size)
+      {
+        this->pretest_size_ = std::max (1, pretest_size);
+      }
+
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Set the number of points scored at once before checking whether the hypothesis can still win.
+        * \param block_size the number of points per block
+        */
+      inline void
+        setBlockSize (int block_size)
+      {
+        this->block_size_ = std::max (1, block_size);
+      }
+
+      bool computeModel (int debug = 0);
+
+    protected:
+      /** \brief Number of points in the T(d,d) pre-test. */
+      int pretest_size_;
+
+      /** \brief Number of points scored between two early termination checks. */
+      int block_size_;
+  };
+}
+
+#endif
@@ -37,6 +37,9 @@
 #include <sensor_msgs/PointCloud.h>  // ROS point cloud type
 
 #include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
 #include <sac_model.h>
 
 namespace sample_consensus
@@ -95,6 +98,10 @@ namespace sample_consensus
         this->probability_ = probability;
       }
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return the number of iterations performed by the last computeModel () call. */
+      inline int getIterations () { return (this->iterations_); }
+
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Compute the actual model. Pure virtual. */
       virtual bool computeModel (int debug = 0) = 0;
@@ -151,39 +158,64 @@ namespace sample_consensus
 
 
       ////////////////////////////////////////////////////////////////////////////////
-      /** \brief Get a set of randomly selected indices.
-        * \note Since we return a set, we do not guarantee that we'll return precisely
-        * the desired number of samples (ie. nr_samples).
+      /** \brief Get a set of randomly selected indices. Exactly min (nr_samples, points.points.size ()) distinct
+        * indices are returned.
         * \param points the point cloud data set to be used
         * \param nr_samples the desired number of point indices
         */
       std::set<int>
-        getRandomSamples (sensor_msgs::PointCloud points, int nr_samples)
+        getRandomSamples (const sensor_msgs::PointCloud &points, int nr_samples)
       {
-        std::set<int> random_idx;
-        for (int i = 0; i < nr_samples; i++)
-          random_idx.insert ((int) (points.points.size () * (rand () / (RAND_MAX + 1.0))));
-        return (random_idx);
+        sac_model_->getRandomGenerator ().sample (points.points.size (), nr_samples, random_samples_);
+        return (std::set<int> (random_samples_.begin (), random_samples_.end ()));
       }
 
       ////////////////////////////////////////////////////////////////////////////////
-      /** \brief Get a vector of randomly selected indices.
-        * \note Since we return a set, we do not guarantee that we'll return precisely
-        * the desired number of samples (ie. nr_samples).
+      /** \brief Get a set of randomly selected positions in a vector of indices. Exactly
+        * min (nr_samples, indices.size ()) distinct positions are returned.
         * \param points the point cloud data set to be used (unused)
         * \param indices a set of indices that represent the data that we're interested in
         * \param nr_samples the desired number of point indices
         */
       std::set<int>
-        getRandomSamples (sensor_msgs::PointCloud points, std::vector<int> indices, int nr_samples)
+        getRandomSamples (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, int nr_samples)
       {
-        std::set<int> random_idx;
-        for (int i = 0; i < nr_samples; i++)
-          random_idx.insert ((int) (indices.size () * (rand () / (RAND_MAX + 1.0))));
-        return (random_idx);
+        sac_model_->getRandomGenerator ().sample (indices.size (), nr_samples, random_samples_);
+        return (std::set<int> (random_samples_.begin (), random_samples_.end ()));
+      }
+
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Get randomly selected, distinct, point indices out of a vector of indices. The cost depends only
+        * on the number of samples, and no memory is allocated if samples is large enough already.
+        * \param indices a set of indices that represent the data that we're interested in
+        * \param nr_samples the desired number of point indices
+        * \param samples the resultant point indices (min (nr_samples, indices.size ()) of them)
+        */
+      void
+        getRandomSamples (const std::vector<int> &indices, int nr_samples, std::vector<int> &samples)
+      {
+        sac_model_->getRandomGenerator ().sample (indices.size (), nr_samples, samples);
+        for (unsigned int i = 0; i < samples.size (); i++)
+          samples[i] = indices[samples[i]];
       }
 
     protected:
+      ////////////////////////////////////////////////////////////////////////////////
+      /** \brief Compute the number of trials k needed to draw, with probability_, at least one sample free from
+        * outliers (k=log(z)/log(1-w^n)).
+        * \param n_inliers the number of inliers of the best model found so far
+        * \param n_samples the number of points that need to be inliers for a trial to succeed
+        */
+      inline double
+        computeMaxTrials (int n_inliers, int n_samples)
+      {
+        double w = (double)n_inliers / (double)sac_model_->getIndices ()->size ();
+        double p_no_outliers = 1 - pow (w, (double)n_samples);
+        p_no_outliers = std::max (std::numeric_limits<double>::epsilon (), p_no_outliers);       // Avoid division by -Inf
+        p_no_outliers = std::min (1 - std::numeric_limits<double>::epsilon (), p_no_outliers);   // Avoid division by 0.
+        return (log (1 - probability_) / log (p_no_outliers));
+      }
+
       /** \brief The underlying data model used (i.e. what is it that we attempt to search for). */
       SACModel *sac_model_;
 
@@ -198,6 +230,9 @@ namespace sample_consensus
 
       /** \brief Distance to model threshold. */
       double threshold_;
+
+      /** \brief Scratch space for getRandomSamples (). */
+      std::vector<int> random_samples_;
   };
 }
 
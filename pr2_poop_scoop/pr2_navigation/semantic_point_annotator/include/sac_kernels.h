@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SAMPLE_CONSENSUS_SAC_KERNELS_H_
+#define _SAMPLE_CONSENSUS_SAC_KERNELS_H_
+
+#include <sensor_msgs/PointCloud.h>  // ROS point cloud type
+#include <vector>
+
+namespace sample_consensus
+{
+  /** \brief Point coordinates stored as separate, contiguous x, y and z arrays (structure of arrays), so that the
+    * distance kernels can process several points per instruction.
+    */
+  struct PointsSoA
+  {
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Copy the coordinates of a set of points out of a point cloud.
+      * \param cloud the point cloud
+      * \param indices the indices of the points to copy, in order
+      */
+    void gather (const sensor_msgs::PointCloud &cloud, const std::vector<int> &indices);
+
+    /** \brief Return the number of points. */
+    inline unsigned int size () const { return (x.size ()); }
+
+    std::vector<float> x, y, z;
+  };
+
+  /** \brief Kernels shared by the SAmple Consensus models. Lines are given by a point and a unit direction, planes by
+    * a unit normal and an offset (ax+by+cz+d=0). All distances are computed in single precision, the same way in
+    * the vectorized (SoA) and in the indexed versions, so counts and selections of the same points always agree.
+    */
+  namespace kernels
+  {
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Count the points whose squared distance to a line is below sqr_threshold. */
+    int countLineInliers (const PointsSoA &points, const float line_point[3], const float line_dir[3], float sqr_threshold);
+
+    /** \brief Count the points (given by index into a cloud) whose squared distance to a line is below sqr_threshold. */
+    int countLineInliers (const sensor_msgs::PointCloud &cloud, const std::vector<int> &indices,
+                          const float line_point[3], const float line_dir[3], float sqr_threshold);
+
+    /** \brief Select the points whose squared distance to a line is below sqr_threshold.
+      * \param indices the point indices corresponding to the entries of points; the selected ones are returned
+      */
+    void selectLineInliers (const PointsSoA &points, const std::vector<int> &indices, const float line_point[3],
+                            const float line_dir[3], float sqr_threshold, std::vector<int> &inliers);
+
+    /** \brief Compute the distances from all the points to a line. */
+    void lineDistances (const PointsSoA &points, const float line_point[3], const float line_dir[3], std::vector<double> &distances);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Count the points whose distance to a plane is below threshold. */
+    int countPlaneInliers (const PointsSoA &points, const float plane[4], float threshold);
+
+    /** \brief Count the points (given by index into a cloud) whose distance to a plane is below threshold. */
+    int countPlaneInliers (const sensor_msgs::PointCloud &cloud, const std::vector<int> &indices, const float plane[4], float threshold);
+
+    /** \brief Select the points whose distance to a plane is below threshold.
+      * \param indices the point indices corresponding to the entries of points; the selected ones are returned
+      */
+    void selectPlaneInliers (const PointsSoA &points, const std::vector<int> &indices, const float plane[4],
+                             float threshold, std::vector<int> &inliers);
+
+    /** \brief Compute the (unsigned) distances from all the points to a plane. */
+    void planeDistances (const PointsSoA &points, const float plane[4], std::vector<double> &distances);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Compute the centroid and the 3x3 covariance matrix of a set of points.
+      * \param covariance the upper triangle of the (unnormalized) covariance matrix: xx, xy, xz, yy, yz, zz
+      */
+    void computeCovariance (const PointsSoA &points, double centroid[3], double covariance[6]);
+
+    /** \brief Compute the eigenvalues and eigenvectors of a symmetric 3x3 matrix in closed form.
+      * \param matrix the upper triangle of the matrix: xx, xy, xz, yy, yz, zz
+      * \param values the eigenvalues, in increasing order
+      * \param vectors the corresponding unit eigenvectors (vectors[i] goes with values[i])
+      */
+    void solveSymmetric3 (const double matrix[6], double values[3], double vectors[3][3]);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Convert a line given by two points (x1, y1, z1, x2, y2, z2) to a point and a unit direction.
+      * Returns false if the two points coincide.
+      */
+    bool lineFromCoefficients (const std::vector<double> &model_coefficients, float line_point[3], float line_dir[3]);
+  }
+}
+
+#endif
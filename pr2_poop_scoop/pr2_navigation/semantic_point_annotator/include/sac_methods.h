@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SAMPLE_CONSENSUS_SAC_METHODS_H_
+#define _SAMPLE_CONSENSUS_SAC_METHODS_H_
+
+#include <method_types.h>
+#include <ransac.h>
+#include <rransac.h>
+#include <prosac.h>
+#include <lo_ransac.h>
+
+namespace sample_consensus
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Create a SAmple Consensus estimator of the given type. Returns NULL for an unknown type.
+    * \param method_type the type of estimator (SAC_RANSAC, SAC_RRANSAC, SAC_PROSAC or SAC_LORANSAC)
+    * \param model the SAmple Consensus model
+    * \param threshold distance to model threshold
+    * \note PROSAC expects the model's data indices to be sorted by decreasing quality.
+    */
+  inline SAC*
+    createSAC (int method_type, SACModel *model, double threshold)
+  {
+    switch (method_type)
+    {
+      case SAC_RANSAC:
+        return (new RANSAC (model, threshold));
+      case SAC_RRANSAC:
+        return (new RRANSAC (model, threshold));
+      case SAC_PROSAC:
+        return (new PROSAC (model, threshold));
+      case SAC_LORANSAC:
+        return (new LORANSAC (model, threshold));
+      default:
+        return (NULL);
+    }
+  }
+}
+
+#endif
@@ -37,6 +37,8 @@
 #include <sensor_msgs/PointCloud.h>  // ROS point cloud type
 
 #include <set>
+#include <sac_random.h>
+#include <sac_kernels.h>
 
 namespace sample_consensus
 {
@@ -59,6 +61,10 @@ namespace sample_consensus
         */
       virtual void getSamples (int &iterations, std::vector<int> &samples) = 0;
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return the number of points needed to compute the model coefficients. Pure virtual. */
+      virtual int getSampleSize () = 0;
+
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Test whether the given model coefficients are valid given the input point cloud data. Pure virtual.
         * \param model_coefficients the model coefficients that need to be tested
@@ -97,6 +103,26 @@ namespace sample_consensus
         */
       virtual void selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers) = 0;
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Count all the points which respect the given model coefficients as inliers, without storing them.
+        * \param model_coefficients the coefficients of a model that we need to compute distances to
+        * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+        */
+      virtual int
+        countWithinDistance (const std::vector<double> &model_coefficients, double threshold)
+      {
+        return (countWithinDistance (model_coefficients, threshold, indices_));
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Count the points out of a given subset which respect the given model coefficients as inliers. Pure virtual.
+        * Implementations must not modify the model, as SAC methods may call this from several threads at once.
+        * \param model_coefficients the coefficients of a model that we need to compute distances to
+        * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+        * \param indices the point cloud indices that need to be tested
+        */
+      virtual int countWithinDistance (const std::vector<double> &model_coefficients, double threshold, const std::vector<int> &indices) = 0;
+
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Create a new point cloud with inliers projected onto the model. Pure virtual.
         * \param inliers the data inliers that we want to project on the model
@@ -131,6 +157,7 @@ namespace sample_consensus
         indices_.resize (cloud_->points.size ());
         for (unsigned int i = 0; i < cloud_->points.size (); i++)
           indices_[i] = i;
+        points_.gather (*cloud_, indices_);
       }
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the dataset and indices
@@ -141,11 +168,18 @@ namespace sample_consensus
       {
         this->cloud_   = cloud;
         this->indices_ = indices;
+        points_.gather (*cloud_, indices_);
       }
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the indices
        * \param indices the point indices used */
-      void setDataIndices (std::vector<int> indices) { this->indices_ = indices; }
+      void
+        setDataIndices (std::vector<int> indices)
+      {
+        this->indices_ = indices;
+        if (cloud_ != NULL)
+          points_.gather (*cloud_, indices_);
+      }
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Remove the inliers found from the initial set of given point indices. */
@@ -183,6 +217,14 @@ namespace sample_consensus
       /** \brief Return a pointer to the point cloud data indices. */
       std::vector<int>* getIndices () { return (&this->indices_); }
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Reset the random number generator used to draw samples, e.g., for reproducible results.
+       * \param seed the random seed */
+      void setRandomSeed (uint64_t seed) { rng_.setSeed (seed); }
+
+      /** \brief Return the random number generator used to draw samples. */
+      SACRandom& getRandomGenerator () { return (this->rng_); }
+
     protected:
 
       /** \brief Holds a pointer to the point cloud data array, since we don't want to copy the whole thing here */
@@ -191,6 +233,10 @@ namespace sample_consensus
       /** \brief The list of internal point indices used */
       std::vector<int> indices_;
 
+      /** \brief A copy of the coordinates of the points in indices_, in the same order, for the vectorized kernels.
+        * Refreshed whenever the data set or the indices change. */
+      PointsSoA points_;
+
       /** \brief The coefficients of our model computed directly from the best samples found */
       std::vector<double> model_coefficients_;
 
@@ -198,6 +244,9 @@ namespace sample_consensus
       std::vector<int> best_model_;
       /** \brief The indices of the points that were chosen as inliers after the last computeModel () call */
       std::vector<int> best_inliers_;
+
+      /** \brief The random number generator used to draw samples */
+      SACRandom rng_;
   };
 }
 
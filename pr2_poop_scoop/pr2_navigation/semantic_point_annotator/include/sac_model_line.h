@@ -36,9 +36,6 @@
 #include <sac_model.h>
 #include <model_types.h>
 
-/** \brief Define the maximum number of iterations for selecting 2 unique points */
-#define MAX_ITERATIONS_UNIQUE 1000
-
 namespace sample_consensus
 {
   /** \brief A Sample Consensus Model class for 3D line segmentation.
@@ -56,6 +53,10 @@ namespace sample_consensus
 
       virtual void getSamples (int &iterations, std::vector<int> &samples);
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return the number of points needed to compute a line model (2). */
+      virtual int getSampleSize () { return (2); }
+
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Test whether the given model coefficients are valid given the input point cloud data.
         * \param model_coefficients the model coefficients that need to be tested
@@ -68,6 +69,8 @@ namespace sample_consensus
       virtual void refitModel (const std::vector<int> &inliers, std::vector<double> &refit_coefficients);
       virtual void getDistancesToModel (const std::vector<double> &model_coefficients, std::vector<double> &distances);
       virtual void selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers);
+      virtual int countWithinDistance (const std::vector<double> &model_coefficients, double threshold);
+      virtual int countWithinDistance (const std::vector<double> &model_coefficients, double threshold, const std::vector<int> &indices);
 
       virtual void projectPoints (const std::vector<int> &inliers, const std::vector<double> &model_coefficients, sensor_msgs::PointCloud &projected_points);
 
@@ -92,62 +95,6 @@ namespace sample_consensus
         r.z = p1.x * p2.y - p1.y * p2.x;
         return (r);
       }
-
-      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-      /** \brief Compute the centroid of a set of points using their indices and return it as a Point32 message.
-        * \param points the input point cloud
-        * \param indices the point cloud indices that need to be used
-        * \param centroid the output centroid
-        */
-      inline void
-        computeCentroid (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, geometry_msgs::Point32 &centroid)
-      {
-        centroid.x = centroid.y = centroid.z = 0;
-        // For each point in the cloud
-        for (unsigned int i = 0; i < indices.size (); i++)
-        {
-          centroid.x += points.points.at (indices.at (i)).x;
-          centroid.y += points.points.at (indices.at (i)).y;
-          centroid.z += points.points.at (indices.at (i)).z;
-        }
-
-        centroid.x /= indices.size ();
-        centroid.y /= indices.size ();
-        centroid.z /= indices.size ();
-      }
-      
-      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-      /** \brief Compute the 3x3 covariance matrix of a given set of points using their indices.
-        * The result is returned as a Eigen::Matrix3d.
-        * \note The (x-y-z) centroid is also returned as a Point32 message.
-        * \param points the input point cloud
-        * \param indices the point cloud indices that need to be used
-        * \param covariance_matrix the 3x3 covariance matrix
-        * \param centroid the computed centroid
-        */
-      inline void
-        computeCovarianceMatrix (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, Eigen::Matrix3d &covariance_matrix, geometry_msgs::Point32 &centroid)
-      {
-        computeCentroid (points, indices, centroid);
-
-        // Initialize to 0
-        covariance_matrix = Eigen::Matrix3d::Zero ();
-
-        for (unsigned int j = 0; j < indices.size (); j++)
-        {
-          covariance_matrix (0, 0) += (points.points[indices.at (j)].x - centroid.x) * (points.points[indices.at (j)].x - centroid.x);
-          covariance_matrix (0, 1) += (points.points[indices.at (j)].x - centroid.x) * (points.points[indices.at (j)].y - centroid.y);
-          covariance_matrix (0, 2) += (points.points[indices.at (j)].x - centroid.x) * (points.points[indices.at (j)].z - centroid.z);
-
-          covariance_matrix (1, 0) += (points.points[indices.at (j)].y - centroid.y) * (points.points[indices.at (j)].x - centroid.x);
-          covariance_matrix (1, 1) += (points.points[indices.at (j)].y - centroid.y) * (points.points[indices.at (j)].y - centroid.y);
-          covariance_matrix (1, 2) += (points.points[indices.at (j)].y - centroid.y) * (points.points[indices.at (j)].z - centroid.z);
-
-          covariance_matrix (2, 0) += (points.points[indices.at (j)].z - centroid.z) * (points.points[indices.at (j)].x - centroid.x);
-          covariance_matrix (2, 1) += (points.points[indices.at (j)].z - centroid.z) * (points.points[indices.at (j)].y - centroid.y);
-          covariance_matrix (2, 2) += (points.points[indices.at (j)].z - centroid.z) * (points.points[indices.at (j)].z - centroid.z);
-        }
-      }
     };
 }
 
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SAMPLE_CONSENSUS_SAC_RANDOM_H_
+#define _SAMPLE_CONSENSUS_SAC_RANDOM_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+namespace sample_consensus
+{
+  /** \brief Default seed of the SAmple Consensus random number generators */
+  static const uint64_t SAC_DEFAULT_SEED = 0x5ac5eedULL;
+
+  /** \brief A small, fast and seedable pseudo-random number generator (xoroshiro128+) for SAmple Consensus methods.
+    * Unlike rand (), every instance has its own state, so models used from different threads do not interfere and
+    * a given seed always reproduces the same samples.
+    */
+  class SACRandom
+  {
+    public:
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Constructor.
+        * \param seed the random seed
+        */
+      SACRandom (uint64_t seed = SAC_DEFAULT_SEED) { setSeed (seed); }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Reset the generator.
+        * \param seed the random seed
+        */
+      inline void
+        setSeed (uint64_t seed)
+      {
+        // Expand the seed with splitmix64, as recommended for xoroshiro
+        for (int i = 0; i < 2; i++)
+        {
+          uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+          z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+          z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+          state_[i] = z ^ (z >> 31);
+        }
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return 64 random bits. */
+      inline uint64_t
+        next ()
+      {
+        uint64_t s0 = state_[0], s1 = state_[1];
+        uint64_t result = s0 + s1;
+        s1 ^= s0;
+        state_[0] = ((s0 << 24) | (s0 >> 40)) ^ s1 ^ (s1 << 16);
+        state_[1] = (s1 << 37) | (s1 >> 27);
+        return (result);
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return a random integer in [0, n).
+        * \param n the (positive) number of possible values
+        */
+      inline int
+        uniform (int n)
+      {
+        // Multiply the high 32 bits by n and keep the high part, which avoids a division
+        return ((int)(((next () >> 32) * (uint64_t)n) >> 32));
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Draw nr_samples distinct integers in [0, n) with Floyd's algorithm. Only nr_samples random numbers are
+        * needed, regardless of n. If nr_samples > n, all of [0, n) is returned.
+        * \param n the number of possible values
+        * \param nr_samples the desired number of samples
+        * \param samples the resultant samples (overwritten; no allocation happens if the capacity suffices)
+        */
+      inline void
+        sample (int n, int nr_samples, std::vector<int> &samples)
+      {
+        nr_samples = std::max (0, std::min (nr_samples, n));
+        samples.resize (nr_samples);
+        if (nr_samples <= SMALL_SAMPLE)
+        {
+          // Few samples: a linear search is cheaper than a set
+          int s = 0;
+          for (int j = n - nr_samples; j < n; j++)
+          {
+            int t = uniform (j + 1);
+            samples[s] = (std::find (samples.begin (), samples.begin () + s, t) == samples.begin () + s) ? t : j;
+            s++;
+          }
+        }
+        else
+        {
+          std::set<int> taken;
+          int s = 0;
+          for (int j = n - nr_samples; j < n; j++)
+          {
+            int t = uniform (j + 1);
+            if (!taken.insert (t).second)
+            {
+              taken.insert (j);
+              t = j;
+            }
+            samples[s++] = t;
+          }
+        }
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Shuffle a range of values (Fisher-Yates).
+        * \param first the beginning of the range
+        * \param last the end of the range
+        */
+      template <typename Iterator> inline void
+        shuffle (Iterator first, Iterator last)
+      {
+        for (int i = (int)(last - first) - 1; i > 0; i--)
+          std::swap (first[i], first[uniform (i + 1)]);
+      }
+
+    private:
+      /** \brief Up to this many samples, Floyd's algorithm checks for duplicates with a linear search. */
+      static const int SMALL_SAMPLE = 32;
+
+      /** \brief The generator state. */
+      uint64_t state_[2];
+  };
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SEMANTIC_POINT_ANNOTATOR_VOXEL_GRID_FILTER_H_
+#define _SEMANTIC_POINT_ANNOTATOR_VOXEL_GRID_FILTER_H_
+
+#include <sensor_msgs/PointCloud.h>  // ROS point cloud type
+#include <vector>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Downsample a point cloud to (at most) one point per occupied cell of a 3D voxel grid.
+    *
+    * With \a centroid set, the output point is the centroid of the points in the voxel and the normals (channels nx,
+    * ny, nz) are averaged and renormalized. The other channels are always copied from a representative point, the
+    * one closest to the centroid, since averaging packed values (such as rgb or scan indices) is meaningless. Without
+    * \a centroid, the whole representative point is copied. Points with non-finite coordinates are dropped.
+    *
+    * \param cloud_in the input point cloud
+    * \param leaf_size the size of a voxel, in m
+    * \param centroid whether to output the voxel centroids, or the representative points
+    * \param cloud_out the resultant downsampled cloud, with the same channels as the input one
+    * \param voxel_of_point for every input point, the index of its point in cloud_out (-1 if it was dropped), so that
+    *        results computed on the downsampled cloud can be propagated back to the full resolution one
+    */
+  void downsampleVoxelGrid (const sensor_msgs::PointCloud &cloud_in, double leaf_size, bool centroid,
+                            sensor_msgs::PointCloud &cloud_out, std::vector<int> &voxel_of_point);
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#ifndef _SEMANTIC_POINT_ANNOTATOR_VOXEL_GRID_INDEX_H_
+#define _SEMANTIC_POINT_ANNOTATOR_VOXEL_GRID_INDEX_H_
+
+#include <sensor_msgs/PointCloud.h>  // ROS point cloud type
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+
+namespace semantic_point_annotator
+{
+  /** \brief A read-only spatial index for fixed radius searches. The points are binned into cubic cells (voxels) of a
+    * given size, sorted by cell, and a search only visits the cells overlapping the query sphere. The index is built
+    * once per set of points; all the searches are const and may run from several threads at once (unlike
+    * cloud_kdtree::KdTreeANN, which keeps its search state in the tree).
+    */
+  class VoxelGridIndex
+  {
+    public:
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Constructor for an empty VoxelGridIndex. */
+      VoxelGridIndex () : leaf_size_ (0) { }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Build the index over a set of points. Searches are fastest when the leaf size is the search radius.
+        * \param points the point cloud
+        * \param indices the indices of the points to index
+        * \param leaf_size the size of a cell (voxel), in m
+        */
+      void build (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, double leaf_size);
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return the number of points in the index. */
+      inline unsigned int size () const { return (x_.size ()); }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Return the positions (in the indices given to build ()) of the points sorted by cell. Running a batch of
+        * searches in this order touches far less memory than running them in the original order. */
+      inline const std::vector<int>& getCellOrder () const { return (cell_points_); }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Find all the points within a given radius of an indexed point (including the point itself).
+        * \param index the position of the query point in the indices given to build ()
+        * \param radius the search radius
+        * \param k_indices the resultant neighbors, as positions in the indices given to build (), in no particular order
+        */
+      inline int
+        radiusSearch (int index, double radius, std::vector<int> &k_indices) const
+      {
+        return (radiusSearch (x_[index], y_[index], z_[index], radius, k_indices));
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Find all the points within a given radius of a query point.
+        * \param x the x coordinate of the query point
+        * \param y the y coordinate of the query point
+        * \param z the z coordinate of the query point
+        * \param radius the search radius
+        * \param k_indices the resultant neighbors, as positions in the indices given to build (), in no particular order
+        */
+      int radiusSearch (float x, float y, float z, double radius, std::vector<int> &k_indices) const;
+
+      /** \brief Number of bits used for each cell coordinate in a cell key */
+      static const int KEY_BITS = 21;
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Pack the (non-negative, less than 2^KEY_BITS) coordinates of a cell into a single key. Sorting by key
+        * groups the points by cell. */
+      static inline uint64_t
+        cellKey (int i, int j, int k)
+      {
+        return (((uint64_t)i << (2 * KEY_BITS)) | ((uint64_t)j << KEY_BITS) | (uint64_t)k);
+      }
+
+    private:
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Compute the cell coordinate of a point coordinate along one axis. */
+      inline int
+        cellCoordinate (float v, int d) const
+      {
+        return ((int)floor ((v - min_[d]) / leaf_size_));
+      }
+
+      /** \brief The coordinates of the indexed points */
+      std::vector<float> x_, y_, z_;
+
+      /** \brief The size of a cell and the minimum corner of the bounding box of the points */
+      double leaf_size_;
+      float min_[3];
+      /** \brief The number of cells along each axis */
+      int nr_cells_[3];
+
+      /** \brief The keys of the non-empty cells, sorted */
+      std::vector<uint64_t> cell_keys_;
+      /** \brief The points of cell i are cell_points_[cell_start_[i]] ... cell_points_[cell_start_[i + 1] - 1] */
+      std::vector<int> cell_start_, cell_points_;
+      /** \brief The coordinates of the points in cell order (cell_x_[k] is the x coordinate of cell_points_[k]) */
+      std::vector<float> cell_x_, cell_y_, cell_z_;
+  };
+}
+
+#endif
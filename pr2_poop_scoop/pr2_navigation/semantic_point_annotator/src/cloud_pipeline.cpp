@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <algorithm>
+#include <cloud_pipeline.h>
+#include <sac_kernels.h>
+#include <sys/time.h>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  int
+    getChannelIndex (const sensor_msgs::PointCloud &points, const std::string &channel_name)
+  {
+    for (unsigned int d = 0; d < points.channels.size (); d++)
+      if (points.channels[d].name == channel_name)
+        return (d);
+    return (-1);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  std::string
+    getAvailableChannels (const sensor_msgs::PointCloud &cloud)
+  {
+    std::string result;
+    for (unsigned int i = 0; i < cloud.channels.size (); i++)
+    {
+      if (i > 0)
+        result += " ";
+      result += cloud.channels[i].name;
+    }
+    return (result);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    splitPointsBasedOnLaserScanIndex (const sensor_msgs::PointCloud &points, const std::vector<int> &indices,
+                                      std::vector<std::vector<int> > &clusters, int idx)
+  {
+    std::vector<int> seed_queue;
+    int prev_idx = -1;
+    // Process all points in the indices vector
+    for (unsigned int i = 0; i < indices.size (); i++)
+    {
+      // Get the current laser scan measurement index
+      int cur_idx = points.channels[idx].values.at (indices[i]);
+
+      if (cur_idx > prev_idx)   // Still the same laser scan ?
+      {
+        seed_queue.push_back (indices[i]);
+        prev_idx = cur_idx;
+      }
+      else                      // Have we found a new scan ?
+      {
+        prev_idx = -1;
+        clusters.push_back (seed_queue);
+        seed_queue.clear ();
+      }
+    }
+    // Copy the last laser scan as well
+    if (seed_queue.size () > 0)
+      clusters.push_back (seed_queue);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    flipNormalTowardsViewpoint (Eigen::Vector4d &normal, const geometry_msgs::Point32 &point,
+                                const geometry_msgs::PointStamped &viewpoint)
+  {
+    // See if we need to flip any plane normals
+    float vp_m[3];
+    vp_m[0] = viewpoint.point.x - point.x;
+    vp_m[1] = viewpoint.point.y - point.y;
+    vp_m[2] = viewpoint.point.z - point.z;
+
+    // Dot product between the (viewpoint - point) and the plane normal
+    double cos_theta = (vp_m[0] * normal (0) + vp_m[1] * normal (1) + vp_m[2] * normal (2));
+
+    // Flip the plane normal
+    if (cos_theta < 0)
+    {
+      for (int d = 0; d < 3; d++)
+        normal (d) *= -1;
+      // Hessian form (D = nc . p_plane (centroid here) + p)
+      normal (3) = -1 * (normal (0) * point.x + normal (1) * point.y + normal (2) * point.z);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    computePointNormal (const sensor_msgs::PointCloud &points, const std::vector<int> &indices,
+                        Eigen::Vector4d &plane_parameters, double &curvature)
+  {
+    sample_consensus::PointsSoA soa;
+    soa.gather (points, indices);
+    // Compute the 3x3 covariance matrix
+    double centroid[3], covariance[6];
+    sample_consensus::kernels::computeCovariance (soa, centroid, covariance);
+
+    // Extract the eigenvalues and eigenvectors (in increasing order of the eigenvalues)
+    double eigen_values[3], eigen_vectors[3][3];
+    sample_consensus::kernels::solveSymmetric3 (covariance, eigen_values, eigen_vectors);
+
+    // The surface normal is the (unit) eigenvector corresponding to the smallest eigenvalue
+    plane_parameters (0) = eigen_vectors[0][0];
+    plane_parameters (1) = eigen_vectors[0][1];
+    plane_parameters (2) = eigen_vectors[0][2];
+
+    // Hessian form (D = nc . p_plane (centroid here) + p)
+    plane_parameters (3) = -1 * (plane_parameters (0) * centroid[0] + plane_parameters (1) * centroid[1] + plane_parameters (2) * centroid[2]);
+
+    // Compute the curvature surface change
+    curvature = fabs ( eigen_values[0] / (eigen_values[0] + eigen_values[1] + eigen_values[2]) );
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    getCloudViewPoint (tf::TransformListener *tf, const std::string &viewpoint_frame, const std::string &cloud_frame,
+                       geometry_msgs::PointStamped &viewpoint_cloud)
+  {
+    // Figure out the viewpoint value in the point cloud frame
+    geometry_msgs::PointStamped viewpoint_laser;
+    viewpoint_laser.header.frame_id = viewpoint_frame;
+    // Set the viewpoint in the laser coordinate system to 0, 0, 0
+    viewpoint_laser.point.x = viewpoint_laser.point.y = viewpoint_laser.point.z = 0.0;
+
+    try
+    {
+      tf->transformPoint (cloud_frame, viewpoint_laser, viewpoint_cloud);
+      ROS_DEBUG ("Cloud view point in frame %s is: %g, %g, %g.", cloud_frame.c_str (),
+                 viewpoint_cloud.point.x, viewpoint_cloud.point.y, viewpoint_cloud.point.z);
+    }
+    catch (tf::TransformException &ex)
+    {
+      ROS_WARN ("Could not transform a point from frame %s to frame %s! %s", viewpoint_laser.header.frame_id.c_str (),
+                cloud_frame.c_str (), ex.what ());
+      // Default to 0.05, 0, 0.942768
+      viewpoint_cloud.point.x = 0.05; viewpoint_cloud.point.y = 0.0; viewpoint_cloud.point.z = 0.942768;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  double
+    transformDoubleValueTF (double val, const std::string &src_frame, const std::string &tgt_frame,
+                            const ros::Time &stamp, tf::TransformListener *tf)
+  {
+    tf::Stamped<tf::Point> temp;
+    temp.stamp_ = stamp;
+    temp.frame_id_ = src_frame;
+    temp[0] = temp[1] = 0;
+    temp[2] = val;
+
+    try
+    {
+      tf->transformPoint (tgt_frame, temp, temp);
+    }
+    catch (tf::TransformException &ex)
+    {
+      ROS_ERROR ("%s", ex.what ());
+      return (val);
+    }
+    return (temp[2]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    CloudPipeline::addStage (const std::string &name, const CloudStage &stage)
+  {
+    names_.push_back (name);
+    stages_.push_back (stage);
+    last_time_.push_back (0);
+    total_time_.push_back (0);
+    nr_runs_.push_back (0);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    CloudPipeline::process (CloudContext &context)
+  {
+    std::fill (last_time_.begin (), last_time_.end (), 0.0);
+    timeval t1, t2;
+    for (unsigned int s = 0; s < stages_.size (); s++)
+    {
+      gettimeofday (&t1, NULL);
+      bool ok = stages_[s] (context);
+      gettimeofday (&t2, NULL);
+
+      last_time_[s] = t2.tv_sec + (double)t2.tv_usec / 1000000.0 - (t1.tv_sec + (double)t1.tv_usec / 1000000.0);
+      total_time_[s] += last_time_[s];
+      nr_runs_[s]++;
+      if (!ok)
+        return (false);
+    }
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    CloudPipeline::printTimings () const
+  {
+    for (unsigned int s = 0; s < stages_.size (); s++)
+      ROS_DEBUG ("Stage %s: %g seconds (%g on average over %d clouds).", names_[s].c_str (), last_time_[s],
+                 nr_runs_[s] > 0 ? total_time_[s] / nr_runs_[s] : 0.0, nr_runs_[s]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    TransformCloud::operator () (CloudContext &context) const
+  {
+    try
+    {
+      tf_->transformPointCloud (target_frame_, *context.input, context.cloud);
+    }
+    catch (tf::TransformException &ex)
+    {
+      ROS_ERROR ("Can't transform cloud from frame %s into frame %s: %s", context.input->header.frame_id.c_str (),
+                 target_frame_.c_str (), ex.what ());
+      return (false);
+    }
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    ComputeViewPoint::operator () (CloudContext &context) const
+  {
+    getCloudViewPoint (tf_, viewpoint_frame_, context.cloud.header.frame_id, context.viewpoint);
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    SelectGroundCandidates::operator () (CloudContext &context) const
+  {
+    const sensor_msgs::PointCloud &cloud = context.cloud;
+    // Transform z_threshold_ from the robot footprint frame into the point cloud frame
+    double z_threshold_cloud = transformDoubleValueTF (z_threshold_, robot_footprint_frame_, cloud.header.frame_id,
+                                                      cloud.header.stamp, tf_);
+
+    context.candidates.clear ();
+    for (unsigned int cp = 0; cp < cloud.points.size (); cp++)
+    {
+      const geometry_msgs::Point32 &p = cloud.points[cp];
+      if (fabs (p.z) < z_threshold_cloud ||                                             // max height for ground
+          p.z * p.z < ground_slope_threshold_ * (p.x * p.x + p.y * p.y))                // max slope for ground
+        context.candidates.push_back (cp);
+    }
+    ROS_DEBUG ("Number of possible ground indices: %d.", (int)context.candidates.size ());
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    RefineGroundPlane::operator () (CloudContext &context) const
+  {
+    //make sure that there are inliers to refine
+    if (context.inliers.empty ())
+      return (true);
+
+    const sensor_msgs::PointCloud &cloud = context.cloud;
+
+    // Estimate the plane from the inliers
+    Eigen::Vector4d plane_parameters;
+    double curvature;
+    computePointNormal (cloud, context.inliers, plane_parameters, curvature);
+    flipNormalTowardsViewpoint (plane_parameters, cloud.points.at (context.inliers[0]), context.viewpoint);
+
+    // Compute the distance from the remaining points to the model plane, and add to the inliers list if they are below
+    std::vector<char> is_inlier (cloud.points.size (), 0);
+    for (unsigned int i = 0; i < context.inliers.size (); i++)
+      is_inlier[context.inliers[i]] = 1;
+    for (unsigned int i = 0; i < cloud.points.size (); i++)
+    {
+      if (is_inlier[i])
+        continue;
+      if (pointToPlaneDistanceSigned (cloud.points[i], plane_parameters) < 1e-6)
+        context.inliers.push_back (i);
+    }
+    ROS_DEBUG ("Total number of ground inliers after refinement: %d.", (int)context.inliers.size ());
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    ExtractOutliers::operator () (CloudContext &context) const
+  {
+    const sensor_msgs::PointCloud &cloud = context.cloud;
+    std::vector<char> is_inlier (cloud.points.size (), 0);
+    for (unsigned int i = 0; i < context.inliers.size (); i++)
+      is_inlier[context.inliers[i]] = 1;
+
+    // Prepare new arrays
+    int nr_remaining_pts = cloud.points.size () - std::count (is_inlier.begin (), is_inlier.end (), 1);
+    context.output.header = cloud.header;
+    context.output.points.resize (nr_remaining_pts);
+    context.output.channels.resize (cloud.channels.size ());
+    for (unsigned int d = 0; d < cloud.channels.size (); d++)
+    {
+      context.output.channels[d].name = cloud.channels[d].name;
+      context.output.channels[d].values.resize (nr_remaining_pts);
+    }
+
+    int nr_p = 0;
+    for (unsigned int i = 0; i < cloud.points.size (); i++)
+    {
+      if (is_inlier[i])
+        continue;
+      context.output.points[nr_p] = cloud.points[i];
+      for (unsigned int d = 0; d < cloud.channels.size (); d++)
+        context.output.channels[d].values[nr_p] = cloud.channels[d].values[i];
+      nr_p++;
+    }
+    return (true);
+  }
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <plane_cache.h>
+#include <sac_kernels.h>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    transformPlane (const tf::Transform &transform, const std::vector<double> &coefficients_in,
+                    std::vector<double> &coefficients_out)
+  {
+    tf::Vector3 normal = transform.getBasis () * tf::Vector3 (coefficients_in[0], coefficients_in[1], coefficients_in[2]);
+    coefficients_out.resize (4);
+    coefficients_out[0] = normal.x ();
+    coefficients_out[1] = normal.y ();
+    coefficients_out[2] = normal.z ();
+    coefficients_out[3] = coefficients_in[3] - normal.dot (transform.getOrigin ());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    PlaneCache::update (tf::TransformListener *tf, const std::string &cloud_frame, const ros::Time &stamp,
+                        const std::vector<TrackedPlane> &planes)
+  {
+    planes_.clear ();
+    tf::StampedTransform transform;
+    try
+    {
+      tf->lookupTransform (fixed_frame_, cloud_frame, stamp, transform);
+    }
+    catch (tf::TransformException &ex)
+    {
+      ROS_WARN ("Could not cache the planes in frame %s: %s", fixed_frame_.c_str (), ex.what ());
+      return (false);
+    }
+
+    planes_.resize (planes.size ());
+    for (unsigned int i = 0; i < planes.size (); i++)
+    {
+      planes_[i] = planes[i];
+      transformPlane (transform, planes[i].coefficients, planes_[i].coefficients);
+    }
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    PlaneCache::predict (tf::TransformListener *tf, const std::string &cloud_frame, const ros::Time &stamp,
+                         std::vector<TrackedPlane> &planes) const
+  {
+    planes.clear ();
+    if (planes_.empty ())
+      return (true);
+
+    tf::StampedTransform transform;
+    try
+    {
+      tf->lookupTransform (cloud_frame, fixed_frame_, stamp, transform);
+    }
+    catch (tf::TransformException &ex)
+    {
+      ROS_WARN ("Could not predict the cached planes in frame %s: %s", cloud_frame.c_str (), ex.what ());
+      return (false);
+    }
+
+    planes.resize (planes_.size ());
+    for (unsigned int i = 0; i < planes_.size (); i++)
+    {
+      planes[i] = planes_[i];
+      transformPlane (transform, planes_[i].coefficients, planes[i].coefficients);
+    }
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  bool
+    validatePlane (const sensor_msgs::PointCloud &points, const std::vector<int> &indices,
+                   std::vector<double> &coefficients, double threshold, int min_inliers, std::vector<int> &inliers)
+  {
+    inliers.clear ();
+    if ((int)indices.size () < min_inliers)
+      return (false);
+
+    float plane[4];
+    for (int d = 0; d < 4; d++)
+      plane[d] = coefficients[d];
+    if (sample_consensus::kernels::countPlaneInliers (points, indices, plane, threshold) < min_inliers)
+      return (false);
+
+    // Refit the plane to the points close to the prediction
+    sample_consensus::PointsSoA candidates, fit;
+    candidates.gather (points, indices);
+    sample_consensus::kernels::selectPlaneInliers (candidates, indices, plane, threshold, inliers);
+    fit.gather (points, inliers);
+
+    double centroid[3], covariance[6], eigen_values[3], eigen_vectors[3][3];
+    sample_consensus::kernels::computeCovariance (fit, centroid, covariance);
+    sample_consensus::kernels::solveSymmetric3 (covariance, eigen_values, eigen_vectors);
+
+    // The normal is the eigenvector of the smallest eigenvalue, pointing the same way as the predicted one
+    double sign = (eigen_vectors[0][0] * coefficients[0] + eigen_vectors[0][1] * coefficients[1] +
+                   eigen_vectors[0][2] * coefficients[2]) < 0 ? -1.0 : 1.0;
+    for (int d = 0; d < 3; d++)
+      coefficients[d] = sign * eigen_vectors[0][d];
+    coefficients[3] = -1 * (coefficients[0] * centroid[0] + coefficients[1] * centroid[1] + coefficients[2] * centroid[2]);
+
+    // The refitted plane may have moved: select its inliers again
+    for (int d = 0; d < 4; d++)
+      plane[d] = coefficients[d];
+    sample_consensus::kernels::selectPlaneInliers (candidates, indices, plane, threshold, inliers);
+    return ((int)inliers.size () >= min_inliers);
+  }
+}
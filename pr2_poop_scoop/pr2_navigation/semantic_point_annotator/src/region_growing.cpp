@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <cmath>
+#include <algorithm>
+#include <region_growing.h>
+#include <voxel_grid_index.h>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Find the root of the set of x. Parents only ever decrease (roots are linked under smaller roots), so a
+    * concurrent path halving step can only shorten the path, and is simply skipped if another thread got there first.
+    */
+  static inline int
+    findRoot (int *parent, int x)
+  {
+    volatile int *p = parent;
+    while (true)
+    {
+      int px = p[x];
+      if (px == x)
+        return (x);
+      int gx = p[px];
+      if (gx != px)
+        __sync_bool_compare_and_swap (&parent[x], px, gx);
+      x = gx;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Merge the sets of a and b. Safe to call from several threads at once. */
+  static inline void
+    unite (int *parent, int a, int b)
+  {
+    while (true)
+    {
+      a = findRoot (parent, a);
+      b = findRoot (parent, b);
+      if (a == b)
+        return;
+      if (a < b)
+        std::swap (a, b);
+      // Link the larger root under the smaller one; retry if another thread linked it in the meantime
+      if (__sync_bool_compare_and_swap (&parent[a], a, b))
+        return;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    growRegions (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, double tolerance,
+                 int nx_idx, int ny_idx, int nz_idx, double angle_threshold, unsigned int min_pts_per_cluster,
+                 std::vector<std::vector<int> > &clusters)
+  {
+    int n = indices.size ();
+    if (n == 0)
+      return;
+
+    // Normalize the normals once, so that comparing two of them is a dot product against cos (angle_threshold)
+    std::vector<float> nx (n), ny (n), nz (n);
+    const std::vector<float> &cx = points.channels[nx_idx].values, &cy = points.channels[ny_idx].values, &cz = points.channels[nz_idx].values;
+#pragma omp parallel for
+    for (int i = 0; i < n; i++)
+    {
+      float x = cx[indices[i]], y = cy[indices[i]], z = cz[indices[i]];
+      float norm = sqrt (x * x + y * y + z * z);
+      if (norm > 0)
+      {
+        x /= norm; y /= norm; z /= norm;
+      }
+      nx[i] = x; ny[i] = y; nz[i] = z;
+    }
+    float cos_threshold = cos (angle_threshold);
+
+    // Cells of half the search radius: more cells per search, but a smaller volume to scan than cells of the radius
+    VoxelGridIndex grid;
+    grid.build (points, indices, tolerance / 2);
+    const std::vector<int> &order = grid.getCellOrder ();
+
+    std::vector<int> parent (n);
+    for (int i = 0; i < n; i++)
+      parent[i] = i;
+
+#pragma omp parallel
+    {
+      std::vector<int> nn_indices;
+#pragma omp for schedule(dynamic, 256)
+      for (int s = 0; s < n; s++)
+      {
+        // Go through the points cell by cell, so that consecutive searches visit the same cells
+        int i = order[s];
+        grid.radiusSearch (i, tolerance, nn_indices);
+        for (unsigned int j = 0; j < nn_indices.size (); j++)
+        {
+          int k = nn_indices[j];
+          // Each pair is seen from both ends; only handle it once
+          if (k <= i)
+            continue;
+          if (nx[i] * nx[k] + ny[i] * ny[k] + nz[i] * nz[k] > cos_threshold)
+            unite (&parent[0], i, k);
+        }
+      }
+    }
+
+    // Collect the regions, in the order of their first point
+    std::vector<int> region (n, -1);
+    std::vector<std::vector<int> > regions;
+    for (int i = 0; i < n; i++)
+    {
+      int root = findRoot (&parent[0], i);
+      if (region[root] == -1)
+      {
+        region[root] = regions.size ();
+        regions.push_back (std::vector<int> ());
+      }
+      regions[region[root]].push_back (indices[i]);
+    }
+
+    for (unsigned int r = 0; r < regions.size (); r++)
+    {
+      if (regions[r].size () < min_pts_per_cluster)
+        continue;
+      clusters.push_back (std::vector<int> ());
+      clusters.back ().swap (regions[r]);
+    }
+  }
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <limits>
+#include <lo_ransac.h>
+
+namespace sample_consensus
+{
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief LO-RANSAC (Locally Optimized RAndom SAmple Consensus) main constructor
+    * \param model a Sample Consensus model
+    * \param threshold distance to model threshold
+    */
+  LORANSAC::LORANSAC (SACModel *model, double threshold) : SAC (model)
+  {
+    this->threshold_ = threshold;
+    // Desired probability of choosing at least one sample free from outliers
+    this->probability_    = 0.99;
+    // Maximum number of trials before we give up.
+    this->max_iterations_ = 10000;
+
+    this->iterations_    = 0;
+    this->lo_iterations_ = 4;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief LO-RANSAC (Locally Optimized RAndom SAmple Consensus) main constructor
+    * \param model a Sample Consensus model
+    */
+  LORANSAC::LORANSAC (SACModel* model) : SAC (model), lo_iterations_ (4) { }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief Compute the actual model and find the inliers
+    * \param debug enable/disable on-screen debug information
+    */
+  bool
+    LORANSAC::computeModel (int debug)
+  {
+    iterations_ = 0;
+    int n_best_inliers_count = -INT_MAX;
+    double k = 1.0;
+
+    std::vector<int> best_model;
+    std::vector<int> best_inliers, inliers;
+    std::vector<double> coefficients, refit_coefficients;
+    std::vector<int> selection;
+    best_coefficients_.clear ();
+
+    // Iterate
+    while (iterations_ < k)
+    {
+      // Get X samples which satisfy the model criteria
+      sac_model_->getSamples (iterations_, selection);
+
+      if (selection.size () == 0) break;
+
+      sac_model_->computeModelCoefficients (selection);
+      coefficients = sac_model_->getModelCoefficients ();
+      int n_inliers_count = sac_model_->countWithinDistance (coefficients, threshold_);
+
+      // Better match ?
+      if (n_inliers_count > n_best_inliers_count)
+      {
+        // Local optimization: refit the model to its inliers while this gains support
+        sac_model_->selectWithinDistance (coefficients, threshold_, inliers);
+        for (int lo = 0; lo < lo_iterations_ && inliers.size () > 0; lo++)
+        {
+          sac_model_->refitModel (inliers, refit_coefficients);
+          int n_refit_count = sac_model_->countWithinDistance (refit_coefficients, threshold_);
+          if (n_refit_count <= n_inliers_count)
+            break;
+          if (debug > 1)
+            std::cerr << "[LORANSAC::computeModel] Local optimization " << lo + 1 << ": " << n_inliers_count << " -> " << n_refit_count << " inliers." << std::endl;
+          n_inliers_count = n_refit_count;
+          coefficients = refit_coefficients;
+          sac_model_->selectWithinDistance (coefficients, threshold_, inliers);
+        }
+
+        n_best_inliers_count = n_inliers_count;
+        best_inliers.swap (inliers);
+        best_model = selection;
+        best_coefficients_ = coefficients;
+
+        k = computeMaxTrials (n_inliers_count, selection.size ());
+      }
+
+      iterations_ += 1;
+      if (debug > 1)
+        std::cerr << "[LORANSAC::computeModel] Trial " << iterations_ << " out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
+      if (iterations_ > max_iterations_)
+      {
+        if (debug > 0)
+          std::cerr << "[LORANSAC::computeModel] LO-RANSAC reached the maximum number of trials." << std::endl;
+        break;
+      }
+    }
+
+    if (best_model.size () != 0)
+    {
+      if (debug > 0)
+        std::cerr << "[LORANSAC::computeModel] Model found: " << n_best_inliers_count << " inliers." << std::endl;
+      sac_model_->setBestModel (best_model);
+      sac_model_->setBestInliers (best_inliers);
+      return (true);
+    }
+    else
+      if (debug > 0)
+        std::cerr << "[LORANSAC::computeModel] Unable to find a solution!" << std::endl;
+    return (false);
+  }
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <limits>
+#include <prosac.h>
+
+namespace sample_consensus
+{
+  /** \brief Number of trials after which PROSAC draws its samples from all the points, as RANSAC does */
+  static const double PROSAC_T_N = 200000.0;
+  /** \brief Probability that a point is an inlier to a wrong model, for the non-randomness test */
+  static const double PROSAC_BETA = 0.05;
+  /** \brief Quantile of the chi-square distribution for a 5% chance of accepting a random model as correct */
+  static const double PROSAC_CHI2 = 2.706;
+  /** \brief Smallest termination length considered, so that a handful of lucky points cannot end the search */
+  static const int PROSAC_MIN_N_STAR = 20;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief PROSAC (PROgressive SAmple Consensus) main constructor
+    * \param model a Sample Consensus model
+    * \param threshold distance to model threshold
+    */
+  PROSAC::PROSAC (SACModel *model, double threshold) : SAC (model)
+  {
+    this->threshold_ = threshold;
+    // Desired probability of choosing at least one sample free from outliers
+    this->probability_    = 0.99;
+    // Maximum number of trials before we give up.
+    this->max_iterations_ = 10000;
+
+    this->iterations_ = 0;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief PROSAC (PROgressive SAmple Consensus) main constructor
+    * \param model a Sample Consensus model
+    */
+  PROSAC::PROSAC (SACModel* model) : SAC (model) { }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void
+    PROSAC::drawSamples (int range, int nr_samples, std::vector<int> &samples)
+  {
+    std::vector<int> *indices = sac_model_->getIndices ();
+    sac_model_->getRandomGenerator ().sample (range, nr_samples, positions_);
+    for (int i = 0; i < nr_samples; i++)
+      samples.push_back ((*indices)[positions_[i]]);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief Compute the actual model and find the inliers
+    * \param debug enable/disable on-screen debug information
+    */
+  bool
+    PROSAC::computeModel (int debug)
+  {
+    iterations_ = 0;
+    int n_best_inliers_count = -INT_MAX;
+    double k = 1.0;
+
+    std::vector<int> best_model;
+    std::vector<double> best_coefficients, coefficients;
+    std::vector<int> selection;
+
+    int n_indices = sac_model_->getIndices ()->size ();
+    int m = sac_model_->getSampleSize ();
+    if (n_indices < m)
+      return (false);
+
+    // The growth function: T_n is the expected number of samples drawn only from the n best points, out of T_N
+    int n = m;
+    double T_n = PROSAC_T_N;
+    for (int i = 0; i < m; i++)
+      T_n *= (double)(n - i) / (double)(n_indices - i);
+    double T_prime_n = 1.0;
+
+    // The termination length n_star: the best solution is looked for in the n_star best points only
+    int n_star = n_indices;
+    std::vector<int> positions;
+    std::vector<int> inliers;
+
+    // Iterate
+    while (iterations_ < k)
+    {
+      int t = iterations_ + 1;
+
+      // Choice of the hypothesis generation set
+      if (t >= T_prime_n && n < n_star)
+      {
+        double T_n_plus_1 = T_n * (double)(n + 1) / (double)(n + 1 - m);
+        T_prime_n += ceil (T_n_plus_1 - T_n);
+        T_n = T_n_plus_1;
+        n++;
+      }
+
+      // Semi-random sample: either m points out of the n best, or the n-th point plus m-1 points out of the n-1 best
+      selection.clear ();
+      if (T_prime_n < t)
+        drawSamples (n, m, selection);
+      else
+      {
+        selection.push_back (sac_model_->getIndices ()->at (n - 1));
+        drawSamples (n - 1, m - 1, selection);
+      }
+
+      sac_model_->computeModelCoefficients (selection);
+      coefficients = sac_model_->getModelCoefficients ();
+      int n_inliers_count = sac_model_->countWithinDistance (coefficients, threshold_);
+
+      // Better match ?
+      if (n_inliers_count > n_best_inliers_count)
+      {
+        n_best_inliers_count = n_inliers_count;
+        best_model = selection;
+        best_coefficients = coefficients;
+
+        // Pick the termination length n_star that needs the fewest trials, out of those where the support of the
+        // model is too large to be random (non-randomness) given the inlier ratio I_n / n in the n best points
+        if (positions.size () == 0)
+        {
+          positions.resize (sac_model_->getCloud ()->points.size (), -1);
+          for (int i = 0; i < n_indices; i++)
+            positions[sac_model_->getIndices ()->at (i)] = i;
+        }
+        sac_model_->selectWithinDistance (coefficients, threshold_, inliers);
+        std::vector<int> inliers_at (n_indices + 1, 0);
+        for (unsigned int i = 0; i < inliers.size (); i++)
+          inliers_at[positions[inliers[i]] + 1]++;
+        int I_n = 0;
+        k = std::numeric_limits<double>::max ();
+        for (int nn = 1; nn <= n_indices; nn++)
+        {
+          I_n += inliers_at[nn];
+          if (nn < std::max (m, std::min (PROSAC_MIN_N_STAR, n_indices)))
+            continue;
+          double mu = nn * PROSAC_BETA, sigma = sqrt (nn * PROSAC_BETA * (1 - PROSAC_BETA));
+          if (I_n < m + ceil (mu + sigma * sqrt (PROSAC_CHI2)))
+            continue;
+          double p_no_outliers = 1 - pow ((double)I_n / (double)nn, (double)m);
+          p_no_outliers = std::max (std::numeric_limits<double>::epsilon (), p_no_outliers);
+          p_no_outliers = std::min (1 - std::numeric_limits<double>::epsilon (), p_no_outliers);
+          double k_n = log (1 - probability_) / log (p_no_outliers);
+          if (k_n < k)
+          {
+            k = k_n;
+            n_star = nn;
+          }
+        }
+        // No termination length passes the non-randomness test: fall back to the RANSAC criterion
+        if (k == std::numeric_limits<double>::max ())
+        {
+          k = computeMaxTrials (n_inliers_count, m);
+          n_star = n_indices;
+        }
+      }
+
+      iterations_ += 1;
+      if (debug > 1)
+        std::cerr << "[PROSAC::computeModel] Trial " << iterations_ << " (sampling the " << n << " best points) out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
+      if (iterations_ > max_iterations_)
+      {
+        if (debug > 0)
+          std::cerr << "[PROSAC::computeModel] PROSAC reached the maximum number of trials." << std::endl;
+        break;
+      }
+    }
+
+    if (best_model.size () != 0)
+    {
+      if (debug > 0)
+        std::cerr << "[PROSAC::computeModel] Model found: " << n_best_inliers_count << " inliers." << std::endl;
+      std::vector<int> best_inliers;
+      sac_model_->selectWithinDistance (best_coefficients, threshold_, best_inliers);
+      sac_model_->setBestModel (best_model);
+      sac_model_->setBestInliers (best_inliers);
+      return (true);
+    }
+    else
+      if (debug > 0)
+        std::cerr << "[PROSAC::computeModel] Unable to find a solution!" << std::endl;
+    return (false);
+  }
+}
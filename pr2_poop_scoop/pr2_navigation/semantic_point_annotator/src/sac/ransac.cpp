@@ -35,6 +35,9 @@
 
 namespace sample_consensus
 {
+  /** \brief Default number of hypotheses scored together in RANSAC::computeModel */
+  static const int RANSAC_BATCH_SIZE = 16;
+
   ////////////////////////////////////////////////////////////////////////////////
   /** \brief RANSAC (RAndom SAmple Consensus) main constructor
     * \param model a Sample Consensus model
@@ -49,16 +52,21 @@ namespace sample_consensus
     this->max_iterations_ = 10000;
 
     this->iterations_ = 0;
+    this->batch_size_ = RANSAC_BATCH_SIZE;
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   /** \brief RANSAC (RAndom SAmple Consensus) main constructor
     * \param model a Sample Consensus model
     */
-  RANSAC::RANSAC (SACModel* model) : SAC (model) { }
+  RANSAC::RANSAC (SACModel* model) : SAC (model), batch_size_ (RANSAC_BATCH_SIZE) { }
 
   ////////////////////////////////////////////////////////////////////////////////
   /** \brief Compute the actual model and find the inliers
+    * \note Hypotheses are drawn sequentially in batches of batch_size_ and their inliers are counted in parallel.
+    * They are then accepted in the order in which they were drawn, with the same stopping rule as the sequential
+    * algorithm, so the result does not depend on the number of threads. The inliers are only extracted for the
+    * winning model.
     * \param debug enable/disable on-screen debug information
     */
   bool
@@ -69,56 +77,89 @@ namespace sample_consensus
     double k = 1.0;
 
     std::vector<int> best_model;
-    std::vector<int> best_inliers, inliers;
-    std::vector<int> selection;
+    std::vector<double> best_coefficients;
 
-    int n_inliers_count = 0;
+    std::vector<std::vector<int> > selections (batch_size_);
+    std::vector<std::vector<double> > coefficients (batch_size_);
+    std::vector<int> counts (batch_size_);
+    std::vector<int> extra_iterations (batch_size_);
 
-    // Iterate
-    while (iterations_ < k)
+    int n_batch_max = 1;
+    bool done = false;
+    while (!done && iterations_ < k)
     {
-      // Get X samples which satisfy the model criteria
-      sac_model_->getSamples (iterations_, selection);
-
-      if (selection.size () == 0) break;
-
-      // Search for inliers in the point cloud for the current plane model M
-      sac_model_->computeModelCoefficients (selection);
-
-      sac_model_->selectWithinDistance (sac_model_->getModelCoefficients (), threshold_, inliers);
-      n_inliers_count = inliers.size ();
-
-      // Better match ?
-      if (n_inliers_count > n_best_inliers_count)
+      // Draw the samples and compute the model coefficients for a batch of hypotheses. This stays sequential so that
+      // the random number sequence (and hence the result) is the same for any number of threads. The batch grows
+      // geometrically up to batch_size_ and never exceeds what the current estimate of k (or the maximum number of
+      // trials) still allows, so that few hypotheses are drawn in vain once a good model has been found
+      n_batch_max = std::min (batch_size_, 2 * n_batch_max);
+      int n_batch = (int)std::min ((double)n_batch_max, std::min (ceil (k), (double)max_iterations_ + 1.0) - iterations_);
+      n_batch = std::max (1, n_batch);
+      int n_hyp = 0;
+      for (; n_hyp < n_batch; n_hyp++)
       {
-        n_best_inliers_count = n_inliers_count;
-        best_inliers = inliers;
-        //inliers.clear ();
-        best_model = selection;
-
-        // Compute the k parameter (k=log(z)/log(1-w^n))
-        double w = (double)((double)n_inliers_count / (double)sac_model_->getIndices ()->size ());
-        double p_no_outliers = 1 - pow (w, (double)selection.size ());
-        p_no_outliers = std::max (std::numeric_limits<double>::epsilon (), p_no_outliers);       // Avoid division by -Inf
-        p_no_outliers = std::min (1 - std::numeric_limits<double>::epsilon (), p_no_outliers);   // Avoid division by 0.
-        k = log (1 - probability_) / log (p_no_outliers);
+        extra_iterations[n_hyp] = 0;
+        sac_model_->getSamples (extra_iterations[n_hyp], selections[n_hyp]);
+        if (selections[n_hyp].size () == 0)
+          break;
+        sac_model_->computeModelCoefficients (selections[n_hyp]);
+        coefficients[n_hyp] = sac_model_->getModelCoefficients ();
       }
 
-      iterations_ += 1;
-      if (debug > 1)
-        std::cerr << "[RANSAC::computeModel] Trial " << iterations_ << " out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
-      if (iterations_ > max_iterations_)
+      // Count the inliers of each hypothesis
+#pragma omp parallel for schedule(dynamic)
+      for (int h = 0; h < n_hyp; h++)
+        counts[h] = sac_model_->countWithinDistance (coefficients[h], threshold_);
+
+      // Accept the hypotheses in the order in which they were drawn
+      for (int h = 0; h < n_hyp; h++)
       {
-        if (debug > 0)
-          std::cerr << "[RANSAC::computeModel] RANSAC reached the maximum number of trials." << std::endl;
-        break;
+        if (iterations_ >= k)
+        {
+          done = true;
+          break;
+        }
+        iterations_ += extra_iterations[h];
+        int n_inliers_count = counts[h];
+
+        // Better match ?
+        if (n_inliers_count > n_best_inliers_count)
+        {
+          n_best_inliers_count = n_inliers_count;
+          best_model = selections[h];
+          best_coefficients = coefficients[h];
+
+          // Compute the k parameter (k=log(z)/log(1-w^n))
+          double w = (double)((double)n_inliers_count / (double)sac_model_->getIndices ()->size ());
+          double p_no_outliers = 1 - pow (w, (double)selections[h].size ());
+          p_no_outliers = std::max (std::numeric_limits<double>::epsilon (), p_no_outliers);       // Avoid division by -Inf
+          p_no_outliers = std::min (1 - std::numeric_limits<double>::epsilon (), p_no_outliers);   // Avoid division by 0.
+          k = log (1 - probability_) / log (p_no_outliers);
+        }
+
+        iterations_ += 1;
+        if (debug > 1)
+          std::cerr << "[RANSAC::computeModel] Trial " << iterations_ << " out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
+        if (iterations_ > max_iterations_)
+        {
+          if (debug > 0)
+            std::cerr << "[RANSAC::computeModel] RANSAC reached the maximum number of trials." << std::endl;
+          done = true;
+          break;
+        }
       }
+
+      // An empty selection means no more samples can be drawn
+      if (n_hyp < n_batch)
+        done = true;
     }
 
     if (best_model.size () != 0)
     {
       if (debug > 0)
         std::cerr << "[RANSAC::computeModel] Model found: " << n_best_inliers_count << " inliers." << std::endl;
+      std::vector<int> best_inliers;
+      sac_model_->selectWithinDistance (best_coefficients, threshold_, best_inliers);
       sac_model_->setBestModel (best_model);
       sac_model_->setBestInliers (best_inliers);
       return (true);
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <limits>
+#include <rransac.h>
+
+namespace sample_consensus
+{
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief RRANSAC (Randomized RAndom SAmple Consensus) main constructor
+    * \param model a Sample Consensus model
+    * \param threshold distance to model threshold
+    */
+  RRANSAC::RRANSAC (SACModel *model, double threshold) : SAC (model)
+  {
+    this->threshold_ = threshold;
+    // Desired probability of choosing at least one sample free from outliers
+    this->probability_    = 0.99;
+    // Maximum number of trials before we give up.
+    this->max_iterations_ = 10000;
+
+    this->iterations_   = 0;
+    this->pretest_size_ = 1;
+    this->block_size_   = 64;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief RRANSAC (Randomized RAndom SAmple Consensus) main constructor
+    * \param model a Sample Consensus model
+    */
+  RRANSAC::RRANSAC (SACModel* model) : SAC (model), pretest_size_ (1), block_size_ (64) { }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /** \brief Compute the actual model and find the inliers
+    * \param debug enable/disable on-screen debug information
+    */
+  bool
+    RRANSAC::computeModel (int debug)
+  {
+    iterations_ = 0;
+    int n_best_inliers_count = -INT_MAX;
+    // Hypotheses may fail the pre-test, so keep trying until one passes (or we run out of trials)
+    double k = max_iterations_ + 1.0;
+    int n_pretest_rejected = 0, n_early_terminated = 0;
+
+    std::vector<int> best_model;
+    std::vector<double> best_coefficients, coefficients;
+    std::vector<int> selection;
+    std::vector<int> pretest (pretest_size_);
+
+    // Split the indices into blocks, in a random order so that the partial scores are representative
+    std::vector<int> *indices = sac_model_->getIndices ();
+    int n_indices = indices->size ();
+    if (n_indices == 0)
+      return (false);
+    std::vector<int> shuffled (*indices);
+    SACRandom &rng = sac_model_->getRandomGenerator ();
+    rng.shuffle (shuffled.begin (), shuffled.end ());
+    std::vector<std::vector<int> > blocks ((n_indices + block_size_ - 1) / block_size_);
+    for (unsigned int b = 0; b < blocks.size (); b++)
+      blocks[b].assign (shuffled.begin () + b * block_size_, shuffled.begin () + std::min ((int)(b + 1) * block_size_, n_indices));
+
+    // Iterate
+    while (iterations_ < k)
+    {
+      // Get X samples which satisfy the model criteria
+      sac_model_->getSamples (iterations_, selection);
+
+      if (selection.size () == 0) break;
+
+      sac_model_->computeModelCoefficients (selection);
+      coefficients = sac_model_->getModelCoefficients ();
+
+      // T(d,d) pre-test: all of the d random points must be inliers
+      for (int d = 0; d < pretest_size_; d++)
+        pretest[d] = (*indices)[rng.uniform (n_indices)];
+      int n_inliers_count = -1;
+      if (sac_model_->countWithinDistance (coefficients, threshold_, pretest) < pretest_size_)
+        n_pretest_rejected++;
+      else
+      {
+        // Score block by block, and give up once the hypothesis can no longer beat the best one
+        n_inliers_count = 0;
+        int n_remaining = n_indices;
+        for (unsigned int b = 0; b < blocks.size (); b++)
+        {
+          n_inliers_count += sac_model_->countWithinDistance (coefficients, threshold_, blocks[b]);
+          n_remaining -= blocks[b].size ();
+          if (n_inliers_count + n_remaining <= n_best_inliers_count)
+          {
+            n_early_terminated++;
+            break;
+          }
+        }
+      }
+
+      // Better match ?
+      if (n_inliers_count > n_best_inliers_count)
+      {
+        n_best_inliers_count = n_inliers_count;
+        best_model = selection;
+        best_coefficients = coefficients;
+
+        // A good sample also has to pass the pre-test, so it needs to be free from outliers on n + d points
+        k = computeMaxTrials (n_inliers_count, selection.size () + pretest_size_);
+      }
+
+      iterations_ += 1;
+      if (debug > 1)
+        std::cerr << "[RRANSAC::computeModel] Trial " << iterations_ << " out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
+      if (iterations_ > max_iterations_)
+      {
+        if (debug > 0)
+          std::cerr << "[RRANSAC::computeModel] RRANSAC reached the maximum number of trials." << std::endl;
+        break;
+      }
+    }
+
+    if (debug > 0)
+      std::cerr << "[RRANSAC::computeModel] " << n_pretest_rejected << " hypotheses rejected by the pre-test, " << n_early_terminated << " terminated early." << std::endl;
+
+    if (best_model.size () != 0)
+    {
+      if (debug > 0)
+        std::cerr << "[RRANSAC::computeModel] Model found: " << n_best_inliers_count << " inliers." << std::endl;
+      std::vector<int> best_inliers;
+      sac_model_->selectWithinDistance (best_coefficients, threshold_, best_inliers);
+      sac_model_->setBestModel (best_model);
+      sac_model_->setBestInliers (best_inliers);
+      return (true);
+    }
+    else
+      if (debug > 0)
+        std::cerr << "[RRANSAC::computeModel] Unable to find a solution!" << std::endl;
+    return (false);
+  }
+}
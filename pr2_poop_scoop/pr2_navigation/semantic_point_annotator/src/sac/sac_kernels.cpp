@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <cmath>
+#include <sac_kernels.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sample_consensus
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    PointsSoA::gather (const sensor_msgs::PointCloud &cloud, const std::vector<int> &indices)
+  {
+    x.resize (indices.size ());
+    y.resize (indices.size ());
+    z.resize (indices.size ());
+    for (unsigned int i = 0; i < indices.size (); i++)
+    {
+      const geometry_msgs::Point32 &p = cloud.points[indices[i]];
+      x[i] = p.x;
+      y[i] = p.y;
+      z[i] = p.z;
+    }
+  }
+
+  namespace kernels
+  {
+#if defined(__SSE2__)
+    /** \brief Number of bits set in each 4-bit mask */
+    static const int MASK_BITS[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+#endif
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Squared distance from a point to a line. The vectorized kernels below do the same operations in the
+      * same order, so they give bit-identical results. */
+    static inline float
+      sqrLineDistance (float x, float y, float z, const float a[3], const float d[3])
+    {
+      float vx = x - a[0], vy = y - a[1], vz = z - a[2];
+      float cx = d[1] * vz - d[2] * vy;
+      float cy = d[2] * vx - d[0] * vz;
+      float cz = d[0] * vy - d[1] * vx;
+      return (cx * cx + cy * cy + cz * cz);
+    }
+
+    /** \brief Distance from a point to a plane */
+    static inline float
+      planeDistance (float x, float y, float z, const float plane[4])
+    {
+      return (fabsf (plane[0] * x + plane[1] * y + plane[2] * z + plane[3]));
+    }
+
+#if defined(__SSE2__)
+    /** \brief Squared distances from 4 points to a line */
+    static inline __m128
+      sqrLineDistance4 (__m128 x, __m128 y, __m128 z, const __m128 a[3], const __m128 d[3])
+    {
+      __m128 vx = _mm_sub_ps (x, a[0]), vy = _mm_sub_ps (y, a[1]), vz = _mm_sub_ps (z, a[2]);
+      __m128 cx = _mm_sub_ps (_mm_mul_ps (d[1], vz), _mm_mul_ps (d[2], vy));
+      __m128 cy = _mm_sub_ps (_mm_mul_ps (d[2], vx), _mm_mul_ps (d[0], vz));
+      __m128 cz = _mm_sub_ps (_mm_mul_ps (d[0], vy), _mm_mul_ps (d[1], vx));
+      return (_mm_add_ps (_mm_add_ps (_mm_mul_ps (cx, cx), _mm_mul_ps (cy, cy)), _mm_mul_ps (cz, cz)));
+    }
+
+    /** \brief Distances from 4 points to a plane */
+    static inline __m128
+      planeDistance4 (__m128 x, __m128 y, __m128 z, const __m128 plane[4])
+    {
+      __m128 d = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (plane[0], x), _mm_mul_ps (plane[1], y)), _mm_mul_ps (plane[2], z)), plane[3]);
+      // Clear the sign bit
+      return (_mm_andnot_ps (_mm_set1_ps (-0.0f), d));
+    }
+#endif
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    int
+      countLineInliers (const PointsSoA &points, const float line_point[3], const float line_dir[3], float sqr_threshold)
+    {
+      int n = points.size (), i = 0, nr_p = 0;
+      if (n == 0)
+        return (0);
+      const float *x = &points.x[0], *y = &points.y[0], *z = &points.z[0];
+#if defined(__SSE2__)
+      __m128 a[3] = { _mm_set1_ps (line_point[0]), _mm_set1_ps (line_point[1]), _mm_set1_ps (line_point[2]) };
+      __m128 d[3] = { _mm_set1_ps (line_dir[0]), _mm_set1_ps (line_dir[1]), _mm_set1_ps (line_dir[2]) };
+      __m128 t = _mm_set1_ps (sqr_threshold);
+      for (; i + 4 <= n; i += 4)
+      {
+        __m128 s = sqrLineDistance4 (_mm_loadu_ps (x + i), _mm_loadu_ps (y + i), _mm_loadu_ps (z + i), a, d);
+        nr_p += MASK_BITS[_mm_movemask_ps (_mm_cmplt_ps (s, t))];
+      }
+#endif
+      for (; i < n; i++)
+        if (sqrLineDistance (x[i], y[i], z[i], line_point, line_dir) < sqr_threshold)
+          nr_p++;
+      return (nr_p);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    int
+      countLineInliers (const sensor_msgs::PointCloud &cloud, const std::vector<int> &indices,
+                        const float line_point[3], const float line_dir[3], float sqr_threshold)
+    {
+      int nr_p = 0;
+      for (unsigned int i = 0; i < indices.size (); i++)
+      {
+        const geometry_msgs::Point32 &p = cloud.points[indices[i]];
+        if (sqrLineDistance (p.x, p.y, p.z, line_point, line_dir) < sqr_threshold)
+          nr_p++;
+      }
+      return (nr_p);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void
+      selectLineInliers (const PointsSoA &points, const std::vector<int> &indices, const float line_point[3],
+                         const float line_dir[3], float sqr_threshold, std::vector<int> &inliers)
+    {
+      int n = points.size (), i = 0, nr_p = 0;
+      inliers.resize (n);
+      if (n == 0)
+        return;
+      const float *x = &points.x[0], *y = &points.y[0], *z = &points.z[0];
+#if defined(__SSE2__)
+      __m128 a[3] = { _mm_set1_ps (line_point[0]), _mm_set1_ps (line_point[1]), _mm_set1_ps (line_point[2]) };
+      __m128 d[3] = { _mm_set1_ps (line_dir[0]), _mm_set1_ps (line_dir[1]), _mm_set1_ps (line_dir[2]) };
+      __m128 t = _mm_set1_ps (sqr_threshold);
+      for (; i + 4 <= n; i += 4)
+      {
+        __m128 s = sqrLineDistance4 (_mm_loadu_ps (x + i), _mm_loadu_ps (y + i), _mm_loadu_ps (z + i), a, d);
+        int mask = _mm_movemask_ps (_mm_cmplt_ps (s, t));
+        for (int j = 0; mask; j++, mask >>= 1)
+          if (mask & 1)
+            inliers[nr_p++] = indices[i + j];
+      }
+#endif
+      for (; i < n; i++)
+        if (sqrLineDistance (x[i], y[i], z[i], line_point, line_dir) < sqr_threshold)
+          inliers[nr_p++] = indices[i];
+      inliers.resize (nr_p);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void
+      lineDistances (const PointsSoA &points, const float line_point[3], const float line_dir[3], std::vector<double> &distances)
+    {
+      distances.resize (points.size ());
+      for (unsigned int i = 0; i < points.size (); i++)
+        distances[i] = sqrt (sqrLineDistance (points.x[i], points.y[i], points.z[i], line_point, line_dir));
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    int
+      countPlaneInliers (const PointsSoA &points, const float plane[4], float threshold)
+    {
+      int n = points.size (), i = 0, nr_p = 0;
+      if (n == 0)
+        return (0);
+      const float *x = &points.x[0], *y = &points.y[0], *z = &points.z[0];
+#if defined(__SSE2__)
+      __m128 p[4] = { _mm_set1_ps (plane[0]), _mm_set1_ps (plane[1]), _mm_set1_ps (plane[2]), _mm_set1_ps (plane[3]) };
+      __m128 t = _mm_set1_ps (threshold);
+      for (; i + 4 <= n; i += 4)
+      {
+        __m128 s = planeDistance4 (_mm_loadu_ps (x + i), _mm_loadu_ps (y + i), _mm_loadu_ps (z + i), p);
+        nr_p += MASK_BITS[_mm_movemask_ps (_mm_cmplt_ps (s, t))];
+      }
+#endif
+      for (; i < n; i++)
+        if (planeDistance (x[i], y[i], z[i], plane) < threshold)
+          nr_p++;
+      return (nr_p);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    int
+      countPlaneInliers (const sensor_msgs::PointCloud &cloud, const std::vector<int> &indices, const float plane[4], float threshold)
+    {
+      int nr_p = 0;
+      for (unsigned int i = 0; i < indices.size (); i++)
+      {
+        const geometry_msgs::Point32 &p = cloud.points[indices[i]];
+        if (planeDistance (p.x, p.y, p.z, plane) < threshold)
+          nr_p++;
+      }
+      return (nr_p);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void
+      selectPlaneInliers (const PointsSoA &points, const std::vector<int> &indices, const float plane[4],
+                          float threshold, std::vector<int> &inliers)
+    {
+      int n = points.size (), i = 0, nr_p = 0;
+      inliers.resize (n);
+      if (n == 0)
+        return;
+      const float *x = &points.x[0], *y = &points.y[0], *z = &points.z[0];
+#if defined(__SSE2__)
+      __m128 p[4] = { _mm_set1_ps (plane[0]), _mm_set1_ps (plane[1]), _mm_set1_ps (plane[2]), _mm_set1_ps (plane[3]) };
+      __m128 t = _mm_set1_ps (threshold);
+      for (; i + 4 <= n; i += 4)
+      {
+        __m128 s = planeDistance4 (_mm_loadu_ps (x + i), _mm_loadu_ps (y + i), _mm_loadu_ps (z + i), p);
+        int mask = _mm_movemask_ps (_mm_cmplt_ps (s, t));
+        for (int j = 0; mask; j++, mask >>= 1)
+          if (mask & 1)
+            inliers[nr_p++] = indices[i + j];
+      }
+#endif
+      for (; i < n; i++)
+        if (planeDistance (x[i], y[i], z[i], plane) < threshold)
+          inliers[nr_p++] = indices[i];
+      inliers.resize (nr_p);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void
+      planeDistances (const PointsSoA &points, const float plane[4], std::vector<double> &distances)
+    {
+      distances.resize (points.size ());
+      for (unsigned int i = 0; i < points.size (); i++)
+        distances[i] = planeDistance (points.x[i], points.y[i], points.z[i], plane);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void
+      computeCovariance (const PointsSoA &points, double centroid[3], double covariance[6])
+    {
+      int n = points.size ();
+      for (int d = 0; d < 6; d++)
+        covariance[d] = 0.0;
+      centroid[0] = centroid[1] = centroid[2] = 0.0;
+      if (n == 0)
+        return;
+
+      // Two passes (centroid first), accumulated in double precision, to avoid cancellation far from the origin
+      double sx = 0, sy = 0, sz = 0;
+      for (int i = 0; i < n; i++)
+      {
+        sx += points.x[i];
+        sy += points.y[i];
+        sz += points.z[i];
+      }
+      centroid[0] = sx / n;
+      centroid[1] = sy / n;
+      centroid[2] = sz / n;
+
+      double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+      for (int i = 0; i < n; i++)
+      {
+        double dx = points.x[i] - centroid[0], dy = points.y[i] - centroid[1], dz = points.z[i] - centroid[2];
+        xx += dx * dx; xy += dx * dy; xz += dx * dz;
+        yy += dy * dy; yz += dy * dz; zz += dz * dz;
+      }
+      covariance[0] = xx; covariance[1] = xy; covariance[2] = xz;
+      covariance[3] = yy; covariance[4] = yz; covariance[5] = zz;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Cross product */
+    static inline void
+      cross3 (const double a[3], const double b[3], double r[3])
+    {
+      r[0] = a[1] * b[2] - a[2] * b[1];
+      r[1] = a[2] * b[0] - a[0] * b[2];
+      r[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    /** \brief Find a unit eigenvector of matrix m (upper triangle) for the eigenvalue lambda, as the largest cross
+      * product of two rows of (m - lambda I). Returns false if the eigenvalue is (close to) a repeated one. */
+    static bool
+      eigenvector3 (const double m[6], double lambda, double scale, double v[3])
+    {
+      double r0[3] = { m[0] - lambda, m[1], m[2] };
+      double r1[3] = { m[1], m[3] - lambda, m[4] };
+      double r2[3] = { m[2], m[4], m[5] - lambda };
+      double c[3][3];
+      cross3 (r0, r1, c[0]);
+      cross3 (r0, r2, c[1]);
+      cross3 (r1, r2, c[2]);
+      int best = 0;
+      double best_norm = -1.0;
+      for (int i = 0; i < 3; i++)
+      {
+        double norm = c[i][0] * c[i][0] + c[i][1] * c[i][1] + c[i][2] * c[i][2];
+        if (norm > best_norm)
+        {
+          best_norm = norm;
+          best = i;
+        }
+      }
+      // The rows span less than a plane: the eigenvalue is repeated and any vector of the eigenspace would do
+      if (best_norm <= 1e-20 * scale * scale * scale * scale)
+        return (false);
+      best_norm = sqrt (best_norm);
+      for (int d = 0; d < 3; d++)
+        v[d] = c[best][d] / best_norm;
+      return (true);
+    }
+
+    /** \brief Return a unit vector orthogonal to v */
+    static void
+      anyOrthogonal (const double v[3], double r[3])
+    {
+      double axis[3] = { 0.0, 0.0, 0.0 };
+      // Use the axis along which v is smallest
+      int i = (fabs (v[0]) < fabs (v[1])) ? (fabs (v[0]) < fabs (v[2]) ? 0 : 2) : (fabs (v[1]) < fabs (v[2]) ? 1 : 2);
+      axis[i] = 1.0;
+      cross3 (v, axis, r);
+      double norm = sqrt (r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+      for (int d = 0; d < 3; d++)
+        r[d] /= norm;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void
+      solveSymmetric3 (const double matrix[6], double values[3], double vectors[3][3])
+    {
+      // Scale the matrix to avoid over/underflow
+      double scale = 0.0;
+      for (int d = 0; d < 6; d++)
+        scale = std::max (scale, fabs (matrix[d]));
+      if (scale == 0.0)
+      {
+        for (int i = 0; i < 3; i++)
+        {
+          values[i] = 0.0;
+          for (int d = 0; d < 3; d++)
+            vectors[i][d] = (i == d) ? 1.0 : 0.0;
+        }
+        return;
+      }
+      double m[6];
+      for (int d = 0; d < 6; d++)
+        m[d] = matrix[d] / scale;
+
+      // Eigenvalues of a symmetric 3x3 matrix, from the characteristic polynomial (trigonometric solution)
+      double q = (m[0] + m[3] + m[5]) / 3.0;
+      double p1 = m[1] * m[1] + m[2] * m[2] + m[4] * m[4];
+      double p2 = (m[0] - q) * (m[0] - q) + (m[3] - q) * (m[3] - q) + (m[5] - q) * (m[5] - q) + 2.0 * p1;
+      double p = sqrt (p2 / 6.0);
+      double lambda_min, lambda_mid, lambda_max;
+      if (p == 0.0)
+        lambda_min = lambda_mid = lambda_max = q;
+      else
+      {
+        double b0 = (m[0] - q) / p, b1 = m[1] / p, b2 = m[2] / p, b3 = (m[3] - q) / p, b4 = m[4] / p, b5 = (m[5] - q) / p;
+        double r = (b0 * (b3 * b5 - b4 * b4) - b1 * (b1 * b5 - b4 * b2) + b2 * (b1 * b4 - b3 * b2)) / 2.0;
+        r = std::max (-1.0, std::min (1.0, r));
+        double phi = acos (r) / 3.0;
+        lambda_max = q + 2.0 * p * cos (phi);
+        lambda_min = q + 2.0 * p * cos (phi + 2.0 * M_PI / 3.0);
+        lambda_mid = 3.0 * q - lambda_max - lambda_min;
+      }
+
+      // Eigenvectors of the extreme eigenvalues; the middle one completes the basis
+      double v_min[3], v_max[3], v_mid[3];
+      bool has_min = eigenvector3 (m, lambda_min, 1.0, v_min);
+      bool has_max = eigenvector3 (m, lambda_max, 1.0, v_max);
+      if (!has_min && !has_max)
+      {
+        // All three eigenvalues are equal
+        v_min[0] = 1.0; v_min[1] = 0.0; v_min[2] = 0.0;
+        v_max[0] = 0.0; v_max[1] = 0.0; v_max[2] = 1.0;
+      }
+      else if (!has_min)
+      {
+        anyOrthogonal (v_max, v_min);
+      }
+      else if (!has_max)
+      {
+        anyOrthogonal (v_min, v_max);
+      }
+      else
+      {
+        // Make sure the two are exactly orthogonal
+        double dot = v_min[0] * v_max[0] + v_min[1] * v_max[1] + v_min[2] * v_max[2];
+        for (int d = 0; d < 3; d++)
+          v_max[d] -= dot * v_min[d];
+        double norm = sqrt (v_max[0] * v_max[0] + v_max[1] * v_max[1] + v_max[2] * v_max[2]);
+        for (int d = 0; d < 3; d++)
+          v_max[d] /= norm;
+      }
+      cross3 (v_max, v_min, v_mid);
+
+      values[0] = lambda_min * scale;
+      values[1] = lambda_mid * scale;
+      values[2] = lambda_max * scale;
+      for (int d = 0; d < 3; d++)
+      {
+        vectors[0][d] = v_min[d];
+        vectors[1][d] = v_mid[d];
+        vectors[2][d] = v_max[d];
+      }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool
+      lineFromCoefficients (const std::vector<double> &model_coefficients, float line_point[3], float line_dir[3])
+    {
+      double dx = model_coefficients.at (3) - model_coefficients.at (0);
+      double dy = model_coefficients.at (4) - model_coefficients.at (1);
+      double dz = model_coefficients.at (5) - model_coefficients.at (2);
+      double norm = sqrt (dx * dx + dy * dy + dz * dz);
+      if (norm == 0.0)
+        return (false);
+      line_point[0] = model_coefficients[0];
+      line_point[1] = model_coefficients[1];
+      line_point[2] = model_coefficients[2];
+      line_dir[0] = dx / norm;
+      line_dir[1] = dy / norm;
+      line_dir[2] = dz / norm;
+      return (true);
+    }
+  }
+}
@@ -52,7 +52,7 @@ namespace sample_consensus
                     inserter (remaining_indices, remaining_indices.begin ()));
 
     indices_ = remaining_indices;
-
+    points_.gather (*cloud_, indices_);
 
     return indices_.size ();
   }
@@ -33,46 +33,31 @@
   * \todo Change the internal representation of the line model from 2 points to 1 point + direction.
   */
 
-#include <Eigen/Core>
-#include <Eigen/QR>
+#include <limits>
 #include <sac_model_line.h>
 
 namespace sample_consensus
 {
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-  /** \brief Get 2 random points as data samples and return them as point indices.
-    * \param iterations the internal number of iterations used by SAC methods
+  /** \brief Get 2 random points as data samples and return them as point indices. The two indices are always
+    * distinct; if there are fewer than 2 indices, samples is left empty.
+    * \param iterations the internal number of iterations used by SAC methods (unused, no retries are needed)
     * \param samples the resultant model samples
     * \note assumes unique points!
     */
   void
     SACModelLine::getSamples (int &iterations, std::vector<int> &samples)
   {
-    samples.resize (2);
-    double trand = indices_.size () / (RAND_MAX + 1.0);
-
-    // Get a random number between 1 and max_indices
-    int idx = (int)(rand () * trand);
-    // Get the index
-    samples[0] = indices_.at (idx);
-
-    // Get a second point which is different than the first
-    int iter = 0;
-    do
+    if (indices_.size () < 2)
     {
-      idx = (int)(rand () * trand);
-      samples[1] = indices_.at (idx);
-      iter++;
+      samples.clear ();
+      return;
+    }
 
-      if (iter > MAX_ITERATIONS_UNIQUE)
-      {
-        ROS_WARN ("[SACModelLine::getSamples] WARNING: Could not select 2 unique points in %d iterations!", MAX_ITERATIONS_UNIQUE);
-        break;
-      }
-      iterations++;
-    } while (samples[1] == samples[0]);
-    iterations--;
-    return;
+    // Draw 2 distinct positions and map them to point indices
+    rng_.sample (indices_.size (), 2, samples);
+    samples[0] = indices_[samples[0]];
+    samples[1] = indices_[samples[1]];
   }
 
  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -86,46 +71,45 @@ namespace sample_consensus
   void
     SACModelLine::selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers)
   {
-    double sqr_threshold = threshold * threshold;
-
-    int nr_p = 0;
-    inliers.resize (indices_.size ());
-
-    // Obtain the line direction
-    geometry_msgs::Point32 p3, p4;
-    p3.x = model_coefficients.at (3) - model_coefficients.at (0);
-    p3.y = model_coefficients.at (4) - model_coefficients.at (1);
-    p3.z = model_coefficients.at (5) - model_coefficients.at (2);
-
-    // Iterate through the 3d points and calculate the distances from them to the plane
-    for (unsigned int i = 0; i < indices_.size (); i++)
+    // The line as a point and a unit direction, so that the squared distance is just the squared norm of a cross product
+    float line_point[3], line_dir[3];
+    if (!kernels::lineFromCoefficients (model_coefficients, line_point, line_dir))
     {
-      // Calculate the distance from the point to the line
-      // D = ||(P2-P1) x (P1-P0)|| / ||P2-P1|| = norm (cross (p2-p1, p2-p0)) / norm(p2-p1)
-      // P1, P2 = line points, P0 = query point
-      // P1P2 = <x2-x1, y2-y1, z2-z1> = <x3, y3, z3>
-      // P1P0 = < x-x1,  y-y1, z-z1 > = <x4, y4, z4>
-      // P1P2 x P1P0 = < y3*z4 - z3*y4, -(x3*z4 - x4*z3), x3*y4 - x4*y3 >
-      //             = < (y2-y1)*(z-z1) - (z2-z1)*(y-y1), -[(x2-x1)*(z-z1) - (x-x1)*(z2-z1)], (x2-x1)*(y-y1) - (x-x1)*(y2-y1) >
-      p4.x = model_coefficients.at (3) - cloud_->points.at (indices_.at (i)).x;
-      p4.y = model_coefficients.at (4) - cloud_->points.at (indices_.at (i)).y;
-      p4.z = model_coefficients.at (5) - cloud_->points.at (indices_.at (i)).z;
+      inliers.clear ();
+      return;
+    }
+    kernels::selectLineInliers (points_, indices_, line_point, line_dir, threshold * threshold, inliers);
+  }
 
-      // P1P2 = sqrt (x3^2 + y3^2 + z3^2)
-      // a = sqrt [(y3*z4 - z3*y4)^2 + (x3*z4 - x4*z3)^2 + (x3*y4 - x4*y3)^2]
-      //double distance = SQR_NORM (cANN::cross (p4, p3)) / SQR_NORM (p3);
-      geometry_msgs::Point32 c = cross (p4, p3);
-      double sqr_distance = (c.x * c.x + c.y * c.y + c.z * c.z) / (p3.x * p3.x + p3.y * p3.y + p3.z * p3.z);
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Count all the points which respect the given model coefficients as inliers, without storing them.
+    * \param model_coefficients the coefficients of a line model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    */
+  int
+    SACModelLine::countWithinDistance (const std::vector<double> &model_coefficients, double threshold)
+  {
+    float line_point[3], line_dir[3];
+    if (!kernels::lineFromCoefficients (model_coefficients, line_point, line_dir))
+      return (0);
+    return (kernels::countLineInliers (points_, line_point, line_dir, threshold * threshold));
+  }
 
-      if (sqr_distance < sqr_threshold)
-      {
-        // Returns the indices of the points whose squared distances are smaller than the threshold
-        inliers[nr_p] = indices_[i];
-        nr_p++;
-      }
-    }
-    inliers.resize (nr_p);
-    return;
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Count the points out of a given subset which respect the given model coefficients as inliers. Uses the
+    * same arithmetic as selectWithinDistance, so the count always matches the size of the inlier list, but only reads
+    * the point cloud, so it can be called from several threads at once.
+    * \param model_coefficients the coefficients of a line model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    * \param indices the point cloud indices that need to be tested
+    */
+  int
+    SACModelLine::countWithinDistance (const std::vector<double> &model_coefficients, double threshold, const std::vector<int> &indices)
+  {
+    float line_point[3], line_dir[3];
+    if (!kernels::lineFromCoefficients (model_coefficients, line_point, line_dir))
+      return (0);
+    return (kernels::countLineInliers (*cloud_, indices, line_point, line_dir, threshold * threshold));
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -136,27 +120,14 @@ namespace sample_consensus
   void
     SACModelLine::getDistancesToModel (const std::vector<double> &model_coefficients, std::vector<double> &distances)
   {
-    distances.resize (indices_.size ());
-
-    // Obtain the line direction
-    geometry_msgs::Point32 p3, p4;
-    p3.x = model_coefficients.at (3) - model_coefficients.at (0);
-    p3.y = model_coefficients.at (4) - model_coefficients.at (1);
-    p3.z = model_coefficients.at (5) - model_coefficients.at (2);
-
-    // Iterate through the 3d points and calculate the distances from them to the plane
-    for (unsigned int i = 0; i < indices_.size (); i++)
+    float line_point[3], line_dir[3];
+    if (!kernels::lineFromCoefficients (model_coefficients, line_point, line_dir))
     {
-      // Calculate the distance from the point to the line
-      // D = ||(P2-P1) x (P1-P0)|| / ||P2-P1|| = norm (cross (p2-p1, p2-p0)) / norm(p2-p1)
-      p4.x = model_coefficients.at (3) - cloud_->points.at (indices_.at (i)).x;
-      p4.y = model_coefficients.at (4) - cloud_->points.at (indices_.at (i)).y;
-      p4.z = model_coefficients.at (5) - cloud_->points.at (indices_.at (i)).z;
-
-      geometry_msgs::Point32 c = cross (p4, p3);
-      distances[i] = sqrt (c.x * c.x + c.y * c.y + c.z * c.z) / (p3.x * p3.x + p3.y * p3.y + p3.z * p3.z);
+      // No line through two identical points
+      distances.assign (indices_.size (), std::numeric_limits<double>::quiet_NaN ());
+      return;
     }
-    return;
+    kernels::lineDistances (points_, line_point, line_dir, distances);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -229,6 +200,8 @@ namespace sample_consensus
       cloud_->points.at (inliers.at (i)).y = model_coefficients_.at (1) + k * p21.y;
       cloud_->points.at (inliers.at (i)).z = model_coefficients_.at (2) + k * p21.z;
     }
+    // The projected points may be part of indices_
+    points_.gather (*cloud_, indices_);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -269,25 +242,18 @@ namespace sample_consensus
 
     refit_coefficients.resize (6);
 
-    // Compute the centroid of the samples
-    geometry_msgs::Point32 centroid;
-    // Compute the 3x3 covariance matrix
-    Eigen::Matrix3d covariance_matrix;
-    computeCovarianceMatrix (*cloud_, inliers, covariance_matrix, centroid);
+    // The least-squares line goes through the centroid, along the principal direction of the inliers
+    PointsSoA points;
+    points.gather (*cloud_, inliers);
+    double centroid[3], covariance[6], eigen_values[3], eigen_vectors[3][3];
+    kernels::computeCovariance (points, centroid, covariance);
+    kernels::solveSymmetric3 (covariance, eigen_values, eigen_vectors);
 
-    refit_coefficients[0] = centroid.x;
-    refit_coefficients[1] = centroid.y;
-    refit_coefficients[2] = centroid.z;
-
-    // Extract the eigenvalues and eigenvectors
-    //cloud_geometry::eigen_cov (covariance_matrix, eigen_values, eigen_vectors);
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> ei_symm (covariance_matrix.cast<float> ());
-    Eigen::Vector3f eigen_values  = ei_symm.eigenvalues ();
-    Eigen::Matrix3f eigen_vectors = ei_symm.eigenvectors ();
-
-    refit_coefficients[3] = eigen_vectors (0, 2) + refit_coefficients[0];
-    refit_coefficients[4] = eigen_vectors (1, 2) + refit_coefficients[1];
-    refit_coefficients[5] = eigen_vectors (2, 2) + refit_coefficients[2];
+    for (int d = 0; d < 3; d++)
+    {
+      refit_coefficients[d]     = centroid[d];
+      refit_coefficients[d + 3] = centroid[d] + eigen_vectors[2][d];
+    }
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <cmath>
+#include <limits>
+#include <sac_model_plane.h>
+
+namespace sample_consensus
+{
+  /** \brief Maximum number of draws when looking for 3 points which are not collinear */
+  static const int MAX_ITERATIONS_COLLINEAR = 100;
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Convert the plane coefficients to single precision, for the kernels. */
+  static inline void
+    toFloat (const std::vector<double> &model_coefficients, float plane[4])
+  {
+    for (int d = 0; d < 4; d++)
+      plane[d] = model_coefficients.at (d);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Compute the (unnormalized) normal of the plane through 3 points and return its squared norm. */
+  static inline double
+    sampleNormal (const geometry_msgs::Point32 &p0, const geometry_msgs::Point32 &p1, const geometry_msgs::Point32 &p2, double n[3])
+  {
+    double a[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+    double b[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+    n[0] = a[1] * b[2] - a[2] * b[1];
+    n[1] = a[2] * b[0] - a[0] * b[2];
+    n[2] = a[0] * b[1] - a[1] * b[0];
+    return (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Get 3 random points (which are not collinear, if possible) as data samples and return them as point
+    * indices. If there are fewer than 3 indices, samples is left empty.
+    * \param iterations the internal number of iterations used by SAC methods (unused)
+    * \param samples the resultant model samples
+    */
+  void
+    SACModelPlane::getSamples (int &iterations, std::vector<int> &samples)
+  {
+    if (indices_.size () < 3)
+    {
+      samples.clear ();
+      return;
+    }
+
+    double n[3];
+    for (int iter = 0; iter < MAX_ITERATIONS_COLLINEAR; iter++)
+    {
+      rng_.sample (indices_.size (), 3, samples);
+      for (int d = 0; d < 3; d++)
+        samples[d] = indices_[samples[d]];
+      if (sampleNormal (cloud_->points[samples[0]], cloud_->points[samples[1]], cloud_->points[samples[2]], n) > 0.0)
+        return;
+    }
+    // Give up and let computeModelCoefficients reject the sample
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Select all the points which respect the given model coefficients as inliers.
+    * \param model_coefficients the coefficients of a plane model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    * \param inliers the resultant model inliers
+    */
+  void
+    SACModelPlane::selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers)
+  {
+    float plane[4];
+    toFloat (model_coefficients, plane);
+    kernels::selectPlaneInliers (points_, indices_, plane, threshold, inliers);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Count all the points which respect the given model coefficients as inliers, without storing them.
+    * \param model_coefficients the coefficients of a plane model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    */
+  int
+    SACModelPlane::countWithinDistance (const std::vector<double> &model_coefficients, double threshold)
+  {
+    float plane[4];
+    toFloat (model_coefficients, plane);
+    return (kernels::countPlaneInliers (points_, plane, threshold));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Count the points out of a given subset which respect the given model coefficients as inliers.
+    * \param model_coefficients the coefficients of a plane model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    * \param indices the point cloud indices that need to be tested
+    */
+  int
+    SACModelPlane::countWithinDistance (const std::vector<double> &model_coefficients, double threshold, const std::vector<int> &indices)
+  {
+    float plane[4];
+    toFloat (model_coefficients, plane);
+    return (kernels::countPlaneInliers (*cloud_, indices, plane, threshold));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Compute all distances from the cloud data to a given plane model.
+    * \param model_coefficients the coefficients of a plane model that we need to compute distances to
+    * \param distances the resultant estimated distances
+    */
+  void
+    SACModelPlane::getDistancesToModel (const std::vector<double> &model_coefficients, std::vector<double> &distances)
+  {
+    float plane[4];
+    toFloat (model_coefficients, plane);
+    kernels::planeDistances (points_, plane, distances);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Create a new point cloud with inliers projected onto the plane model.
+    * \param inliers the data inliers that we want to project on the plane model
+    * \param model_coefficients the coefficients of a plane model
+    * \param projected_points the resultant projected points
+    */
+  void
+    SACModelPlane::projectPoints (const std::vector<int> &inliers, const std::vector<double> &model_coefficients,
+                                  sensor_msgs::PointCloud &projected_points)
+  {
+    // Allocate enough space
+    projected_points.points.resize (inliers.size ());
+    projected_points.set_channels_size (cloud_->get_channels_size ());
+
+    // Create the channels
+    for (unsigned int d = 0; d < projected_points.get_channels_size (); d++)
+    {
+      projected_points.channels[d].name = cloud_->channels[d].name;
+      projected_points.channels[d].values.resize (inliers.size ());
+    }
+
+    for (unsigned int i = 0; i < inliers.size (); i++)
+    {
+      const geometry_msgs::Point32 &p = cloud_->points[inliers[i]];
+      // Signed distance to the plane, then move the point along the normal
+      double k = model_coefficients.at (0) * p.x + model_coefficients.at (1) * p.y + model_coefficients.at (2) * p.z + model_coefficients.at (3);
+      projected_points.points[i].x = p.x - k * model_coefficients[0];
+      projected_points.points[i].y = p.y - k * model_coefficients[1];
+      projected_points.points[i].z = p.z - k * model_coefficients[2];
+      // Copy the other attributes
+      for (unsigned int d = 0; d < projected_points.get_channels_size (); d++)
+        projected_points.channels[d].values[i] = cloud_->channels[d].values[inliers[i]];
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Project inliers (in place) onto the given plane model.
+    * \param inliers the data inliers that we want to project on the plane model
+    * \param model_coefficients the coefficients of a plane model
+    */
+  void
+    SACModelPlane::projectPointsInPlace (const std::vector<int> &inliers, const std::vector<double> &model_coefficients)
+  {
+    for (unsigned int i = 0; i < inliers.size (); i++)
+    {
+      geometry_msgs::Point32 &p = cloud_->points.at (inliers[i]);
+      double k = model_coefficients.at (0) * p.x + model_coefficients.at (1) * p.y + model_coefficients.at (2) * p.z + model_coefficients.at (3);
+      p.x -= k * model_coefficients[0];
+      p.y -= k * model_coefficients[1];
+      p.z -= k * model_coefficients[2];
+    }
+    // The projected points may be part of indices_
+    points_.gather (*cloud_, indices_);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Check whether the given index samples can form a valid plane model, compute the model coefficients from
+    * these samples and store them internally in model_coefficients_. If the samples are collinear, the coefficients
+    * are set to NaN, so that no point is found within any distance of them.
+    * \param samples the point indices found as possible good candidates for creating a valid model
+    */
+  bool
+    SACModelPlane::computeModelCoefficients (const std::vector<int> &samples)
+  {
+    model_coefficients_.resize (4);
+
+    const geometry_msgs::Point32 &p0 = cloud_->points.at (samples.at (0));
+    double n[3];
+    double sqr_norm = sampleNormal (p0, cloud_->points.at (samples.at (1)), cloud_->points.at (samples.at (2)), n);
+    if (sqr_norm == 0.0)
+    {
+      model_coefficients_.assign (4, std::numeric_limits<double>::quiet_NaN ());
+      return (false);
+    }
+
+    double norm = sqrt (sqr_norm);
+    for (int d = 0; d < 3; d++)
+      model_coefficients_[d] = n[d] / norm;
+    model_coefficients_[3] = -1 * (model_coefficients_[0] * p0.x + model_coefficients_[1] * p0.y + model_coefficients_[2] * p0.z);
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Recompute the plane coefficients using the given inlier set and return them to the user.
+    * @note: these are the coefficients of the plane model after refinement (least-squares)
+    * \param inliers the data inliers found as supporting the model
+    * \param refit_coefficients the resultant recomputed coefficients
+    */
+  void
+    SACModelPlane::refitModel (const std::vector<int> &inliers, std::vector<double> &refit_coefficients)
+  {
+    if (inliers.size () < 3)
+    {
+      ROS_ERROR ("[SACModelPlane::RefitModel] Cannot re-fit %d inliers!", (int)inliers.size ());
+      refit_coefficients = model_coefficients_;
+      return;
+    }
+
+    refit_coefficients.resize (4);
+
+    // The least-squares plane goes through the centroid; its normal is the direction of least variance
+    PointsSoA points;
+    points.gather (*cloud_, inliers);
+    double centroid[3], covariance[6], eigen_values[3], eigen_vectors[3][3];
+    kernels::computeCovariance (points, centroid, covariance);
+    kernels::solveSymmetric3 (covariance, eigen_values, eigen_vectors);
+
+    for (int d = 0; d < 3; d++)
+      refit_coefficients[d] = eigen_vectors[0][d];
+    // Hessian form (D = nc . p_plane (centroid here) + p)
+    refit_coefficients[3] = -1 * (refit_coefficients[0] * centroid[0] + refit_coefficients[1] * centroid[1] + refit_coefficients[2] * centroid[2]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Verify whether a subset of indices verifies the internal plane model coefficients, i.e., whether all the
+    * points are within the given distance of the plane.
+    * \param indices the data indices that need to be tested against the plane model
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    */
+  bool
+    SACModelPlane::doSamplesVerifyModel (const std::set<int> &indices, double threshold)
+  {
+    for (std::set<int>::iterator it = indices.begin (); it != indices.end (); ++it)
+    {
+      const geometry_msgs::Point32 &p = cloud_->points.at (*it);
+      double distance = model_coefficients_.at (0) * p.x + model_coefficients_.at (1) * p.y + model_coefficients_.at (2) * p.z + model_coefficients_.at (3);
+      if (fabs (distance) > threshold)
+        return (false);
+    }
+    return (true);
+  }
+}
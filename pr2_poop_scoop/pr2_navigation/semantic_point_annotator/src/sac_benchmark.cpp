@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/**
+@b sac_benchmark compares the SAmple Consensus estimators on recorded tilt laser scans. Each sensor_msgs/PointCloud
+message read from the bag is one scan; the dominant line is fitted to it, as sac_inc_ground_removal does, with every
+method in turn and with the same random seed, so runs are reproducible. No ROS master is needed.
+
+Usage: sac_benchmark <data.bag> [topic [distance_threshold [max_iterations]]]
+
+For each method the average number of trials, the time per scan, the number of inliers and the RMS distance of the
+inliers to the least-squares refined line are reported. For PROSAC the points are ordered by their distance to the
+ground (|z|), as sac_inc_ground_removal does.
+ **/
+
+#include <cstdio>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud.h>
+// Sample Consensus
+#include <sac.h>
+#include <sac_methods.h>
+#include <sac_model_line.h>
+// PROSAC ordering shared with the ground removal nodes
+#include <cloud_pipeline.h>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+/** \brief The random seed (plus the scan number) used for each method */
+static const unsigned int BENCHMARK_SEED = 42;
+
+static const char *METHOD_NAMES[] = { "RANSAC", "RRANSAC", "PROSAC", "LO-RANSAC" };
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/** \brief Compute the RMS distance of a set of points to a line given by two of its points
+  * \param points the point cloud
+  * \param indices the indices of the points to use
+  * \param line_coefficients the line, as (x1, y1, z1, x2, y2, z2)
+  */
+double
+  rmsDistanceToLine (const sensor_msgs::PointCloud &points, const vector<int> &indices, const vector<double> &line_coefficients)
+{
+  if (indices.size () == 0)
+    return (0.0);
+  double dx = line_coefficients[3] - line_coefficients[0], dy = line_coefficients[4] - line_coefficients[1], dz = line_coefficients[5] - line_coefficients[2];
+  double sqr_norm = dx * dx + dy * dy + dz * dz;
+  double sum = 0.0;
+  for (unsigned int i = 0; i < indices.size (); i++)
+  {
+    const geometry_msgs::Point32 &p = points.points[indices[i]];
+    double px = p.x - line_coefficients[0], py = p.y - line_coefficients[1], pz = p.z - line_coefficients[2];
+    double cx = py * dz - pz * dy, cy = pz * dx - px * dz, cz = px * dy - py * dx;
+    sum += (cx * cx + cy * cy + cz * cz) / sqr_norm;
+  }
+  return (sqrt (sum / indices.size ()));
+}
+
+/* ---[ */
+int
+  main (int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    printf ("Usage: %s <data.bag> [topic [distance_threshold [max_iterations]]]\n", argv[0]);
+    return (1);
+  }
+  ros::Time::init ();
+
+  string topic = argc > 2 ? argv[2] : "tilt_laser_cloud_filtered";
+  double threshold = argc > 3 ? atof (argv[3]) : 0.015;
+  int max_iterations = argc > 4 ? atoi (argv[4]) : 200;
+
+  // Read the scans
+  vector<sensor_msgs::PointCloud> scans;
+  try
+  {
+    rosbag::Bag bag (argv[1]);
+    vector<string> topics;
+    topics.push_back (topic);
+    topics.push_back ("/" + topic);
+    rosbag::View view (bag, rosbag::TopicQuery (topics));
+    BOOST_FOREACH (const rosbag::MessageInstance &m, view)
+    {
+      sensor_msgs::PointCloud::ConstPtr scan = m.instantiate<sensor_msgs::PointCloud> ();
+      if (scan && scan->points.size () >= 2)
+        scans.push_back (*scan);
+    }
+  }
+  catch (rosbag::BagException &ex)
+  {
+    ROS_ERROR ("Unable to read %s: %s", argv[1], ex.what ());
+    return (1);
+  }
+  if (scans.size () == 0)
+  {
+    ROS_ERROR ("No scans found on topic %s.", topic.c_str ());
+    return (1);
+  }
+  ROS_INFO ("Read %d scans from %s.", (int)scans.size (), argv[1]);
+
+  printf ("%-10s %10s %10s %10s %10s %10s\n", "method", "found", "trials", "ms/scan", "inliers", "rms [mm]");
+  for (int method = SAC_RANSAC; method <= SAC_LORANSAC; method++)
+  {
+    int n_found = 0;
+    double trials = 0, seconds = 0, inliers = 0, rms = 0;
+
+    for (unsigned int s = 0; s < scans.size (); s++)
+    {
+      sensor_msgs::PointCloud &scan = scans[s];
+      vector<int> indices (scan.points.size ());
+      for (unsigned int i = 0; i < indices.size (); i++)
+        indices[i] = i;
+      if (method == SAC_PROSAC)
+        sort (indices.begin (), indices.end (), semantic_point_annotator::CloserToGround (&scan));
+
+      sample_consensus::SACModelLine model;
+      sample_consensus::SAC *sac = sample_consensus::createSAC (method, &model, threshold);
+      sac->setMaxIterations (max_iterations);
+      sac->setProbability (0.99);
+      model.setDataSet (&scan, indices);
+      model.setRandomSeed (BENCHMARK_SEED + s);
+
+      ros::WallTime t1 = ros::WallTime::now ();
+      bool found = sac->computeModel (0);
+      seconds += (ros::WallTime::now () - t1).toSec ();
+      trials += sac->getIterations ();
+
+      if (found)
+      {
+        vector<double> line_coeff;
+        vector<int> line_inliers;
+        sac->computeCoefficients (line_coeff);
+        sac->refineCoefficients (line_coeff);
+        model.selectWithinDistance (line_coeff, threshold, line_inliers);
+        n_found++;
+        inliers += line_inliers.size ();
+        rms += rmsDistanceToLine (scan, line_inliers, line_coeff);
+      }
+      delete sac;
+    }
+
+    printf ("%-10s %10d %10.1f %10.3f %10.1f %10.3f\n", METHOD_NAMES[method], n_found, trials / scans.size (),
+            seconds * 1000.0 / scans.size (), n_found ? inliers / n_found : 0.0, n_found ? rms * 1000.0 / n_found : 0.0);
+  }
+
+  return (0);
+}
+/* ]--- */
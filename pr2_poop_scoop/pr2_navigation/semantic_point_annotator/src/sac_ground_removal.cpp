@@ -43,29 +43,21 @@
 #include <ros/ros.h>
 // ROS messages
 #include <sensor_msgs/PointCloud.h>
-#include <geometry_msgs/Polygon.h>
-#include <mapping_msgs/PolygonalMap.h>
 
 // Sample Consensus
-#include <point_cloud_mapping/sample_consensus/sac.h>
-#include <point_cloud_mapping/sample_consensus/msac.h>
-#include <point_cloud_mapping/sample_consensus/ransac.h>
-#include <point_cloud_mapping/sample_consensus/lmeds.h>
-#include <point_cloud_mapping/sample_consensus/sac_model_line.h>
-
-// Cloud geometry
-#include <point_cloud_mapping/geometry/angles.h>
-#include <point_cloud_mapping/geometry/areas.h>
-#include <point_cloud_mapping/geometry/point.h>
-#include <point_cloud_mapping/geometry/distances.h>
-#include <point_cloud_mapping/geometry/nearest.h>
+#include <sac.h>
+#include <ransac.h>
+#include <sac_model_line.h>
+#include <sac_model_plane.h>
+
+// Helpers shared with the other ground removal nodes
+#include <cloud_pipeline.h>
 
 #include <tf/transform_listener.h>
 
 #include <sys/time.h>
 
 using namespace std;
-using namespace mapping_msgs;
 
 class GroundRemoval
 {
@@ -85,6 +77,7 @@ class GroundRemoval
     int sac_min_points_per_model_, sac_max_iterations_;
     double sac_distance_threshold_;
     int planar_refine_;
+    std::string robot_footprint_frame_, laser_tilt_mount_frame_;
 
     ros::Publisher cloud_publisher_;
     ros::Subscriber cloud_subscriber_;
@@ -98,6 +91,8 @@ class GroundRemoval
       node_.param ("planar_refine", planar_refine_, 1);                        // enable a final planar refinement step?
       node_.param ("sac_min_points_per_model", sac_min_points_per_model_, 6);  // 6 points minimum per line
       node_.param ("sac_max_iterations", sac_max_iterations_, 200);            // maximum 200 iterations
+      node_.param ("robot_footprint_frame", robot_footprint_frame_, std::string("base_footprint"));
+      node_.param ("laser_tilt_mount_frame", laser_tilt_mount_frame_, std::string("laser_tilt_mount_link"));
 
       string cloud_topic ("full_cloud");
 
@@ -127,52 +122,6 @@ class GroundRemoval
       if (node_.hasParam ("sac_distance_threshold")) node_.getParam ("sac_distance_threshold", sac_distance_threshold_);
     }
 
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Decompose a PointCloud message into LaserScan clusters
-      * \param points pointer to the point cloud message
-      * \param indices pointer to a list of point indices
-      * \param clusters the resultant clusters
-      * \param idx the index of the channel containing the laser scan index
-      */
-    void
-      splitPointsBasedOnLaserScanIndex (sensor_msgs::PointCloud *points, vector<int> *indices, vector<vector<int> > &clusters, int idx)
-    {
-      vector<int> seed_queue;
-      int prev_idx = -1;
-      // Process all points in the indices vector
-      for (unsigned int i = 0; i < indices->size (); i++)
-      {
-        // Get the current laser scan measurement index
-        int cur_idx = points->channels[idx].values.at (indices->at (i));
-
-        if (cur_idx > prev_idx)   // Still the same laser scan ?
-        {
-          seed_queue.push_back (indices->at (i));
-          prev_idx = cur_idx;
-        }
-        else                      // Have we found a new scan ?
-        {
-          prev_idx = -1;
-          vector<int> r;
-          r.resize (seed_queue.size ());
-          for (unsigned int j = 0; j < r.size (); j++)
-            r[j] = seed_queue[j];
-          clusters.push_back (r);
-          seed_queue.resize (0);
-          seed_queue.push_back (indices->at (i));
-        }
-      }
-      // Copy the last laser scan as well
-      if (seed_queue.size () > 0)
-      {
-        vector<int> r;
-        r.resize (seed_queue.size ());
-        for (unsigned int j = 0; j < r.size (); j++)
-          r[j] = seed_queue[j];
-        clusters.push_back (r);
-      }
-    }
-
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /** \brief Find a line model in a point cloud given via a set of point indices with SAmple Consensus methods
       * \param points the point cloud message
@@ -217,6 +166,36 @@ class GroundRemoval
       return (true);
     }
 
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Find the ground plane supported by the line inliers with SAmple Consensus methods, so that lines
+      * fitted to the odd obstacle scan do not tilt it, and refine it using least-squares.
+      * \param points the point cloud message
+      * \param indices a pointer to a set of point cloud indices to test
+      * \param plane_parameters the resultant plane parameters as: a, b, c, d (ax + by + cz + d = 0)
+      */
+    bool
+      fitSACPlane (sensor_msgs::PointCloud *points, vector<int> *indices, Eigen::Vector4d &plane_parameters)
+    {
+      if (indices->size () < 3)
+        return (false);
+
+      sample_consensus::SACModelPlane model;
+      sample_consensus::RANSAC sac (&model, sac_distance_threshold_);
+      sac.setMaxIterations (sac_max_iterations_);
+      sac.setProbability (0.99);
+
+      model.setDataSet (points, *indices);
+      if (!sac.computeModel (0))
+        return (false);
+
+      vector<double> plane_coeff;
+      sac.computeCoefficients (plane_coeff);
+      sac.refineCoefficients (plane_coeff);
+      for (int d = 0; d < 4; d++)
+        plane_parameters (d) = plane_coeff[d];
+      return (true);
+    }
+
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Callback
     void cloud_cb (const sensor_msgs::PointCloudConstPtr& msg)
@@ -226,12 +205,12 @@ class GroundRemoval
       if (cloud_.points.empty ())
       {
         ROS_DEBUG("Received an empty point cloud");
-        cloud_publisher_.publsih(msg);
+        cloud_publisher_.publish (msg);
         return;
       }
 
-      ROS_INFO ("Received %d data points with %d channels (%s).", (int)cloud_.points.size (), (int)cloud_.channels.size (), cloud_geometry::getAvailableChannels (cloud_).c_str ());
-      int idx_idx = cloud_geometry::getChannelIndex (cloud_, "index");
+      ROS_INFO ("Received %d data points with %d channels (%s).", (int)cloud_.points.size (), (int)cloud_.channels.size (), semantic_point_annotator::getAvailableChannels (cloud_).c_str ());
+      int idx_idx = semantic_point_annotator::getChannelIndex (cloud_, "index");
       if (idx_idx == -1)
       {
         ROS_ERROR ("Channel 'index' missing in input PointCloud message!");
@@ -248,10 +227,10 @@ class GroundRemoval
       gettimeofday (&t1, NULL);
 
       // Get the cloud viewpoint
-      getCloudViewPoint (cloud_.header.frame_id, viewpoint_cloud_, &tf_);
+      semantic_point_annotator::getCloudViewPoint (&tf_, laser_tilt_mount_frame_, cloud_.header.frame_id, viewpoint_cloud_);
 
       // Transform z_threshold_ from the parameter parameter frame (parameter_frame_) into the point cloud frame
-      z_threshold_ = transformDoubleValueTF (z_threshold_, "base_footprint", cloud_.header.frame_id, cloud_.header.stamp, &tf_);
+      double z_threshold_cloud = semantic_point_annotator::transformDoubleValueTF (z_threshold_, robot_footprint_frame_, cloud_.header.frame_id, cloud_.header.stamp, &tf_);
 
       // Select points whose Z dimension is close to the ground (0,0,0 in base_footprint)
       vector<int> possible_ground_indices (cloud_.points.size ());
@@ -260,7 +239,7 @@ class GroundRemoval
       for (unsigned int cp = 0; cp < cloud_.points.size (); cp++)
       {
         all_indices[cp] = cp;
-        if (fabs (cloud_.points[cp].z) < z_threshold_)
+        if (fabs (cloud_.points[cp].z) < z_threshold_cloud)
         {
           possible_ground_indices[nr_p] = cp;
           nr_p++;
@@ -272,7 +251,7 @@ class GroundRemoval
 
       vector<vector<int> > clusters;
       // Split the points into clusters based on their laser scan information
-      splitPointsBasedOnLaserScanIndex (&cloud_, &possible_ground_indices, clusters, idx_idx);
+      semantic_point_annotator::splitPointsBasedOnLaserScanIndex (cloud_, possible_ground_indices, clusters, idx_idx);
 
       ROS_INFO ("Number of clusters: %d", (int)clusters.size ());
 
@@ -312,20 +291,16 @@ class GroundRemoval
         set_difference (possible_ground_indices.begin (), possible_ground_indices.end (), ground_inliers.begin (), ground_inliers.end (),
                         inserter (remaining_possible_ground_indices, remaining_possible_ground_indices.begin ()));
 
-        // Estimate the plane from the line inliers
-        Eigen::Vector4d plane_parameters;
-        double curvature;
-        cloud_geometry::nearest::computePointNormal (cloud_, ground_inliers, plane_parameters, curvature);
-
         //make sure that there are inliers to refine
-        if (!ground_inliers.empty ())
+        Eigen::Vector4d plane_parameters;
+        if (fitSACPlane (&cloud_, &ground_inliers, plane_parameters))
         {
-          cloud_geometry::angles::flipNormalTowardsViewpoint (plane_parameters, cloud_.points.at (ground_inliers[0]), viewpoint_cloud_);
+          semantic_point_annotator::flipNormalTowardsViewpoint (plane_parameters, cloud_.points.at (ground_inliers[0]), viewpoint_cloud_);
 
           // Compute the distance from the remaining points to the model plane, and add to the inliers list if they are below
           for (unsigned int i = 0; i < remaining_possible_ground_indices.size (); i++)
           {
-            double distance_to_ground  = cloud_geometry::distances::pointToPlaneDistanceSigned (cloud_.points.at (remaining_possible_ground_indices[i]), plane_parameters);
+            double distance_to_ground  = semantic_point_annotator::pointToPlaneDistanceSigned (cloud_.points.at (remaining_possible_ground_indices[i]), plane_parameters);
             if (distance_to_ground > 0)
               continue;
             ground_inliers.push_back (remaining_possible_ground_indices[i]);
@@ -390,90 +365,6 @@ class GroundRemoval
                 (int)remaining_indices.size (), time_spent);
       cloud_publisher_.publish (cloud_noground_);
     }
-
-
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Get the view point from where the scans were taken in the incoming PointCloud message frame
-      * \param cloud_frame the point cloud message TF frame
-      * \param viewpoint_cloud the resultant view point in the incoming cloud frame
-      * \param tf a pointer to a TransformListener object
-      */
-    void
-    getCloudViewPoint (string cloud_frame, geometry_msgs::PointStamped &viewpoint_cloud, tf::TransformListener *tf)
-    {
-      // Figure out the viewpoint value in the point cloud frame
-      geometry_msgs::PointStamped viewpoint_laser;
-      viewpoint_laser.header.frame_id = "laser_tilt_mount_link";
-      // Set the viewpoint in the laser coordinate system to 0, 0, 0
-      viewpoint_laser.point.x = viewpoint_laser.point.y = viewpoint_laser.point.z = 0.0;
-
-      try
-      {
-        tf->transformPoint (cloud_frame, viewpoint_laser, viewpoint_cloud);
-        ROS_INFO ("Cloud view point in frame %s is: %g, %g, %g.", cloud_frame.c_str (),
-                  viewpoint_cloud.point.x, viewpoint_cloud.point.y, viewpoint_cloud.point.z);
-      }
-      catch (tf::TransformException& ex)
-      {
-        ROS_WARN ("Could not transform a point from frame %s to frame %s! %s", viewpoint_laser.header.frame_id.c_str (), cloud_frame.c_str (), ex.what());
-        // Default to 0.05, 0, 0.942768
-        viewpoint_cloud.point.x = 0.05; viewpoint_cloud.point.y = 0.0; viewpoint_cloud.point.z = 0.942768;
-      }
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Transform a given point from its current frame to a given target frame
-      * \param tf a pointer to a TransformListener object
-      * \param target_frame the target frame to transform the point into
-      * \param stamped_in the input point
-      * \param stamped_out the output point
-      */
-    inline void
-      transformPoint (tf::TransformListener *tf, const std::string &target_frame,
-                      const tf::Stamped< geometry_msgs::Point32 > &stamped_in, tf::Stamped< geometry_msgs::Point32 > &stamped_out)
-    {
-      tf::Stamped<tf::Point> tmp;
-      tmp.stamp_ = stamped_in.stamp_;
-      tmp.frame_id_ = stamped_in.frame_id_;
-      tmp[0] = stamped_in.x;
-      tmp[1] = stamped_in.y;
-      tmp[2] = stamped_in.z;
-
-      try{
-        tf->transformPoint (target_frame, tmp, tmp);
-      }
-      catch (tf::TransformException& ex)
-      {
-        ROS_ERROR("%s", ex.what());
-      }
-
-      stamped_out.stamp_ = tmp.stamp_;
-      stamped_out.frame_id_ = tmp.frame_id_;
-      stamped_out.x = tmp[0];
-      stamped_out.y = tmp[1];
-      stamped_out.z = tmp[2];
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Transform a value from a source frame to a target frame at a certain moment in time with TF
-      * \param val the value to transform
-      * \param src_frame the source frame to transform the value from
-      * \param tgt_frame the target frame to transform the value into
-      * \param stamp a given time stamp
-      * \param tf a pointer to a TransformListener object
-      */
-    inline double
-      transformDoubleValueTF (double val, std::string src_frame, std::string tgt_frame, ros::Time stamp, tf::TransformListener *tf)
-    {
-      geometry_msgs::Point32 temp;
-      temp.x = temp.y = 0;
-      temp.z = val;
-      tf::Stamped<geometry_msgs::Point32> temp_stamped (temp, stamp, src_frame);
-      transformPoint (tf, tgt_frame, temp_stamped, temp_stamped);
-      return (temp_stamped.z);
-    }
-
 };
 
 /* ---[ */
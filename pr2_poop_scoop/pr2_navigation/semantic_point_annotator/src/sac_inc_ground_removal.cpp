@@ -51,12 +51,8 @@
 #include <point_cloud_mapping/sample_consensus/lmeds.h>
 #include <point_cloud_mapping/sample_consensus/sac_model_line.h>
 
-// Cloud geometry
-#include <point_cloud_mapping/geometry/areas.h>
-#include <point_cloud_mapping/geometry/angles.h>
-#include <point_cloud_mapping/geometry/point.h>
-#include <point_cloud_mapping/geometry/distances.h>
-#include <point_cloud_mapping/geometry/nearest.h>
+// Helpers shared with the other ground removal nodes
+#include <cloud_pipeline.h>
 
 #include <tf/transform_listener.h>
 #include "tf/message_filter.h"
@@ -67,7 +63,6 @@
 #include <boost/thread.hpp>
 
 using namespace std;
-using namespace mapping_msgs;
 
 class IncGroundRemoval
 {
@@ -150,51 +145,6 @@ class IncGroundRemoval
       node_.getParam ("sac_distance_threshold", sac_distance_threshold_);
     }
 
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Decompose a PointCloud message into LaserScan clusters
-      * \param points pointer to the point cloud message
-      * \param indices pointer to a list of point indices
-      * \param clusters the resultant clusters
-      * \param idx the index of the channel containing the laser scan index
-      */
-    void
-      splitPointsBasedOnLaserScanIndex (sensor_msgs::PointCloud *points, vector<int> *indices, vector<vector<int> > &clusters, int idx)
-    {
-      vector<int> seed_queue;
-      int prev_idx = -1;
-      // Process all points in the indices vector
-      for (unsigned int i = 0; i < indices->size (); i++)
-      {
-        // Get the current laser scan measurement index
-        int cur_idx = points->channels[idx].values.at (indices->at (i));
-
-        if (cur_idx > prev_idx)   // Still the same laser scan ?
-        {
-          seed_queue.push_back (indices->at (i));
-          prev_idx = cur_idx;
-        }
-        else                      // Have we found a new scan ?
-        {
-          prev_idx = -1;
-          vector<int> r;
-          r.resize (seed_queue.size ());
-          for (unsigned int j = 0; j < r.size (); j++)
-            r[j] = seed_queue[j];
-          clusters.push_back (r);
-          seed_queue.resize (0);
-        }
-      }
-      // Copy the last laser scan as well
-      if (seed_queue.size () > 0)
-      {
-        vector<int> r;
-        r.resize (seed_queue.size ());
-        for (unsigned int j = 0; j < r.size (); j++)
-          r[j] = seed_queue[j];
-        clusters.push_back (r);
-      }
-    }
-
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /** \brief Find a line model in a point cloud given via a set of point indices with SAmple Consensus methods
       * \param points the point cloud message
@@ -259,8 +209,8 @@ class IncGroundRemoval
         return;
       }
 
-      ROS_DEBUG ("Received %d data points with %d channels (%s).", (int)cloud_.points.size (), (int)cloud_.channels.size (), cloud_geometry::getAvailableChannels (cloud_).c_str ());
-      int idx_idx = cloud_geometry::getChannelIndex (cloud_, "index");
+      ROS_DEBUG ("Received %d data points with %d channels (%s).", (int)cloud_.points.size (), (int)cloud_.channels.size (), semantic_point_annotator::getAvailableChannels (cloud_).c_str ());
+      int idx_idx = semantic_point_annotator::getChannelIndex (cloud_, "index");
       if (idx_idx == -1)
       {
         ROS_ERROR ("Channel 'index' missing in input PointCloud message!");
@@ -277,10 +227,10 @@ class IncGroundRemoval
       gettimeofday (&t1, NULL);
 
       // Get the cloud viewpoint
-      getCloudViewPoint (cloud_.header.frame_id, viewpoint_cloud_, &tf_);
+      semantic_point_annotator::getCloudViewPoint (&tf_, laser_tilt_mount_frame_, cloud_.header.frame_id, viewpoint_cloud_);
 
       // Transform z_threshold_ from the parameter parameter frame (parameter_frame_) into the point cloud frame
-      double z_threshold_cloud = transformDoubleValueTF (z_threshold_, robot_footprint_frame_, cloud_.header.frame_id, cloud_.header.stamp, &tf_);
+      double z_threshold_cloud = semantic_point_annotator::transformDoubleValueTF (z_threshold_, robot_footprint_frame_, cloud_.header.frame_id, cloud_.header.stamp, &tf_);
 
       // Select points whose Z dimension is close to the ground (0,0,0 in base_footprint) or under a gentle slope (allowing for pitch/roll error)
       vector<int> possible_ground_indices (cloud_.points.size ());
@@ -327,17 +277,17 @@ class IncGroundRemoval
         // Estimate the plane from the line inliers
         Eigen::Vector4d plane_parameters;
         double curvature;
-        cloud_geometry::nearest::computePointNormal (cloud_, ground_inliers, plane_parameters, curvature);
+        semantic_point_annotator::computePointNormal (cloud_, ground_inliers, plane_parameters, curvature);
 
         //make sure that there are inliers to refine
         if (!ground_inliers.empty ())
         {
-          cloud_geometry::angles::flipNormalTowardsViewpoint (plane_parameters, cloud_.points.at (ground_inliers[0]), viewpoint_cloud_);
+          semantic_point_annotator::flipNormalTowardsViewpoint (plane_parameters, cloud_.points.at (ground_inliers[0]), viewpoint_cloud_);
 
           // Compute the distance from the remaining points to the model plane, and add to the inliers list if they are below
           for (unsigned int i = 0; i < remaining_possible_ground_indices.size (); i++)
           {
-            double distance_to_ground  = cloud_geometry::distances::pointToPlaneDistanceSigned (cloud_.points.at (remaining_possible_ground_indices[i]), plane_parameters);
+            double distance_to_ground  = semantic_point_annotator::pointToPlaneDistanceSigned (cloud_.points.at (remaining_possible_ground_indices[i]), plane_parameters);
             if (distance_to_ground >= 1e-6){
               continue;
             }
@@ -404,94 +354,6 @@ class IncGroundRemoval
                 (int)remaining_indices.size (), time_spent);
       cloud_publisher_.publish (cloud_noground_);
     }
-
-
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Get the view point from where the scans were taken in the incoming PointCloud message frame
-      * \param cloud_frame the point cloud message TF frame
-      * \param viewpoint_cloud the resultant view point in the incoming cloud frame
-      * \param tf a pointer to a TransformListener object
-      */
-    void
-      getCloudViewPoint (string cloud_frame, geometry_msgs::PointStamped &viewpoint_cloud, tf::TransformListener *tf)
-    {
-      // Figure out the viewpoint value in the point cloud frame
-      geometry_msgs::PointStamped viewpoint_laser;
-      viewpoint_laser.header.frame_id = laser_tilt_mount_frame_;
-      // Set the viewpoint in the laser coordinate system to 0, 0, 0
-      viewpoint_laser.point.x = viewpoint_laser.point.y = viewpoint_laser.point.z = 0.0;
-
-      try
-      {
-        tf->transformPoint (cloud_frame, viewpoint_laser, viewpoint_cloud);
-        ROS_DEBUG ("Cloud view point in frame %s is: %g, %g, %g.", cloud_frame.c_str (),
-                  viewpoint_cloud.point.x, viewpoint_cloud.point.y, viewpoint_cloud.point.z);
-      }
-      catch (tf::ConnectivityException)
-      {
-        ROS_WARN ("Could not transform a point from frame %s to frame %s!", viewpoint_laser.header.frame_id.c_str (), cloud_frame.c_str ());
-        // Default to 0.05, 0, 0.942768
-        viewpoint_cloud.point.x = 0.05; viewpoint_cloud.point.y = 0.0; viewpoint_cloud.point.z = 0.942768;
-      }
-      catch(tf::TransformException &ex){
-        ROS_ERROR("Can't transform viewpoint for ground plan detection");
-        viewpoint_cloud.point.x = 0.05; viewpoint_cloud.point.y = 0.0; viewpoint_cloud.point.z = 0.942768;
-      }
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Transform a given point from its current frame to a given target frame
-      * \param tf a pointer to a TransformListener object
-      * \param target_frame the target frame to transform the point into
-      * \param stamped_in the input point
-      * \param stamped_out the output point
-      */
-    inline void
-      transformPoint (tf::TransformListener *tf, const std::string &target_frame,
-                      const tf::Stamped< geometry_msgs::Point32 > &stamped_in, tf::Stamped< geometry_msgs::Point32 > &stamped_out)
-    {
-      tf::Stamped<tf::Point> tmp;
-      tmp.stamp_ = stamped_in.stamp_;
-      tmp.frame_id_ = stamped_in.frame_id_;
-      tmp[0] = stamped_in.x;
-      tmp[1] = stamped_in.y;
-      tmp[2] = stamped_in.z;
-
-      try{
-        tf->transformPoint (target_frame, tmp, tmp);
-      }
-      catch(tf::TransformException &ex){
-        ROS_ERROR("Can't transform cloud for ground plane detection");
-        return;
-      }
-
-      stamped_out.stamp_ = tmp.stamp_;
-      stamped_out.frame_id_ = tmp.frame_id_;
-      stamped_out.x = tmp[0];
-      stamped_out.y = tmp[1];
-      stamped_out.z = tmp[2];
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Transform a value from a source frame to a target frame at a certain moment in time with TF
-      * \param val the value to transform
-      * \param src_frame the source frame to transform the value from
-      * \param tgt_frame the target frame to transform the value into
-      * \param stamp a given time stamp
-      * \param tf a pointer to a TransformListener object
-      */
-    inline double
-      transformDoubleValueTF (double val, std::string src_frame, std::string tgt_frame, ros::Time stamp, tf::TransformListener *tf)
-    {
-      geometry_msgs::Point32 temp;
-      temp.x = temp.y = 0;
-      temp.z = val;
-      tf::Stamped<geometry_msgs::Point32> temp_stamped (temp, stamp, src_frame);
-      transformPoint (tf, tgt_frame, temp_stamped, temp_stamped);
-      return (temp_stamped.z);
-    }
-
 };
 
 /* ---[ */
@@ -43,11 +43,13 @@
 #include <ros/ros.h>
 // ROS messages
 #include <sensor_msgs/PointCloud.h>
-#include <Eigen/QR>
+#include <Eigen/Core>
 // Sample Consensus
 #include <sac.h>
-#include <ransac.h>
+#include <sac_methods.h>
 #include <sac_model_line.h>
+// Pipeline stages shared with the other ground removal nodes
+#include <cloud_pipeline.h>
 
 #include <tf/transform_listener.h>
 #include "tf/message_filter.h"
@@ -57,8 +59,18 @@
 
 #include <boost/thread.hpp>
 
+#include <deque>
+
 using namespace std;
 
+/** \brief Minimum fraction of the points close to the previous ground plane that the warm started line must explain */
+static const double WARM_START_MIN_INLIER_RATIO = 0.8;
+/** \brief Number of previous scans whose ground lines are used to estimate the ground plane for the warm start */
+static const unsigned int WARM_START_HISTORY = 5;
+/** \brief Minimum spread (standard deviation, in m) of the ground lines across their direction, below which they
+  * are too close to being collinear to define a plane */
+static const double WARM_START_MIN_SPREAD = 0.05;
+
 class IncGroundRemoval
 {
   protected:
@@ -66,24 +78,37 @@ class IncGroundRemoval
 
   public:
 
-    // ROS messages
-    sensor_msgs::PointCloud laser_cloud_, cloud_, cloud_noground_;
-
     tf::TransformListener tf_;
-    geometry_msgs::PointStamped viewpoint_cloud_;
     tf::MessageFilter<sensor_msgs::PointCloud>* cloud_notifier_;
     message_filters::Subscriber<sensor_msgs::PointCloud>* cloud_subscriber_;
   
     // Parameters
     double z_threshold_, ground_slope_threshold_;
-    int sac_min_points_per_model_, sac_max_iterations_;
+    int sac_min_points_per_model_, sac_max_iterations_, sac_method_;
     double sac_distance_threshold_;
     double sac_fitting_distance_threshold_;
-    int planar_refine_;
+    int planar_refine_, warm_start_;
     std::string robot_footprint_frame_, laser_tilt_mount_frame_;
 
     ros::Publisher cloud_publisher_;
 
+    // Sample consensus objects, created once and reused for every scan
+    sample_consensus::SACModelLine line_model_;
+    sample_consensus::SAC *line_sac_;
+
+    // The ground lines of the last scans and the plane through them (in the fixed frame), used to warm start the
+    // line fit of the next scan
+    deque<sample_consensus::PointsSoA> ground_history_;
+    Eigen::Vector4d prev_ground_plane_;
+    bool has_prev_ground_plane_;
+
+    // Scratch buffers reused between scans
+    vector<int> sorted_indices_, warm_start_candidates_;
+
+    // The stages run on every scan, and the buffers they share
+    semantic_point_annotator::CloudPipeline pipeline_;
+    semantic_point_annotator::CloudContext context_;
+
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     IncGroundRemoval (ros::NodeHandle& anode) : node_ (anode)
     {
@@ -95,6 +120,8 @@ class IncGroundRemoval
       node_.param ("planar_refine", planar_refine_, 1);                        // enable a final planar refinement step?
       node_.param ("sac_min_points_per_model", sac_min_points_per_model_, 6);  // 6 points minimum per line
       node_.param ("sac_max_iterations", sac_max_iterations_, 200);            // maximum 200 iterations
+      node_.param ("sac_method", sac_method_, SAC_RANSAC);                     // RANSAC, RRANSAC, PROSAC or LO-RANSAC (see method_types.h)
+      node_.param ("warm_start", warm_start_, 1);                              // try the previous scan's ground plane before sampling?
       node_.param ("robot_footprint_frame", robot_footprint_frame_, std::string("base_footprint"));
       node_.param ("laser_tilt_mount_frame", laser_tilt_mount_frame_, std::string("laser_tilt_mount_link"));
 
@@ -125,10 +152,34 @@ class IncGroundRemoval
 //                        boost::bind (&IncGroundRemoval::cloud_cb, this, _1), cloud_topic, "odom_combined", 50);
 
       cloud_publisher_ = public_node.advertise<sensor_msgs::PointCloud> ("cloud_ground_filtered", 1);
+
+      line_sac_ = sample_consensus::createSAC (sac_method_, &line_model_, sac_fitting_distance_threshold_);
+      if (!line_sac_)
+      {
+        ROS_WARN ("Unknown SAC method %d, using RANSAC.", sac_method_);
+        sac_method_ = SAC_RANSAC;
+        line_sac_ = sample_consensus::createSAC (sac_method_, &line_model_, sac_fitting_distance_threshold_);
+      }
+      line_sac_->setMaxIterations (sac_max_iterations_);
+      line_sac_->setProbability (0.99);
+      has_prev_ground_plane_ = false;
+
+      using namespace semantic_point_annotator;
+      pipeline_.addStage ("transform", TransformCloud (&tf_, "odom_combined"));
+      pipeline_.addStage ("viewpoint", ComputeViewPoint (&tf_, laser_tilt_mount_frame_));
+      pipeline_.addStage ("ground_candidates", SelectGroundCandidates (&tf_, robot_footprint_frame_, z_threshold_, ground_slope_threshold_));
+      pipeline_.addStage ("ground_line", boost::bind (&IncGroundRemoval::fitGroundLine, this, _1));
+      if (planar_refine_ > 0)
+        pipeline_.addStage ("planar_refine", RefineGroundPlane ());
+      pipeline_.addStage ("extract", ExtractOutliers ());
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    virtual ~IncGroundRemoval () { delete cloud_notifier_; }
+    virtual ~IncGroundRemoval ()
+    {
+      delete cloud_notifier_;
+      delete line_sac_;
+    }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     void
@@ -141,48 +192,68 @@ class IncGroundRemoval
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Decompose a PointCloud message into LaserScan clusters
-      * \param points pointer to the point cloud message
-      * \param indices pointer to a list of point indices
-      * \param clusters the resultant clusters
-      * \param idx the index of the channel containing the laser scan index
+    /** \brief Fit the ground line of the current scan without sampling: the ground points of consecutive scans lie
+      * on (nearly) the same plane, so the points close to the previous ground plane are taken as the inliers and the
+      * line is fitted to them with least-squares. The line is only accepted if it explains most of these points.
+      * \param points the point cloud message
+      * \param indices the point cloud indices to test (already set as the data set of the line model)
+      * \param line_coeff the resultant line coefficients
+      */
+    bool
+      warmStartLine (sensor_msgs::PointCloud *points, const vector<int> &indices, vector<double> &line_coeff)
+    {
+      warm_start_candidates_.clear ();
+      for (unsigned int i = 0; i < indices.size (); i++)
+        if (fabs (semantic_point_annotator::pointToPlaneDistanceSigned (points->points[indices[i]], prev_ground_plane_)) < sac_distance_threshold_)
+          warm_start_candidates_.push_back (indices[i]);
+
+      if ((int)warm_start_candidates_.size () < sac_min_points_per_model_)
+        return (false);
+
+      line_model_.refitModel (warm_start_candidates_, line_coeff);
+      int nr_inliers = line_model_.countWithinDistance (line_coeff, sac_fitting_distance_threshold_, warm_start_candidates_);
+      return (nr_inliers >= WARM_START_MIN_INLIER_RATIO * warm_start_candidates_.size ());
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Add the ground line of the current scan to the history and re-estimate the ground plane through the
+      * lines of the last WARM_START_HISTORY scans. A single line does not define a plane, so the warm start is only
+      * enabled once the lines are spread enough, and only if they actually lie on a plane.
+      * \param points the point cloud message
+      * \param line_inliers the inliers of the ground line of the current scan (empty if no line was found)
       */
     void
-      splitPointsBasedOnLaserScanIndex (sensor_msgs::PointCloud *points, vector<int> *indices, vector<vector<int> > &clusters, int idx)
+      updateWarmStartPlane (const sensor_msgs::PointCloud &points, const vector<int> &line_inliers)
     {
-      vector<int> seed_queue;
-      int prev_idx = -1;
-      // Process all points in the indices vector
-      for (unsigned int i = 0; i < indices->size (); i++)
-      {
-        // Get the current laser scan measurement index
-        int cur_idx = points->channels[idx].values.at (indices->at (i));
+      if (line_inliers.empty ())
+        return;
 
-        if (cur_idx > prev_idx)   // Still the same laser scan ?
-        {
-          seed_queue.push_back (indices->at (i));
-          prev_idx = cur_idx;
-        }
-        else                      // Have we found a new scan ?
-        {
-          prev_idx = -1;
-          vector<int> r;
-          r.resize (seed_queue.size ());
-          for (unsigned int j = 0; j < r.size (); j++)
-            r[j] = seed_queue[j];
-          clusters.push_back (r);
-          seed_queue.resize (0);
-        }
-      }
-      // Copy the last laser scan as well
-      if (seed_queue.size () > 0)
+      ground_history_.push_back (sample_consensus::PointsSoA ());
+      ground_history_.back ().gather (points, line_inliers);
+      if (ground_history_.size () > WARM_START_HISTORY)
+        ground_history_.pop_front ();
+
+      sample_consensus::PointsSoA history;
+      for (unsigned int i = 0; i < ground_history_.size (); i++)
       {
-        vector<int> r;
-        r.resize (seed_queue.size ());
-        for (unsigned int j = 0; j < r.size (); j++)
-          r[j] = seed_queue[j];
-        clusters.push_back (r);
+        history.x.insert (history.x.end (), ground_history_[i].x.begin (), ground_history_[i].x.end ());
+        history.y.insert (history.y.end (), ground_history_[i].y.begin (), ground_history_[i].y.end ());
+        history.z.insert (history.z.end (), ground_history_[i].z.begin (), ground_history_[i].z.end ());
       }
+
+      double centroid[3], covariance[6], eigen_values[3], eigen_vectors[3][3];
+      sample_consensus::kernels::computeCovariance (history, centroid, covariance);
+      sample_consensus::kernels::solveSymmetric3 (covariance, eigen_values, eigen_vectors);
+
+      int n = history.size ();
+      has_prev_ground_plane_ = (sqrt (eigen_values[1] / n) > WARM_START_MIN_SPREAD &&
+                                sqrt (eigen_values[0] / n) < sac_fitting_distance_threshold_);
+      if (!has_prev_ground_plane_)
+        return;
+
+      for (int d = 0; d < 3; d++)
+        prev_ground_plane_ (d) = eigen_vectors[0][d];
+      prev_ground_plane_ (3) = -1 * (prev_ground_plane_ (0) * centroid[0] + prev_ground_plane_ (1) * centroid[1] + prev_ground_plane_ (2) * centroid[2]);
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -197,460 +268,102 @@ class IncGroundRemoval
       if ((int)indices->size () < sac_min_points_per_model_)
         return (false);
 
-      // Create and initialize the SAC model
-      sample_consensus::SACModelLine *model = new sample_consensus::SACModelLine ();
-      sample_consensus::SAC *sac            = new sample_consensus::RANSAC (model, sac_fitting_distance_threshold_);
-      sac->setMaxIterations (sac_max_iterations_);
-      sac->setProbability (0.99);
-
-      model->setDataSet (points, *indices);
-
-      vector<double> line_coeff;
-      // Search for the best model
-      if (sac->computeModel (0))
+      // The model and the SAC method are reused for every scan, only the data and the thresholds change
+      line_sac_->setThreshold (sac_fitting_distance_threshold_);
+      if (sac_method_ == SAC_PROSAC)
       {
-        // Obtain the inliers and the planar model coefficients
-        if ((int)sac->getInliers ().size () < sac_min_points_per_model_)
-          return (false);
-        //inliers    = sac->getInliers ();
-
-        sac->computeCoefficients (line_coeff);             // Compute the model coefficients
-        sac->refineCoefficients (line_coeff);              // Refine them using least-squares
-        model->selectWithinDistance (line_coeff, sac_distance_threshold_, inliers);
-
-        // Project the inliers onto the model
-        //model->projectPointsInPlace (sac->getInliers (), coeff);
+        // PROSAC wants the most likely inliers first: these are the points closest to the ground
+        sorted_indices_ = *indices;
+        sort (sorted_indices_.begin (), sorted_indices_.end (), semantic_point_annotator::CloserToGround (points));
+        line_model_.setDataSet (points, sorted_indices_);
       }
       else
-        return (false);
+        line_model_.setDataSet (points, *indices);
 
-      delete sac;
-      delete model;
-      return (true);
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Flip (in place) the estimated normal of a point towards a given viewpoint
-      * \param normal the plane normal to be flipped
-      * \param point a given point
-      * \param viewpoint the viewpoint
-      */
-    inline void
-      flipNormalTowardsViewpoint (Eigen::Vector4d &normal, const geometry_msgs::Point32 &point, const geometry_msgs::PointStamped &viewpoint)
-    {
-      // See if we need to flip any plane normals
-      float vp_m[3];
-      vp_m[0] = viewpoint.point.x - point.x;
-      vp_m[1] = viewpoint.point.y - point.y;
-      vp_m[2] = viewpoint.point.z - point.z;
-
-      // Dot product between the (viewpoint - point) and the plane normal
-      double cos_theta = (vp_m[0] * normal (0) + vp_m[1] * normal (1) + vp_m[2] * normal (2));
-
-      // Flip the plane normal
-      if (cos_theta < 0)
-      {
-        for (int d = 0; d < 3; d++)
-          normal (d) *= -1;
-        // Hessian form (D = nc . p_plane (centroid here) + p)
-        normal (3) = -1 * (normal (0) * point.x + normal (1) * point.y + normal (2) * point.z);
-      }
-    }
-    
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Compute the centroid of a set of points using their indices and return it as a Point32 message.
-      * \param points the input point cloud
-      * \param indices the point cloud indices that need to be used
-      * \param centroid the output centroid
-      */
-    inline void
-      computeCentroid (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, geometry_msgs::Point32 &centroid)
-    {
-      centroid.x = centroid.y = centroid.z = 0;
-      // For each point in the cloud
-      for (unsigned int i = 0; i < indices.size (); i++)
+      vector<double> line_coeff;
+      if (warm_start_ && has_prev_ground_plane_ && warmStartLine (points, *indices, line_coeff))
       {
-        centroid.x += points.points.at (indices.at (i)).x;
-        centroid.y += points.points.at (indices.at (i)).y;
-        centroid.z += points.points.at (indices.at (i)).z;
+        line_model_.selectWithinDistance (line_coeff, sac_distance_threshold_, inliers);
+        return (true);
       }
 
-      centroid.x /= indices.size ();
-      centroid.y /= indices.size ();
-      centroid.z /= indices.size ();
-    }
- 
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Compute the 3x3 covariance matrix of a given set of points using their indices.
-      * The result is returned as a Eigen::Matrix3d.
-      * \note The (x-y-z) centroid is also returned as a Point32 message.
-      * \param points the input point cloud
-      * \param indices the point cloud indices that need to be used
-      * \param covariance_matrix the 3x3 covariance matrix
-      * \param centroid the computed centroid
-      */
-    inline void
-      computeCovarianceMatrix (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, Eigen::Matrix3d &covariance_matrix, geometry_msgs::Point32 &centroid)
-    {
-      computeCentroid (points, indices, centroid);
-
-      // Initialize to 0
-      covariance_matrix = Eigen::Matrix3d::Zero ();
+      // Search for the best model
+      if (!line_sac_->computeModel (0))
+        return (false);
 
-      for (unsigned int j = 0; j < indices.size (); j++)
-      {
-        covariance_matrix (0, 0) += (points.points[indices.at (j)].x - centroid.x) * (points.points[indices.at (j)].x - centroid.x);
-        covariance_matrix (0, 1) += (points.points[indices.at (j)].x - centroid.x) * (points.points[indices.at (j)].y - centroid.y);
-        covariance_matrix (0, 2) += (points.points[indices.at (j)].x - centroid.x) * (points.points[indices.at (j)].z - centroid.z);
+      // Obtain the inliers and the line model coefficients
+      if ((int)line_sac_->getInliers ().size () < sac_min_points_per_model_)
+        return (false);
 
-        covariance_matrix (1, 0) += (points.points[indices.at (j)].y - centroid.y) * (points.points[indices.at (j)].x - centroid.x);
-        covariance_matrix (1, 1) += (points.points[indices.at (j)].y - centroid.y) * (points.points[indices.at (j)].y - centroid.y);
-        covariance_matrix (1, 2) += (points.points[indices.at (j)].y - centroid.y) * (points.points[indices.at (j)].z - centroid.z);
+      line_sac_->computeCoefficients (line_coeff);             // Compute the model coefficients
+      line_sac_->refineCoefficients (line_coeff);              // Refine them using least-squares
+      line_model_.selectWithinDistance (line_coeff, sac_distance_threshold_, inliers);
 
-        covariance_matrix (2, 0) += (points.points[indices.at (j)].z - centroid.z) * (points.points[indices.at (j)].x - centroid.x);
-        covariance_matrix (2, 1) += (points.points[indices.at (j)].z - centroid.z) * (points.points[indices.at (j)].y - centroid.y);
-        covariance_matrix (2, 2) += (points.points[indices.at (j)].z - centroid.z) * (points.points[indices.at (j)].z - centroid.z);
-      }
+      // Project the inliers onto the model
+      //line_model_.projectPointsInPlace (line_sac_->getInliers (), coeff);
+      return (true);
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Compute the Least-Squares plane fit for a given set of points, using their indices,
-      * and return the estimated plane parameters together with the surface curvature.
-      * \param points the input point cloud
-      * \param indices the point cloud indices that need to be used
-      * \param plane_parameters the plane parameters as: a, b, c, d (ax + by + cz + d = 0)
-      * \param curvature the estimated surface curvature as a measure of
-      * \f[
-      * \lambda_0 / (\lambda_0 + \lambda_1 + \lambda_2)
-      * \f]
+    /** \brief Pipeline stage: find the ground line in the candidate points, and remember it to warm start the
+      * next scans. If no line can be found, all the candidates are taken as ground.
+      * \param context the pipeline data
       */
-    void
-      computePointNormal (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, Eigen::Vector4d &plane_parameters, double &curvature)
+    bool
+      fitGroundLine (semantic_point_annotator::CloudContext &context)
     {
-      geometry_msgs::Point32 centroid;
-      // Compute the 3x3 covariance matrix
-      Eigen::Matrix3d covariance_matrix;
-      computeCovarianceMatrix (points, indices, covariance_matrix, centroid);
-
-      // Extract the eigenvalues and eigenvectors
-      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> ei_symm (covariance_matrix);
-      Eigen::Vector3d eigen_values  = ei_symm.eigenvalues ();
-      Eigen::Matrix3d eigen_vectors = ei_symm.eigenvectors ();
-
-      // Normalize the surface normal (eigenvector corresponding to the smallest eigenvalue)
-      // Note: Remember to take care of the eigen_vectors ordering
-      double norm = sqrt ( eigen_vectors (0, 0) * eigen_vectors (0, 0) +
-                           eigen_vectors (1, 0) * eigen_vectors (1, 0) +
-                           eigen_vectors (2, 0) * eigen_vectors (2, 0));
-      plane_parameters (0) = eigen_vectors (0, 0) / norm;
-      plane_parameters (1) = eigen_vectors (1, 0) / norm;
-      plane_parameters (2) = eigen_vectors (2, 0) / norm;
-
-      // Hessian form (D = nc . p_plane (centroid here) + p)
-      plane_parameters (3) = -1 * (plane_parameters (0) * centroid.x + plane_parameters (1) * centroid.y + plane_parameters (2) * centroid.z);
-
-      // Compute the curvature surface change
-      curvature = fabs ( eigen_values (0) / (eigen_values (0) + eigen_values (1) + eigen_values (2)) );
-    }
+      // Find the dominant plane in the space of possible ground indices
+      fitSACLine (&context.cloud, &context.candidates, context.inliers);
 
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Get the index of a specified dimension/channel in a point cloud
-      * \param points the point cloud
-      * \param channel_name the string defining the channel name
-      */
-    int
-      getChannelIndex (const sensor_msgs::PointCloud &points, std::string channel_name)
-    {
-      for (unsigned int d = 0; d < points.channels.size (); d++)
-        if (points.channels[d].name == channel_name)
-          return (d);
-      return (-1);
-    }
+      // Remember where the ground was, to warm start the line fit of the next scans
+      if (warm_start_)
+        updateWarmStartPlane (context.cloud, context.inliers);
 
-    ////////////////////////////////////////////////////////////////////////////////
-    /** \brief Get the available dimensions as a space separated string
-      * \param cloud the point cloud data message
-      */
-    std::string
-      getAvailableChannels (const sensor_msgs::PointCloud &cloud)
-    {
-      std::string result;
-      if (cloud.channels.size () == 0)
-        return (result);
-      unsigned int i;
-      for (i = 0; i < cloud.channels.size () - 1; i++)
+      if (context.inliers.size () == 0)
       {
-        std::string index = cloud.channels[i].name + " ";
-        result += index;
+        ROS_DEBUG ("Couldn't fit a model to the scan.");
+        //if we can't fit a line model to the scan, we have to assume all the possible ground inliers are on the ground
+        context.inliers = context.candidates;
       }
-      std::string index = cloud.channels[i].name;
-      result += index;
-      return (result);
+      ROS_DEBUG ("Total number of ground inliers before refinement: %d.", (int)context.inliers.size ());
+      return (true);
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Callback
     void cloud_cb (const sensor_msgs::PointCloudConstPtr& msg)
     {
-      laser_cloud_ = *msg;
       //check to see if the point cloud is empty
-      if(laser_cloud_.points.empty()){
+      if (msg->points.empty ())
+      {
         ROS_DEBUG("Received an empty point cloud");
         cloud_publisher_.publish(msg);
         return;
       }
 
-      try{
-        tf_.transformPointCloud("odom_combined", laser_cloud_, cloud_);
-      }
-      catch(tf::TransformException &ex){
-        ROS_ERROR("Can't transform cloud for ground plane detection");
-        return;
-      }
-
-      ROS_DEBUG ("Received %d data points with %d channels (%s).", (int)cloud_.points.size (), (int)cloud_.channels.size (), getAvailableChannels (cloud_).c_str ());
-      int idx_idx = getChannelIndex (cloud_, "index");
-      if (idx_idx == -1)
+      ROS_DEBUG ("Received %d data points with %d channels (%s).", (int)msg->points.size (), (int)msg->channels.size (),
+                 semantic_point_annotator::getAvailableChannels (*msg).c_str ());
+      if (semantic_point_annotator::getChannelIndex (*msg, "index") == -1)
       {
         ROS_ERROR ("Channel 'index' missing in input PointCloud message!");
         return;
       }
-      if (cloud_.points.size () == 0)
-        return;
 
       //updateParametersFromServer ();
-      // Copy the header
-      cloud_noground_.header = cloud_.header;
-
       timeval t1, t2;
       gettimeofday (&t1, NULL);
 
-      // Get the cloud viewpoint
-      getCloudViewPoint (cloud_.header.frame_id, viewpoint_cloud_, &tf_);
-
-      // Transform z_threshold_ from the parameter parameter frame (parameter_frame_) into the point cloud frame
-      double z_threshold_cloud = transformDoubleValueTF (z_threshold_, robot_footprint_frame_, cloud_.header.frame_id, cloud_.header.stamp, &tf_);
-
-      // Select points whose Z dimension is close to the ground (0,0,0 in base_footprint) or under a gentle slope (allowing for pitch/roll error)
-      vector<int> possible_ground_indices (cloud_.points.size ());
-      vector<int> all_indices (cloud_.points.size ());
-      int nr_p = 0;
-      for (unsigned int cp = 0; cp < cloud_.points.size (); cp++)
-      {
-        all_indices[cp] = cp;
-        if (fabs (cloud_.points[cp].z) < z_threshold_cloud || // max height for ground
-            cloud_.points[cp].z*cloud_.points[cp].z < ground_slope_threshold_ * (cloud_.points[cp].x*cloud_.points[cp].x + cloud_.points[cp].y*cloud_.points[cp].y)) // max slope for ground 
-        {
-          possible_ground_indices[nr_p] = cp;
-          nr_p++;
-        }
-      }
-      possible_ground_indices.resize (nr_p);
-
-      ROS_DEBUG ("Number of possible ground indices: %d.", (int)possible_ground_indices.size ());
-
-      vector<int> ground_inliers;
-
-      // Find the dominant plane in the space of possible ground indices
-      fitSACLine (&cloud_, &possible_ground_indices, ground_inliers);
-      
-
-      if (ground_inliers.size () == 0){
-        ROS_DEBUG ("Couldn't fit a model to the scan.");
-        //if we can't fit a line model to the scan, we have to assume all the possible ground inliers are on the ground
-        ground_inliers = possible_ground_indices;
-      }
-
-      ROS_DEBUG ("Total number of ground inliers before refinement: %d.", (int)ground_inliers.size ());
-
-      // Do we attempt to do a planar refinement to remove points "below" the plane model found ?
-      if (planar_refine_ > 0)
-      {
-        // Get the remaining point indices
-        vector<int> remaining_possible_ground_indices;
-        sort (all_indices.begin (), all_indices.end ());
-        sort (ground_inliers.begin (), ground_inliers.end ());
-        set_difference (all_indices.begin (), all_indices.end (), ground_inliers.begin (), ground_inliers.end (),
-                        inserter (remaining_possible_ground_indices, remaining_possible_ground_indices.begin ()));
-
-        // Estimate the plane from the line inliers
-        Eigen::Vector4d plane_parameters;
-        double curvature;
-        computePointNormal (cloud_, ground_inliers, plane_parameters, curvature);
-
-        //make sure that there are inliers to refine
-        if (!ground_inliers.empty ())
-        {
-          flipNormalTowardsViewpoint (plane_parameters, cloud_.points.at (ground_inliers[0]), viewpoint_cloud_);
-
-          // Compute the distance from the remaining points to the model plane, and add to the inliers list if they are below
-          for (unsigned int i = 0; i < remaining_possible_ground_indices.size (); i++)
-          {
-            double distance_to_ground  = pointToPlaneDistanceSigned (cloud_.points.at (remaining_possible_ground_indices[i]), plane_parameters);
-            if (distance_to_ground >= 1e-6){
-              continue;
-            }
-            ground_inliers.push_back (remaining_possible_ground_indices[i]);
-          }
-        }
-      }
-      ROS_DEBUG ("Total number of ground inliers after refinement: %d.", (int)ground_inliers.size ());
-
-#if DEBUG
-      // Prepare new arrays
-      cloud_noground_.points.resize (possible_ground_indices.size ());
-      cloud_noground_.channels.resize (1);
-      cloud_noground_.channels[0].name = "rgb";
-      cloud_noground_.channels[0].values.resize (possible_ground_indices.size ());
-
-      cloud_noground_.points.resize (ground_inliers.size ());
-      cloud_noground_.channels[0].values.resize (ground_inliers.size ());
-      float r = rand () / (RAND_MAX + 1.0);
-      float g = rand () / (RAND_MAX + 1.0);
-      float b = rand () / (RAND_MAX + 1.0);
-
-      for (unsigned int i = 0; i < ground_inliers.size (); i++)
-      {
-        cloud_noground_.points[i].x = cloud_.points.at (ground_inliers[i]).x;
-        cloud_noground_.points[i].y = cloud_.points.at (ground_inliers[i]).y;
-        cloud_noground_.points[i].z = cloud_.points.at (ground_inliers[i]).z;
-        cloud_noground_.channels[0].values[i] = getRGB (r, g, b);
-      }
-      cloud_publisher_.publish (cloud_noground_);
-
-      return;
-#endif
-
-      // Get all the non-ground point indices
-      vector<int> remaining_indices;
-      sort (ground_inliers.begin (), ground_inliers.end ());
-      sort (all_indices.begin(), all_indices.end());
-      set_difference (all_indices.begin (), all_indices.end (), ground_inliers.begin (), ground_inliers.end (),
-                      inserter (remaining_indices, remaining_indices.begin ()));
-
-      // Prepare new arrays
-      int nr_remaining_pts = remaining_indices.size ();
-      cloud_noground_.points.resize (nr_remaining_pts);
-      cloud_noground_.channels.resize (cloud_.channels.size ());
-      for (unsigned int d = 0; d < cloud_.channels.size (); d++)
-      {
-        cloud_noground_.channels[d].name = cloud_.channels[d].name;
-        cloud_noground_.channels[d].values.resize (nr_remaining_pts);
-      }
-
-      for (unsigned int i = 0; i < remaining_indices.size (); i++)
-      {
-        cloud_noground_.points[i].x = cloud_.points.at (remaining_indices[i]).x;
-        cloud_noground_.points[i].y = cloud_.points.at (remaining_indices[i]).y;
-        cloud_noground_.points[i].z = cloud_.points.at (remaining_indices[i]).z;
-        for (unsigned int d = 0; d < cloud_.channels.size (); d++)
-          cloud_noground_.channels[d].values[i] = cloud_.channels[d].values.at (remaining_indices[i]);
-      }
+      context_.input = msg;
+      if (!pipeline_.process (context_))
+        return;
 
       gettimeofday (&t2, NULL);
       double time_spent = t2.tv_sec + (double)t2.tv_usec / 1000000.0 - (t1.tv_sec + (double)t1.tv_usec / 1000000.0);
-      ROS_DEBUG ("Number of points found on ground plane: %d ; remaining: %d (%g seconds).", (int)ground_inliers.size (),
-                (int)remaining_indices.size (), time_spent);
-      cloud_publisher_.publish (cloud_noground_);
-    }
-
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Get the distance from a point to a plane (signed) defined by ax+by+cz+d=0
-      * \param p a point
-      * \param plane_coefficients the normalized coefficients (a, b, c, d) of a plane
-      */
-    inline double
-      pointToPlaneDistanceSigned (const geometry_msgs::Point32 &p, const Eigen::Vector4d &plane_coefficients)
-    {
-      return ( plane_coefficients (0) * p.x + plane_coefficients (1) * p.y + plane_coefficients (2) * p.z + plane_coefficients (3) );
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Get the view point from where the scans were taken in the incoming PointCloud message frame
-      * \param cloud_frame the point cloud message TF frame
-      * \param viewpoint_cloud the resultant view point in the incoming cloud frame
-      * \param tf a pointer to a TransformListener object
-      */
-    void
-      getCloudViewPoint (string cloud_frame, geometry_msgs::PointStamped &viewpoint_cloud, tf::TransformListener *tf)
-    {
-      // Figure out the viewpoint value in the point cloud frame
-      geometry_msgs::PointStamped viewpoint_laser;
-      viewpoint_laser.header.frame_id = laser_tilt_mount_frame_;
-      // Set the viewpoint in the laser coordinate system to 0, 0, 0
-      viewpoint_laser.point.x = viewpoint_laser.point.y = viewpoint_laser.point.z = 0.0;
-
-      try
-      {
-        tf->transformPoint (cloud_frame, viewpoint_laser, viewpoint_cloud);
-        ROS_DEBUG ("Cloud view point in frame %s is: %g, %g, %g.", cloud_frame.c_str (),
-                  viewpoint_cloud.point.x, viewpoint_cloud.point.y, viewpoint_cloud.point.z);
-      }
-      catch (tf::ConnectivityException)
-      {
-        ROS_WARN ("Could not transform a point from frame %s to frame %s!", viewpoint_laser.header.frame_id.c_str (), cloud_frame.c_str ());
-        // Default to 0.05, 0, 0.942768
-        viewpoint_cloud.point.x = 0.05; viewpoint_cloud.point.y = 0.0; viewpoint_cloud.point.z = 0.942768;
-      }
-      catch(tf::TransformException &ex){
-        ROS_ERROR("Can't transform viewpoint for ground plan detection");
-        viewpoint_cloud.point.x = 0.05; viewpoint_cloud.point.y = 0.0; viewpoint_cloud.point.z = 0.942768;
-      }
+      ROS_DEBUG ("Number of points found on ground plane: %d ; remaining: %d (%g seconds).", (int)context_.inliers.size (),
+                (int)context_.output.points.size (), time_spent);
+      pipeline_.printTimings ();
+      cloud_publisher_.publish (context_.output);
     }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Transform a given point from its current frame to a given target frame
-      * \param tf a pointer to a TransformListener object
-      * \param target_frame the target frame to transform the point into
-      * \param stamped_in the input point
-      * \param stamped_out the output point
-      */
-    inline void
-      transformPoint (tf::TransformListener *tf, const std::string &target_frame,
-                      const tf::Stamped< geometry_msgs::Point32 > &stamped_in, tf::Stamped< geometry_msgs::Point32 > &stamped_out)
-    {
-      tf::Stamped<tf::Point> tmp;
-      tmp.stamp_ = stamped_in.stamp_;
-      tmp.frame_id_ = stamped_in.frame_id_;
-      tmp[0] = stamped_in.x;
-      tmp[1] = stamped_in.y;
-      tmp[2] = stamped_in.z;
-
-      try{
-        tf->transformPoint (target_frame, tmp, tmp);
-      }
-      catch(tf::TransformException &ex){
-        ROS_ERROR("Can't transform cloud for ground plane detection");
-        return;
-      }
-
-      stamped_out.stamp_ = tmp.stamp_;
-      stamped_out.frame_id_ = tmp.frame_id_;
-      stamped_out.x = tmp[0];
-      stamped_out.y = tmp[1];
-      stamped_out.z = tmp[2];
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Transform a value from a source frame to a target frame at a certain moment in time with TF
-      * \param val the value to transform
-      * \param src_frame the source frame to transform the value from
-      * \param tgt_frame the target frame to transform the value into
-      * \param stamp a given time stamp
-      * \param tf a pointer to a TransformListener object
-      */
-    inline double
-      transformDoubleValueTF (double val, std::string src_frame, std::string tgt_frame, ros::Time stamp, tf::TransformListener *tf)
-    {
-      geometry_msgs::Point32 temp;
-      temp.x = temp.y = 0;
-      temp.z = val;
-      tf::Stamped<geometry_msgs::Point32> temp_stamped (temp, stamp, src_frame);
-      transformPoint (tf, tgt_frame, temp_stamped, temp_stamped);
-      return (temp_stamped.z);
-    }
-
 };
 
 /* ---[ */
@@ -54,8 +54,13 @@
 #include <tf/transform_listener.h>
 #include <angles/angles.h>
 
-// Kd Tree
-#include <point_cloud_mapping/kdtree/kdtree_ann.h>
+// Thread safe spatial index and region growing
+#include <voxel_grid_index.h>
+#include <region_growing.h>
+// Downsampling
+#include <voxel_grid_filter.h>
+// Planes tracked from one cloud to the next
+#include <plane_cache.h>
 
 // Cloud geometry
 #include <point_cloud_mapping/geometry/areas.h>
@@ -65,6 +70,9 @@
 #include <point_cloud_mapping/geometry/statistics.h>
 
 #include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
 
 using namespace std;
 using namespace mapping_msgs;
@@ -75,6 +83,19 @@ struct Region
   vector<int> indices;
 };
 
+// Everything computed for one cluster. Each task owns its buffers, so that clusters can be processed concurrently
+struct ClusterTask
+{
+  vector<vector<int> > inliers;         // the inliers of every plane found in the cluster
+  vector<vector<double> > coeffs;       // the coefficients of every plane found in the cluster
+  vector<double> rgb;                   // the class (color) of every plane
+  vector<vector<int> > neighbors;       // the neighbors of the first plane's inliers, for its concave hull
+  int nr_validated;                     // the number of planes taken from the plane cache
+  double time_fit, time_classify, time_neighbors, time_hull;
+
+  ClusterTask () : nr_validated (0), time_fit (0), time_classify (0), time_neighbors (0), time_hull (0) { }
+};
+
 class SemanticPointAnnotator
 {
   protected:
@@ -101,6 +122,19 @@ class SemanticPointAnnotator
     bool polygonal_map_, concave_;
     int min_cluster_pts_;
 
+    // Downsampling
+    double leaf_size_;
+    bool leaf_centroid_, annotate_full_resolution_;
+    vector<int> voxel_of_point_;
+    vector<float> voxel_rgb_;
+    vector<char> voxel_annotated_;
+
+    // Plane tracking
+    bool use_plane_cache_;
+    double plane_cache_min_inlier_ratio_;
+    string fixed_frame_;
+    semantic_point_annotator::PlaneCache plane_cache_;
+
     ros::Publisher polygonal_map_publisher_, cloud_publisher_;
     ros::Subscriber cloud_subscriber_;
 
@@ -132,6 +166,17 @@ class SemanticPointAnnotator
       node_.param ("concave", concave_, false);                              // Create concave hulls by default
       node_.param ("boundary_angle_threshold", boundary_angle_threshold_, 120.0); // Boundary angle threshold
 
+      node_.param ("leaf_size", leaf_size_, 0.0);                            // Downsample the input with 0 cm leaves (disabled)
+      node_.param ("leaf_centroid", leaf_centroid_, true);                   // Use the voxel centroids, rather than representative points
+      node_.param ("annotate_full_resolution", annotate_full_resolution_, true); // Propagate the labels back to the input points
+      if (leaf_size_ > 0)
+        ROS_INFO ("Downsampling enabled. Leaf size set to %g.", leaf_size_);
+
+      node_.param ("plane_cache", use_plane_cache_, false);                 // Try the planes of the previous cloud before RANSAC
+      node_.param ("plane_cache_min_inlier_ratio", plane_cache_min_inlier_ratio_, 0.5); // Fraction of a cluster a cached plane must explain
+      node_.param ("fixed_frame", fixed_frame_, string ("odom_combined"));  // Frame the planes are cached in
+      plane_cache_.setFixedFrame (fixed_frame_);
+
       if (polygonal_map_)
        polygonal_map_publisher_ = node_.advertise<PolygonalMap> ("semantic_polygonal_map", 1);
 
@@ -167,14 +212,15 @@ class SemanticPointAnnotator
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /** \brief Decompose a region of space into clusters based on the euclidean distance between points
+    /** \brief Decompose a region of space into clusters based on the euclidean distance between points and the angle
+      * between their normals (see semantic_point_annotator::growRegions)
       * \param points the point cloud message
       * \param indices a list of point indices
       * \param tolerance the spatial tolerance as a measure in the L2 Euclidean space
       * \param clusters the resultant clusters
-      * \param nx_idx
-      * \param ny_idx
-      * \param nz_idx
+      * \param nx_idx the index of the channel containing the x component of the normals
+      * \param ny_idx the index of the channel containing the y component of the normals
+      * \param nz_idx the index of the channel containing the z component of the normals
       * \param min_pts_per_cluster minimum number of points that a cluster may contain (default = 1)
       */
     void
@@ -182,106 +228,75 @@ class SemanticPointAnnotator
                     int nx_idx, int ny_idx, int nz_idx,
                     unsigned int min_pts_per_cluster = 1)
     {
-      // Create a tree for these points
-      cloud_kdtree::KdTree* tree = new cloud_kdtree::KdTreeANN (points, indices);
-
-      // Create a bool vector of processed point indices, and initialize it to false
-      vector<bool> processed;
-      processed.resize (indices.size (), false);
-
-      vector<int> nn_indices;
-      vector<float> nn_distances;
-      // Process all points in the indices vector
-      for (unsigned int i = 0; i < indices.size (); i++)
-      {
-        if (processed[i])
-          continue;
-
-        vector<int> seed_queue;
-        int sq_idx = 0;
-        seed_queue.push_back (i);
-
-        double norm_a = sqrt (points.channels[nx_idx].values[indices.at (i)] * points.channels[nx_idx].values[indices.at (i)] +
-                              points.channels[ny_idx].values[indices.at (i)] * points.channels[ny_idx].values[indices.at (i)] +
-                              points.channels[nz_idx].values[indices.at (i)] * points.channels[nz_idx].values[indices.at (i)]);
-
-        processed[i] = true;
-
-        while (sq_idx < (int)seed_queue.size ())
-        {
-          tree->radiusSearch (seed_queue.at (sq_idx), tolerance, nn_indices, nn_distances);
-
-          for (unsigned int j = 1; j < nn_indices.size (); j++)
-          {
-            if (!processed.at (nn_indices[j]))
-            {
-              double norm_b = sqrt (points.channels[nx_idx].values[indices.at (nn_indices[j])] * points.channels[nx_idx].values[indices.at (nn_indices[j])] +
-                                    points.channels[ny_idx].values[indices.at (nn_indices[j])] * points.channels[ny_idx].values[indices.at (nn_indices[j])] +
-                                    points.channels[nz_idx].values[indices.at (nn_indices[j])] * points.channels[nz_idx].values[indices.at (nn_indices[j])]);
-              // [-1;1]
-              double dot_p = points.channels[nx_idx].values[indices.at (i)] * points.channels[nx_idx].values[indices.at (nn_indices[j])] +
-                             points.channels[ny_idx].values[indices.at (i)] * points.channels[ny_idx].values[indices.at (nn_indices[j])] +
-                             points.channels[nz_idx].values[indices.at (i)] * points.channels[nz_idx].values[indices.at (nn_indices[j])];
-              if ( acos (dot_p / (norm_a * norm_b)) < region_angle_threshold_)
-              {
-                processed[nn_indices[j]] = true;
-                seed_queue.push_back (nn_indices[j]);
-              }
-            }
-          }
-
-          sq_idx++;
-        }
-
-        // If this queue is satisfactory, add to the clusters
-        if (seed_queue.size () >= min_pts_per_cluster)
-        {
-          Region r;
-          //r.indices = seed_queue;
-          r.indices.resize (seed_queue.size ());
-          for (unsigned int j = 0; j < r.indices.size (); j++)
-            r.indices[j] = indices.at (seed_queue[j]);
-          clusters.push_back (r);
-        }
-      }
-
-      // Destroy the tree
-      delete tree;
+      vector<vector<int> > regions;
+      semantic_point_annotator::growRegions (points, indices, tolerance, nx_idx, ny_idx, nz_idx, region_angle_threshold_,
+                                             min_pts_per_cluster, regions);
+
+      int nr_c = clusters.size ();
+      clusters.resize (nr_c + regions.size ());
+      for (unsigned int i = 0; i < regions.size (); i++)
+        clusters[nr_c + i].indices.swap (regions[i]);
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Order the boundary points of a planar patch by repeatedly walking to the closest unvisited point. No
+      * kd-tree is used, as ANN is not reentrant and this gets called from several threads at once. The walk is
+      * quadratic in the number of boundary points, but a patch boundary only has tens to a few hundred of them, fewer
+      * than it takes for building a VoxelGridIndex over them to pay off. Points with non-finite coordinates are skipped.
+      * \param points the point cloud message
+      * \param indices the indices of the boundary points
+      * \param poly the resultant polygon
+      */
     void
-    sortConcaveHull2D (const sensor_msgs::PointCloud &points, const vector<int> &indices, geometry_msgs::Polygon &poly)
+      sortConcaveHull2D (const sensor_msgs::PointCloud &points, const vector<int> &indices, geometry_msgs::Polygon &poly)
     {
-      // Create a tree for these points
-      cloud_kdtree::KdTree* tree = new cloud_kdtree::KdTreeANN (points, indices);
-
-      vector<int> seed_queue;
-      seed_queue.push_back (0);
+      poly.points.clear ();
+      if (indices.size () == 0)
+        return;
 
-      // Create a bool vector of processed point indices, and initialize it to false
+      // Create a bool vector of processed point indices. Non-finite points are never visited, so mark them as processed
       vector<bool> processed;
       processed.resize (indices.size (), false);
-      vector<int> nn_indices;
-      vector<float> nn_distances;
+      int i = -1;
+      for (unsigned int j = 0; j < indices.size (); j++)
+      {
+        const geometry_msgs::Point32 &q = points.points.at (indices[j]);
+        if (!std::isfinite (q.x) || !std::isfinite (q.y) || !std::isfinite (q.z))
+          processed[j] = true;
+        else if (i == -1)
+          i = j;
+      }
+      if (i == -1)
+        return;
+
+      vector<int> seed_queue;
+      seed_queue.reserve (indices.size ());
+      seed_queue.push_back (i);
 
       // Process all points in the indices vector
-      int i = 0;
       processed[i] = true;                            // Mark the current point as "processed"
       while (seed_queue.size () < indices.size ())
       {
-        tree->nearestKSearch (seed_queue[i], indices.size (), nn_indices, nn_distances);
-
-        for (unsigned int j = 0;  j < nn_indices.size (); j++)
+        const geometry_msgs::Point32 &p = points.points.at (indices.at (i));
+        int closest = -1;
+        double closest_sqr_dist = DBL_MAX;
+        for (unsigned int j = 0; j < indices.size (); j++)
         {
-          if (!processed.at (nn_indices[j]))             // Check the closest neighbor
+          if (processed[j])
+            continue;
+          const geometry_msgs::Point32 &q = points.points.at (indices[j]);
+          double sqr_dist = (q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y) + (q.z - p.z) * (q.z - p.z);
+          if (sqr_dist < closest_sqr_dist)
           {
-            processed[nn_indices[j]] = true;
-            seed_queue.push_back (nn_indices[j]);
-            i++;
-            break;
+            closest_sqr_dist = sqr_dist;
+            closest = j;
           }
         }
+        if (closest == -1)                            // No unprocessed point left
+          break;
+        processed[closest] = true;
+        seed_queue.push_back (closest);
+        i = closest;
       }
 
       poly.points.resize (seed_queue.size ());
@@ -291,13 +306,21 @@ class SemanticPointAnnotator
         poly.points[i].y = points.points.at (indices.at (seed_queue[i])).y;
         poly.points[i].z = points.points.at (indices.at (seed_queue[i])).z;
       }
-      // Destroy the tree
-      delete tree;
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Find all the planes in a set of points. The predicted planes are tried first, each with a single
+      * inlier count, and MSAC only searches the points that none of them explains.
+      * \param points the point cloud message (the inliers get projected onto their planes)
+      * \param indices the indices of the points
+      * \param predicted the planes expected in these points (e.g. the ones found in the previous cloud)
+      * \param inliers the resultant inliers of every plane
+      * \param coeff the resultant coefficients of every plane
+      * \param nr_validated the resultant number of planes taken from the predicted ones
+      */
     int
-      fitSACPlane (sensor_msgs::PointCloud *points, vector<int> *indices, vector<vector<int> > &inliers, vector<vector<double> > &coeff)
+      fitSACPlane (sensor_msgs::PointCloud *points, vector<int> *indices, const vector<semantic_point_annotator::TrackedPlane> &predicted,
+                   vector<vector<int> > &inliers, vector<vector<double> > &coeff, int &nr_validated)
     {
       vector<int> empty_inliers;
       vector<double> empty_coeffs;
@@ -309,15 +332,60 @@ class SemanticPointAnnotator
         return (-1);
       }
 
+      // ---[ Validate the predicted planes
+      vector<int> remaining;
+      vector<int> *sac_indices = indices;
+      nr_validated = 0;
+      if (!predicted.empty ())
+      {
+        remaining = *indices;
+        for (unsigned int p = 0; p < predicted.size () && (int)remaining.size () > sac_min_points_left_; p++)
+        {
+          vector<double> plane_coeff = predicted[p].coefficients;
+          vector<int> plane_inliers;
+          int min_inliers = max (sac_min_points_per_model_, (int)(plane_cache_min_inlier_ratio_ * remaining.size ()));
+          if (!semantic_point_annotator::validatePlane (*points, remaining, plane_coeff, sac_distance_threshold_, min_inliers, plane_inliers))
+            continue;
+
+          // Project the inliers onto the model
+          for (unsigned int i = 0; i < plane_inliers.size (); i++)
+          {
+            geometry_msgs::Point32 &pt = points->points[plane_inliers[i]];
+            double distance = plane_coeff[0] * pt.x + plane_coeff[1] * pt.y + plane_coeff[2] * pt.z + plane_coeff[3];
+            pt.x -= distance * plane_coeff[0];
+            pt.y -= distance * plane_coeff[1];
+            pt.z -= distance * plane_coeff[2];
+          }
+          inliers.push_back (plane_inliers);
+          coeff.push_back (plane_coeff);
+          nr_validated++;
+
+          // Remove the inliers, which come in the same order as in remaining
+          unsigned int k = 0, nr_left = 0;
+          for (unsigned int i = 0; i < remaining.size (); i++)
+          {
+            if (k < plane_inliers.size () && remaining[i] == plane_inliers[k])
+            {
+              k++;
+              continue;
+            }
+            remaining[nr_left++] = remaining[i];
+          }
+          remaining.resize (nr_left);
+        }
+        if ((int)remaining.size () <= sac_min_points_left_)
+          return (0);
+        sac_indices = &remaining;
+      }
+
       // Create and initialize the SAC model
       sample_consensus::SACModelPlane *model = new sample_consensus::SACModelPlane ();
       sample_consensus::SAC *sac             = new sample_consensus::MSAC (model, sac_distance_threshold_);
       sac->setMaxIterations (120);
       sac->setProbability (0.99);
-      model->setDataSet (points, *indices);
+      model->setDataSet (points, *sac_indices);
 
-      sensor_msgs::PointCloud pts (*points);
-      int nr_points_left = indices->size ();
+      int nr_points_left = sac_indices->size ();
       int nr_models = 0;
       while (nr_points_left > sac_min_points_left_)
       {
@@ -349,7 +417,11 @@ class SemanticPointAnnotator
           nr_points_left = sac->removeInliers ();
           nr_models++;
         }
+        else
+          break;
       }
+      delete sac;
+      delete model;
       return (0);
     }
 
@@ -401,7 +473,7 @@ class SemanticPointAnnotator
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     void
       getObjectClassForPerpendicular (sensor_msgs::PointCloud *points, vector<int> *indices,
-                                      double &rgb)
+                                      unsigned int &seed, double &rgb)
     {
       double r, g, b;
       // Get the minimum and maximum bounds of the plane
@@ -410,9 +482,9 @@ class SemanticPointAnnotator
       // Test for wall
       if (maxP.z > rule_wall_)
       {
-        r = rand () / (RAND_MAX + 1.0);
-        g = rand () / (RAND_MAX + 1.0);
-        b = rand () / (RAND_MAX + 1.0);
+        r = rand_r (&seed) / (RAND_MAX + 1.0);
+        g = rand_r (&seed) / (RAND_MAX + 1.0);
+        b = rand_r (&seed) / (RAND_MAX + 1.0);
         r = r * .3;
         b = b * .3 + .7;
         g = g * .3;
@@ -446,12 +518,114 @@ class SemanticPointAnnotator
       sortConcaveHull2D (points, inliers, poly);
     }
 
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Get the current wall clock time in seconds */
+    static double
+      getTime ()
+    {
+      timeval t;
+      gettimeofday (&t, NULL);
+      return (t.tv_sec + (double)t.tv_usec / 1000000.0);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /** \brief Process one cluster: fit planes to it, classify them and compute the hull of the first one. Only
+      * touches cloud_ at the cluster's own indices and the given polygon, so clusters can be processed concurrently.
+      * \param cluster the cluster
+      * \param predicted the planes expected in the cluster
+      * \param map_origin the robot origin
+      * \param seed the seed for the random colors of the walls
+      * \param task the resultant planes, classes and timings
+      * \param poly the resultant hull, or NULL if no polygonal map is needed
+      */
+    void
+      processCluster (Region &cluster, const vector<semantic_point_annotator::TrackedPlane> &predicted,
+                      const geometry_msgs::PointStamped &map_origin, unsigned int seed, ClusterTask &task, geometry_msgs::Polygon *poly)
+    {
+      // ---[ Find all planes in this cluster
+      double t = getTime ();
+      fitSACPlane (&cloud_, &cluster.indices, predicted, task.inliers, task.coeffs, task.nr_validated);
+      task.time_fit = getTime () - t;
+
+      // ---[ Mark all the points inside every plane. The color carries over to the planes that no rule matches
+      t = getTime ();
+      double rgb;
+      int res = (255 << 16) | (255 << 8) | 255;
+      rgb = *(float*)(&res);
+      task.rgb.resize (task.inliers.size ());
+      if (task.inliers.size () == task.coeffs.size ())
+      {
+        for (unsigned int j = 0; j < task.inliers.size (); j++)
+        {
+          if (task.inliers[j].size () == 0 || task.coeffs[j].size () == 0)
+            continue;
+          switch (cluster.region_type)
+          {
+            case 0:     // Z-parallel
+            {
+              getObjectClassForParallel (&cloud_, &task.inliers[j], &task.coeffs[j], map_origin, rgb);
+              break;
+            }
+            case 1:     // Z-perpendicular
+            {
+              getObjectClassForPerpendicular (&cloud_, &task.inliers[j], seed, rgb);
+              break;
+            }
+          }
+          task.rgb[j] = rgb;
+        }
+      }
+      task.time_classify = getTime () - t;
+
+      if (poly == NULL)
+        return;
+      poly->points.clear ();
+      if (task.inliers.size () == 0 || task.coeffs.size () == 0)
+        return;
+      if (task.inliers[0].size () == 0 || task.coeffs[0].size () == 0)
+        return;
+
+      // ---[ Fit a hull to the inliers of the first plane (points should be projected!)
+      if (concave_)
+      {
+        // Get the neighbors for the concave hull
+        t = getTime ();
+        task.neighbors.resize (task.inliers[0].size ());
+        semantic_point_annotator::VoxelGridIndex grid;
+        grid.build (cloud_, task.inliers[0], 0.3);
+        for (unsigned int i = 0; i < task.inliers[0].size (); i++)
+        {
+          grid.radiusSearch (i, 0.3, task.neighbors[i]);                                // 30cm radius search
+          // Note: the neighbors below are in the 0->indices.size () spectrum and need to be
+          // transformed into global point indices (!)
+          for (unsigned int j = 0; j < task.neighbors[i].size (); j++)
+            task.neighbors[i][j] = task.inliers[0][task.neighbors[i][j]];
+        }
+        task.time_neighbors = getTime () - t;
+
+        t = getTime ();
+        computeConcaveHull (cloud_, task.inliers[0], task.coeffs[0], task.neighbors, *poly);
+        task.time_hull = getTime () - t;
+      }
+      else
+      {
+        t = getTime ();
+        cloud_geometry::areas::convexHull2D (cloud_, task.inliers[0], task.coeffs[0], *poly);
+        task.time_hull = getTime () - t;
+      }
+    }
+
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Callback
     void cloud_cb (const sensor_msgs::PointCloudConstPtr &cloud_in )
     {
-      cloud_ = *cloud_in;
+      // Work on a downsampled copy of the input, but remember which voxel each input point went into
+      bool downsample = (leaf_size_ > 0);
+      if (downsample)
+        semantic_point_annotator::downsampleVoxelGrid (*cloud_in, leaf_size_, leaf_centroid_, cloud_, voxel_of_point_);
+      else
+        cloud_ = *cloud_in;
       geometry_msgs::PointStamped base_link_origin, map_origin;
       base_link_origin.point.x = base_link_origin.point.y = base_link_origin.point.z = 0.0;
       base_link_origin.header.frame_id = "base_link";
@@ -459,7 +633,9 @@ class SemanticPointAnnotator
 
       tf_.transformPoint ("base_link", base_link_origin, map_origin);
 
-      ROS_INFO ("Received %d data points. Current robot pose is %g, %g, %g", (int)cloud_.points.size (), map_origin.point.x, map_origin.point.y, map_origin.point.z);
+      ROS_INFO ("Received %d data points. Current robot pose is %g, %g, %g", (int)cloud_in->points.size (), map_origin.point.x, map_origin.point.y, map_origin.point.z);
+      if (downsample)
+        ROS_INFO ("Downsampled to %d data points.", (int)cloud_.points.size ());
 
       cloud_annotated_.header = cloud_.header;
 
@@ -507,99 +683,91 @@ class SemanticPointAnnotator
       ROS_INFO ("Found %d clusters with %d points in %g seconds.", (int)clusters.size (), total_p, time_spent);
       gettimeofday (&t1, NULL);
 
-      vector<vector<vector<int> > > all_cluster_inliers (clusters.size ());
-      vector<vector<vector<double> > > all_cluster_coeff (clusters.size ());
-
       // Reserve enough space
       cloud_annotated_.points.resize (total_p);
       cloud_annotated_.channels[0].values.resize (total_p);
 
       int nr_p = 0;
 
+      if (downsample)
+      {
+        voxel_rgb_.resize (cloud_.points.size ());
+        voxel_annotated_.assign (cloud_.points.size (), 0);
+      }
+
       if (polygonal_map_)
       {
         pmap_.header = cloud_.header;
         pmap_.polygons.resize (clusters.size ());         // Allocate space for the polygonal map
       }
 
-      // Process all clusters in parallel
-      #pragma omp parallel for schedule(dynamic)
-      for (int cc = 0; cc < (int)clusters.size (); cc++)
+      // Process the largest clusters first, so that the small ones fill in the gaps at the end
+      vector<pair<int, int> > order (clusters.size ());
+      for (unsigned int cc = 0; cc < clusters.size (); cc++)
+        order[cc] = make_pair ((int)clusters[cc].indices.size (), (int)cc);
+      sort (order.rbegin (), order.rend ());
+
+      // Get the planes found in the previous cloud, in the frame of this one, by region type
+      vector<semantic_point_annotator::TrackedPlane> predicted[2];
+      if (use_plane_cache_)
       {
-        // Find all planes in this cluster
-        int ret = fitSACPlane (&cloud_, &clusters[cc].indices, all_cluster_inliers[cc], all_cluster_coeff[cc]);
-        if (ret != 0 || all_cluster_inliers[cc].size () == 0)
-          continue;
+        vector<semantic_point_annotator::TrackedPlane> cached;
+        plane_cache_.predict (&tf_, cloud_.header.frame_id, cloud_.header.stamp, cached);
+        for (unsigned int i = 0; i < cached.size (); i++)
+          predicted[cached[i].region_type].push_back (cached[i]);
       }
 
-      // Bummer - no omp here
-      // cloud_kdtree is not thread safe because we rely on ANN/FL-ANN, so get the neighbors here
-      vector<float> nn_distances;
-      vector<vector<vector<int> > > neighbors (clusters.size ());
-      if (concave_)
+      // Fit, classify and compute the hull of every cluster as an independent task
+      vector<ClusterTask> tasks (clusters.size ());
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (int t = 0; t < (int)order.size (); t++)
       {
-        for (int cc = 0; cc < (int)clusters.size (); cc++)
-        {
-          if (all_cluster_inliers[cc].size () == 0 || all_cluster_coeff[cc].size () == 0)
-            continue;
-
-          vector<vector<int> > *cluster_neighbors = &neighbors[cc];
-
-          if (all_cluster_inliers[cc][0].size () == 0)
-            continue;
-          cluster_neighbors->resize (all_cluster_inliers[cc][0].size ());
-
-          // Create a tree for these points
-          cloud_kdtree::KdTree* tree = new cloud_kdtree::KdTreeANN (cloud_, all_cluster_inliers[cc][0]);
-          for (unsigned int i = 0; i < all_cluster_inliers[cc][0].size (); i++)
-          {
-            tree->radiusSearch (i, 0.3, cluster_neighbors->at (i), nn_distances);                      // 30cm radius search
-//            tree->nearestKSearch (i, 30);                      // 30cm radius search
-            // Note: the neighbors below are in the 0->indices.size () spectrum and need to be
-            // transformed into global point indices (!)
-            for (unsigned int j = 0; j < cluster_neighbors->at (i).size (); j++)
-              cluster_neighbors->at(i).at(j) = all_cluster_inliers[cc][0].at (cluster_neighbors->at(i).at(j));
-          }
-          // Destroy the tree
-          delete tree;
-        }
-        gettimeofday (&t2, NULL);
-        time_spent = t2.tv_sec + (double)t2.tv_usec / 1000000.0 - (t1.tv_sec + (double)t1.tv_usec / 1000000.0);
-        ROS_INFO ("Nearest neighbors (concave hull) estimated in %g seconds.", time_spent);
-        gettimeofday (&t1, NULL);
+        int cc = order[t].second;
+        processCluster (clusters[cc], predicted[(int)clusters[cc].region_type], map_origin, cc, tasks[cc],
+                        polygonal_map_ ? &pmap_.polygons[cc] : NULL);
       }
 
-      if (polygonal_map_)
+      // Remember the planes for the next cloud
+      int nr_validated = 0;
+      vector<semantic_point_annotator::TrackedPlane> found;
+      for (unsigned int cc = 0; cc < tasks.size (); cc++)
       {
-        // Process all clusters in parallel
-        //#pragma omp parallel for schedule(dynamic)
-        // Fit convex hulls to the inliers (points should be projected!)
-        for (int cc = 0; cc < (int)clusters.size (); cc++)
+        nr_validated += tasks[cc].nr_validated;
+        for (unsigned int j = 0; j < tasks[cc].inliers.size () && j < tasks[cc].coeffs.size (); j++)
         {
-          if (all_cluster_inliers[cc].size () == 0 || all_cluster_coeff[cc].size () == 0)
-            continue;
-
-          if (all_cluster_inliers[cc][0].size () == 0 || all_cluster_coeff[cc][0].size () == 0)
+          if (tasks[cc].inliers[j].size () == 0 || tasks[cc].coeffs[j].size () != 4)
             continue;
-
-          if (concave_)
-            computeConcaveHull (cloud_, all_cluster_inliers[cc][0], all_cluster_coeff[cc][0], neighbors[cc], pmap_.polygons[cc]);
-          else
-            cloud_geometry::areas::convexHull2D (cloud_, all_cluster_inliers[cc][0], all_cluster_coeff[cc][0], pmap_.polygons[cc]);
+          semantic_point_annotator::TrackedPlane plane;
+          plane.coefficients = tasks[cc].coeffs[j];
+          plane.region_type  = clusters[cc].region_type;
+          plane.nr_inliers   = tasks[cc].inliers[j].size ();
+          found.push_back (plane);
         }
       }
+      if (use_plane_cache_)
+        plane_cache_.update (&tf_, cloud_.header.frame_id, cloud_.header.stamp, found);
+
+      gettimeofday (&t2, NULL);
+      time_spent = t2.tv_sec + (double)t2.tv_usec / 1000000.0 - (t1.tv_sec + (double)t1.tv_usec / 1000000.0);
+      double time_fit = 0, time_classify = 0, time_neighbors = 0, time_hull = 0;
+      for (unsigned int cc = 0; cc < tasks.size (); cc++)
+      {
+        time_fit       += tasks[cc].time_fit;
+        time_classify  += tasks[cc].time_classify;
+        time_neighbors += tasks[cc].time_neighbors;
+        time_hull      += tasks[cc].time_hull;
+      }
+      ROS_INFO ("Clusters processed in %g seconds. Time spent over all clusters: %g (fit), %g (classify), %g (neighbors), %g (hull).",
+                time_spent, time_fit, time_classify, time_neighbors, time_hull);
+      ROS_INFO ("Found %d planes, %d of which validated from the previous cloud.", (int)found.size (), nr_validated);
+      gettimeofday (&t1, NULL);
 
       // Go over each cluster
       for (int cc = 0; cc < (int)clusters.size (); cc++)
       {
-        double r, g, b, rgb;
-        r = g = b = 1.0;
-        int res = (int(r * 255) << 16) | (int(g*255) << 8) | int(b*255);
-        rgb = *(float*)(&res);
-
         // Get the planes in this cluster
-        vector<vector<int> > *planes_inliers   = &all_cluster_inliers[cc];
-        vector<vector<double> > *planes_coeffs = &all_cluster_coeff[cc];
+        vector<vector<int> > *planes_inliers   = &tasks[cc].inliers;
+        vector<vector<double> > *planes_coeffs = &tasks[cc].coeffs;
 
         if (planes_inliers->size () == 0 || planes_coeffs->size () == 0 || planes_inliers->size () != planes_coeffs->size ())
           continue;
@@ -613,20 +781,7 @@ class SemanticPointAnnotator
           if (plane_inliers->size () == 0 || plane_coeffs->size () == 0)
             continue;
 
-          // Mark all the points inside
-          switch (clusters[cc].region_type)
-          {
-            case 0:     // Z-parallel
-            {
-              getObjectClassForParallel (&cloud_, plane_inliers, plane_coeffs, map_origin, rgb);
-              break;
-            }
-            case 1:     // Z-perpendicular
-            {
-              getObjectClassForPerpendicular (&cloud_, plane_inliers, rgb);
-              break;
-            }
-          }
+          double rgb = tasks[cc].rgb[j];
           for (unsigned int k = 0; k < plane_inliers->size (); k++)
           {
             cloud_annotated_.points[nr_p].x = cloud_.points.at (plane_inliers->at (k)).x;
@@ -635,6 +790,14 @@ class SemanticPointAnnotator
             cloud_annotated_.channels[0].values[nr_p] = rgb;
             nr_p++;
           }
+          if (downsample)
+          {
+            for (unsigned int k = 0; k < plane_inliers->size (); k++)
+            {
+              voxel_rgb_[plane_inliers->at (k)] = rgb;
+              voxel_annotated_[plane_inliers->at (k)] = 1;
+            }
+          }
         }
 /*        r = rand () / (RAND_MAX + 1.0);
         g = rand () / (RAND_MAX + 1.0);
@@ -656,6 +819,26 @@ class SemanticPointAnnotator
       cloud_annotated_.points.resize (nr_p);
       cloud_annotated_.channels[0].values.resize (nr_p);
 
+      // Give every input point the label of its voxel. Note that, unlike the downsampled ones, these are not
+      // projected onto their planes
+      if (downsample && annotate_full_resolution_)
+      {
+        nr_p = 0;
+        cloud_annotated_.points.resize (cloud_in->points.size ());
+        cloud_annotated_.channels[0].values.resize (cloud_in->points.size ());
+        for (unsigned int i = 0; i < cloud_in->points.size (); i++)
+        {
+          int v = voxel_of_point_[i];
+          if (v == -1 || !voxel_annotated_[v])
+            continue;
+          cloud_annotated_.points[nr_p] = cloud_in->points[i];
+          cloud_annotated_.channels[0].values[nr_p] = voxel_rgb_[v];
+          nr_p++;
+        }
+        cloud_annotated_.points.resize (nr_p);
+        cloud_annotated_.channels[0].values.resize (nr_p);
+      }
+
       cloud_publisher_.publish(cloud_annotated_);
 
       if (polygonal_map_)
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+#include <cloud_pipeline.h>
+#include <voxel_grid_filter.h>
+#include <voxel_grid_index.h>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    downsampleVoxelGrid (const sensor_msgs::PointCloud &cloud_in, double leaf_size, bool centroid,
+                         sensor_msgs::PointCloud &cloud_out, std::vector<int> &voxel_of_point)
+  {
+    int n = cloud_in.points.size ();
+    voxel_of_point.assign (n, -1);
+    cloud_out.header = cloud_in.header;
+    cloud_out.points.clear ();
+    cloud_out.channels.resize (cloud_in.channels.size ());
+    for (unsigned int d = 0; d < cloud_in.channels.size (); d++)
+    {
+      cloud_out.channels[d].name = cloud_in.channels[d].name;
+      cloud_out.channels[d].values.clear ();
+    }
+
+    // Get the bounding box of the (finite) points
+    float min_p[3] = { std::numeric_limits<float>::max (), std::numeric_limits<float>::max (), std::numeric_limits<float>::max () };
+    float max_p[3] = { -std::numeric_limits<float>::max (), -std::numeric_limits<float>::max (), -std::numeric_limits<float>::max () };
+    std::vector<int> valid;
+    valid.reserve (n);
+    for (int i = 0; i < n; i++)
+    {
+      const geometry_msgs::Point32 &p = cloud_in.points[i];
+      if (!std::isfinite (p.x) || !std::isfinite (p.y) || !std::isfinite (p.z))
+        continue;
+      valid.push_back (i);
+      min_p[0] = std::min (min_p[0], p.x); max_p[0] = std::max (max_p[0], p.x);
+      min_p[1] = std::min (min_p[1], p.y); max_p[1] = std::max (max_p[1], p.y);
+      min_p[2] = std::min (min_p[2], p.z); max_p[2] = std::max (max_p[2], p.z);
+    }
+    if (valid.empty ())
+      return;
+
+    // Grow the voxels if needed, so that the voxel coordinates fit in a cell key
+    for (int d = 0; d < 3; d++)
+      leaf_size = std::max (leaf_size, (double)(max_p[d] - min_p[d]) / ((1 << VoxelGridIndex::KEY_BITS) - 2));
+
+    // Sort the points by voxel
+    std::vector<std::pair<uint64_t, int> > keyed (valid.size ());
+    for (unsigned int i = 0; i < valid.size (); i++)
+    {
+      const geometry_msgs::Point32 &p = cloud_in.points[valid[i]];
+      int ix = (int)floor ((p.x - min_p[0]) / leaf_size);
+      int iy = (int)floor ((p.y - min_p[1]) / leaf_size);
+      int iz = (int)floor ((p.z - min_p[2]) / leaf_size);
+      keyed[i] = std::make_pair (VoxelGridIndex::cellKey (ix, iy, iz), valid[i]);
+    }
+    std::sort (keyed.begin (), keyed.end ());
+
+    int nx = getChannelIndex (cloud_in, "nx"), ny = getChannelIndex (cloud_in, "ny"), nz = getChannelIndex (cloud_in, "nz");
+    bool normals = (nx != -1 && ny != -1 && nz != -1);
+
+    // Process one voxel (keyed[begin] ... keyed[end - 1]) at a time
+    for (unsigned int begin = 0, end = 0; begin < keyed.size (); begin = end)
+    {
+      end = begin + 1;
+      while (end < keyed.size () && keyed[end].first == keyed[begin].first)
+        end++;
+
+      double c[3] = { 0, 0, 0 };
+      for (unsigned int i = begin; i < end; i++)
+      {
+        const geometry_msgs::Point32 &p = cloud_in.points[keyed[i].second];
+        c[0] += p.x; c[1] += p.y; c[2] += p.z;
+      }
+      for (int d = 0; d < 3; d++)
+        c[d] /= (end - begin);
+
+      // The representative point is the one closest to the centroid
+      int rep = keyed[begin].second;
+      double best = std::numeric_limits<double>::max ();
+      for (unsigned int i = begin; i < end; i++)
+      {
+        const geometry_msgs::Point32 &p = cloud_in.points[keyed[i].second];
+        double sqr_dist = (p.x - c[0]) * (p.x - c[0]) + (p.y - c[1]) * (p.y - c[1]) + (p.z - c[2]) * (p.z - c[2]);
+        if (sqr_dist < best)
+        {
+          best = sqr_dist;
+          rep = keyed[i].second;
+        }
+      }
+
+      int v = cloud_out.points.size ();
+      for (unsigned int i = begin; i < end; i++)
+        voxel_of_point[keyed[i].second] = v;
+
+      geometry_msgs::Point32 p = cloud_in.points[rep];
+      for (unsigned int d = 0; d < cloud_in.channels.size (); d++)
+        cloud_out.channels[d].values.push_back (cloud_in.channels[d].values[rep]);
+      if (centroid)
+      {
+        p.x = c[0]; p.y = c[1]; p.z = c[2];
+        if (normals)
+        {
+          double nrm[3] = { 0, 0, 0 };
+          for (unsigned int i = begin; i < end; i++)
+          {
+            nrm[0] += cloud_in.channels[nx].values[keyed[i].second];
+            nrm[1] += cloud_in.channels[ny].values[keyed[i].second];
+            nrm[2] += cloud_in.channels[nz].values[keyed[i].second];
+          }
+          double norm = sqrt (nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+          // Opposite normals cancel out: keep the representative's normal then
+          if (norm > 0)
+          {
+            cloud_out.channels[nx].values[v] = nrm[0] / norm;
+            cloud_out.channels[ny].values[v] = nrm[1] / norm;
+            cloud_out.channels[nz].values[v] = nrm[2] / norm;
+          }
+        }
+      }
+      cloud_out.points.push_back (p);
+    }
+  }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2008 Radu Bogdan Rusu <rusu -=- cs.tum.edu>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \author Radu Bogdan Rusu */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <voxel_grid_index.h>
+
+namespace semantic_point_annotator
+{
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  void
+    VoxelGridIndex::build (const sensor_msgs::PointCloud &points, const std::vector<int> &indices, double leaf_size)
+  {
+    int n = indices.size ();
+    x_.resize (n); y_.resize (n); z_.resize (n);
+    cell_keys_.clear ();
+    cell_start_.clear ();
+    cell_points_.clear ();
+    if (n == 0)
+      return;
+
+    for (int d = 0; d < 3; d++)
+      min_[d] = std::numeric_limits<float>::max ();
+    float max_p[3] = { -std::numeric_limits<float>::max (), -std::numeric_limits<float>::max (), -std::numeric_limits<float>::max () };
+    for (int i = 0; i < n; i++)
+    {
+      const geometry_msgs::Point32 &p = points.points[indices[i]];
+      x_[i] = p.x; y_[i] = p.y; z_[i] = p.z;
+      min_[0] = std::min (min_[0], p.x); max_p[0] = std::max (max_p[0], p.x);
+      min_[1] = std::min (min_[1], p.y); max_p[1] = std::max (max_p[1], p.y);
+      min_[2] = std::min (min_[2], p.z); max_p[2] = std::max (max_p[2], p.z);
+    }
+
+    // Grow the cells if needed, so that the cell coordinates fit in a key
+    leaf_size_ = leaf_size;
+    for (int d = 0; d < 3; d++)
+      leaf_size_ = std::max (leaf_size_, (double)(max_p[d] - min_[d]) / ((1 << KEY_BITS) - 2));
+    for (int d = 0; d < 3; d++)
+      nr_cells_[d] = cellCoordinate (max_p[d], d) + 1;
+
+    // Sort the points by cell
+    std::vector<std::pair<uint64_t, int> > keyed (n);
+    for (int i = 0; i < n; i++)
+      keyed[i] = std::make_pair (cellKey (cellCoordinate (x_[i], 0), cellCoordinate (y_[i], 1), cellCoordinate (z_[i], 2)), i);
+    std::sort (keyed.begin (), keyed.end ());
+
+    // Keep a copy of the coordinates in cell order too, so that the points of a cell are read contiguously
+    cell_points_.resize (n);
+    cell_x_.resize (n); cell_y_.resize (n); cell_z_.resize (n);
+    for (int i = 0; i < n; i++)
+    {
+      if (i == 0 || keyed[i].first != keyed[i - 1].first)
+      {
+        cell_keys_.push_back (keyed[i].first);
+        cell_start_.push_back (i);
+      }
+      int p = keyed[i].second;
+      cell_points_[i] = p;
+      cell_x_[i] = x_[p]; cell_y_[i] = y_[p]; cell_z_[i] = z_[p];
+    }
+    cell_start_.push_back (n);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  int
+    VoxelGridIndex::radiusSearch (float x, float y, float z, double radius, std::vector<int> &k_indices) const
+  {
+    k_indices.clear ();
+    if (cell_keys_.empty ())
+      return (0);
+
+    // The range of cells overlapping the bounding box of the query sphere, clamped to the grid
+    float q[3] = { x, y, z };
+    int lo[3], hi[3];
+    for (int d = 0; d < 3; d++)
+    {
+      lo[d] = std::max (0, cellCoordinate (q[d] - radius, d));
+      hi[d] = std::min (nr_cells_[d] - 1, cellCoordinate (q[d] + radius, d));
+      if (lo[d] > hi[d])
+        return (0);
+    }
+
+    float sqr_radius = radius * radius;
+    for (int i = lo[0]; i <= hi[0]; i++)
+    {
+      for (int j = lo[1]; j <= hi[1]; j++)
+      {
+        // The cells along z are contiguous in key order, so look up the first one and walk forward
+        std::vector<uint64_t>::const_iterator it = std::lower_bound (cell_keys_.begin (), cell_keys_.end (), cellKey (i, j, lo[2]));
+        uint64_t last = cellKey (i, j, hi[2]);
+        for (; it != cell_keys_.end () && *it <= last; ++it)
+        {
+          int c = it - cell_keys_.begin ();
+          for (int k = cell_start_[c]; k < cell_start_[c + 1]; k++)
+          {
+            float dx = cell_x_[k] - x, dy = cell_y_[k] - y, dz = cell_z_[k] - z;
+            if (dx * dx + dy * dy + dz * dz <= sqr_radius)
+              k_indices.push_back (cell_points_[k]);
+          }
+        }
+      }
+    }
+    return (k_indices.size ());
+  }
+}
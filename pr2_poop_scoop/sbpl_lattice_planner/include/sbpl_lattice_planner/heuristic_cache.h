@@ -0,0 +1,170 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef SBPL_LATTICE_PLANNER_HEURISTIC_CACHE_H
+#define SBPL_LATTICE_PLANNER_HEURISTIC_CACHE_H
+
+#include <list>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+// sbpl headers
+#include <sbpl/headers.h>
+
+namespace sbpl_lattice_planner{
+
+/**
+ * @brief 2D costs-to-go from one cell of the map, in the units of the SBPL 2D heuristic (cost times millimeters)
+ */
+struct HeuristicTable{
+  int x, y; /**< the cell the costs are computed from */
+  std::vector<int> costs; /**< the cost from (x, y) to every cell, row major, INFINITECOST if unreachable */
+};
+
+/**
+ * @class HeuristicCache
+ * @brief Keeps the 2D heuristic tables of the last few goals, most recently used first
+ */
+class HeuristicCache{
+public:
+  /**
+   * @param capacity The number of tables to keep
+   * @param reuse_cost A table may be used for another cell if it can reach it within this cost (0 reuses exact matches only)
+   */
+  HeuristicCache(unsigned int capacity, int reuse_cost);
+
+  /**
+   * @brief  Set the size of the map, drops all tables
+   * @param obsthresh Cells at or above this cost are not traversable
+   */
+  void setMap(int width, int height, double cellsize_m, unsigned char obsthresh);
+
+  /**
+   * @brief  Get a table for a cell, computing it if no cached table can stand in
+   * @param x The cell
+   * @param y The cell
+   * @param costs The SBPL costs of the map, row major
+   * @param offset Will be set to the amount to take off the values of the table, when it was computed from a nearby cell
+   */
+  boost::shared_ptr<const HeuristicTable> get(int x, int y, const std::vector<unsigned char>& costs, int& offset);
+
+  /**
+   * @brief  Compute the 2D costs from a cell to a few others, without keeping a table. The search stops as soon
+   * as the targets are reached, and does not touch the cache, so it may run in several threads at once.
+   * @param x The cell
+   * @param y The cell
+   * @param costs The SBPL costs of the map, row major
+   * @param targets The row major indices of the cells to compute the costs to
+   * @param target_costs Will be filled with the cost to each target, INFINITECOST if it can not be reached
+   */
+  void costsTo(int x, int y, const std::vector<unsigned char>& costs, const std::vector<int>& targets, std::vector<int>& target_costs) const;
+
+  /**
+   * @brief  Account for a cell that got cheaper. Higher costs leave the tables a lower bound, but a cheaper
+   * cell can shorten the paths through it by at most the cost of entering and leaving it, so the tables
+   * take that much slack. Tables that grow too loose, or that a cleared obstacle may have cut short, are dropped.
+   */
+  void costDecreased(int x, int y, unsigned char old_cost, unsigned char new_cost);
+
+  void clear(){ entries_.clear(); }
+
+  unsigned int size() const { return entries_.size(); }
+
+  unsigned int hits_, near_hits_, misses_;
+
+private:
+  struct Entry{
+    boost::shared_ptr<HeuristicTable> table;
+    int slack; /**< how much the costs of the table may exceed the current ones */
+  };
+
+  /**
+   * @brief  Dijkstra over the 8-connected grid, up to max_cost or until the distances say the search is done
+   */
+  template <typename Distances>
+  void search(int x, int y, const std::vector<unsigned char>& costs, int max_cost, Distances& dist) const;
+
+  unsigned int capacity_;
+  int reuse_cost_;
+  int width_, height_;
+  int cellsize_mm_;
+  unsigned char obsthresh_;
+  std::list<Entry> entries_; /**< most recently used first */
+};
+
+/**
+ * @class CachedHeuristicEnvironment
+ * @brief A lattice environment that takes its heuristics from a HeuristicCache instead of running a 2D search for every new goal
+ */
+class CachedHeuristicEnvironment : public EnvironmentNAVXYTHETALAT{
+public:
+  CachedHeuristicEnvironment(unsigned int cache_size, double reuse_distance_m);
+
+  /**
+   * @brief  Must be called after InitializeEnv, with the same parameters
+   */
+  void initializeHeuristics(int width, int height, double cellsize_m, double nominalvel_mpersecs, unsigned char obsthresh);
+
+  /**
+   * @brief  Keep track of the cost of a cell, call along with UpdateCost
+   */
+  void setCellCost(int x, int y, unsigned char cost);
+
+  /**
+   * @brief  Tell the environment which states the heuristics are computed from
+   */
+  void setEndpoints(int start_state_id, int goal_state_id);
+
+  virtual void EnsureHeuristicsUpdated(bool bGoalHeuristics);
+  virtual int GetGoalHeuristic(int stateID);
+  virtual int GetStartHeuristic(int stateID);
+
+  const HeuristicCache& getCache() const { return cache_; }
+
+private:
+  int heuristic(const boost::shared_ptr<const HeuristicTable>& table, int offset, int to_x, int to_y, int stateID);
+
+  HeuristicCache cache_;
+  std::vector<unsigned char> costs_;
+  int width_, height_;
+  double cellsize_m_, nominalvel_mpersecs_;
+
+  int start_x_, start_y_, goal_x_, goal_y_;
+  boost::shared_ptr<const HeuristicTable> start_table_, goal_table_;
+  int start_offset_, goal_offset_;
+};
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef SBPL_LATTICE_PLANNER_LATTICE_ENVIRONMENT_H
+#define SBPL_LATTICE_PLANNER_LATTICE_ENVIRONMENT_H
+
+#include <string>
+#include <vector>
+#include <geometry_msgs/Point.h>
+#include <costmap_2d/costmap_2d.h>
+
+// sbpl headers
+#include <sbpl/headers.h>
+#include <sbpl_lattice_planner/heuristic_cache.h>
+
+namespace sbpl_lattice_planner{
+
+/**
+ * @brief  Fill a table with the SBPL cost of every costmap cost, as the planner maps them
+ * @param lethal_obstacle The SBPL cost of a lethal cell, inscribed cells get one less and the rest is scaled below that
+ * @param lut Will be filled with the SBPL cost of every costmap cost
+ */
+void buildCostLUT(unsigned char lethal_obstacle, unsigned char lut[256]);
+
+/**
+ * @brief  Turn a footprint into the perimeter the lattice environment checks the motions with
+ */
+std::vector<sbpl_2Dpt_t> footprintToPerimeter(const std::vector<geometry_msgs::Point>& footprint);
+
+/**
+ * @brief  Set up a lattice environment over a costmap, as SBPLLatticePlanner::initialize does
+ * @param env The environment to set up
+ * @param heuristic_env env, if it caches its heuristics, NULL otherwise
+ * @param cost_map The costmap, whose costs are copied into the environment
+ * @param perimeter The footprint of the robot
+ * @param lut The SBPL cost of every costmap cost, from buildCostLUT
+ * @param primitive_filename The motion primitives
+ * @return False if SBPL refused the parameters or the motion primitives
+ */
+bool initializeLatticeEnvironment(EnvironmentNAVXYTHETALAT* env, CachedHeuristicEnvironment* heuristic_env,
+                                  const costmap_2d::Costmap2D& cost_map, const std::vector<sbpl_2Dpt_t>& perimeter,
+                                  const unsigned char lut[256], double nominalvel_mpersecs,
+                                  double timetoturn45degsinplace_secs, const std::string& primitive_filename);
+
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef SBPL_LATTICE_PLANNER_PATH_SMOOTHER_H
+#define SBPL_LATTICE_PLANNER_PATH_SMOOTHER_H
+
+#include <vector>
+
+#include <costmap_2d/costmap_2d.h>
+#include <geometry_msgs/PoseStamped.h>
+
+namespace sbpl_lattice_planner{
+
+/**
+ * @class PathSmoother
+ * @brief Post-processing of the poses of a lattice path: shortcuts, smoothing and a velocity profile
+ *
+ * The path is split where the kind of motion changes (driving forward, backward, sideways or
+ * turning in place), and those poses are kept exactly as the motion primitives left them. Within
+ * a stretch of one kind of motion, poses are replaced by straight lines wherever that does not
+ * bring the robot closer to obstacles than the lattice path did, and stretches driven forward or
+ * backward are then smoothed against the costmap under the same rule.
+ */
+class PathSmoother{
+public:
+  PathSmoother();
+
+  /**
+   * @param iterations The number of smoothing sweeps, 0 to only take shortcuts
+   * @param smooth_weight How hard each pose is pulled towards the middle of its neighbors
+   * @param data_weight How hard each pose is pulled back towards where it started
+   */
+  void setSmoothing(int iterations, double smooth_weight, double data_weight);
+
+  /**
+   * @param max_vel The top speed, in m/s
+   * @param max_rot_vel The top rotational speed, in rad/s, it bounds the speed on curves
+   * @param acc_lim The linear acceleration limit, in m/s^2
+   * @param max_lateral_acc The centripetal acceleration limit, in m/s^2
+   */
+  void setLimits(double max_vel, double max_rot_vel, double acc_lim, double max_lateral_acc);
+
+  /**
+   * @brief  Shortcut and smooth a path in place
+   * @param cost_map The costmap the path was planned in, the poses are in its world frame
+   */
+  void smooth(const costmap_2d::Costmap2D& cost_map, std::vector<geometry_msgs::PoseStamped>& plan) const;
+
+  /**
+   * @brief  Compute the speed at every pose of a path, bounded by the curvature and the acceleration limits,
+   * and the time it takes to get there. The robot stops at the end of the path, where it reverses and where it turns in place.
+   */
+  void timeParameterize(const std::vector<geometry_msgs::PoseStamped>& plan, std::vector<double>& velocities,
+                        std::vector<double>& times) const;
+
+private:
+  struct Waypoint{
+    double x, y, theta;
+  };
+
+  enum Motion{ FORWARD, BACKWARD, LATERAL, ROTATION };
+
+  static Motion classify(const Waypoint& a, const Waypoint& b);
+
+  /**
+   * @brief  Replace the poses from..to of a stretch of one kind of motion with straight lines where possible
+   */
+  void shortcut(const costmap_2d::Costmap2D& cost_map, const std::vector<Waypoint>& path, unsigned int from,
+                unsigned int to, Motion motion, std::vector<Waypoint>& run) const;
+
+  /**
+   * @brief  Smooth the inner poses of a run and face them along it, leaving alone the poses at or above headingCost()
+   */
+  void smoothRun(const costmap_2d::Costmap2D& cost_map, Motion motion, std::vector<Waypoint>& run) const;
+
+  /**
+   * @brief  The lowest cost at which the footprint may hit an obstacle at some heading, only the lattice checks poses there
+   */
+  static unsigned char headingCost(const costmap_2d::Costmap2D& cost_map);
+
+  /**
+   * @brief  Check whether no cell on the segment a-b costs more than limit
+   */
+  bool segmentFree(const costmap_2d::Costmap2D& cost_map, const Waypoint& a, const Waypoint& b, unsigned char limit) const;
+
+  /**
+   * @brief  The cost of the cell under a point, LETHAL_OBSTACLE off the map
+   */
+  static unsigned char cellCost(const costmap_2d::Costmap2D& cost_map, double x, double y);
+
+  int iterations_;
+  double smooth_weight_, data_weight_;
+  double max_vel_, max_rot_vel_, acc_lim_, max_lateral_acc_;
+};
+};
+
+#endif
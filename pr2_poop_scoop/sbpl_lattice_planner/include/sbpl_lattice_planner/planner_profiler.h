@@ -0,0 +1,105 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef SBPL_LATTICE_PLANNER_PLANNER_PROFILER_H
+#define SBPL_LATTICE_PLANNER_PLANNER_PROFILER_H
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <sbpl_lattice_planner/SBPLLatticePlannerProfile.h>
+
+namespace sbpl_lattice_planner{
+
+/**
+ * @brief What went into one call to makePlan
+ */
+struct PlanSample{
+  PlanSample();
+
+  double stamp; /**< when the plan was made, in seconds */
+  double latency; /**< wall time of the whole request, in seconds */
+  bool searched; /**< whether the request ran a search, the costmap and search fields below are only set if it did */
+  double diff_time; /**< wall time spent getting the costmap and pushing its changes into the environment */
+  int changed_cells; /**< how many cells changed their SBPL cost since the last plan */
+  bool from_scratch; /**< whether changed_cells went over force_scratch_limit */
+  double search_time; /**< wall time spent in the search */
+  int expansions;
+  double epsilon; /**< the suboptimality bound of the solution */
+  bool solved;
+  int solution_cost;
+  double conversion_time; /**< wall time spent turning the solution into poses */
+  double allocated_time;
+  int force_scratch_limit;
+};
+
+/**
+ * @class PlannerProfiler
+ * @brief Keeps the samples of the last few plans, sums them up as histograms and logs every one of them to a CSV file
+ */
+class PlannerProfiler{
+public:
+  PlannerProfiler();
+  ~PlannerProfiler();
+
+  /**
+   * @param window The number of plans the histograms are made of
+   * @param csv_filename The file to append a line per plan to, none if empty
+   */
+  void initialize(unsigned int window, const std::string& csv_filename);
+
+  void add(const PlanSample& sample);
+
+  /**
+   * @brief  Fill a profile message with the histograms of the plans in the window
+   */
+  void getProfile(SBPLLatticePlannerProfile& profile) const;
+
+private:
+  /**
+   * @brief  A histogram with log spaced bins between lo and hi, bins_per_decade to a factor of 10
+   */
+  static void histogram(const std::string& name, std::vector<double>& values, double lo, double hi,
+                        int bins_per_decade, PlannerHistogram& hist);
+
+  unsigned int window_;
+  std::deque<PlanSample> samples_; /**< most recent last */
+  FILE* csv_;
+};
+};
+
+#endif
@@ -12,8 +12,15 @@ using namespace std;
 // Costmap used for the map representation
 #include <costmap_2d/costmap_2d_ros.h>
 
+#include <boost/thread.hpp>
+
 // sbpl headers
 #include <sbpl/headers.h>
+#include <sbpl_lattice_planner/heuristic_cache.h>
+#include <sbpl_lattice_planner/lattice_environment.h>
+#include <sbpl_lattice_planner/PlanTour.h>
+#include <sbpl_lattice_planner/planner_profiler.h>
+#include <sbpl_lattice_planner/path_smoother.h>
 
 //global representation
 #include <nav_core/base_global_planner.h>
@@ -56,23 +63,90 @@ public:
                         const geometry_msgs::PoseStamped& goal, 
                         std::vector<geometry_msgs::PoseStamped>& plan);
 
-  virtual ~SBPLLatticePlanner(){};
+  virtual ~SBPLLatticePlanner();
 
 private:
-  unsigned char costMapCostToSBPLCost(unsigned char newcost);
+  /**
+   * @brief  The body of makePlan, which hands the sample to the profiler whichever way this returns
+   * @param sample Will be filled with what the request took
+   */
+  bool planRequest(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                   std::vector<geometry_msgs::PoseStamped>& plan, PlanSample& sample);
+
+  /**
+   * @brief  Push the cells of cost_map_ whose cost changed since the last call into the environment
+   * @param changedcellsV Will be filled with the cells whose SBPL cost changed
+   * @return The number of changed cells
+   */
+  int updateChangedCells(std::vector<nav2dcell_t>& changedcellsV);
+
+  /**
+   * @brief  Get a fresh copy of the costmap and pass its changes on to the planner
+   * @return The number of changed cells, -1 on failure
+   */
+  int updateCosts();
+
+  bool setStartAndGoal(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal);
+
+  /**
+   * @brief  Run the planner and convert its solution into poses
+   * @param allocated_time The time the planner may take
+   * @param start The start pose, for the height of the plan
+   * @param plan Will be filled with the plan
+   * @param solution_cost Will be set to the cost of the solution
+   * @return True if a solution was found
+   */
+  bool runPlanner(double allocated_time, const geometry_msgs::PoseStamped& start,
+                  std::vector<geometry_msgs::PoseStamped>& plan, int& solution_cost);
+
+  void publishPlan(const std::vector<geometry_msgs::PoseStamped>& plan);
+
+  /**
+   * @brief  Check whether two goals fall on the same lattice state
+   */
+  bool sameGoal(const geometry_msgs::PoseStamped& a, const geometry_msgs::PoseStamped& b) const;
+
+  /**
+   * @brief  Hand out the path the background thread holds for a goal, starting at the pose closest to the robot
+   * @return False if the background thread has no path to that goal
+   */
+  bool serveBackgroundPlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                           std::vector<geometry_msgs::PoseStamped>& plan);
+
+  /**
+   * @brief  Keeps improving the path to the current goal, replan_slice_time_ seconds at a time
+   */
+  void replanThread();
+
+  /**
+   * @brief  Service call that orders a set of goals into a short tour. The costs between the goals are the
+   * 2D costs the lattice heuristic is made of, computed in tour_threads_ threads, and the order comes from
+   * orderTour. The legs of the tour are then planned on the lattice if the request asks for it.
+   */
+  bool planTour(PlanTour::Request& req, PlanTour::Response& res);
+
   void publishStats(int solution_cost, int solution_size, 
                     const geometry_msgs::PoseStamped& start, 
                     const geometry_msgs::PoseStamped& goal);
 
+  /**
+   * @brief  Hand a sample to the profiler and publish the histograms
+   * @param sample What the request took
+   * @param request_start When makePlan was called
+   */
+  void recordPlan(PlanSample& sample, const ros::WallTime& request_start);
+
   bool initialized_;
 
   SBPLPlanner* planner_;
   EnvironmentNAVXYTHETALAT* env_;
+  CachedHeuristicEnvironment* heuristic_env_; /**< env_, when the heuristics are cached */
   
   std::string planner_type_; /**< sbpl method to use for planning.  choices are ARAPlanner and ADPlanner */
 
   double allocated_time_; /**< amount of time allowed for search */
   double initial_epsilon_; /**< initial epsilon for beginning the anytime search */
+  double nominalvel_mpersecs_; /**< the nominal velocity of the robot, the 2D costs are divided by it like the heuristics are */
 
   std::string environment_type_; /** what type of environment in which to plan.  choices are 2D and XYThetaLattice. */ 
   std::string cost_map_topic_; /** what topic is being used for the costmap topic */
@@ -84,6 +158,8 @@ private:
   unsigned char lethal_obstacle_;
   unsigned char inscribed_inflated_obstacle_;
   unsigned char sbpl_cost_multiplier_;
+  unsigned char cost_lut_[256]; /**< the SBPL cost of every costmap cost, from buildCostLUT */
+  std::vector<unsigned char> last_costs_; /**< the costmap costs the environment was last updated with */
 
 
   costmap_2d::Costmap2DROS* costmap_ros_; /**< manages the cost map for us */
@@ -91,9 +167,39 @@ private:
 
   ros::Publisher plan_pub_;
   ros::Publisher stats_publisher_;
+  ros::Publisher profile_publisher_;
+  ros::Publisher timed_plan_pub_;
+  ros::ServiceServer tour_service_;
   
   std::vector<geometry_msgs::Point> footprint_;
 
+  bool background_replanning_; /**< whether to improve the plan in a background thread between requests */
+  double replan_slice_time_; /**< how long the background thread plans before it publishes its path */
+  double epsilon_decay_; /**< how much lower than the last solution's epsilon a restarted background search begins */
+
+  boost::mutex planner_mutex_; /**< guards env_, planner_ and cost_map_ */
+  boost::mutex plan_mutex_; /**< guards the bg_ members */
+  boost::condition_variable replan_cond_;
+  boost::thread* replan_thread_;
+  bool shutdown_;
+
+  bool bg_active_; /**< whether the background thread has a goal */
+  bool bg_converged_; /**< whether the background plan can not be improved anymore */
+  geometry_msgs::PoseStamped bg_start_, bg_goal_;
+  std::vector<geometry_msgs::PoseStamped> bg_plan_; /**< the best plan to bg_goal_ so far */
+  double bg_epsilon_; /**< the suboptimality bound of bg_plan_ */
+  double bg_time_; /**< the time spent improving bg_plan_ since the last request */
+
+  int tour_threads_; /**< how many threads compute the costs between the goals of a tour, 0 for one per core */
+  double tour_leg_time_; /**< the time the planner may take for each leg of a tour */
+
+  bool smooth_path_; /**< whether to shortcut and smooth the lattice path before handing it out */
+  PathSmoother smoother_;
+
+  PlannerProfiler profiler_;
+  boost::mutex profile_mutex_; /**< guards profiler_ */
+  PlanSample sample_; /**< the plan being made, filled in by updateCosts and runPlanner, guarded by planner_mutex_ */
+
 };
 };
 
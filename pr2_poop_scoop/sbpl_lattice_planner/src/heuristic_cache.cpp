@@ -0,0 +1,283 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include <sbpl_lattice_planner/heuristic_cache.h>
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+
+using namespace std;
+
+namespace sbpl_lattice_planner{
+
+namespace{
+  //distances over the whole map, one per cell
+  struct DenseDistances{
+    DenseDistances(vector<int>& dist) : dist_(dist) {}
+    int get(int index) const { return dist_[index]; }
+    void set(int index, int value){ dist_[index] = value; }
+    bool settled(int index){ return false; }
+    vector<int>& dist_;
+  };
+
+  //distances for the few cells around a goal
+  struct SparseDistances{
+    int get(int index) const {
+      map<int, int>::const_iterator it = dist_.find(index);
+      return it == dist_.end() ? INFINITECOST : it->second;
+    }
+    void set(int index, int value){ dist_[index] = value; }
+    bool settled(int index){ return false; }
+    map<int, int> dist_;
+  };
+
+  //distances over the whole map, the search stops once the ones to the targets are known
+  struct TargetDistances{
+    TargetDistances(int num_cells, const vector<int>& targets) : dist_(num_cells, INFINITECOST), targets_(targets) {
+      sort(targets_.begin(), targets_.end());
+      targets_.erase(unique(targets_.begin(), targets_.end()), targets_.end());
+      remaining_ = targets_.size();
+    }
+    int get(int index) const { return dist_[index]; }
+    void set(int index, int value){ dist_[index] = value; }
+    bool settled(int index){
+      if(binary_search(targets_.begin(), targets_.end(), index))
+        remaining_--;
+      return remaining_ == 0;
+    }
+    vector<int> dist_;
+    vector<int> targets_;
+    int remaining_;
+  };
+};
+
+HeuristicCache::HeuristicCache(unsigned int capacity, int reuse_cost)
+  : hits_(0), near_hits_(0), misses_(0), capacity_(capacity), reuse_cost_(reuse_cost),
+    width_(0), height_(0), cellsize_mm_(0), obsthresh_(0){
+}
+
+void HeuristicCache::setMap(int width, int height, double cellsize_m, unsigned char obsthresh){
+  width_ = width;
+  height_ = height;
+  cellsize_mm_ = (int)(cellsize_m * 1000 + 0.5);
+  obsthresh_ = obsthresh;
+  entries_.clear();
+}
+
+template <typename Distances>
+void HeuristicCache::search(int x, int y, const vector<unsigned char>& costs, int max_cost, Distances& dist) const{
+  static const int dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+  static const int dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  const int step[2] = {cellsize_mm_, cellsize_mm_ * 1414 / 1000};
+
+  typedef pair<int, int> QueueEntry; //cost, cell
+  priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry> > queue;
+  dist.set(y * width_ + x, 0);
+  queue.push(QueueEntry(0, y * width_ + x));
+  while(!queue.empty()){
+    QueueEntry top = queue.top();
+    queue.pop();
+    int index = top.second;
+    if(top.first > dist.get(index))
+      continue;
+    if(dist.settled(index))
+      break;
+    int cx = index % width_, cy = index / width_;
+    for(int d = 0; d < 8; ++d){
+      int nx = cx + dx[d], ny = cy + dy[d];
+      if(nx < 0 || ny < 0 || nx >= width_ || ny >= height_)
+        continue;
+      int next = ny * width_ + nx;
+      if(costs[next] >= obsthresh_)
+        continue;
+      //same edge cost as the SBPL 2D search: the cost of the more expensive cell, times the length of the step
+      int cost = top.first + (max(costs[index], costs[next]) + 1) * step[d & 1];
+      if(cost > max_cost || cost >= dist.get(next))
+        continue;
+      dist.set(next, cost);
+      queue.push(QueueEntry(cost, next));
+    }
+  }
+}
+
+boost::shared_ptr<const HeuristicTable> HeuristicCache::get(int x, int y, const vector<unsigned char>& costs, int& offset){
+  //the table of this very cell
+  for(list<Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it){
+    if(it->table->x == x && it->table->y == y){
+      entries_.splice(entries_.begin(), entries_, it);
+      offset = entries_.front().slack;
+      hits_++;
+      return entries_.front().table;
+    }
+  }
+
+  //the table of a cell close by: by the triangle inequality, its costs less the cost of getting
+  //from this cell to the other one are a lower bound on the costs from this cell
+  if(reuse_cost_ > 0 && !entries_.empty()){
+    SparseDistances around;
+    search(x, y, costs, reuse_cost_, around);
+    list<Entry>::iterator best = entries_.end();
+    int best_offset = INFINITECOST;
+    for(list<Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it){
+      int to_table = around.get(it->table->y * width_ + it->table->x);
+      if(to_table < INFINITECOST && to_table + it->slack < best_offset){
+        best_offset = to_table + it->slack;
+        best = it;
+      }
+    }
+    if(best != entries_.end() && best_offset <= reuse_cost_){
+      entries_.splice(entries_.begin(), entries_, best);
+      offset = best_offset;
+      near_hits_++;
+      return entries_.front().table;
+    }
+  }
+
+  //compute a new table, in place of the least recently used one
+  misses_++;
+  Entry entry;
+  if(capacity_ > 0 && entries_.size() >= capacity_){
+    entry.table = entries_.back().table;
+    entries_.pop_back();
+    //the table may still be in use by the environment
+    if(!entry.table.unique())
+      entry.table.reset();
+  }
+  if(!entry.table)
+    entry.table.reset(new HeuristicTable());
+  entry.table->x = x;
+  entry.table->y = y;
+  entry.table->costs.assign(width_ * height_, INFINITECOST);
+  DenseDistances dist(entry.table->costs);
+  search(x, y, costs, INFINITECOST, dist);
+  entry.slack = 0;
+  offset = 0;
+  if(capacity_ > 0)
+    entries_.push_front(entry);
+  return entry.table;
+}
+
+void HeuristicCache::costsTo(int x, int y, const vector<unsigned char>& costs, const vector<int>& targets, vector<int>& target_costs) const{
+  TargetDistances dist(width_ * height_, targets);
+  search(x, y, costs, INFINITECOST, dist);
+  target_costs.resize(targets.size());
+  for(unsigned int i = 0; i < targets.size(); ++i)
+    target_costs[i] = dist.get(targets[i]);
+}
+
+void HeuristicCache::costDecreased(int x, int y, unsigned char old_cost, unsigned char new_cost){
+  int slack = 2 * (old_cost - new_cost) * (cellsize_mm_ * 1414 / 1000);
+  for(list<Entry>::iterator it = entries_.begin(); it != entries_.end();){
+    it->slack += slack;
+    //a cleared obstacle can open paths the table never saw
+    if(old_cost >= obsthresh_ || it->slack > reuse_cost_)
+      it = entries_.erase(it);
+    else
+      ++it;
+  }
+}
+
+CachedHeuristicEnvironment::CachedHeuristicEnvironment(unsigned int cache_size, double reuse_distance_m)
+  : cache_(cache_size, (int)(reuse_distance_m * 1000)), width_(0), height_(0), cellsize_m_(0.0), nominalvel_mpersecs_(1.0),
+    start_x_(-1), start_y_(-1), goal_x_(-1), goal_y_(-1), start_offset_(0), goal_offset_(0){
+}
+
+void CachedHeuristicEnvironment::initializeHeuristics(int width, int height, double cellsize_m, double nominalvel_mpersecs, unsigned char obsthresh){
+  width_ = width;
+  height_ = height;
+  cellsize_m_ = cellsize_m;
+  nominalvel_mpersecs_ = nominalvel_mpersecs;
+  costs_.assign(width * height, 0);
+  cache_.setMap(width, height, cellsize_m, obsthresh);
+  start_table_.reset();
+  goal_table_.reset();
+}
+
+void CachedHeuristicEnvironment::setCellCost(int x, int y, unsigned char cost){
+  unsigned char& old_cost = costs_[y * width_ + x];
+  if(cost < old_cost)
+    cache_.costDecreased(x, y, old_cost, cost);
+  old_cost = cost;
+}
+
+void CachedHeuristicEnvironment::setEndpoints(int start_state_id, int goal_state_id){
+  int theta;
+  GetCoordFromState(start_state_id, start_x_, start_y_, theta);
+  GetCoordFromState(goal_state_id, goal_x_, goal_y_, theta);
+  start_table_.reset();
+  goal_table_.reset();
+}
+
+void CachedHeuristicEnvironment::EnsureHeuristicsUpdated(bool bGoalHeuristics){
+  if(bGoalHeuristics){
+    if(goal_x_ >= 0)
+      goal_table_ = cache_.get(goal_x_, goal_y_, costs_, goal_offset_);
+  }
+  else{
+    if(start_x_ >= 0)
+      start_table_ = cache_.get(start_x_, start_y_, costs_, start_offset_);
+  }
+}
+
+int CachedHeuristicEnvironment::heuristic(const boost::shared_ptr<const HeuristicTable>& table, int offset, int to_x, int to_y, int stateID){
+  int x, y, theta;
+  GetCoordFromState(stateID, x, y, theta);
+
+  int h2D = table->costs[y * width_ + x];
+  if(h2D >= INFINITECOST)
+    return INFINITECOST;
+  h2D = max(0, h2D - offset);
+  int hEuclid = (int)(1000 * cellsize_m_ * sqrt((double)((x - to_x) * (x - to_x) + (y - to_y) * (y - to_y))));
+  return (int)(((double)max(h2D, hEuclid)) / nominalvel_mpersecs_);
+}
+
+int CachedHeuristicEnvironment::GetGoalHeuristic(int stateID){
+  if(!goal_table_)
+    EnsureHeuristicsUpdated(true);
+  if(!goal_table_)
+    return 0;
+  return heuristic(goal_table_, goal_offset_, goal_x_, goal_y_, stateID);
+}
+
+int CachedHeuristicEnvironment::GetStartHeuristic(int stateID){
+  if(!start_table_)
+    EnsureHeuristicsUpdated(false);
+  if(!start_table_)
+    return 0;
+  return heuristic(start_table_, start_offset_, start_x_, start_y_, stateID);
+}
+};
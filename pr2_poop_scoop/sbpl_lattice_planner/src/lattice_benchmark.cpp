@@ -0,0 +1,467 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Offline benchmark for the lattice planner. The costmap is built from a
+   map_server map file instead of a running move_base, so runs are
+   reproducible and need no ROS master.
+
+   Usage: lattice_benchmark [options] <map.yaml> <primitives.mprim> <queries.txt>
+
+   Every line of the queries file holds a start and a goal pose in the frame
+   of the map: "start_x start_y start_theta goal_x goal_y goal_theta", lines
+   starting with # are skipped. Every query is planned with every planner,
+   initial epsilon and time budget given on the command line, and the time,
+   cost and expansions of each plan are printed along with a summary per
+   configuration. benchmark/blank_map_queries.txt is a sample query set.
+
+   The footprint and the inflation come from the costmap parameters and the
+   planner settings from the SBPLLatticePlanner parameters that move_base is
+   launched with (launch/move_base/ by default), and the environment is set
+   up by the same code as the planner's, so the numbers carry over. The
+   command line options override the parameter files. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <libgen.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <costmap_2d/costmap_2d.h>
+#include <map_server/image_loader.h>
+#include <nav_msgs/GetMap.h>
+#include <yaml-cpp/yaml.h>
+#include <sbpl_lattice_planner/heuristic_cache.h>
+#include <sbpl_lattice_planner/lattice_environment.h>
+
+using namespace std;
+
+struct BenchmarkOptions{
+  //the defaults of SBPLLatticePlanner and Costmap2DROS, for the parameters the files do not set
+  BenchmarkOptions()
+    : initial_epsilon(3.0), allocated_time(10.0), heuristic_cache_size(4), heuristic_reuse_distance(0.5),
+      forward_search(false), lethal_obstacle(20), nominalvel_mpersecs(0.4), timetoturn45degsinplace_secs(0.6),
+      inflation_radius(0.55), cost_scaling_factor(10.0), footprint_padding(0.01){
+  }
+
+  vector<string> planners;
+  vector<double> epsilons;
+  vector<double> times;
+  double initial_epsilon;
+  double allocated_time;
+  int heuristic_cache_size;
+  double heuristic_reuse_distance;
+  bool forward_search;
+  int lethal_obstacle;
+  double nominalvel_mpersecs;
+  double timetoturn45degsinplace_secs;
+  double inflation_radius;
+  double cost_scaling_factor;
+  vector<geometry_msgs::Point> footprint;
+  double footprint_padding;
+};
+
+struct BenchmarkQuery{
+  double start_x, start_y, start_theta;
+  double goal_x, goal_y, goal_theta;
+};
+
+struct BenchmarkResult{
+  BenchmarkResult() : runs(0), solved(0), seconds(0.0), first_seconds(0.0), cost(0.0), expansions(0.0), epsilon(0.0) {}
+
+  void print(const char* planner, double eps, double time) const{
+    printf("%-10s %5.2f %6.2f %7s %4u/%-4u %10.4f %10.4f %12.0f %12.0f %6.2f\n", planner, eps, time, "total", solved, runs,
+           runs ? seconds / runs : 0.0, solved ? first_seconds / solved : 0.0, solved ? cost / solved : 0.0,
+           runs ? expansions / runs : 0.0, solved ? epsilon / solved : 0.0);
+  }
+
+  unsigned int runs, solved;
+  double seconds, first_seconds, cost, expansions, epsilon;
+};
+
+/** \brief Comma separated values */
+template <typename T>
+static vector<T> parseList(const char* arg){
+  vector<T> values;
+  stringstream ss(arg);
+  string item;
+  while(getline(ss, item, ',')){
+    stringstream is(item);
+    T value;
+    if(is >> value)
+      values.push_back(value);
+  }
+  return values;
+}
+
+static bool loadQueries(const char* filename, vector<BenchmarkQuery>& queries){
+  ifstream fin(filename);
+  if(!fin){
+    ROS_ERROR("Unable to open '%s'", filename);
+    return false;
+  }
+  string line;
+  while(getline(fin, line)){
+    if(line.empty() || line[0] == '#')
+      continue;
+    BenchmarkQuery q;
+    stringstream ss(line);
+    if(ss >> q.start_x >> q.start_y >> q.start_theta >> q.goal_x >> q.goal_y >> q.goal_theta)
+      queries.push_back(q);
+    else
+      ROS_WARN("Skipping malformed query '%s'", line.c_str());
+  }
+  return !queries.empty();
+}
+
+/** \brief Read a map the way map_server does */
+static bool loadMap(const char* filename, nav_msgs::GetMap::Response& map){
+  string image;
+  double resolution, occupied_thresh, free_thresh;
+  double origin[3];
+  int negate;
+  try{
+    ifstream fin(filename);
+    YAML::Parser parser(fin);
+    YAML::Node doc;
+    parser.GetNextDocument(doc);
+    doc["image"] >> image;
+    doc["resolution"] >> resolution;
+    doc["negate"] >> negate;
+    doc["occupied_thresh"] >> occupied_thresh;
+    doc["free_thresh"] >> free_thresh;
+    for(int i = 0; i < 3; ++i)
+      doc["origin"][i] >> origin[i];
+  }
+  catch(YAML::Exception& e){
+    ROS_ERROR("Unable to parse '%s': %s", filename, e.what());
+    return false;
+  }
+
+  //the image is relative to the map file
+  if(!image.empty() && image[0] != '/'){
+    char* dir = strdup(filename);
+    image = string(dirname(dir)) + "/" + image;
+    free(dir);
+  }
+  try{
+    map_server::loadMapFromFile(&map, image.c_str(), resolution, negate, occupied_thresh, free_thresh, origin);
+  }
+  catch(std::runtime_error& e){
+    ROS_ERROR("Unable to load '%s': %s", image.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+/** \brief Read a value if the node has it */
+template <typename T>
+static void readParam(const YAML::Node& node, const char* key, T& value){
+  if(const YAML::Node* n = node.FindValue(key))
+    *n >> value;
+}
+
+/** \brief Read the footprint and the inflation from the costmap parameters */
+static bool loadCostmapParams(const string& filename, BenchmarkOptions& options){
+  try{
+    ifstream fin(filename.c_str());
+    YAML::Parser parser(fin);
+    YAML::Node doc;
+    parser.GetNextDocument(doc);
+    if(const YAML::Node* footprint = doc.FindValue("footprint")){
+      options.footprint.clear();
+      for(unsigned int i = 0; i < footprint->size(); ++i){
+        geometry_msgs::Point pt;
+        (*footprint)[i][0] >> pt.x;
+        (*footprint)[i][1] >> pt.y;
+        options.footprint.push_back(pt);
+      }
+    }
+    readParam(doc, "footprint_padding", options.footprint_padding);
+    readParam(doc, "inflation_radius", options.inflation_radius);
+    readParam(doc, "cost_scaling_factor", options.cost_scaling_factor);
+  }
+  catch(YAML::Exception& e){
+    ROS_ERROR("Unable to parse '%s': %s", filename.c_str(), e.what());
+    return false;
+  }
+  if(options.footprint.size() < 3){
+    ROS_ERROR("'%s' has no footprint", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+/** \brief Read the planner settings from the SBPLLatticePlanner parameters */
+static bool loadPlannerParams(const string& filename, BenchmarkOptions& options){
+  try{
+    ifstream fin(filename.c_str());
+    YAML::Parser parser(fin);
+    YAML::Node doc;
+    parser.GetNextDocument(doc);
+    const YAML::Node* params = doc.FindValue("SBPLLatticePlanner");
+    const YAML::Node& node = params ? *params : doc;
+    readParam(node, "initial_epsilon", options.initial_epsilon);
+    readParam(node, "allocated_time", options.allocated_time);
+    readParam(node, "forward_search", options.forward_search);
+    readParam(node, "heuristic_cache_size", options.heuristic_cache_size);
+    readParam(node, "heuristic_reuse_distance", options.heuristic_reuse_distance);
+    readParam(node, "lethal_obstacle", options.lethal_obstacle);
+    readParam(node, "nominalvel_mpersecs", options.nominalvel_mpersecs);
+    readParam(node, "timetoturn45degsinplace_secs", options.timetoturn45degsinplace_secs);
+  }
+  catch(YAML::Exception& e){
+    ROS_ERROR("Unable to parse '%s': %s", filename.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+/** \brief Pad a footprint the way Costmap2DROS pads it, and compute its inscribed and circumscribed radii */
+static vector<geometry_msgs::Point> padFootprint(const vector<geometry_msgs::Point>& footprint, double padding,
+                                                 double& inscribed_radius, double& circumscribed_radius){
+  vector<geometry_msgs::Point> points;
+  for(unsigned int i = 0; i < footprint.size(); ++i){
+    geometry_msgs::Point pt = footprint[i];
+    pt.x += pt.x > 0 ? padding : pt.x < 0 ? -padding : 0.0;
+    pt.y += pt.y > 0 ? padding : pt.y < 0 ? -padding : 0.0;
+    points.push_back(pt);
+  }
+
+  inscribed_radius = 1e9;
+  circumscribed_radius = 0.0;
+  for(unsigned int i = 0; i < points.size(); ++i){
+    const geometry_msgs::Point& a = points[i];
+    const geometry_msgs::Point& b = points[(i + 1) % points.size()];
+    circumscribed_radius = max(circumscribed_radius, sqrt(a.x * a.x + a.y * a.y));
+    //distance from the center to the edge a-b
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double t = max(0.0, min(1.0, -(a.x * dx + a.y * dy) / (dx * dx + dy * dy)));
+    double px = a.x + t * dx, py = a.y + t * dy;
+    inscribed_radius = min(inscribed_radius, sqrt(px * px + py * py));
+  }
+  return points;
+}
+
+/** \brief Set up an environment the way SBPLLatticePlanner::initialize does */
+static EnvironmentNAVXYTHETALAT* createEnvironment(const costmap_2d::Costmap2D& cost_map, const vector<sbpl_2Dpt_t>& perimeter,
+                                                   const unsigned char lut[256], const char* primitives, const BenchmarkOptions& options){
+  sbpl_lattice_planner::CachedHeuristicEnvironment* heuristic_env = NULL;
+  EnvironmentNAVXYTHETALAT* env;
+  if(options.heuristic_cache_size > 0)
+    env = heuristic_env = new sbpl_lattice_planner::CachedHeuristicEnvironment(options.heuristic_cache_size,
+                                                                               options.heuristic_reuse_distance);
+  else
+    env = new EnvironmentNAVXYTHETALAT();
+
+  if(!sbpl_lattice_planner::initializeLatticeEnvironment(env, heuristic_env, cost_map, perimeter, lut, options.nominalvel_mpersecs,
+                                                         options.timetoturn45degsinplace_secs, primitives)){
+    delete env;
+    return NULL;
+  }
+  return env;
+}
+
+static void usage(const char* name){
+  printf("Usage: %s [options] <map.yaml> <primitives.mprim> <queries.txt>\n"
+         "  -k file       costmap parameters (launch/move_base/costmap_common_params.yaml)\n"
+         "  -g file       planner parameters (launch/move_base/sbpl_global_params.yaml)\n"
+         "  -p planners   comma separated, ARAPlanner and/or ADPlanner (both)\n"
+         "  -e epsilons   comma separated initial epsilons (initial_epsilon)\n"
+         "  -t times      comma separated time budgets in seconds (allocated_time)\n"
+         "  -c size       heuristic cache size, 0 for the plain SBPL heuristics (heuristic_cache_size)\n"
+         "  -r distance   heuristic reuse distance in meters (heuristic_reuse_distance)\n"
+         "  -l cost       lethal_obstacle (lethal_obstacle)\n"
+         "  -i radius     inflation radius (inflation_radius)\n"
+         "  -s factor     cost scaling factor (cost_scaling_factor)\n"
+         "  -d padding    footprint padding (footprint_padding)\n"
+         "  -f            search forward (forward_search)\n", name);
+}
+
+int main(int argc, char** argv){
+  //the parameter files are read first, whatever the order of the options, so that the other options override them
+  string package_path = ros::package::getPath("sbpl_lattice_planner");
+  string costmap_params = package_path + "/launch/move_base/costmap_common_params.yaml";
+  string planner_params = package_path + "/launch/move_base/sbpl_global_params.yaml";
+  vector<pair<int, string> > overrides;
+  int opt;
+  while((opt = getopt(argc, argv, "k:g:p:e:t:c:r:l:i:s:d:fh")) != -1){
+    switch(opt){
+      case 'k': costmap_params = optarg; break;
+      case 'g': planner_params = optarg; break;
+      case 'p': case 'e': case 't': case 'c': case 'r': case 'l': case 'i': case 's': case 'd':
+        overrides.push_back(make_pair(opt, string(optarg)));
+        break;
+      case 'f': overrides.push_back(make_pair(opt, string())); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if(argc - optind != 3){
+    usage(argv[0]);
+    return 1;
+  }
+
+  BenchmarkOptions options;
+  if(!loadCostmapParams(costmap_params, options) || !loadPlannerParams(planner_params, options))
+    return 1;
+  for(unsigned int i = 0; i < overrides.size(); ++i){
+    const char* arg = overrides[i].second.c_str();
+    switch(overrides[i].first){
+      case 'p': options.planners = parseList<string>(arg); break;
+      case 'e': options.epsilons = parseList<double>(arg); break;
+      case 't': options.times = parseList<double>(arg); break;
+      case 'c': options.heuristic_cache_size = atoi(arg); break;
+      case 'r': options.heuristic_reuse_distance = atof(arg); break;
+      case 'l': options.lethal_obstacle = atoi(arg); break;
+      case 'i': options.inflation_radius = atof(arg); break;
+      case 's': options.cost_scaling_factor = atof(arg); break;
+      case 'd': options.footprint_padding = atof(arg); break;
+      case 'f': options.forward_search = true; break;
+    }
+  }
+  if(options.planners.empty()){
+    options.planners.push_back("ARAPlanner");
+    options.planners.push_back("ADPlanner");
+  }
+  if(options.epsilons.empty())
+    options.epsilons.push_back(options.initial_epsilon);
+  if(options.times.empty())
+    options.times.push_back(options.allocated_time);
+  const char* map_file = argv[optind];
+  const char* primitives = argv[optind + 1];
+
+  // no master is contacted, the clock is the wall clock
+  ros::Time::init();
+
+  vector<BenchmarkQuery> queries;
+  if(!loadQueries(argv[optind + 2], queries)){
+    ROS_ERROR("No queries to plan");
+    return 1;
+  }
+
+  nav_msgs::GetMap::Response map;
+  if(!loadMap(map_file, map))
+    return 1;
+
+  double inscribed_radius, circumscribed_radius;
+  vector<sbpl_2Dpt_t> perimeter = sbpl_lattice_planner::footprintToPerimeter(
+    padFootprint(options.footprint, options.footprint_padding, inscribed_radius, circumscribed_radius));
+
+  //the same costs a static global costmap would have
+  vector<unsigned char> static_data(map.map.data.begin(), map.map.data.end());
+  costmap_2d::Costmap2D cost_map(map.map.info.width, map.map.info.height, map.map.info.resolution,
+                                 map.map.info.origin.position.x, map.map.info.origin.position.y,
+                                 inscribed_radius, circumscribed_radius, options.inflation_radius,
+                                 0.0, 0.0, 0.0, options.cost_scaling_factor, static_data, 100);
+  unsigned char lut[256];
+  sbpl_lattice_planner::buildCostLUT(options.lethal_obstacle, lut);
+  ROS_INFO("Map of %u x %u cells at %.3f m, %u queries", cost_map.getSizeInCellsX(), cost_map.getSizeInCellsY(),
+           cost_map.getResolution(), (unsigned int)queries.size());
+
+  printf("%-10s %5s %6s %7s %9s %10s %10s %12s %12s %6s\n",
+         "planner", "eps", "time", "query", "solved", "seconds", "first", "cost", "expansions", "final");
+  for(unsigned int p = 0; p < options.planners.size(); ++p){
+    for(unsigned int ep = 0; ep < options.epsilons.size(); ++ep){
+      for(unsigned int t = 0; t < options.times.size(); ++t){
+        //every configuration starts from a fresh environment, so no state carries over between them
+        EnvironmentNAVXYTHETALAT* env = createEnvironment(cost_map, perimeter, lut, primitives, options);
+        if(!env){
+          ROS_ERROR("SBPL initialization failed!");
+          return 1;
+        }
+        SBPLPlanner* planner;
+        if(options.planners[p] == "ARAPlanner")
+          planner = new ARAPlanner(env, options.forward_search);
+        else if(options.planners[p] == "ADPlanner")
+          planner = new ADPlanner(env, options.forward_search);
+        else{
+          ROS_ERROR("Unknown planner '%s'", options.planners[p].c_str());
+          return 1;
+        }
+        sbpl_lattice_planner::CachedHeuristicEnvironment* heuristic_env =
+          dynamic_cast<sbpl_lattice_planner::CachedHeuristicEnvironment*>(env);
+
+        BenchmarkResult result;
+        for(unsigned int q = 0; q < queries.size(); ++q){
+          const BenchmarkQuery& query = queries[q];
+          int solution_cost = 0;
+          vector<int> solution_stateIDs;
+          bool solved = false;
+          ros::WallTime start_time = ros::WallTime::now();
+          try{
+            int start_id = env->SetStart(query.start_x - cost_map.getOriginX(), query.start_y - cost_map.getOriginY(), query.start_theta);
+            int goal_id = env->SetGoal(query.goal_x - cost_map.getOriginX(), query.goal_y - cost_map.getOriginY(), query.goal_theta);
+            if(start_id >= 0 && goal_id >= 0 && planner->set_start(start_id) && planner->set_goal(goal_id)){
+              if(heuristic_env)
+                heuristic_env->setEndpoints(start_id, goal_id);
+              planner->set_initialsolution_eps(options.epsilons[ep]);
+              planner->set_search_mode(false);
+              solved = planner->replan(options.times[t], &solution_stateIDs, &solution_cost);
+            }
+            else
+              ROS_WARN("Query %u: invalid start or goal", q);
+          }
+          catch(SBPL_Exception e){
+            ROS_ERROR("Query %u: SBPL encountered a fatal exception", q);
+          }
+          double seconds = (ros::WallTime::now() - start_time).toSec();
+
+          result.runs++;
+          result.seconds += seconds;
+          result.expansions += planner->get_n_expands();
+          if(solved){
+            result.solved++;
+            result.first_seconds += planner->get_initial_eps_planning_time();
+            result.cost += solution_cost;
+            result.epsilon += planner->get_final_epsilon();
+          }
+          printf("%-10s %5.2f %6.2f %7u %9s %10.4f %10.4f %12d %12d %6.2f\n", options.planners[p].c_str(),
+                 options.epsilons[ep], options.times[t], q, solved ? "yes" : "no", seconds,
+                 solved ? planner->get_initial_eps_planning_time() : 0.0, solved ? solution_cost : -1,
+                 planner->get_n_expands(), solved ? planner->get_final_epsilon() : 0.0);
+        }
+        result.print(options.planners[p].c_str(), options.epsilons[ep], options.times[t]);
+
+        delete planner;
+        delete env;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include <sbpl_lattice_planner/lattice_environment.h>
+#include <ros/ros.h>
+
+using namespace std;
+
+namespace sbpl_lattice_planner{
+
+//Taken from Sachin's sbpl_cart_planner
+//This rescales the costmap according to a rosparam which sets the obstacle cost
+void buildCostLUT(unsigned char lethal_obstacle, unsigned char lut[256]){
+  unsigned char inscribed_inflated_obstacle = lethal_obstacle - 1;
+  unsigned char multiplier = (unsigned char) (costmap_2d::INSCRIBED_INFLATED_OBSTACLE / inscribed_inflated_obstacle + 1);
+  for(int cost = 0; cost < 256; ++cost){
+    if(cost == costmap_2d::LETHAL_OBSTACLE)
+      lut[cost] = lethal_obstacle;
+    else if(cost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
+      lut[cost] = inscribed_inflated_obstacle;
+    else if(cost == 0 || cost == costmap_2d::NO_INFORMATION)
+      lut[cost] = 0;
+    else
+      lut[cost] = (unsigned char) (cost / multiplier + 0.5);
+  }
+}
+
+vector<sbpl_2Dpt_t> footprintToPerimeter(const vector<geometry_msgs::Point>& footprint){
+  vector<sbpl_2Dpt_t> perimeter;
+  perimeter.reserve(footprint.size());
+  for(unsigned int i = 0; i < footprint.size(); ++i){
+    sbpl_2Dpt_t pt;
+    pt.x = footprint[i].x;
+    pt.y = footprint[i].y;
+    perimeter.push_back(pt);
+  }
+  return perimeter;
+}
+
+bool initializeLatticeEnvironment(EnvironmentNAVXYTHETALAT* env, CachedHeuristicEnvironment* heuristic_env,
+                                  const costmap_2d::Costmap2D& cost_map, const vector<sbpl_2Dpt_t>& perimeter,
+                                  const unsigned char lut[256], double nominalvel_mpersecs,
+                                  double timetoturn45degsinplace_secs, const string& primitive_filename){
+  if(!env->SetEnvParameter("cost_inscribed_thresh", lut[costmap_2d::INSCRIBED_INFLATED_OBSTACLE])){
+    ROS_ERROR("Failed to set cost_inscribed_thresh parameter");
+    return false;
+  }
+  if(!env->SetEnvParameter("cost_possibly_circumscribed_thresh", lut[cost_map.getCircumscribedCost()])){
+    ROS_ERROR("Failed to set cost_possibly_circumscribed_thresh parameter");
+    return false;
+  }
+
+  unsigned int width = cost_map.getSizeInCellsX(), height = cost_map.getSizeInCellsY();
+  bool ret;
+  try{
+    ret = env->InitializeEnv(width, // width
+                             height, // height
+                             0, // mapdata
+                             0, 0, 0, // start (x, y, theta, t)
+                             0, 0, 0, // goal (x, y, theta)
+                             0, 0, 0, //goal tolerance
+                             perimeter, cost_map.getResolution(), nominalvel_mpersecs,
+                             timetoturn45degsinplace_secs, lut[costmap_2d::LETHAL_OBSTACLE],
+                             primitive_filename.c_str());
+  }
+  catch(SBPL_Exception e){
+    ROS_ERROR("SBPL encountered a fatal exception!");
+    ret = false;
+  }
+  if(!ret)
+    return false;
+
+  if(heuristic_env)
+    heuristic_env->initializeHeuristics(width, height, cost_map.getResolution(), nominalvel_mpersecs,
+                                        lut[costmap_2d::INSCRIBED_INFLATED_OBSTACLE]);
+  const unsigned char* costs = cost_map.getCharMap();
+  for(unsigned int iy = 0; iy < height; ++iy)
+    for(unsigned int ix = 0; ix < width; ++ix){
+      env->UpdateCost(ix, iy, lut[costs[iy * width + ix]]);
+      if(heuristic_env)
+        heuristic_env->setCellCost(ix, iy, lut[costs[iy * width + ix]]);
+    }
+  return true;
+}
+
+};
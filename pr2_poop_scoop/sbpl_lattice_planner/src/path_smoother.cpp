@@ -0,0 +1,280 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include <sbpl_lattice_planner/path_smoother.h>
+#include <angles/angles.h>
+#include <tf/transform_datatypes.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace sbpl_lattice_planner{
+
+PathSmoother::PathSmoother()
+  : iterations_(50), smooth_weight_(0.3), data_weight_(0.1),
+    max_vel_(0.4), max_rot_vel_(1.0), acc_lim_(0.5), max_lateral_acc_(0.5){
+}
+
+void PathSmoother::setSmoothing(int iterations, double smooth_weight, double data_weight){
+  iterations_ = iterations;
+  smooth_weight_ = smooth_weight;
+  data_weight_ = data_weight;
+}
+
+void PathSmoother::setLimits(double max_vel, double max_rot_vel, double acc_lim, double max_lateral_acc){
+  max_vel_ = max_vel;
+  max_rot_vel_ = max_rot_vel;
+  acc_lim_ = acc_lim;
+  max_lateral_acc_ = max_lateral_acc;
+}
+
+PathSmoother::Motion PathSmoother::classify(const Waypoint& a, const Waypoint& b){
+  double dx = b.x - a.x, dy = b.y - a.y;
+  double length = sqrt(dx * dx + dy * dy);
+  if(length < 1e-3)
+    return ROTATION;
+  //the direction of travel against the heading, within 45 degrees counts as driving straight
+  double along = (dx * cos(a.theta) + dy * sin(a.theta)) / length;
+  if(along > M_SQRT1_2)
+    return FORWARD;
+  if(along < -M_SQRT1_2)
+    return BACKWARD;
+  return LATERAL;
+}
+
+unsigned char PathSmoother::cellCost(const costmap_2d::Costmap2D& cost_map, double x, double y){
+  unsigned int mx, my;
+  if(!cost_map.worldToMap(x, y, mx, my))
+    return costmap_2d::LETHAL_OBSTACLE;
+  return cost_map.getCost(mx, my);
+}
+
+unsigned char PathSmoother::headingCost(const costmap_2d::Costmap2D& cost_map){
+  unsigned char circumscribed = cost_map.getCircumscribedCost();
+  return circumscribed > 0 ? circumscribed : costmap_2d::INSCRIBED_INFLATED_OBSTACLE;
+}
+
+bool PathSmoother::segmentFree(const costmap_2d::Costmap2D& cost_map, const Waypoint& a, const Waypoint& b, unsigned char limit) const{
+  double dx = b.x - a.x, dy = b.y - a.y;
+  int steps = max(1, (int)ceil(2.0 * sqrt(dx * dx + dy * dy) / cost_map.getResolution()));
+  for(int k = 0; k <= steps; ++k){
+    double f = (double)k / steps;
+    if(cellCost(cost_map, a.x + f * dx, a.y + f * dy) > limit)
+      return false;
+  }
+  return true;
+}
+
+void PathSmoother::shortcut(const costmap_2d::Costmap2D& cost_map, const vector<Waypoint>& path, unsigned int from,
+                            unsigned int to, Motion motion, vector<Waypoint>& run) const{
+  //cells at the circumscribed cost may hit the footprint at some headings, only the lattice checks for that
+  unsigned char cap = headingCost(cost_map) - 1;
+  double spacing = cost_map.getResolution();
+
+  run.clear();
+  run.push_back(path[from]);
+  unsigned int a = from;
+  while(a < to){
+    //the farthest pose we can drive to in a straight line, with the heading the motion primitives would have,
+    //and no closer to obstacles than the poses in between
+    unsigned int b = a + 1;
+    unsigned char limit = max(cellCost(cost_map, path[a].x, path[a].y), cellCost(cost_map, path[b].x, path[b].y));
+    while(b < to){
+      const Waypoint& next = path[b + 1];
+      if(motion != LATERAL){
+        double travel = atan2(next.y - path[a].y, next.x - path[a].x) + (motion == BACKWARD ? M_PI : 0.0);
+        if(fabs(angles::shortest_angular_distance(travel, path[a].theta)) > M_PI_4 ||
+           fabs(angles::shortest_angular_distance(travel, next.theta)) > M_PI_4)
+          break;
+      }
+      unsigned char next_limit = max(limit, cellCost(cost_map, next.x, next.y));
+      if(!segmentFree(cost_map, path[a], next, min(next_limit, cap)))
+        break;
+      limit = next_limit;
+      ++b;
+    }
+
+    if(b > a + 1){
+      double dx = path[b].x - path[a].x, dy = path[b].y - path[a].y;
+      double dtheta = angles::shortest_angular_distance(path[a].theta, path[b].theta);
+      int steps = max(1, (int)ceil(sqrt(dx * dx + dy * dy) / spacing));
+      for(int k = 1; k < steps; ++k){
+        double f = (double)k / steps;
+        Waypoint w;
+        w.x = path[a].x + f * dx;
+        w.y = path[a].y + f * dy;
+        w.theta = angles::normalize_angle(path[a].theta + f * dtheta);
+        run.push_back(w);
+      }
+    }
+    run.push_back(path[b]);
+    a = b;
+  }
+}
+
+void PathSmoother::smoothRun(const costmap_2d::Costmap2D& cost_map, Motion motion, vector<Waypoint>& run) const{
+  if(run.size() < 3)
+    return;
+
+  //a pose may only move to cells that cost no more than the one it started on, and the lattice poses
+  //shortcut() kept near obstacles, where only the lattice checked the footprint, stay exactly as they are
+  unsigned char fixed = headingCost(cost_map);
+  vector<Waypoint> ref(run);
+  vector<unsigned char> limits(run.size());
+  for(unsigned int k = 0; k < run.size(); ++k)
+    limits[k] = cellCost(cost_map, ref[k].x, ref[k].y);
+
+  for(int it = 0; it < iterations_; ++it){
+    for(unsigned int k = 1; k + 1 < run.size(); ++k){
+      if(limits[k] >= fixed)
+        continue;
+      double x = run[k].x + data_weight_ * (ref[k].x - run[k].x) + smooth_weight_ * (run[k - 1].x + run[k + 1].x - 2.0 * run[k].x);
+      double y = run[k].y + data_weight_ * (ref[k].y - run[k].y) + smooth_weight_ * (run[k - 1].y + run[k + 1].y - 2.0 * run[k].y);
+      if(cellCost(cost_map, x, y) <= limits[k]){
+        run[k].x = x;
+        run[k].y = y;
+      }
+    }
+  }
+
+  //the ends keep the headings of the lattice states, the poses in between face along the path
+  for(unsigned int k = 1; k + 1 < run.size(); ++k){
+    if(limits[k] >= fixed)
+      continue;
+    double travel = atan2(run[k + 1].y - run[k - 1].y, run[k + 1].x - run[k - 1].x);
+    run[k].theta = angles::normalize_angle(travel + (motion == BACKWARD ? M_PI : 0.0));
+  }
+}
+
+void PathSmoother::smooth(const costmap_2d::Costmap2D& cost_map, vector<geometry_msgs::PoseStamped>& plan) const{
+  if(plan.size() < 3)
+    return;
+
+  vector<Waypoint> path(plan.size());
+  for(unsigned int i = 0; i < plan.size(); ++i){
+    path[i].x = plan[i].pose.position.x;
+    path[i].y = plan[i].pose.position.y;
+    path[i].theta = 2 * atan2(plan[i].pose.orientation.z, plan[i].pose.orientation.w);
+  }
+
+  //work through the path a stretch of one kind of motion at a time, turns in place are left alone
+  vector<Waypoint> smoothed(1, path[0]), run;
+  unsigned int i = 0;
+  while(i + 1 < path.size()){
+    Motion motion = classify(path[i], path[i + 1]);
+    unsigned int j = i + 1;
+    while(j + 1 < path.size() && classify(path[j], path[j + 1]) == motion)
+      ++j;
+    if(motion == ROTATION)
+      smoothed.insert(smoothed.end(), path.begin() + i + 1, path.begin() + j + 1);
+    else{
+      shortcut(cost_map, path, i, j, motion, run);
+      if(motion != LATERAL)
+        smoothRun(cost_map, motion, run);
+      smoothed.insert(smoothed.end(), run.begin() + 1, run.end());
+    }
+    i = j;
+  }
+
+  geometry_msgs::PoseStamped pose = plan[0];
+  plan.clear();
+  plan.reserve(smoothed.size());
+  for(unsigned int k = 0; k < smoothed.size(); ++k){
+    pose.pose.position.x = smoothed[k].x;
+    pose.pose.position.y = smoothed[k].y;
+
+    btQuaternion temp;
+    temp.setEulerZYX(smoothed[k].theta,0,0);
+    pose.pose.orientation.x = temp.getX();
+    pose.pose.orientation.y = temp.getY();
+    pose.pose.orientation.z = temp.getZ();
+    pose.pose.orientation.w = temp.getW();
+
+    plan.push_back(pose);
+  }
+}
+
+void PathSmoother::timeParameterize(const vector<geometry_msgs::PoseStamped>& plan, vector<double>& velocities,
+                                    vector<double>& times) const{
+  unsigned int n = plan.size();
+  velocities.assign(n, 0.0);
+  times.assign(n, 0.0);
+  if(n == 0)
+    return;
+
+  vector<Waypoint> path(n);
+  vector<double> ds(n, 0.0); //the distance from the previous pose
+  for(unsigned int i = 0; i < n; ++i){
+    path[i].x = plan[i].pose.position.x;
+    path[i].y = plan[i].pose.position.y;
+    path[i].theta = 2 * atan2(plan[i].pose.orientation.z, plan[i].pose.orientation.w);
+    if(i > 0)
+      ds[i] = sqrt((path[i].x - path[i - 1].x) * (path[i].x - path[i - 1].x) + (path[i].y - path[i - 1].y) * (path[i].y - path[i - 1].y));
+  }
+
+  //the speed each pose allows on its own
+  for(unsigned int i = 0; i + 1 < n; ++i){
+    double limit = max_vel_;
+    Motion after = classify(path[i], path[i + 1]);
+    if(after == ROTATION || (i > 0 && classify(path[i - 1], path[i]) != after))
+      limit = 0.0;
+    else if(i > 0 && ds[i] + ds[i + 1] > 1e-6){
+      //the change of heading per meter bounds both the rotational speed and the centripetal acceleration
+      double curvature = fabs(angles::shortest_angular_distance(path[i - 1].theta, path[i + 1].theta)) / (ds[i] + ds[i + 1]);
+      if(curvature > 1e-6)
+        limit = min(limit, min(max_rot_vel_ / curvature, sqrt(max_lateral_acc_ / curvature)));
+    }
+    velocities[i] = limit;
+  }
+
+  //and what the acceleration limit lets the robot reach from the poses around it
+  for(unsigned int i = 1; i < n; ++i)
+    velocities[i] = min(velocities[i], sqrt(velocities[i - 1] * velocities[i - 1] + 2.0 * acc_lim_ * ds[i]));
+  for(int i = n - 2; i >= 0; --i)
+    velocities[i] = min(velocities[i], sqrt(velocities[i + 1] * velocities[i + 1] + 2.0 * acc_lim_ * ds[i + 1]));
+
+  for(unsigned int i = 1; i < n; ++i){
+    double dt = 0.0;
+    if(ds[i] > 1e-6){
+      double v = velocities[i - 1] + velocities[i];
+      //two stops in a row: speed up for half the way and slow down for the other half
+      dt = v > 1e-6 ? 2.0 * ds[i] / v : 2.0 * sqrt(ds[i] / acc_lim_);
+    }
+    dt = max(dt, fabs(angles::shortest_angular_distance(path[i - 1].theta, path[i].theta)) / max_rot_vel_);
+    times[i] = times[i - 1] + dt;
+  }
+}
+};
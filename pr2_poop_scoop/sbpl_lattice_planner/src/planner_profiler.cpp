@@ -0,0 +1,159 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include <sbpl_lattice_planner/planner_profiler.h>
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace sbpl_lattice_planner{
+
+PlanSample::PlanSample()
+  : stamp(0.0), latency(0.0), searched(false), diff_time(0.0), changed_cells(0), from_scratch(false), search_time(0.0), expansions(0),
+    epsilon(0.0), solved(false), solution_cost(0), conversion_time(0.0), allocated_time(0.0), force_scratch_limit(0){
+}
+
+PlannerProfiler::PlannerProfiler()
+  : window_(0), csv_(NULL){
+}
+
+PlannerProfiler::~PlannerProfiler(){
+  if(csv_)
+    fclose(csv_);
+}
+
+void PlannerProfiler::initialize(unsigned int window, const std::string& csv_filename){
+  window_ = window;
+  samples_.clear();
+  if(csv_){
+    fclose(csv_);
+    csv_ = NULL;
+  }
+  if(csv_filename.empty())
+    return;
+
+  csv_ = fopen(csv_filename.c_str(), "a");
+  if(!csv_){
+    ROS_ERROR("[sbpl_lattice_planner] cannot open %s to log the plans to", csv_filename.c_str());
+    return;
+  }
+  //a new file gets a header, an old one is appended to
+  if(ftell(csv_) == 0)
+    fprintf(csv_, "stamp,latency,diff_time,changed_cells,from_scratch,search_time,expansions,epsilon,solved,solution_cost,"
+            "conversion_time,allocated_time,force_scratch_limit,searched\n");
+  ROS_INFO("[sbpl_lattice_planner] logging every plan to %s", csv_filename.c_str());
+}
+
+void PlannerProfiler::add(const PlanSample& sample){
+  if(window_ > 0){
+    samples_.push_back(sample);
+    while(samples_.size() > window_)
+      samples_.pop_front();
+  }
+
+  if(csv_){
+    fprintf(csv_, "%.6f,%.6f,%.6f,%d,%d,%.6f,%d,%.3f,%d,%d,%.6f,%.3f,%d,%d\n",
+            sample.stamp, sample.latency, sample.diff_time, sample.changed_cells, (int)sample.from_scratch,
+            sample.search_time, sample.expansions, sample.epsilon, (int)sample.solved, sample.solution_cost,
+            sample.conversion_time, sample.allocated_time, sample.force_scratch_limit, (int)sample.searched);
+    //the planner may never be shut down cleanly, keep the file usable
+    fflush(csv_);
+  }
+}
+
+void PlannerProfiler::histogram(const std::string& name, vector<double>& values, double lo, double hi,
+                                int bins_per_decade, PlannerHistogram& hist){
+  hist.name = name;
+  hist.bin_edges.clear();
+  for(int k = 0; lo * pow(10.0, (double)k / bins_per_decade) <= hi * (1.0 + 1e-9); ++k)
+    hist.bin_edges.push_back(lo * pow(10.0, (double)k / bins_per_decade));
+  hist.counts.assign(hist.bin_edges.size() + 1, 0);
+  hist.min = hist.max = hist.mean = hist.median = hist.p95 = 0.0;
+  if(values.empty())
+    return;
+
+  sort(values.begin(), values.end());
+  double sum = 0.0;
+  for(unsigned int i = 0; i < values.size(); ++i){
+    sum += values[i];
+    hist.counts[upper_bound(hist.bin_edges.begin(), hist.bin_edges.end(), values[i]) - hist.bin_edges.begin()]++;
+  }
+  hist.min = values.front();
+  hist.max = values.back();
+  hist.mean = sum / values.size();
+  hist.median = values[values.size() / 2];
+  hist.p95 = values[min(values.size() - 1, (size_t)ceil(0.95 * values.size()) - 1)];
+}
+
+void PlannerProfiler::getProfile(SBPLLatticePlannerProfile& profile) const{
+  vector<double> latency, expansion_rate, diff_time, changed_cells, conversion_time;
+  profile.window = samples_.size();
+  profile.from_scratch = profile.incremental = profile.served = profile.failed = 0;
+  for(deque<PlanSample>::const_iterator it = samples_.begin(); it != samples_.end(); ++it){
+    latency.push_back(it->latency);
+    if(!it->solved)
+      profile.failed++;
+    //requests answered without a search say nothing about the costmap diff or the search
+    if(!it->searched){
+      if(it->solved)
+        profile.served++;
+      continue;
+    }
+    diff_time.push_back(it->diff_time);
+    changed_cells.push_back(it->changed_cells);
+    if(it->search_time > 0.0)
+      expansion_rate.push_back(it->expansions / it->search_time);
+    if(it->solved)
+      conversion_time.push_back(it->conversion_time);
+    if(it->from_scratch)
+      profile.from_scratch++;
+    else
+      profile.incremental++;
+  }
+  if(!samples_.empty()){
+    profile.allocated_time = samples_.back().allocated_time;
+    profile.force_scratch_limit = samples_.back().force_scratch_limit;
+  }
+
+  profile.histograms.resize(5);
+  histogram("plan_latency", latency, 1e-3, 1e2, 4, profile.histograms[0]);
+  histogram("expansions_per_second", expansion_rate, 1e2, 1e7, 4, profile.histograms[1]);
+  histogram("costmap_diff_time", diff_time, 1e-5, 10.0, 4, profile.histograms[2]);
+  histogram("changed_cells", changed_cells, 1.0, 1e7, 4, profile.histograms[3]);
+  histogram("path_conversion_time", conversion_time, 1e-6, 1.0, 4, profile.histograms[4]);
+}
+};
@@ -39,7 +39,12 @@
 #include <pluginlib/class_list_macros.h>
 #include <nav_msgs/Path.h>
 #include <sbpl_lattice_planner/SBPLLatticePlannerStats.h>
+#include <sbpl_lattice_planner/TimedPath.h>
+#include <sbpl_lattice_planner/tour_planner.h>
 #include <angles/angles.h>
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
 
 using namespace std;
 using namespace ros;
@@ -75,12 +80,32 @@ class LatticeSCQ : public StateChangeQuery{
     mutable std::vector<int> succsOfChangedCells_;
 };
 
+//fills in the costs from every stride-th node of a tour, starting at first, to the nodes after it
+static void computeTourCosts(const HeuristicCache& grid, const std::vector<unsigned char>& costs, int width,
+                             const std::vector<int>& cells, unsigned int first, unsigned int stride, std::vector<double>& matrix){
+  unsigned int num_nodes = cells.size();
+  for(unsigned int i = first; i + 1 < num_nodes; i += stride){
+    if(cells[i] < 0)
+      continue;
+    std::vector<int> nodes, targets, target_costs;
+    for(unsigned int j = i + 1; j < num_nodes; ++j){
+      if(cells[j] < 0)
+        continue;
+      nodes.push_back(j);
+      targets.push_back(cells[j]);
+    }
+    grid.costsTo(cells[i] % width, cells[i] / width, costs, targets, target_costs);
+    for(unsigned int k = 0; k < nodes.size(); ++k)
+      matrix[i * num_nodes + nodes[k]] = matrix[nodes[k] * num_nodes + i] = target_costs[k];
+  }
+}
+
 SBPLLatticePlanner::SBPLLatticePlanner()
-  : initialized_(false), costmap_ros_(NULL){
+  : initialized_(false), heuristic_env_(NULL), costmap_ros_(NULL), replan_thread_(NULL), shutdown_(false), bg_active_(false){
 }
 
 SBPLLatticePlanner::SBPLLatticePlanner(std::string name, costmap_2d::Costmap2DROS* costmap_ros) 
-  : initialized_(false), costmap_ros_(NULL){
+  : initialized_(false), heuristic_env_(NULL), costmap_ros_(NULL), replan_thread_(NULL), shutdown_(false), bg_active_(false){
   initialize(name, costmap_ros);
 }
 
@@ -99,10 +124,41 @@ void SBPLLatticePlanner::initialize(std::string name, costmap_2d::Costmap2DROS*
     private_nh.param("forward_search", forward_search_, bool(false));
     private_nh.param("primitive_filename",primitive_filename_,string(""));
     private_nh.param("force_scratch_limit",force_scratch_limit_,500);
+    private_nh.param("background_replanning", background_replanning_, false);
+    private_nh.param("replan_slice_time", replan_slice_time_, 0.2);
+    private_nh.param("epsilon_decay", epsilon_decay_, 0.5);
+    private_nh.param("tour_threads", tour_threads_, 0);
+    private_nh.param("tour_leg_time", tour_leg_time_, 1.0);
+
+    int profile_window;
+    std::string profile_csv;
+    private_nh.param("profile_window", profile_window, 200);
+    private_nh.param("profile_csv", profile_csv, string(""));
+    profiler_.initialize(profile_window, profile_csv);
+
+    int heuristic_cache_size;
+    double heuristic_reuse_distance;
+    private_nh.param("heuristic_cache_size", heuristic_cache_size, 4);
+    private_nh.param("heuristic_reuse_distance", heuristic_reuse_distance, 0.5);
 
     double nominalvel_mpersecs, timetoturn45degsinplace_secs;
     private_nh.param("nominalvel_mpersecs", nominalvel_mpersecs, 0.4);
     private_nh.param("timetoturn45degsinplace_secs", timetoturn45degsinplace_secs, 0.6);
+    nominalvel_mpersecs_ = nominalvel_mpersecs;
+
+    int smoothing_iterations;
+    double smoothing_weight, smoothing_data_weight;
+    double max_vel_x, max_rotational_vel, acc_lim_x, max_lateral_acc;
+    private_nh.param("smooth_path", smooth_path_, false);
+    private_nh.param("smoothing_iterations", smoothing_iterations, 50);
+    private_nh.param("smoothing_weight", smoothing_weight, 0.3);
+    private_nh.param("smoothing_data_weight", smoothing_data_weight, 0.1);
+    private_nh.param("max_vel_x", max_vel_x, nominalvel_mpersecs);
+    private_nh.param("max_rotational_vel", max_rotational_vel, 1.0);
+    private_nh.param("acc_lim_x", acc_lim_x, 0.5);
+    private_nh.param("max_lateral_acc", max_lateral_acc, 0.5);
+    smoother_.setSmoothing(smoothing_iterations, smoothing_weight, smoothing_data_weight);
+    smoother_.setLimits(max_vel_x, max_rotational_vel, acc_lim_x, max_lateral_acc);
 
     int lethal_obstacle;
     private_nh.param("lethal_obstacle",lethal_obstacle,20);
@@ -110,6 +166,7 @@ void SBPLLatticePlanner::initialize(std::string name, costmap_2d::Costmap2DROS*
     inscribed_inflated_obstacle_ = lethal_obstacle_-1;
     sbpl_cost_multiplier_ = (unsigned char) (costmap_2d::INSCRIBED_INFLATED_OBSTACLE/inscribed_inflated_obstacle_ + 1);
     ROS_DEBUG("SBPL: lethal: %uz, inscribed inflated: %uz, multiplier: %uz",lethal_obstacle,inscribed_inflated_obstacle_,sbpl_cost_multiplier_);
+    buildCostLUT(lethal_obstacle_, cost_lut_);
     
     costmap_ros_ = costmap_ros;
     costmap_ros_->clearRobotFootprint();
@@ -119,54 +176,26 @@ void SBPLLatticePlanner::initialize(std::string name, costmap_2d::Costmap2DROS*
 
     if ("XYThetaLattice" == environment_type_){
       ROS_DEBUG("Using a 3D costmap for theta lattice\n");
-      env_ = new EnvironmentNAVXYTHETALAT();
+      if(heuristic_cache_size > 0){
+        ROS_DEBUG("Caching the heuristics of the last %d goals", heuristic_cache_size);
+        heuristic_env_ = new CachedHeuristicEnvironment(heuristic_cache_size, heuristic_reuse_distance);
+        env_ = heuristic_env_;
+      }
+      else
+        env_ = new EnvironmentNAVXYTHETALAT();
     }
     else{
       ROS_ERROR("XYThetaLattice is currently the only supported environment!\n");
       exit(1);
     }
 
-    if(!env_->SetEnvParameter("cost_inscribed_thresh",costMapCostToSBPLCost(costmap_2d::INSCRIBED_INFLATED_OBSTACLE))){
-      ROS_ERROR("Failed to set cost_inscribed_thresh parameter");
-      exit(1);
-    }
-    if(!env_->SetEnvParameter("cost_possibly_circumscribed_thresh", costMapCostToSBPLCost(cost_map_.getCircumscribedCost()))){
-      ROS_ERROR("Failed to set cost_possibly_circumscribed_thresh parameter");
-      exit(1);
-    }
-    int obst_cost_thresh = costMapCostToSBPLCost(costmap_2d::LETHAL_OBSTACLE);
-    vector<sbpl_2Dpt_t> perimeterptsV;
-    perimeterptsV.reserve(footprint.size());
-    for (size_t ii(0); ii < footprint.size(); ++ii) {
-      sbpl_2Dpt_t pt;
-      pt.x = footprint[ii].x;
-      pt.y = footprint[ii].y;
-      perimeterptsV.push_back(pt);
-    }
-
-    bool ret;
-    try{
-      ret = env_->InitializeEnv(costmap_ros_->getSizeInCellsX(), // width
-                                costmap_ros_->getSizeInCellsY(), // height
-                                0, // mapdata
-                                0, 0, 0, // start (x, y, theta, t)
-                                0, 0, 0, // goal (x, y, theta)
-                                0, 0, 0, //goal tolerance
-                                perimeterptsV, costmap_ros_->getResolution(), nominalvel_mpersecs,
-                                timetoturn45degsinplace_secs, obst_cost_thresh,
-                                primitive_filename_.c_str());
-    }
-    catch(SBPL_Exception e){
-      ROS_ERROR("SBPL encountered a fatal exception!");
-      ret = false;
-    }
-    if(!ret){
+    //the benchmark sets up its environment with the same code
+    if(!initializeLatticeEnvironment(env_, heuristic_env_, cost_map_, footprintToPerimeter(footprint), cost_lut_,
+                                     nominalvel_mpersecs, timetoturn45degsinplace_secs, primitive_filename_)){
       ROS_ERROR("SBPL initialization failed!");
       exit(1);
     }
-    for (ssize_t ix(0); ix < costmap_ros_->getSizeInCellsX(); ++ix)
-      for (ssize_t iy(0); iy < costmap_ros_->getSizeInCellsY(); ++iy)
-        env_->UpdateCost(ix, iy, costMapCostToSBPLCost(cost_map_.getCost(ix,iy)));
+    last_costs_.assign(cost_map_.getCharMap(), cost_map_.getCharMap() + cost_map_.getSizeInCellsX() * cost_map_.getSizeInCellsY());
 
     if ("ARAPlanner" == planner_type_){
       ROS_INFO("Planning with ARA*");
@@ -184,22 +213,55 @@ void SBPLLatticePlanner::initialize(std::string name, costmap_2d::Costmap2DROS*
     ROS_INFO("[sbpl_lattice_planner] Initialized successfully");
     plan_pub_ = private_nh.advertise<nav_msgs::Path>("plan", 1);
     stats_publisher_ = private_nh.advertise<sbpl_lattice_planner::SBPLLatticePlannerStats>("sbpl_lattice_planner_stats", 1);
+    profile_publisher_ = private_nh.advertise<sbpl_lattice_planner::SBPLLatticePlannerProfile>("sbpl_lattice_planner_profile", 1);
+    timed_plan_pub_ = private_nh.advertise<sbpl_lattice_planner::TimedPath>("timed_plan", 1);
+    tour_service_ = private_nh.advertiseService("plan_tour", &SBPLLatticePlanner::planTour, this);
+
+    if(background_replanning_){
+      ROS_INFO("[sbpl_lattice_planner] Improving plans in the background, %.2f seconds at a time", replan_slice_time_);
+      replan_thread_ = new boost::thread(boost::bind(&SBPLLatticePlanner::replanThread, this));
+    }
     
     initialized_ = true;
   }
 }
   
-//Taken from Sachin's sbpl_cart_planner
-//This rescales the costmap according to a rosparam which sets the obstacle cost
-unsigned char SBPLLatticePlanner::costMapCostToSBPLCost(unsigned char newcost){
-  if(newcost == costmap_2d::LETHAL_OBSTACLE)
-    return lethal_obstacle_;
-  else if(newcost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
-    return inscribed_inflated_obstacle_;
-  else if(newcost == 0 || newcost == costmap_2d::NO_INFORMATION)
-    return 0;
-  else
-    return (unsigned char) (newcost/sbpl_cost_multiplier_ + 0.5);
+int SBPLLatticePlanner::updateChangedCells(std::vector<nav2dcell_t>& changedcellsV){
+  const unsigned char* costs = cost_map_.getCharMap();
+  unsigned int size_x = cost_map_.getSizeInCellsX();
+  unsigned int num_cells = size_x * cost_map_.getSizeInCellsY();
+  if(num_cells != last_costs_.size()){
+    ROS_ERROR("The costmap changed size from %u to %u cells, the planner cannot follow", (unsigned int)last_costs_.size(), num_cells);
+    return -1;
+  }
+
+  //compare the raw costs a block at a time, only blocks that differ are looked at cell by cell
+  const unsigned int block_size = 64;
+  unsigned char* last_costs = &last_costs_[0];
+  for(unsigned int block = 0; block < num_cells; block += block_size){
+    unsigned int block_end = std::min(block + block_size, num_cells);
+    if(memcmp(costs + block, last_costs + block, block_end - block) == 0)
+      continue;
+
+    for(unsigned int i = block; i < block_end; ++i){
+      if(costs[i] == last_costs[i])
+        continue;
+      unsigned char oldCost = cost_lut_[last_costs[i]];
+      unsigned char newCost = cost_lut_[costs[i]];
+      last_costs[i] = costs[i];
+      if(oldCost == newCost)
+        continue;
+
+      nav2dcell_t nav2dcell;
+      nav2dcell.x = i % size_x;
+      nav2dcell.y = i / size_x;
+      env_->UpdateCost(nav2dcell.x, nav2dcell.y, newCost);
+      if(heuristic_env_)
+        heuristic_env_->setCellCost(nav2dcell.x, nav2dcell.y, newCost);
+      changedcellsV.push_back(nav2dcell);
+    }
+  }
+  return changedcellsV.size();
 }
 
 void SBPLLatticePlanner::publishStats(int solution_cost, int solution_size, 
@@ -224,6 +286,22 @@ void SBPLLatticePlanner::publishStats(int solution_cost, int solution_size,
   stats_publisher_.publish(stats);
 }
 
+void SBPLLatticePlanner::recordPlan(PlanSample& sample, const ros::WallTime& request_start){
+  sample.stamp = ros::Time::now().toSec();
+  sample.latency = (ros::WallTime::now() - request_start).toSec();
+  sample.allocated_time = allocated_time_;
+  sample.force_scratch_limit = force_scratch_limit_;
+
+  boost::mutex::scoped_lock lock(profile_mutex_);
+  profiler_.add(sample);
+
+  if(profile_publisher_.getNumSubscribers() > 0){
+    sbpl_lattice_planner::SBPLLatticePlannerProfile profile;
+    profiler_.getProfile(profile);
+    profile_publisher_.publish(profile);
+  }
+}
+
 bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
                                  const geometry_msgs::PoseStamped& goal,
                                  std::vector<geometry_msgs::PoseStamped>& plan){
@@ -232,13 +310,17 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
     return false;
   }
 
-  plan.clear();
-
-  ROS_DEBUG("[sbpl_lattice_planner] getting fresh copy of costmap");
-  costmap_ros_->clearRobotFootprint();
-  ROS_DEBUG("[sbpl_lattice_planner] robot footprint cleared");
+  ros::WallTime request_start = ros::WallTime::now();
+  PlanSample sample;
+  bool solved = planRequest(start, goal, plan, sample);
+  recordPlan(sample, request_start);
+  return solved;
+}
 
-  costmap_ros_->getCostmapCopy(cost_map_);
+bool SBPLLatticePlanner::planRequest(const geometry_msgs::PoseStamped& start,
+                                     const geometry_msgs::PoseStamped& goal,
+                                     std::vector<geometry_msgs::PoseStamped>& plan, PlanSample& sample){
+  plan.clear();
 
   ROS_INFO("[sbpl_lattice_planner] getting start point (%g,%g) goal point (%g,%g)",
            start.pose.position.x, start.pose.position.y,goal.pose.position.x, goal.pose.position.y);
@@ -305,12 +387,189 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
     pose.pose.orientation.w = temp.getW();
     plan.push_back(pose);
 
+    sample.solved = true;
     return true;
   }
 
+  //the background thread already has a path to this goal
+  if(background_replanning_ && serveBackgroundPlan(start, goal, plan)){
+    publishPlan(plan);
+    sample.solved = true;
+    return true;
+  }
+
+  {
+    boost::mutex::scoped_lock planner_lock(planner_mutex_);
+    if(background_replanning_){
+      //the background thread must let go of the old goal
+      boost::mutex::scoped_lock lock(plan_mutex_);
+      bg_active_ = false;
+    }
+    sample_ = PlanSample();
+    if(updateCosts() < 0 || !setStartAndGoal(start, goal)){
+      sample = sample_;
+      return false;
+    }
+
+    //setting planner parameters
+    ROS_DEBUG("allocated:%f, init eps:%f\n",allocated_time_,initial_epsilon_);
+    planner_->set_initialsolution_eps(initial_epsilon_);
+    //with background replanning we only wait for the first solution, the thread improves it
+    planner_->set_search_mode(background_replanning_);
+
+    ROS_DEBUG("[sbpl_lattice_planner] run planner");
+    int solution_cost;
+    if(!runPlanner(allocated_time_, start, plan, solution_cost)){
+      publishStats(solution_cost, 0, start, goal);
+      sample = sample_;
+      return false;
+    }
+    publishStats(solution_cost, plan.size(), start, goal);
+    sample = sample_;
+    if(heuristic_env_){
+      const HeuristicCache& cache = heuristic_env_->getCache();
+      ROS_DEBUG("[sbpl_lattice_planner] heuristic cache: %u tables, %u hits, %u near hits, %u misses",
+                cache.size(), cache.hits_, cache.near_hits_, cache.misses_);
+    }
+
+    if(background_replanning_){
+      boost::mutex::scoped_lock lock(plan_mutex_);
+      bg_start_ = start;
+      bg_goal_ = goal;
+      bg_plan_ = plan;
+      bg_epsilon_ = planner_->get_final_epsilon();
+      bg_time_ = 0.0;
+      bg_active_ = true;
+      bg_converged_ = bg_epsilon_ <= 1.0;
+      replan_cond_.notify_one();
+    }
+  }
+
+  publishPlan(plan);
+  return true;
+}
+
+bool SBPLLatticePlanner::planTour(PlanTour::Request& req, PlanTour::Response& res){
+  if(!initialized_){
+    ROS_ERROR("Global planner is not initialized");
+    return false;
+  }
+  if(req.goals.empty())
+    return true;
+
+  //node 0 is the start, node i the goal i - 1
+  unsigned int num_nodes = req.goals.size() + 1;
+  std::vector<int> cells(num_nodes, -1);
+  std::vector<unsigned char> costs;
+  unsigned int size_x, size_y;
+  {
+    boost::mutex::scoped_lock planner_lock(planner_mutex_);
+    if(updateCosts() < 0)
+      return false;
+    size_x = cost_map_.getSizeInCellsX();
+    size_y = cost_map_.getSizeInCellsY();
+    const unsigned char* charmap = cost_map_.getCharMap();
+    costs.resize(size_x * size_y);
+    for(unsigned int i = 0; i < costs.size(); ++i)
+      costs[i] = cost_lut_[charmap[i]];
+    for(unsigned int i = 0; i < num_nodes; ++i){
+      const geometry_msgs::PoseStamped& pose = i == 0 ? req.start : req.goals[i - 1];
+      unsigned int mx, my;
+      if(cost_map_.worldToMap(pose.pose.position.x, pose.pose.position.y, mx, my))
+        cells[i] = my * size_x + mx;
+    }
+  }
+
+  //the searches work on their own copy of the costs, the planner is free in the meantime
+  HeuristicCache grid(0, 0);
+  grid.setMap(size_x, size_y, costmap_ros_->getResolution(), cost_lut_[costmap_2d::INSCRIBED_INFLATED_OBSTACLE]);
+  std::vector<double> matrix(num_nodes * num_nodes, INFINITECOST);
+  for(unsigned int i = 0; i < num_nodes; ++i)
+    matrix[i * num_nodes + i] = 0;
+  unsigned int num_threads = tour_threads_ > 0 ? tour_threads_ : boost::thread::hardware_concurrency();
+  num_threads = std::max(1u, std::min(num_threads, num_nodes - 1));
+  ros::WallTime costs_start = ros::WallTime::now();
+  boost::thread_group threads;
+  for(unsigned int t = 1; t < num_threads; ++t)
+    threads.create_thread(boost::bind(&computeTourCosts, boost::cref(grid), boost::cref(costs), size_x,
+                                      boost::cref(cells), t, num_threads, boost::ref(matrix)));
+  computeTourCosts(grid, costs, size_x, cells, 0, num_threads, matrix);
+  threads.join_all();
+  ROS_DEBUG("[sbpl_lattice_planner] costs between %u tour nodes took %f seconds in %u threads",
+            num_nodes, (ros::WallTime::now() - costs_start).toSec(), num_threads);
+
+  //only the goals we can get to take part in the tour
+  std::vector<int> nodes(1, 0);
+  for(unsigned int i = 1; i < num_nodes; ++i){
+    if(matrix[i] < INFINITECOST)
+      nodes.push_back(i);
+    else
+      ROS_WARN("[sbpl_lattice_planner] goal %u of the tour can not be reached, leaving it out", i - 1);
+  }
+  unsigned int num_reachable = nodes.size();
+  std::vector<double> reachable(num_reachable * num_reachable);
+  for(unsigned int i = 0; i < num_reachable; ++i)
+    for(unsigned int j = 0; j < num_reachable; ++j)
+      reachable[i * num_reachable + j] = matrix[nodes[i] * num_nodes + nodes[j]] / nominalvel_mpersecs_;
+
+  std::vector<int> order;
+  orderTour(reachable, num_reachable, order);
+  res.total_cost = 0;
+  int prev = 0;
+  for(unsigned int k = 0; k < order.size(); ++k){
+    res.order.push_back(nodes[order[k]] - 1);
+    res.route.push_back(req.goals[nodes[order[k]] - 1]);
+    res.leg_costs.push_back((int)reachable[prev * num_reachable + order[k]]);
+    res.total_cost += res.leg_costs.back();
+    prev = order[k];
+  }
+  ROS_INFO("[sbpl_lattice_planner] tour through %u of %u goals, estimated cost %d",
+           (unsigned int)res.order.size(), num_nodes - 1, res.total_cost);
+
+  if(!req.plan_legs || res.route.empty())
+    return true;
+
+  boost::mutex::scoped_lock planner_lock(planner_mutex_);
+  if(background_replanning_){
+    //the background thread must let go of its goal
+    boost::mutex::scoped_lock lock(plan_mutex_);
+    bg_active_ = false;
+  }
+  planner_->set_initialsolution_eps(initial_epsilon_);
+  planner_->set_search_mode(false);
+
+  //a leg ends where the next one starts, so its goal heuristic is the next leg's start heuristic and comes from the cache
+  std::vector<geometry_msgs::PoseStamped> path, leg;
+  bool complete = true;
+  for(unsigned int k = 0; k < res.route.size(); ++k){
+    const geometry_msgs::PoseStamped& from = k == 0 ? req.start : res.route[k - 1];
+    int leg_cost;
+    if(!setStartAndGoal(from, res.route[k]) || !runPlanner(tour_leg_time_, req.start, leg, leg_cost)){
+      ROS_WARN("[sbpl_lattice_planner] failed to plan leg %u of the tour", k);
+      complete = false;
+      break;
+    }
+    res.total_cost += leg_cost - res.leg_costs[k];
+    res.leg_costs[k] = leg_cost;
+    path.insert(path.end(), leg.begin() + (path.empty() || leg.empty() ? 0 : 1), leg.end());
+  }
+  if(complete){
+    res.path.header.frame_id = costmap_ros_->getGlobalFrameID();
+    res.path.header.stamp = ros::Time::now();
+    res.path.poses = path;
+    publishPlan(path);
+  }
+  return true;
+}
+
+bool SBPLLatticePlanner::setStartAndGoal(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal){
+  double theta_start = 2 * atan2(start.pose.orientation.z, start.pose.orientation.w);
+  double theta_goal = 2 * atan2(goal.pose.orientation.z, goal.pose.orientation.w);
+
+  int start_id, goal_id;
   try{
-    int ret = env_->SetStart(start.pose.position.x - cost_map_.getOriginX(), start.pose.position.y - cost_map_.getOriginY(), theta_start);
-    if(ret < 0 || planner_->set_start(ret) == 0){
+    start_id = env_->SetStart(start.pose.position.x - cost_map_.getOriginX(), start.pose.position.y - cost_map_.getOriginY(), theta_start);
+    if(start_id < 0 || planner_->set_start(start_id) == 0){
       ROS_ERROR("ERROR: failed to set start state\n");
       return false;
     }
@@ -321,8 +580,8 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
   }
 
   try{
-    int ret = env_->SetGoal(goal.pose.position.x - cost_map_.getOriginX(), goal.pose.position.y - cost_map_.getOriginY(), theta_goal);
-    if(ret < 0 || planner_->set_goal(ret) == 0){
+    goal_id = env_->SetGoal(goal.pose.position.x - cost_map_.getOriginX(), goal.pose.position.y - cost_map_.getOriginY(), theta_goal);
+    if(goal_id < 0 || planner_->set_goal(goal_id) == 0){
       ROS_ERROR("ERROR: failed to set goal state\n");
       return false;
     }
@@ -331,41 +590,23 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
     ROS_ERROR("SBPL encountered a fatal exception while setting the goal state");
     return false;
   }
-  
-  int offOnCount = 0;
-  int onOffCount = 0;
-  int allCount = 0;
-  vector<nav2dcell_t> changedcellsV;
-
-  for(unsigned int ix = 0; ix < cost_map_.getSizeInCellsX(); ix++) {
-    for(unsigned int iy = 0; iy < cost_map_.getSizeInCellsY(); iy++) {
-
-      unsigned char oldCost = env_->GetMapCost(ix,iy);
-      unsigned char newCost = costMapCostToSBPLCost(cost_map_.getCost(ix,iy));
-
-      if(oldCost == newCost) continue;
-
-      allCount++;
 
-      //first case - off cell goes on
-
-      if((oldCost != costMapCostToSBPLCost(costmap_2d::LETHAL_OBSTACLE) && oldCost != costMapCostToSBPLCost(costmap_2d::INSCRIBED_INFLATED_OBSTACLE)) &&
-          (newCost == costMapCostToSBPLCost(costmap_2d::LETHAL_OBSTACLE) || newCost == costMapCostToSBPLCost(costmap_2d::INSCRIBED_INFLATED_OBSTACLE))) {
-        offOnCount++;
-      }
+  if(heuristic_env_)
+    heuristic_env_->setEndpoints(start_id, goal_id);
+  return true;
+}
 
-      if((oldCost == costMapCostToSBPLCost(costmap_2d::LETHAL_OBSTACLE) || oldCost == costMapCostToSBPLCost(costmap_2d::INSCRIBED_INFLATED_OBSTACLE)) &&
-          (newCost != costMapCostToSBPLCost(costmap_2d::LETHAL_OBSTACLE) && newCost != costMapCostToSBPLCost(costmap_2d::INSCRIBED_INFLATED_OBSTACLE))) {
-        onOffCount++;
-      }
-      env_->UpdateCost(ix, iy, costMapCostToSBPLCost(cost_map_.getCost(ix,iy)));
+int SBPLLatticePlanner::updateCosts(){
+  ros::WallTime diff_start = ros::WallTime::now();
+  costmap_ros_->clearRobotFootprint();
+  costmap_ros_->getCostmapCopy(cost_map_);
 
-      nav2dcell_t nav2dcell;
-      nav2dcell.x = ix;
-      nav2dcell.y = iy;
-      changedcellsV.push_back(nav2dcell);
-    }
-  }
+  vector<nav2dcell_t> changedcellsV;
+  int allCount = updateChangedCells(changedcellsV);
+  if(allCount < 0)
+    return -1;
+  sample_.changed_cells = allCount;
+  sample_.from_scratch = allCount > force_scratch_limit_;
 
   try{
     if(!changedcellsV.empty()){
@@ -379,24 +620,28 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
   }
   catch(SBPL_Exception e){
     ROS_ERROR("SBPL failed to update the costmap");
-    return false;
+    return -1;
   }
+  sample_.diff_time = (ros::WallTime::now() - diff_start).toSec();
+  return allCount;
+}
 
-  //setting planner parameters
-  ROS_DEBUG("allocated:%f, init eps:%f\n",allocated_time_,initial_epsilon_);
-  planner_->set_initialsolution_eps(initial_epsilon_);
-  planner_->set_search_mode(false);
-
-  ROS_DEBUG("[sbpl_lattice_planner] run planner");
+bool SBPLLatticePlanner::runPlanner(double allocated_time, const geometry_msgs::PoseStamped& start,
+                                    std::vector<geometry_msgs::PoseStamped>& plan, int& solution_cost){
+  plan.clear();
   vector<int> solution_stateIDs;
-  int solution_cost;
+  solution_cost = 0;
+  sample_.searched = true;
+  sample_.solved = false;
+  ros::WallTime search_start = ros::WallTime::now();
   try{
-    int ret = planner_->replan(allocated_time_, &solution_stateIDs, &solution_cost);
+    int ret = planner_->replan(allocated_time, &solution_stateIDs, &solution_cost);
+    sample_.search_time = (ros::WallTime::now() - search_start).toSec();
+    sample_.expansions = planner_->get_n_expands();
     if(ret)
       ROS_DEBUG("Solution is found\n");
     else{
       ROS_INFO("Solution not found\n");
-      publishStats(solution_cost, 0, start, goal);
       return false;
     }
   }
@@ -404,6 +649,10 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
     ROS_ERROR("SBPL encountered a fatal exception while planning");
     return false;
   }
+  sample_.epsilon = planner_->get_final_epsilon();
+  sample_.solution_cost = solution_cost;
+
+  ros::WallTime conversion_start = ros::WallTime::now();
 
   ROS_DEBUG("size of solution=%d", (int)solution_stateIDs.size());
 
@@ -418,11 +667,7 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
   ROS_DEBUG("Plan has %d points.\n", (int)sbpl_path.size());
   ros::Time plan_time = ros::Time::now();
 
-  //create a message for the plan 
-  nav_msgs::Path gui_path;
-  gui_path.set_poses_size(sbpl_path.size());
-  gui_path.header.frame_id = costmap_ros_->getGlobalFrameID();
-  gui_path.header.stamp = plan_time;
+  plan.reserve(sbpl_path.size());
   for(unsigned int i=0; i<sbpl_path.size(); i++){
     geometry_msgs::PoseStamped pose;
     pose.header.stamp = plan_time;
@@ -440,14 +685,126 @@ bool SBPLLatticePlanner::makePlan(const geometry_msgs::PoseStamped& start,
     pose.pose.orientation.w = temp.getW();
 
     plan.push_back(pose);
+  }
+  if(smooth_path_){
+    smoother_.smooth(cost_map_, plan);
+    ROS_DEBUG("Smoothed plan has %d points.\n", (int)plan.size());
+  }
+  sample_.conversion_time = (ros::WallTime::now() - conversion_start).toSec();
+  sample_.solved = true;
+  return true;
+}
 
+void SBPLLatticePlanner::publishPlan(const std::vector<geometry_msgs::PoseStamped>& plan){
+  //create a message for the plan 
+  nav_msgs::Path gui_path;
+  gui_path.set_poses_size(plan.size());
+  gui_path.header.frame_id = costmap_ros_->getGlobalFrameID();
+  gui_path.header.stamp = plan.empty() ? ros::Time::now() : plan[0].header.stamp;
+  for(unsigned int i=0; i<plan.size(); i++){
     gui_path.poses[i].pose.position.x = plan[i].pose.position.x;
     gui_path.poses[i].pose.position.y = plan[i].pose.position.y;
     gui_path.poses[i].pose.position.z = plan[i].pose.position.z;
   }
   plan_pub_.publish(gui_path);
-  publishStats(solution_cost, sbpl_path.size(), start, goal);
 
+  if(timed_plan_pub_.getNumSubscribers() > 0){
+    sbpl_lattice_planner::TimedPath timed_path;
+    timed_path.header = gui_path.header;
+    timed_path.poses = plan;
+    smoother_.timeParameterize(plan, timed_path.velocities, timed_path.times);
+    timed_plan_pub_.publish(timed_path);
+  }
+}
+
+bool SBPLLatticePlanner::sameGoal(const geometry_msgs::PoseStamped& a, const geometry_msgs::PoseStamped& b) const{
+  double dx = a.pose.position.x - b.pose.position.x;
+  double dy = a.pose.position.y - b.pose.position.y;
+  double theta_a = 2 * atan2(a.pose.orientation.z, a.pose.orientation.w);
+  double theta_b = 2 * atan2(b.pose.orientation.z, b.pose.orientation.w);
+  double resolution = costmap_ros_->getResolution();
+  return dx*dx + dy*dy <= 0.25*resolution*resolution &&
+    fabs(angles::shortest_angular_distance(theta_a, theta_b)) < 1e-3;
+}
+
+bool SBPLLatticePlanner::serveBackgroundPlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                                             std::vector<geometry_msgs::PoseStamped>& plan){
+  boost::mutex::scoped_lock lock(plan_mutex_);
+  if(!bg_active_ || bg_plan_.empty() || !sameGoal(goal, bg_goal_))
+    return false;
+
+  //the robot has moved along the path since it was planned: serve it from the pose closest to the robot
+  unsigned int closest = 0;
+  double closest_dist = DBL_MAX;
+  for(unsigned int i = 0; i < bg_plan_.size(); ++i){
+    double dx = bg_plan_[i].pose.position.x - start.pose.position.x;
+    double dy = bg_plan_[i].pose.position.y - start.pose.position.y;
+    if(dx*dx + dy*dy < closest_dist){
+      closest_dist = dx*dx + dy*dy;
+      closest = i;
+    }
+  }
+  plan.assign(bg_plan_.begin() + closest, bg_plan_.end());
+  ROS_DEBUG("[sbpl_lattice_planner] serving the background plan (eps %f) from pose %u of %u", bg_epsilon_, closest, (unsigned int)bg_plan_.size());
+
+  //keep improving from where the robot is now, and follow the costmap
+  bg_start_ = start;
+  bg_time_ = 0.0;
+  bg_converged_ = false;
+  replan_cond_.notify_one();
   return true;
 }
+
+void SBPLLatticePlanner::replanThread(){
+  boost::mutex::scoped_lock lock(plan_mutex_);
+  while(!shutdown_){
+    //nothing to improve until the next request
+    if(!bg_active_ || bg_converged_){
+      replan_cond_.wait(lock);
+      continue;
+    }
+    geometry_msgs::PoseStamped start = bg_start_, goal = bg_goal_;
+    double epsilon = bg_epsilon_;
+    lock.unlock();
+
+    std::vector<geometry_msgs::PoseStamped> plan;
+    bool found = false;
+    double solution_epsilon = epsilon;
+    {
+      boost::mutex::scoped_lock planner_lock(planner_mutex_);
+      if(updateCosts() >= 0 && setStartAndGoal(start, goal)){
+        //if the costs changed, the search restarts from a lower epsilon than the first one
+        planner_->set_initialsolution_eps(std::max(1.0, epsilon - epsilon_decay_));
+        planner_->set_search_mode(false);
+        int solution_cost;
+        found = runPlanner(replan_slice_time_, start, plan, solution_cost);
+        solution_epsilon = planner_->get_final_epsilon();
+      }
+    }
+
+    lock.lock();
+    //a new request may have come in while we were planning
+    if(!bg_active_ || !sameGoal(goal, bg_goal_))
+      continue;
+    bg_time_ += replan_slice_time_;
+    if(found){
+      bg_plan_ = plan;
+      bg_epsilon_ = solution_epsilon;
+    }
+    if(bg_epsilon_ <= 1.0 || bg_time_ >= allocated_time_)
+      bg_converged_ = true;
+  }
+}
+
+SBPLLatticePlanner::~SBPLLatticePlanner(){
+  if(replan_thread_){
+    {
+      boost::mutex::scoped_lock lock(plan_mutex_);
+      shutdown_ = true;
+      replan_cond_.notify_one();
+    }
+    replan_thread_->join();
+    delete replan_thread_;
+  }
+}
 };
@@ -0,0 +1,153 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include <sbpl_lattice_planner/tour_planner.h>
+#include <algorithm>
+#include <cfloat>
+
+using namespace std;
+
+namespace sbpl_lattice_planner{
+
+namespace{
+  //the costs between the nodes of a tour, -1 stands for the open end of the tour and costs nothing
+  struct TourCosts{
+    TourCosts(const vector<double>& costs, unsigned int num_nodes) : costs_(costs), num_nodes_(num_nodes) {}
+    double operator()(int a, int b) const {
+      if(a < 0 || b < 0)
+        return 0.0;
+      return costs_[a * num_nodes_ + b];
+    }
+    const vector<double>& costs_;
+    unsigned int num_nodes_;
+  };
+
+  //a move has to gain at least this much, so rounding can not make us go back and forth
+  const double min_gain = 1e-6;
+  const int max_passes = 1000;
+
+  int nodeAt(const vector<int>& tour, int i){
+    return i < (int)tour.size() ? tour[i] : -1;
+  }
+
+  //reverse a stretch of the tour wherever that makes it shorter
+  bool twoOpt(vector<int>& tour, const TourCosts& cost){
+    int n = tour.size();
+    bool improved = false;
+    for(int i = 1; i < n - 1; ++i){
+      for(int k = i + 1; k < n; ++k){
+        int next = nodeAt(tour, k + 1);
+        double before = cost(tour[i - 1], tour[i]) + cost(tour[k], next);
+        double after = cost(tour[i - 1], tour[k]) + cost(tour[i], next);
+        if(after < before - min_gain){
+          reverse(tour.begin() + i, tour.begin() + k + 1);
+          improved = true;
+        }
+      }
+    }
+    return improved;
+  }
+
+  //move a stretch of up to three nodes to another place in the tour, possibly reversed, wherever that makes it shorter
+  bool orOpt(vector<int>& tour, const TourCosts& cost){
+    int n = tour.size();
+    bool improved = false;
+    for(int len = 1; len <= 3; ++len){
+      for(int s = 1; s + len <= n; ++s){
+        int e = s + len - 1;
+        int prev = tour[s - 1], next = nodeAt(tour, e + 1);
+        double removed = cost(prev, tour[s]) + cost(tour[e], next) - cost(prev, next);
+        for(int j = 0; j < n; ++j){
+          //inserting between j and j + 1 would leave the stretch where it is
+          if(j >= s - 1 && j <= e)
+            continue;
+          int a = tour[j], b = nodeAt(tour, j + 1);
+          double forward = cost(a, tour[s]) + cost(tour[e], b) - cost(a, b);
+          double backward = cost(a, tour[e]) + cost(tour[s], b) - cost(a, b);
+          if(min(forward, backward) >= removed - min_gain)
+            continue;
+
+          vector<int> stretch(tour.begin() + s, tour.begin() + e + 1);
+          if(backward < forward)
+            reverse(stretch.begin(), stretch.end());
+          tour.erase(tour.begin() + s, tour.begin() + e + 1);
+          int insert_at = j < s ? j + 1 : j + 1 - len;
+          tour.insert(tour.begin() + insert_at, stretch.begin(), stretch.end());
+          improved = true;
+          break;
+        }
+      }
+    }
+    return improved;
+  }
+};
+
+double orderTour(const vector<double>& costs, unsigned int num_nodes, vector<int>& order){
+  TourCosts cost(costs, num_nodes);
+  vector<int> tour(1, 0);
+  tour.reserve(num_nodes);
+
+  //nearest neighbor
+  vector<bool> visited(num_nodes, false);
+  visited[0] = true;
+  for(unsigned int step = 1; step < num_nodes; ++step){
+    int last = tour.back(), nearest = -1;
+    double nearest_cost = DBL_MAX;
+    for(unsigned int i = 1; i < num_nodes; ++i){
+      if(!visited[i] && cost(last, i) < nearest_cost){
+        nearest_cost = cost(last, i);
+        nearest = i;
+      }
+    }
+    visited[nearest] = true;
+    tour.push_back(nearest);
+  }
+
+  //every pass that changes the tour makes it shorter, so this ends, the bound is for safety only
+  for(int pass = 0; pass < max_passes; ++pass){
+    bool improved = twoOpt(tour, cost);
+    if(orOpt(tour, cost))
+      improved = true;
+    if(!improved)
+      break;
+  }
+
+  double total = 0.0;
+  for(unsigned int i = 1; i < tour.size(); ++i)
+    total += cost(tour[i - 1], tour[i]);
+  order.assign(tour.begin() + 1, tour.end());
+  return total;
+}
+};